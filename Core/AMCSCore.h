@@ -11,3 +11,5 @@
 #include "Launcher/LauncherCore.h"
 #include "Launcher/LaunchOptions.h"
 #include "Launcher/LoaderInterfaces.h"
+#include "Network/MetadataCache.h"
+#include "Network/NetworkService.h"
@@ -1,15 +1,127 @@
 #include "McApi.h"
 
+#include "../Network/NetworkService.h"
+
 #include <QDir>
 #include <QEventLoop>
+#include <QFutureWatcher>
 #include <QJsonArray>
 #include <QJsonDocument>
 #include <QNetworkReply>
 #include <QFile>
 #include <QFileInfo>
+#include <QPromise>
 
 namespace AMCS::Core::Api
 {
+namespace
+{
+// How long a manifest past its cache window is still served while a newer one is fetched
+constexpr int kManifestStaleSeconds = 24 * 60 * 60;
+
+struct HttpReply
+{
+    int httpStatus = 0;
+    QString errorString;  // network error, empty on success
+    QByteArray body;
+};
+
+template <typename T>
+QFuture<McApi::Result<T>> readyFuture(const McApi::Result<T> &result)
+{
+    QPromise<McApi::Result<T>> promise;
+    promise.start();
+    promise.addResult(result);
+    promise.finish();
+    return promise.future();
+}
+
+template <typename T>
+QFuture<McApi::Result<T>> failedFuture(const QString &error)
+{
+    McApi::Result<T> result;
+    result.error = error;
+    return readyFuture(result);
+}
+
+template <typename T>
+McApi::Result<T> waitFor(const QFuture<McApi::Result<T>> &future)
+{
+    // Replies and the continuations bound to McApi are delivered through this thread's events
+    if (!future.isFinished()) {
+        QEventLoop loop;
+        QFutureWatcher<McApi::Result<T>> watcher;
+        QObject::connect(&watcher, &QFutureWatcherBase::finished, &loop, &QEventLoop::quit);
+        watcher.setFuture(future);
+        if (!future.isFinished()) {
+            loop.exec();
+        }
+    }
+    if (future.resultCount() == 0) {
+        McApi::Result<T> result;
+        result.error = QStringLiteral("Request canceled");
+        return result;
+    }
+    return future.result();
+}
+
+// Sends on the calling thread's shared manager; the future finishes from that thread's event loop
+QFuture<HttpReply> send(QNetworkRequest request, const QByteArray *postBody = nullptr)
+{
+    auto *network = Network::NetworkService::getInstance();
+    network->prepareRequest(request);
+    QNetworkReply *reply = postBody ? network->manager()->post(request, *postBody)
+                                    : network->manager()->get(request);
+
+    return QtFuture::connect(reply, &QNetworkReply::finished).then([reply]() {
+        reply->deleteLater();
+
+        HttpReply http;
+        http.httpStatus = reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
+        if (reply->error() != QNetworkReply::NoError) {
+            http.errorString = reply->errorString();
+        }
+        http.body = reply->readAll();
+        return http;
+    });
+}
+
+QJsonObject errorObject(const QString &error, const QString &description)
+{
+    QJsonObject errorObj;
+    errorObj.insert(QStringLiteral("error"), error);
+    errorObj.insert(QStringLiteral("error_description"), description);
+    return errorObj;
+}
+
+QJsonObject parseObject(const QByteArray &data)
+{
+    QJsonParseError parseError;
+    const QJsonDocument doc = QJsonDocument::fromJson(data, &parseError);
+    if (parseError.error != QJsonParseError::NoError) {
+        return errorObject(QStringLiteral("parse_error"), parseError.errorString());
+    }
+
+    if (!doc.isObject()) {
+        return errorObject(QStringLiteral("invalid_response"), QStringLiteral("Response is not a JSON object"));
+    }
+
+    return doc.object();
+}
+
+// POST endpoints report failures in their body, so only the shape of the response is checked
+QJsonObject parsePostBody(const QByteArray &data)
+{
+    QJsonParseError parseError;
+    const QJsonDocument doc = QJsonDocument::fromJson(data, &parseError);
+    if (parseError.error != QJsonParseError::NoError || !doc.isObject()) {
+        return errorObject(QStringLiteral("invalid_response"), QStringLiteral("Non-JSON response"));
+    }
+
+    return doc.object();
+}
+} // namespace
+
 McApi::McApi(Auth::McAccount *account, QObject *parent)
     : QObject(parent)
     , m_account(account)
@@ -187,80 +299,80 @@ int McApi::versionManifestCacheSeconds() const
     return m_versionManifestCacheSeconds;
 }
 
-bool McApi::fetchProfile()
+QFuture<McApi::Result<McApi::Profile>> McApi::fetchProfileAsync()
 {
-    m_lastError.clear();
-
     if (!m_account) {
-        m_lastError = QStringLiteral("Account is null");
-        return false;
+        return failedFuture<Profile>(QStringLiteral("Account is null"));
     }
 
-    const QString accessToken = m_account->mcAccessToken();
-    if (accessToken.isEmpty()) {
-        m_lastError = QStringLiteral("Minecraft access token empty");
-        return false;
+    if (m_account->mcAccessToken().isEmpty()) {
+        return failedFuture<Profile>(QStringLiteral("Minecraft access token empty"));
     }
 
-    QUrl url(m_profileApiUrl);
-    int status = 0;
-    QJsonObject response = getJson(url, &status);
-
-    if (status == 401) {
-        m_lastError = QStringLiteral("Unauthorized: access token invalid");
-        return false;
-    }
-
-    if (!response.contains("id") || !response.contains("name")) {
-        m_lastError = QStringLiteral("Profile response missing id or name");
-        return false;
-    }
-
-    m_profile.id = response.value("id").toString();
-    m_profile.name = response.value("name").toString();
-
-    if (m_account) {
-        m_account->setUuid(m_profile.id);
-        if (!m_profile.name.isEmpty()) {
-            m_account->setAccountName(m_profile.name);
+    return getJson(QUrl(m_profileApiUrl)).then(this, [this](const JsonReply &reply) {
+        Result<Profile> result;
+        if (reply.httpStatus == 401) {
+            result.error = QStringLiteral("Unauthorized: access token invalid");
+            return result;
         }
-    }
-
-    m_profile.skinUrl.clear();
-    m_profile.capeUrl.clear();
-    m_profile.skins.clear();
-    m_profile.capes.clear();
 
-    const QJsonArray skins = response.value("skins").toArray();
-    for (const auto &skinVal : skins) {
-        const QJsonObject skinObj = skinVal.toObject();
-        Skin skin;
-        skin.id = skinObj.value("id").toString();
-        skin.url = skinObj.value("url").toString();
-        skin.state = skinObj.value("state").toString();
-        m_profile.skins.append(skin);
+        const QJsonObject &response = reply.json;
+        if (!response.contains("id") || !response.contains("name")) {
+            result.error = QStringLiteral("Profile response missing id or name");
+            return result;
+        }
 
-        if (skin.state == QLatin1String("ACTIVE")) {
-            m_profile.skinUrl = skin.url;
+        Profile profile;
+        profile.id = response.value("id").toString();
+        profile.name = response.value("name").toString();
+
+        const QJsonArray skins = response.value("skins").toArray();
+        for (const auto &skinVal : skins) {
+            const QJsonObject skinObj = skinVal.toObject();
+            Skin skin;
+            skin.id = skinObj.value("id").toString();
+            skin.url = skinObj.value("url").toString();
+            skin.state = skinObj.value("state").toString();
+            profile.skins.append(skin);
+
+            if (skin.state == QLatin1String("ACTIVE")) {
+                profile.skinUrl = skin.url;
+            }
         }
-    }
 
-    const QJsonArray capes = response.value("capes").toArray();
-    for (const auto &capeVal : capes) {
-        const QJsonObject capeObj = capeVal.toObject();
-        Cape cape;
-        cape.id = capeObj.value("id").toString();
-        cape.url = capeObj.value("url").toString();
-        cape.state = capeObj.value("state").toString();
-        cape.alias = capeObj.value("alias").toString();
-        m_profile.capes.append(cape);
+        const QJsonArray capes = response.value("capes").toArray();
+        for (const auto &capeVal : capes) {
+            const QJsonObject capeObj = capeVal.toObject();
+            Cape cape;
+            cape.id = capeObj.value("id").toString();
+            cape.url = capeObj.value("url").toString();
+            cape.state = capeObj.value("state").toString();
+            cape.alias = capeObj.value("alias").toString();
+            profile.capes.append(cape);
+
+            if (cape.state == QLatin1String("ACTIVE")) {
+                profile.capeUrl = cape.url;
+            }
+        }
 
-        if (cape.state == QLatin1String("ACTIVE")) {
-            m_profile.capeUrl = cape.url;
+        m_profile = profile;
+        if (m_account) {
+            m_account->setUuid(m_profile.id);
+            if (!m_profile.name.isEmpty()) {
+                m_account->setAccountName(m_profile.name);
+            }
         }
-    }
 
-    return true;
+        result.value = profile;
+        return result;
+    });
+}
+
+bool McApi::fetchProfile()
+{
+    const Result<Profile> result = waitFor(fetchProfileAsync());
+    m_lastError = result.error;
+    return result.isOk();
 }
 
 McApi::Profile McApi::profile() const
@@ -313,74 +425,61 @@ Auth::McAccount *McApi::account() const
     return m_account;
 }
 
-bool McApi::checkHasGame()
+QFuture<McApi::Result<bool>> McApi::checkHasGameAsync()
 {
-    m_lastError.clear();
-
     if (!m_account) {
-        m_lastError = QStringLiteral("Account is null");
-        return false;
+        return failedFuture<bool>(QStringLiteral("Account is null"));
     }
 
-    const QString accessToken = m_account->mcAccessToken();
-    if (accessToken.isEmpty()) {
-        m_lastError = QStringLiteral("Minecraft access token empty");
-        return false;
+    if (m_account->mcAccessToken().isEmpty()) {
+        return failedFuture<bool>(QStringLiteral("Minecraft access token empty"));
     }
 
-    QUrl url(m_entitlementsApiUrl);
-    int status = 0;
-    QJsonObject response = getJson(url, &status);
-    if (status == 401) {
-        m_lastError = QStringLiteral("Unauthorized: access token invalid");
-        return false;
-    }
+    return getJson(QUrl(m_entitlementsApiUrl)).then(this, [this](const JsonReply &reply) {
+        Result<bool> result;
+        if (reply.httpStatus == 401) {
+            result.error = QStringLiteral("Unauthorized: access token invalid");
+            return result;
+        }
 
-    if (response.contains("error")) {
-        m_lastError = response.value("error").toString();
-        return false;
-    }
+        if (reply.json.contains("error")) {
+            result.error = reply.json.value("error").toString();
+            return result;
+        }
 
-    m_hasGameLicense = response.value("items").toArray().count() > 0 ||
-                       response.value("signature").toString() != QString();
-    return true;
+        m_hasGameLicense = reply.json.value("items").toArray().count() > 0 ||
+                           reply.json.value("signature").toString() != QString();
+        result.value = m_hasGameLicense;
+        return result;
+    });
 }
 
-bool McApi::uploadSkin(const QString &filePath, bool isSlim)
+bool McApi::checkHasGame()
 {
-    m_lastError.clear();
+    const Result<bool> result = waitFor(checkHasGameAsync());
+    m_lastError = result.error;
+    return result.isOk();
+}
 
+QFuture<McApi::Result<bool>> McApi::uploadSkinAsync(const QString &filePath, bool isSlim)
+{
     if (!m_account) {
-        m_lastError = QStringLiteral("Account is null");
-        return false;
+        return failedFuture<bool>(QStringLiteral("Account is null"));
     }
 
     if (filePath.isEmpty()) {
-        m_lastError = QStringLiteral("File path empty");
-        return false;
+        return failedFuture<bool>(QStringLiteral("File path empty"));
     }
 
     QFile file(filePath);
     if (!file.open(QIODevice::ReadOnly)) {
-        m_lastError = QStringLiteral("Failed to open file: ") + filePath;
-        return false;
+        return failedFuture<bool>(QStringLiteral("Failed to open file: ") + filePath);
     }
 
     QByteArray skinData = file.readAll();
     file.close();
 
-    QUrl url(m_skinApiUrl);
-
-    QMap<QString, QByteArray> fields;
-    fields.insert(QStringLiteral("variant"), isSlim ? "slim" : "classic");
-
-    QNetworkRequest request(url);
-    request.setHeader(QNetworkRequest::UserAgentHeader, m_userAgent);
-
-    const QString accessToken = m_account ? m_account->mcAccessToken() : QString();
-    if (!accessToken.isEmpty()) {
-        request.setRawHeader("Authorization", QByteArray("Bearer ") + accessToken.toUtf8());
-    }
+    QNetworkRequest request = buildRequest(QUrl(m_skinApiUrl), true);
 
     QString boundary = QStringLiteral("----AMCS");
     QByteArray body;
@@ -396,162 +495,187 @@ bool McApi::uploadSkin(const QString &filePath, bool isSlim)
     request.setHeader(QNetworkRequest::ContentTypeHeader,
                       QString("multipart/form-data; boundary=%1").arg(boundary));
 
-    QNetworkReply *reply = m_nam.post(request, body);
-
-    QEventLoop loop;
-    QObject::connect(reply, &QNetworkReply::finished, &loop, &QEventLoop::quit);
-    loop.exec();
-
-    int status = reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
-    reply->readAll();
-    reply->deleteLater();
-
-    if (status != 200) {
-        m_lastError = QStringLiteral("Upload failed, status: %1").arg(status);
-        return false;
-    }
-
-    return true;
+    return send(request, &body).then([](const HttpReply &reply) {
+        Result<bool> result;
+        if (reply.httpStatus != 200) {
+            result.error = QStringLiteral("Upload failed, status: %1").arg(reply.httpStatus);
+            return result;
+        }
+        result.value = true;
+        return result;
+    });
 }
 
-bool McApi::fetchMCVersion(QVector<MCVersion> &outVersions, VersionSource source, const QString &customBaseUrl)
+bool McApi::uploadSkin(const QString &filePath, bool isSlim)
 {
-    m_lastError.clear();
-    outVersions.clear();
-
-    QJsonObject response;
-    if (!fetchVersionManifest(response, source, customBaseUrl)) {
-        return false;
-    }
-
-    if (!response.contains("versions") || !response.value("versions").isArray()) {
-        m_lastError = QStringLiteral("Version manifest missing versions");
-        return false;
-    }
+    const Result<bool> result = waitFor(uploadSkinAsync(filePath, isSlim));
+    m_lastError = result.error;
+    return result.isOk();
+}
 
-    const QJsonArray versions = response.value("versions").toArray();
-    for (const auto &item : versions) {
-        const QJsonObject obj = item.toObject();
-        const QString id = obj.value("id").toString();
-        if (id.isEmpty()) {
-            continue;
+QFuture<McApi::Result<QVector<McApi::MCVersion>>> McApi::fetchMCVersionAsync(VersionSource source,
+                                                                             const QString &customBaseUrl)
+{
+    return fetchVersionManifest(source, customBaseUrl).then([](const Result<QJsonObject> &manifest) {
+        Result<QVector<MCVersion>> result;
+        if (!manifest.isOk()) {
+            result.error = manifest.error;
+            return result;
         }
 
-        MCVersion ver;
-        ver.id = id;
-        ver.type = obj.value("type").toString();
-        ver.url = obj.value("url").toString();
-        ver.time = QDateTime::fromString(obj.value("time").toString(), Qt::ISODate).toUTC();
-        ver.releaseTime = QDateTime::fromString(obj.value("releaseTime").toString(), Qt::ISODate).toUTC();
-        outVersions.append(ver);
-    }
+        const QJsonObject &response = manifest.value;
+        if (!response.contains("versions") || !response.value("versions").isArray()) {
+            result.error = QStringLiteral("Version manifest missing versions");
+            return result;
+        }
 
-    if (outVersions.isEmpty()) {
-        m_lastError = QStringLiteral("Version list empty");
-        return false;
-    }
+        const QJsonArray versions = response.value("versions").toArray();
+        for (const auto &item : versions) {
+            const QJsonObject obj = item.toObject();
+            const QString id = obj.value("id").toString();
+            if (id.isEmpty()) {
+                continue;
+            }
+
+            MCVersion ver;
+            ver.id = id;
+            ver.type = obj.value("type").toString();
+            ver.url = obj.value("url").toString();
+            ver.time = QDateTime::fromString(obj.value("time").toString(), Qt::ISODate).toUTC();
+            ver.releaseTime = QDateTime::fromString(obj.value("releaseTime").toString(), Qt::ISODate).toUTC();
+            result.value.append(ver);
+        }
 
-    return true;
+        if (result.value.isEmpty()) {
+            result.error = QStringLiteral("Version list empty");
+        }
+        return result;
+    });
 }
 
-bool McApi::getLatestMCVersion(QVector<MCVersion> &outLatest, VersionSource source,
-                              const QString &customBaseUrl)
+bool McApi::fetchMCVersion(QVector<MCVersion> &outVersions, VersionSource source, const QString &customBaseUrl)
 {
-    m_lastError.clear();
-    outLatest.clear();
-
-    QJsonObject response;
-    if (!fetchVersionManifest(response, source, customBaseUrl)) {
-        return false;
-    }
-
-    if (!response.contains("latest") || !response.value("latest").isObject()) {
-        m_lastError = QStringLiteral("Version manifest missing latest");
-        return false;
-    }
-
-    if (!response.contains("versions") || !response.value("versions").isArray()) {
-        m_lastError = QStringLiteral("Version manifest missing versions");
-        return false;
-    }
-
-    const QJsonObject latestObj = response.value("latest").toObject();
-    const QString latestRelease = latestObj.value("release").toString();
-    const QString latestSnapshot = latestObj.value("snapshot").toString();
+    const Result<QVector<MCVersion>> result = waitFor(fetchMCVersionAsync(source, customBaseUrl));
+    m_lastError = result.error;
+    outVersions = result.value;
+    return result.isOk();
+}
 
-    MCVersion releaseVersion;
-    MCVersion snapshotVersion;
-    bool foundRelease = false;
-    bool foundSnapshot = false;
+QFuture<McApi::Result<QVector<McApi::MCVersion>>> McApi::getLatestMCVersionAsync(VersionSource source,
+                                                                                 const QString &customBaseUrl)
+{
+    return fetchVersionManifest(source, customBaseUrl).then([](const Result<QJsonObject> &manifest) {
+        Result<QVector<MCVersion>> result;
+        if (!manifest.isOk()) {
+            result.error = manifest.error;
+            return result;
+        }
 
-    const QJsonArray versions = response.value("versions").toArray();
-    for (const auto &item : versions) {
-        const QJsonObject obj = item.toObject();
-        const QString id = obj.value("id").toString();
-        if (id.isEmpty()) {
-            continue;
+        const QJsonObject &response = manifest.value;
+        if (!response.contains("latest") || !response.value("latest").isObject()) {
+            result.error = QStringLiteral("Version manifest missing latest");
+            return result;
         }
 
-        if (!foundRelease && id == latestRelease) {
-            releaseVersion.id = id;
-            releaseVersion.type = obj.value("type").toString();
-            releaseVersion.url = obj.value("url").toString();
-            releaseVersion.time = QDateTime::fromString(obj.value("time").toString(), Qt::ISODate).toUTC();
-            releaseVersion.releaseTime = QDateTime::fromString(obj.value("releaseTime").toString(), Qt::ISODate).toUTC();
-            foundRelease = true;
+        if (!response.contains("versions") || !response.value("versions").isArray()) {
+            result.error = QStringLiteral("Version manifest missing versions");
+            return result;
         }
 
-        if (!foundSnapshot && id == latestSnapshot) {
-            snapshotVersion.id = id;
-            snapshotVersion.type = obj.value("type").toString();
-            snapshotVersion.url = obj.value("url").toString();
-            snapshotVersion.time = QDateTime::fromString(obj.value("time").toString(), Qt::ISODate).toUTC();
-            snapshotVersion.releaseTime = QDateTime::fromString(obj.value("releaseTime").toString(), Qt::ISODate).toUTC();
-            foundSnapshot = true;
+        const QJsonObject latestObj = response.value("latest").toObject();
+        const QString latestRelease = latestObj.value("release").toString();
+        const QString latestSnapshot = latestObj.value("snapshot").toString();
+
+        MCVersion releaseVersion;
+        MCVersion snapshotVersion;
+        bool foundRelease = false;
+        bool foundSnapshot = false;
+
+        const QJsonArray versions = response.value("versions").toArray();
+        for (const auto &item : versions) {
+            const QJsonObject obj = item.toObject();
+            const QString id = obj.value("id").toString();
+            if (id.isEmpty()) {
+                continue;
+            }
+
+            if (!foundRelease && id == latestRelease) {
+                releaseVersion.id = id;
+                releaseVersion.type = obj.value("type").toString();
+                releaseVersion.url = obj.value("url").toString();
+                releaseVersion.time = QDateTime::fromString(obj.value("time").toString(), Qt::ISODate).toUTC();
+                releaseVersion.releaseTime = QDateTime::fromString(obj.value("releaseTime").toString(), Qt::ISODate).toUTC();
+                foundRelease = true;
+            }
+
+            if (!foundSnapshot && id == latestSnapshot) {
+                snapshotVersion.id = id;
+                snapshotVersion.type = obj.value("type").toString();
+                snapshotVersion.url = obj.value("url").toString();
+                snapshotVersion.time = QDateTime::fromString(obj.value("time").toString(), Qt::ISODate).toUTC();
+                snapshotVersion.releaseTime = QDateTime::fromString(obj.value("releaseTime").toString(), Qt::ISODate).toUTC();
+                foundSnapshot = true;
+            }
+
+            if (foundRelease && foundSnapshot) {
+                break;
+            }
         }
 
-        if (foundRelease && foundSnapshot) {
-            break;
+        if (!foundRelease || !foundSnapshot) {
+            result.error = QStringLiteral("Latest release or snapshot not found");
+            return result;
         }
-    }
 
-    if (!foundRelease || !foundSnapshot) {
-        m_lastError = QStringLiteral("Latest release or snapshot not found");
-        return false;
-    }
+        result.value.append(releaseVersion);
+        result.value.append(snapshotVersion);
+        return result;
+    });
+}
 
-    outLatest.append(releaseVersion);
-    outLatest.append(snapshotVersion);
-    return true;
+bool McApi::getLatestMCVersion(QVector<MCVersion> &outLatest, VersionSource source,
+                              const QString &customBaseUrl)
+{
+    const Result<QVector<MCVersion>> result = waitFor(getLatestMCVersionAsync(source, customBaseUrl));
+    m_lastError = result.error;
+    outLatest = result.value;
+    return result.isOk();
 }
 
-bool McApi::fetchVersionManifest(QJsonObject &outManifest, VersionSource source, const QString &customBaseUrl)
+QFuture<McApi::Result<QJsonObject>> McApi::fetchVersionManifest(VersionSource source, const QString &customBaseUrl)
 {
     const QString urlString = buildManifestUrl(source, customBaseUrl);
     if (urlString.isEmpty()) {
-        m_lastError = QStringLiteral("Custom source empty");
-        return false;
+        return failedFuture<QJsonObject>(QStringLiteral("Custom source empty"));
     }
 
     if (isManifestCacheValid(source, customBaseUrl)) {
-        outManifest = m_versionManifestCache;
-        return true;
-    }
-
-    const QUrl url(urlString);
-    int status = 0;
-    const QJsonObject response = getJson(url, &status);
-    if (response.contains("error")) {
-        const QString err = response.value("error_description").toString(response.value("error").toString());
-        m_lastError = err.isEmpty() ? QStringLiteral("Fetch manifest failed") : err;
-        return false;
-    }
+        Result<QJsonObject> cached;
+        cached.value = m_versionManifestCache;
+        return readyFuture(cached);
+    }
+
+    // The disk copy outlives this instance: a cold start serves it (refreshing it in the background
+    // when it is older than the cache window) and revalidates with a conditional request after that
+    Network::MetadataCache::Policy policy;
+    policy.maxAgeSeconds = m_versionManifestCacheSeconds;
+    policy.staleWhileRevalidateSeconds = m_versionManifestCacheSeconds > 0 ? kManifestStaleSeconds : 0;
+
+    return getJson(QUrl(urlString), &policy).then(this, [this, urlString](const JsonReply &reply) {
+        Result<QJsonObject> result;
+        const QJsonObject &response = reply.json;
+        if (response.contains("error")) {
+            const QString err = response.value("error_description").toString(response.value("error").toString());
+            result.error = err.isEmpty() ? QStringLiteral("Fetch manifest failed") : err;
+            return result;
+        }
 
-    m_versionManifestCache = response;
-    m_versionManifestCacheAt = QDateTime::currentDateTimeUtc();
-    m_versionManifestCacheUrl = urlString;
-    outManifest = response;
-    return true;
+        m_versionManifestCache = response;
+        m_versionManifestCacheAt = QDateTime::currentDateTimeUtc();
+        m_versionManifestCacheUrl = urlString;
+        result.value = response;
+        return result;
+    });
 }
 
 bool McApi::isManifestCacheValid(VersionSource source, const QString &customBaseUrl) const
@@ -600,104 +724,56 @@ QString McApi::buildManifestUrl(VersionSource source, const QString &customBaseU
     return base + m_versionManifestPath;
 }
 
-QJsonObject McApi::getJson(const QUrl &url, int *httpStatus)
+QNetworkRequest McApi::buildRequest(const QUrl &url, bool authorize) const
 {
     QNetworkRequest request(url);
     request.setHeader(QNetworkRequest::UserAgentHeader, m_userAgent);
 
-    const QString accessToken = m_account ? m_account->mcAccessToken() : QString();
+    const QString accessToken = authorize && m_account ? m_account->mcAccessToken() : QString();
     if (!accessToken.isEmpty()) {
         request.setRawHeader("Authorization", QByteArray("Bearer ") + accessToken.toUtf8());
     }
+    return request;
+}
 
-    QNetworkReply *reply = m_nam.get(request);
-
-    QEventLoop loop;
-    QObject::connect(reply, &QNetworkReply::finished, &loop, &QEventLoop::quit);
-    loop.exec();
-
-    int status = reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
-    if (httpStatus) {
-        *httpStatus = status;
-    }
-
-    if (reply->error() != QNetworkReply::NoError) {
-        QJsonObject errorObj;
-        errorObj.insert(QStringLiteral("error"), QStringLiteral("network_error"));
-        errorObj.insert(QStringLiteral("error_description"), reply->errorString());
-        reply->deleteLater();
-        return errorObj;
-    }
-
-    const QByteArray data = reply->readAll();
-    reply->deleteLater();
-
-    QJsonParseError parseError;
-    const QJsonDocument doc = QJsonDocument::fromJson(data, &parseError);
-    if (parseError.error != QJsonParseError::NoError) {
-        QJsonObject errorObj;
-        errorObj.insert(QStringLiteral("error"), QStringLiteral("parse_error"));
-        errorObj.insert(QStringLiteral("error_description"), parseError.errorString());
-        return errorObj;
-    }
-
-    if (!doc.isObject()) {
-        QJsonObject errorObj;
-        errorObj.insert(QStringLiteral("error"), QStringLiteral("invalid_response"));
-        errorObj.insert(QStringLiteral("error_description"), QStringLiteral("Response is not a JSON object"));
-        return errorObj;
+QFuture<McApi::JsonReply> McApi::getJson(const QUrl &url, const Network::MetadataCache::Policy *cachePolicy) const
+{
+    if (cachePolicy) {
+        return Network::MetadataCache::getInstance()
+            ->getAsync(buildRequest(url, false), *cachePolicy)
+            .then([](const Network::MetadataCache::Response &response) {
+                JsonReply reply;
+                reply.httpStatus = response.fromCache ? 200 : response.httpStatus;
+                reply.json = response.isValid()
+                                 ? parseObject(response.body)
+                                 : errorObject(QStringLiteral("network_error"), response.errorString);
+                return reply;
+            });
     }
 
-    return doc.object();
+    return send(buildRequest(url, true)).then([](const HttpReply &http) {
+        JsonReply reply;
+        reply.httpStatus = http.httpStatus;
+        reply.json = http.errorString.isEmpty() ? parseObject(http.body)
+                                                : errorObject(QStringLiteral("network_error"), http.errorString);
+        return reply;
+    });
 }
 
-QJsonObject McApi::postJson(const QUrl &url, const QJsonObject &payload, int *httpStatus)
+QFuture<McApi::JsonReply> McApi::postJson(const QUrl &url, const QJsonObject &payload) const
 {
-    QNetworkRequest request(url);
+    QNetworkRequest request = buildRequest(url, true);
     request.setHeader(QNetworkRequest::ContentTypeHeader, QStringLiteral("application/json"));
-    request.setHeader(QNetworkRequest::UserAgentHeader, m_userAgent);
-
-    const QString accessToken = m_account ? m_account->mcAccessToken() : QString();
-    if (!accessToken.isEmpty()) {
-        request.setRawHeader("Authorization", QByteArray("Bearer ") + accessToken.toUtf8());
-    }
 
     const QByteArray body = QJsonDocument(payload).toJson(QJsonDocument::Compact);
-
-    QNetworkReply *reply = m_nam.post(request, body);
-
-    QEventLoop loop;
-    QObject::connect(reply, &QNetworkReply::finished, &loop, &QEventLoop::quit);
-    loop.exec();
-
-    if (httpStatus) {
-        *httpStatus = reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
-    }
-
-    const QByteArray data = reply->readAll();
-    reply->deleteLater();
-
-    QJsonParseError parseError;
-    const QJsonDocument doc = QJsonDocument::fromJson(data, &parseError);
-    if (parseError.error != QJsonParseError::NoError || !doc.isObject()) {
-        QJsonObject errorObj;
-        errorObj.insert(QStringLiteral("error"), QStringLiteral("invalid_response"));
-        errorObj.insert(QStringLiteral("error_description"), QStringLiteral("Non-JSON response"));
-        return errorObj;
-    }
-
-    return doc.object();
+    return send(request, &body).then([](const HttpReply &http) {
+        return JsonReply{http.httpStatus, parsePostBody(http.body)};
+    });
 }
 
-QJsonObject McApi::postMultipart(const QUrl &url, const QMap<QString, QByteArray> &fields, int *httpStatus)
+QFuture<McApi::JsonReply> McApi::postMultipart(const QUrl &url, const QMap<QString, QByteArray> &fields) const
 {
-    QNetworkRequest request(url);
-    request.setHeader(QNetworkRequest::UserAgentHeader, m_userAgent);
-
-    const QString accessToken = m_account ? m_account->mcAccessToken() : QString();
-    if (!accessToken.isEmpty()) {
-        request.setRawHeader("Authorization", QByteArray("Bearer ") + accessToken.toUtf8());
-    }
+    QNetworkRequest request = buildRequest(url, true);
 
     QString boundary = QStringLiteral("----AMCS");
     QByteArray body;
@@ -712,28 +788,8 @@ QJsonObject McApi::postMultipart(const QUrl &url, const QMap<QString, QByteArray
     request.setHeader(QNetworkRequest::ContentTypeHeader,
                       QString("multipart/form-data; boundary=%1").arg(boundary));
 
-    QNetworkReply *reply = m_nam.post(request, body);
-
-    QEventLoop loop;
-    QObject::connect(reply, &QNetworkReply::finished, &loop, &QEventLoop::quit);
-    loop.exec();
-
-    if (httpStatus) {
-        *httpStatus = reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
-    }
-
-    const QByteArray data = reply->readAll();
-    reply->deleteLater();
-
-    QJsonParseError parseError;
-    const QJsonDocument doc = QJsonDocument::fromJson(data, &parseError);
-    if (parseError.error != QJsonParseError::NoError || !doc.isObject()) {
-        QJsonObject errorObj;
-        errorObj.insert(QStringLiteral("error"), QStringLiteral("invalid_response"));
-        errorObj.insert(QStringLiteral("error_description"), QStringLiteral("Non-JSON response"));
-        return errorObj;
-    }
-
-    return doc.object();
+    return send(request, &body).then([](const HttpReply &http) {
+        return JsonReply{http.httpStatus, parsePostBody(http.body)};
+    });
 }
 } // namespace AMCS::Core::Api
@@ -1,12 +1,13 @@
 #pragma once
 
 #include <QObject>
-#include <QNetworkAccessManager>
 #include <QDateTime>
+#include <QFuture>
 #include <QJsonObject>
 #include <QStringList>
 
 #include "../Auth/McAccount.h"
+#include "../Network/MetadataCache.h"
 
 namespace AMCS::Core::Api
 {
@@ -73,6 +74,15 @@ public:
         return !(lhs == rhs);
     }
 
+    template <typename T>
+    struct Result
+    {
+        T value{};
+        QString error;  // empty on success
+
+        bool isOk() const { return error.isEmpty(); }
+    };
+
     explicit McApi(Auth::McAccount *account, QObject *parent = nullptr);
 
     static Auth::McAccount *createOfflineAccount(const QString &name, QObject *parent = nullptr);
@@ -86,6 +96,18 @@ public:
     void setVersionManifestCacheSeconds(int seconds);
     int versionManifestCacheSeconds() const;
 
+    // Non-blocking calls: the request goes out on the calling thread's shared network manager and the
+    // future finishes from its event loop, so independent calls run concurrently. Profile, license and
+    // manifest state of this object is updated in its own thread before the future finishes.
+    QFuture<Result<Profile>> fetchProfileAsync();
+    QFuture<Result<bool>> checkHasGameAsync();
+    QFuture<Result<bool>> uploadSkinAsync(const QString &filePath, bool isSlim = false);
+    QFuture<Result<QVector<MCVersion>>> fetchMCVersionAsync(VersionSource source = VersionSource::Official,
+                                                            const QString &customBaseUrl = QString());
+    QFuture<Result<QVector<MCVersion>>> getLatestMCVersionAsync(VersionSource source = VersionSource::Official,
+                                                                const QString &customBaseUrl = QString());
+
+    // Blocking variants of the calls above; the error is kept in lastError()
     bool fetchProfile();
     bool checkHasGame();
     bool uploadSkin(const QString &filePath, bool isSlim = false);
@@ -115,17 +137,25 @@ public:
     QString getVersionManifestPath() const;
 
 private:
-    bool fetchVersionManifest(QJsonObject &outManifest, VersionSource source, const QString &customBaseUrl);
+    struct JsonReply
+    {
+        int httpStatus = 0;
+        QJsonObject json;  // carries "error" / "error_description" when the request failed
+    };
+
+    QFuture<Result<QJsonObject>> fetchVersionManifest(VersionSource source, const QString &customBaseUrl);
     bool isManifestCacheValid(VersionSource source, const QString &customBaseUrl) const;
     QString buildManifestUrl(VersionSource source, const QString &customBaseUrl) const;
 
-    QJsonObject getJson(const QUrl &url, int *httpStatus = nullptr);
-    QJsonObject postJson(const QUrl &url, const QJsonObject &payload, int *httpStatus = nullptr);
-    QJsonObject postMultipart(const QUrl &url, const QMap<QString, QByteArray> &fields, int *httpStatus = nullptr);
+    QNetworkRequest buildRequest(const QUrl &url, bool authorize) const;
+
+    // With a cache policy the response goes through the on-disk metadata cache (unauthenticated documents only)
+    QFuture<JsonReply> getJson(const QUrl &url, const Network::MetadataCache::Policy *cachePolicy = nullptr) const;
+    QFuture<JsonReply> postJson(const QUrl &url, const QJsonObject &payload) const;
+    QFuture<JsonReply> postMultipart(const QUrl &url, const QMap<QString, QByteArray> &fields) const;
 
 private:
     Auth::McAccount *m_account;
-    QNetworkAccessManager m_nam;
     Profile m_profile;
     bool m_hasGameLicense = false;
     QString m_lastError;
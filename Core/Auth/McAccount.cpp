@@ -1,6 +1,7 @@
 #include "McAccount.h"
 
 #include "../CoreSettings.h"
+#include "../Network/NetworkService.h"
 
 #include <QEventLoop>
 #include <QJsonArray>
@@ -482,7 +483,9 @@ QJsonObject McAccount::postForm(const QUrl &url, const QMap<QString, QString> &f
         query.addQueryItem(it.key(), it.value());
     }
 
-    QNetworkReply *reply = m_nam.post(request, query.query(QUrl::FullyEncoded).toUtf8());
+    auto *network = Network::NetworkService::getInstance();
+    network->prepareRequest(request);
+    QNetworkReply *reply = network->manager()->post(request, query.query(QUrl::FullyEncoded).toUtf8());
 
     QEventLoop loop;
     QObject::connect(reply, &QNetworkReply::finished, &loop, &QEventLoop::quit);
@@ -514,7 +517,9 @@ QJsonObject McAccount::postJson(const QUrl &url, const QJsonObject &payload, int
 
     const QByteArray body = QJsonDocument(payload).toJson(QJsonDocument::Compact);
 
-    QNetworkReply *reply = m_nam.post(request, body);
+    auto *network = Network::NetworkService::getInstance();
+    network->prepareRequest(request);
+    QNetworkReply *reply = network->manager()->post(request, body);
 
     QEventLoop loop;
     QObject::connect(reply, &QNetworkReply::finished, &loop, &QEventLoop::quit);
@@ -3,7 +3,6 @@
 #include <QObject>
 #include <QDateTime>
 #include <QJsonObject>
-#include <QNetworkAccessManager>
 #include <QUrl>
 
 namespace AMCS::Core::Auth
@@ -85,7 +84,6 @@ private:
     void waitSeconds(int seconds) const;
 
 private:
-    QNetworkAccessManager m_nam;
     Tokens m_tokens;
     QString m_lastError;
     QString m_accountName;
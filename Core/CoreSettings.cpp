@@ -22,6 +22,7 @@ bool CoreSettings::coreInit(const QString &baseDir)
     setAccountsFilePath(QDir(dataDir).absoluteFilePath(m_accountsFileName));
     setVersionsFilePath(QDir(dataDir).absoluteFilePath(m_versionsFileName));
     setJavaFilePath(QDir(dataDir).absoluteFilePath(m_javaFileName));
+    setMetadataCacheDir(QDir(dataDir).absoluteFilePath(m_metadataCacheDirName));
 
     const QString accountsPath = accountsFilePath();
     const QString versionsPath = versionsFilePath();
@@ -120,6 +121,11 @@ QString CoreSettings::getJavaFileName() const
     return m_javaFileName;
 }
 
+QString CoreSettings::getMetadataCacheDirName() const
+{
+    return m_metadataCacheDirName;
+}
+
 QString CoreSettings::getMinecraftDirName() const
 {
     return m_minecraftDirName;
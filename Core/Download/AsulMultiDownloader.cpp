@@ -1,10 +1,309 @@
 #include "AsulMultiDownloader.h"
+#include "DownloadSink.h"
+#include "../Network/NetworkService.h"
 #include <QDir>
 #include <QFileInfo>
 #include <QDateTime>
+#include <QHostInfo>
+#include <QDeadlineTimer>
 #include <QRandomGenerator>
 #include <QDebug>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QSaveFile>
+#include <QCoreApplication>
+#if QT_CONFIG(ssl)
+#include <QSslConfiguration>
+#endif
+#include <algorithm>
 #include <atomic>
+#include <climits>
+#include <cmath>
+#include <limits>
+#include <utility>
+
+#ifdef AMCS_HAVE_LIBURING
+#include <liburing.h>
+#endif
+
+#ifdef Q_OS_WIN
+#include <qt_windows.h>
+#include <io.h>
+#else
+#include <cerrno>
+#include <csignal>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+using AMCS::Core::Network::NetworkService;
+
+namespace
+{
+// 乱序到达的分段数据最多暂存这么多用于摘要计算，超出部分在完成时从磁盘补读
+constexpr qint64 kMaxPendingDigestBytes = 8 * 1024 * 1024;
+
+// 拆分缺失区间时每段的最小大小
+constexpr qint64 kMinSegmentBytes = 256 * 1024;
+
+// 断点续传日志的最短落盘间隔
+constexpr qint64 kJournalSaveIntervalMs = 1000;
+
+// 自适应并发：初始上限、下限、加性增长步长和出错时的缩减系数
+constexpr double kInitialHostLimit = 8;
+constexpr double kMinHostLimit = 2;
+constexpr double kHostLimitIncrease = 4;
+constexpr double kHostLimitDecrease = 0.5;
+// 吞吐较上个窗口下降超过该比例时视为过载，不再增长
+constexpr double kGoodputDropRatio = 0.8;
+
+// 镜像健康度：滑动平均系数、无样本时的假定延迟、进入冷却的连续失败次数和冷却时长
+constexpr double kMirrorEwmaAlpha = 0.3;
+constexpr double kMirrorDefaultLatencyMs = 500;
+constexpr int kMirrorCooldownFailures = 3;
+constexpr qint64 kMirrorCooldownMs = 30000;
+// 候选顺序越靠后，评分惩罚越大（健康度相近时优先使用排在前面的镜像）
+constexpr double kMirrorRankPenalty = 0.25;
+
+// 不超过该大小且已知大小的文件在内存中接收，完成后一次写入
+constexpr qint64 kBufferedWriteBytes = 256 * 1024;
+
+// 从磁盘回放已提交文件给接收器时每次读取的大小
+constexpr qint64 kReplayChunkBytes = 256 * 1024;
+
+// 慢分段对冲：运行满 kHedgeMinAgeMs 且速度低于其他分段平均值 1/kHedgeSlowRatio 时，
+// 对其剩余区间发起重复请求；每个任务最多对冲 kMaxHedgesPerTask 次
+constexpr qint64 kHedgeCheckIntervalMs = 1000;
+constexpr qint64 kHedgeMinAgeMs = 3000;
+constexpr qint64 kHedgeSlowRatio = 4;
+constexpr int kMaxHedgesPerTask = 2;
+
+// 限速：接收缓冲区大小、单次最小读取量（避免碎片化读取）、令牌桶突发时长、最长读取间隔
+constexpr qint64 kPacedReadBufferBytes = 64 * 1024;
+constexpr qint64 kMinPacedReadBytes = 4 * 1024;
+constexpr qint64 kRateBurstMs = 250;
+constexpr int kMaxPacedWaitMs = 1000;
+// 重试退避：临时错误和限流的基础延迟、最大延迟，以及接受的最长Retry-After
+constexpr qint64 kRetryBaseDelayMs = 500;
+constexpr qint64 kThrottledBaseDelayMs = 2000;
+constexpr qint64 kRetryMaxDelayMs = 30000;
+constexpr qint64 kMaxRetryAfterMs = 5 * 60 * 1000;
+
+// 限速时每个在途任务至少应分得的速度，据此收紧在途任务数，避免任务因长时间收不到数据而超时
+constexpr qint64 kMinPacedBytesPerTask = 32 * 1024;
+
+// 磁盘写入：排队数据上限（超出时阻塞网络线程）和每批最多提交的块数
+constexpr qint64 kMaxQueuedWriteBytes = 64 * 1024 * 1024;
+constexpr int kMaxWriteBatch = 64;
+
+// 文件提交：等待更多完成文件并入同一组的时间，以及每组最多提交的文件数
+constexpr int kCommitWindowMs = 20;
+constexpr int kMaxCommitBatch = 512;
+// 同时打开并发起回写的文件数上限（限制文件描述符占用）
+constexpr int kSyncBatchFiles = 64;
+
+// 工作线程：默认最多使用的线程数，以及每个线程至少拥有的网络管理器数
+constexpr int kMaxDefaultWorkerThreads = 4;
+constexpr int kMinManagersPerShard = 4;
+
+// 经写入器写入；写入器为空（任务不属于管理器）时在当前线程同步写入
+bool writeAt(DiskWriter *writer, QFile *file, qint64 offset, const QByteArray &data)
+{
+    if (writer) {
+        return writer->write(file, offset, data);
+    }
+    return file->seek(offset) && file->write(data) == data.size();
+}
+
+// 可续传的直写文件使用的固定临时文件，与目标文件位于同一目录（改名不跨文件系统）；
+// 持有 "<临时文件>.lock" 的写入方独占它和断点日志
+QString stagingPathFor(const QString &savePath)
+{
+    return savePath.isEmpty() ? QString() : savePath + QStringLiteral(".download");
+}
+
+// 每次尝试各自的临时文件：进程号 + 进程内序号，其他任务或进程的错误处理不会删除它
+QString uniqueStagingPathFor(const QString &savePath)
+{
+    static std::atomic<quint64> serial{0};
+    if (savePath.isEmpty()) {
+        return QString();
+    }
+    return QStringLiteral("%1.%2-%3.download")
+        .arg(savePath)
+        .arg(QCoreApplication::applicationPid(), 0, 36)
+        .arg(++serial, 0, 36);
+}
+
+// 进程是否仍在运行（无权查询的进程视为在运行）
+bool processAlive(qint64 pid)
+{
+#ifdef Q_OS_WIN
+    HANDLE process = ::OpenProcess(PROCESS_QUERY_LIMITED_INFORMATION, FALSE, DWORD(pid));
+    if (!process) {
+        return ::GetLastError() == ERROR_ACCESS_DENIED;
+    }
+    DWORD code = 0;
+    const bool alive = ::GetExitCodeProcess(process, &code) && code == STILL_ACTIVE;
+    ::CloseHandle(process);
+    return alive;
+#else
+    return ::kill(pid_t(pid), 0) == 0 || errno == EPERM;
+#endif
+}
+
+// 删除已退出的进程留下的临时文件（含分段文件）："<文件名>.<进程号>-<序号>.download[.partN]"；
+// 这些文件名各不相同，进程被杀死或崩溃后不会被任何后续尝试覆盖，预留的空间也一直占用
+void removeOrphanedStagingFiles(const QString &savePath)
+{
+    const QFileInfo target(savePath);
+    const QString prefix = target.fileName() + QLatin1Char('.');
+    const QString marker = QStringLiteral(".download");
+    const QDir dir = target.absoluteDir();
+    const QStringList candidates = dir.entryList({prefix + QStringLiteral("*-*.download*")}, QDir::Files | QDir::Hidden);
+
+    QHash<qint64, bool> alive;
+    for (const QString &name : candidates) {
+        const qsizetype end = name.indexOf(marker, prefix.size());
+        if (end < 0) {
+            continue;
+        }
+        const QStringList owner = name.mid(prefix.size(), end - prefix.size()).split(QLatin1Char('-'));
+        bool pidOk = false;
+        bool serialOk = false;
+        const qint64 pid = owner.size() == 2 ? owner.at(0).toLongLong(&pidOk, 36) : 0;
+        if (owner.size() == 2) {
+            owner.at(1).toULongLong(&serialOk, 36);
+        }
+        if (!pidOk || !serialOk || pid <= 0 || pid == QCoreApplication::applicationPid()) {
+            continue;
+        }
+
+        auto it = alive.constFind(pid);
+        if (it == alive.constEnd()) {
+            it = alive.insert(pid, processAlive(pid));
+        }
+        if (!it.value()) {
+            QFile::remove(dir.filePath(name));
+        }
+    }
+}
+
+// 按已知大小预留磁盘空间，减少碎片并尽早发现空间不足；keepSize 为true时不改变文件长度
+// （顺序写入的文件），否则把文件设为该长度（各分段定位写入的文件）
+bool preallocateFile(QFile *file, qint64 size, bool keepSize)
+{
+#ifdef Q_OS_LINUX
+    if (::fallocate(file->handle(), keepSize ? FALLOC_FL_KEEP_SIZE : 0, 0, size) == 0) {
+        return keepSize || file->size() == size || file->resize(size);
+    }
+    if (errno == ENOSPC) {
+        return false;
+    }
+    // 文件系统不支持（例如部分网络文件系统），退回到普通方式
+#endif
+    return keepSize || file->resize(size);
+}
+
+// 把文件数据刷到磁盘
+bool syncFile(const QString &path)
+{
+#ifdef Q_OS_WIN
+    QFile file(path);
+    return file.open(QIODevice::ReadWrite) && ::_commit(file.handle()) == 0;
+#else
+    QFile file(path);
+    return file.open(QIODevice::ReadOnly) && ::fsync(file.handle()) == 0;
+#endif
+}
+
+// 原子地用 from 替换 to（to 已存在时直接覆盖）
+bool replaceFile(const QString &from, const QString &to)
+{
+#ifdef Q_OS_WIN
+    return ::MoveFileExW(reinterpret_cast<const wchar_t *>(QDir::toNativeSeparators(from).utf16()),
+                         reinterpret_cast<const wchar_t *>(QDir::toNativeSeparators(to).utf16()),
+                         MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH) != 0;
+#else
+    return ::rename(QFile::encodeName(from).constData(), QFile::encodeName(to).constData()) == 0;
+#endif
+}
+
+// 落盘目录项，使改名在断电后仍然有效（Windows 由 MOVEFILE_WRITE_THROUGH 保证）
+void syncDirectory(const QString &dirPath)
+{
+#ifndef Q_OS_WIN
+    const int fd = ::open(QFile::encodeName(dirPath).constData(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (fd >= 0) {
+        ::fsync(fd);
+        ::close(fd);
+    }
+#else
+    Q_UNUSED(dirPath);
+#endif
+}
+
+// 放弃一个不再使用的请求（先断开信号，防止abort()同步触发finished信号导致死锁）
+void discardReply(QNetworkReply *reply)
+{
+    if (reply) {
+        reply->disconnect();
+        reply->abort();
+        reply->deleteLater();
+    }
+}
+
+// 解析 "bytes <start>-<end>/<total>"；总大小未知（"*"）时 total 为-1
+bool parseContentRange(const QByteArray &header, qint64 *start, qint64 *total)
+{
+    const QByteArray value = header.trimmed();
+    if (!value.startsWith("bytes ")) {
+        return false;
+    }
+    const int dash = value.indexOf('-');
+    const int slash = value.indexOf('/');
+    if (dash < 0 || slash < dash) {
+        return false;
+    }
+
+    bool ok = false;
+    *start = value.mid(6, dash - 6).trimmed().toLongLong(&ok);
+    if (!ok) {
+        return false;
+    }
+    const QByteArray totalPart = value.mid(slash + 1).trimmed();
+    if (totalPart == "*") {
+        *total = -1;
+        return true;
+    }
+    *total = totalPart.toLongLong(&ok);
+    return ok;
+}
+
+// 立即完成的 QFuture（无需排队的请求）
+QFuture<DownloadResult> readyResult(const DownloadResult &result)
+{
+    QPromise<DownloadResult> promise;
+    promise.start();
+    promise.addResult(result);
+    promise.finish();
+    return promise.future();
+}
+
+// 在任务所在线程中执行操作：任务位于工作线程时经事件循环排队，与该线程中的其他操作保持先后顺序
+template <typename Fn>
+void runOnTaskThread(const std::shared_ptr<DownloadTask> &task, Fn fn)
+{
+    if (task->thread() == QThread::currentThread()) {
+        fn(task.get());
+        return;
+    }
+    // 持有副本，保证执行时任务对象仍然存在
+    QMetaObject::invokeMethod(task.get(), [task, fn]() { fn(task.get()); }, Qt::QueuedConnection);
+}
+}
 
 // ==================== AsulMultiDownloader 实现 ====================
 
@@ -17,6 +316,19 @@
     , m_downloadTimeout(15000)
     , m_autoRetry(true)
     , m_maxRetryCount(5)
+    , m_directSegmentWrite(true)
+    , m_adaptiveSegments(true)
+    , m_rangedProbe(true)
+    , m_http2Enabled(false)
+    , m_http2ConnectionsPerHost(2)
+    , m_http2MaxStreamsPerConnection(100)
+    , m_prewarmConnectionsPerHost(4)
+    , m_prewarmCursor(0)
+    , m_coalescing(true)
+    , m_queuedCount(0)
+    , m_mirrorHedging(false)
+    , m_mirrorHedgeDelay(2000)
+    , m_adaptiveConcurrency(true)
     , m_activeDownloads(0)
     , m_taskIdCounter(0)
     , m_speedMonitoringEnabled(true)
@@ -26,11 +338,22 @@
     , m_monitorLastTime(0)
     , m_monitorLastBytes(0)
     , m_allFinishedEmitted(false)
+    , m_liveBytes(0)
+    , m_completedBytes(0)
+    , m_progressInterval(100)
     , m_networkManagerPoolSize(32)  // 优化：使用32个网络管理器，分散负载并增加总连接数限制
+    , m_bandwidth(std::make_unique<BandwidthLimiter>())
+    , m_retryPolicy(std::make_shared<DownloadRetryPolicy>())
+    , m_workerThreadCount(qBound(1, QThread::idealThreadCount() / 2, kMaxDefaultWorkerThreads))
+    , m_shardsStarted(false)
+    , m_diskWriter(std::make_unique<DiskWriter>(kMaxQueuedWriteBytes))
+    , m_fileCommitter(std::make_unique<FileCommitter>())
+    , m_batchCounter(0)
 {
-    // 初始化网络管理器池
+    // 初始化网络管理器池（由进程共享的网络服务创建：代理配置和TLS会话缓存与其他组件共用）
+    auto *network = NetworkService::getInstance();
     for (int i = 0; i < m_networkManagerPoolSize; ++i) {
-        QNetworkAccessManager *manager = new QNetworkAccessManager(this);
+        QNetworkAccessManager *manager = network->createManager(this);
         m_networkManagers.append(manager);
     }
 
@@ -44,6 +367,14 @@
     connect(m_monitorTimer, &QTimer::timeout, this, &AsulMultiDownloader::onMonitorDownloads);
     m_monitorTimer->start(1000);  // 每秒检查一次，大幅降低频率
 
+    m_progressTimer = new QTimer(this);
+    connect(m_progressTimer, &QTimer::timeout, this, &AsulMultiDownloader::onFlushProgress);
+    m_progressTimer->start(m_progressInterval);
+
+    m_retryTimer = new QTimer(this);
+    m_retryTimer->setSingleShot(true);
+    connect(m_retryTimer, &QTimer::timeout, this, &AsulMultiDownloader::onRetryTimer);
+
     // 初始化域名策略（参考PCL对特定域名的优化）
     m_noMultiThreadHosts << "bmclapi" << "github.com" << "modrinth.com"
                          << "optifine.net" << "curseforge.com";
@@ -51,7 +382,18 @@
 
 AsulMultiDownloader::~AsulMultiDownloader()
 {
+    // 先中断进行中的任务，保留断点续传记录，下次（包括新进程）可继续下载
+    {
+        QMutexLocker locker(&m_mutex);
+        for (auto it = m_records.constBegin(); it != m_records.constEnd(); ++it) {
+            if (it->status == DownloadStatus::Downloading && it->task) {
+                runOnTaskThread(it->task, [](DownloadTask *task) { task->interrupt(); });
+            }
+        }
+    }
+
     cancelAll();
+    stopNetworkShards();
 }
 
 // ==================== 配置接口实现 ====================
@@ -193,579 +535,3790 @@ QStringList AsulMultiDownloader::noMultiThreadHosts() const
     return m_noMultiThreadHosts;
 }
 
-// ==================== 下载控制接口实现 ====================
-
-QString AsulMultiDownloader::addDownload(const QUrl &url, const QString &savePath, int priority, qint64 knownFileSize)
+void AsulMultiDownloader::setDirectSegmentWriteEnabled(bool enable)
 {
     QMutexLocker locker(&m_mutex);
-
-    QString taskId = generateTaskId();
-
-    // 创建下载任务
-    auto task = std::make_shared<DownloadTask>(taskId, url, savePath, priority, this);
-    task->setTimeout(m_downloadTimeout);
-
-    // 设置已知文件大小（跳过HEAD请求优化）
-    if (knownFileSize > 0) {
-        task->setKnownFileSize(knownFileSize);
-    }
-
-    // 设置分段数
-    task->setSegmentCount(m_segmentCount);
-
-    // 连接信号
-    connect(task.get(), &DownloadTask::started, this, &AsulMultiDownloader::downloadStarted);
-    connect(task.get(), &DownloadTask::progress, this, &AsulMultiDownloader::onTaskProgress);
-    connect(task.get(), &DownloadTask::finished, this, &AsulMultiDownloader::onTaskFinished);
-    connect(task.get(), &DownloadTask::failed, this, &AsulMultiDownloader::onTaskFailed);
-    connect(task.get(), &DownloadTask::paused, this, &AsulMultiDownloader::downloadPaused);
-    connect(task.get(), &DownloadTask::resumed, this, &AsulMultiDownloader::downloadResumed);
-
-    m_tasks[taskId] = task;
-    m_taskStatus[taskId] = DownloadStatus::Queued;
-    m_taskRetryCount[taskId] = 0;
-    m_taskQueue.enqueue(taskId);
-
-    emit downloadAdded(taskId, url);
-
-    // 尝试处理队列
-    processQueue();
-
-    return taskId;
+    m_directSegmentWrite = enable;
 }
 
-QStringList AsulMultiDownloader::addDownloads(const QList<QUrl> &urls, const QStringList &savePaths, int priority)
+bool AsulMultiDownloader::directSegmentWriteEnabled() const
 {
-    QStringList taskIds;
-
-    int count = qMin(urls.size(), savePaths.size());
-    for (int i = 0; i < count; ++i) {
-        QString taskId = addDownload(urls[i], savePaths[i], priority);
-        taskIds.append(taskId);
-    }
-
-    return taskIds;
+    QMutexLocker locker(&m_mutex);
+    return m_directSegmentWrite;
 }
 
-void AsulMultiDownloader::pauseDownload(const QString &taskId)
+void AsulMultiDownloader::setAdaptiveSegmentsEnabled(bool enable)
 {
     QMutexLocker locker(&m_mutex);
-
-    if (!m_tasks.contains(taskId)) {
-        return;
-    }
-
-    auto task = m_tasks[taskId];
-    DownloadStatus status = m_taskStatus[taskId];
-
-    if (status == DownloadStatus::Downloading) {
-        task->pause();
-        m_taskStatus[taskId] = DownloadStatus::Paused;
-        updateHostConnections(task->url().host(), -1);
-        m_activeDownloads--;
-        processQueue();
-    } else if (status == DownloadStatus::Queued) {
-        m_taskStatus[taskId] = DownloadStatus::Paused;
-        m_taskQueue.removeOne(taskId);
-    }
+    m_adaptiveSegments = enable;
 }
 
-void AsulMultiDownloader::resumeDownload(const QString &taskId)
+bool AsulMultiDownloader::adaptiveSegmentsEnabled() const
 {
     QMutexLocker locker(&m_mutex);
+    return m_adaptiveSegments;
+}
 
-    if (!m_tasks.contains(taskId)) {
-        return;
-    }
+void AsulMultiDownloader::setRangedProbeEnabled(bool enable)
+{
+    QMutexLocker locker(&m_mutex);
+    m_rangedProbe = enable;
+}
 
-    DownloadStatus status = m_taskStatus[taskId];
+bool AsulMultiDownloader::rangedProbeEnabled() const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_rangedProbe;
+}
 
-    if (status == DownloadStatus::Paused) {
-        m_taskStatus[taskId] = DownloadStatus::Queued;
-        m_taskQueue.enqueue(taskId);
-        processQueue();
+void AsulMultiDownloader::setAdaptiveConcurrencyEnabled(bool enable)
+{
+    QMutexLocker locker(&m_mutex);
+    m_adaptiveConcurrency = enable;
+    if (!m_adaptiveConcurrency) {
+        m_hostCongestion.clear();
     }
+    processQueue();
 }
 
-void AsulMultiDownloader::cancelDownload(const QString &taskId)
+bool AsulMultiDownloader::adaptiveConcurrencyEnabled() const
 {
     QMutexLocker locker(&m_mutex);
+    return m_adaptiveConcurrency;
+}
 
-    if (!m_tasks.contains(taskId)) {
-        return;
-    }
-
-    auto task = m_tasks[taskId];
-    DownloadStatus status = m_taskStatus[taskId];
+int AsulMultiDownloader::hostConcurrencyLimit(const QString &host) const
+{
+    QMutexLocker locker(&m_mutex);
+    return effectiveHostLimit(host);
+}
 
-    if (status == DownloadStatus::Downloading) {
-        task->cancel();
-        m_taskStatus[taskId] = DownloadStatus::Canceled;
-        updateHostConnections(task->url().host(), -1);
-        m_activeDownloads--;
-        processQueue();
-    } else if (status == DownloadStatus::Queued) {
-        m_taskStatus[taskId] = DownloadStatus::Canceled;
-        m_taskQueue.removeOne(taskId);
-    } else {
-        m_taskStatus[taskId] = DownloadStatus::Canceled;
-    }
+void AsulMultiDownloader::setMirrorHedgingEnabled(bool enable)
+{
+    QMutexLocker locker(&m_mutex);
+    m_mirrorHedging = enable;
+}
 
-    emit downloadCanceled(taskId);
+bool AsulMultiDownloader::mirrorHedgingEnabled() const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_mirrorHedging;
 }
 
-void AsulMultiDownloader::pauseAll()
+void AsulMultiDownloader::setMirrorHedgeDelay(int msecs)
 {
     QMutexLocker locker(&m_mutex);
+    m_mirrorHedgeDelay = qMax(0, msecs);
+}
 
-    QStringList taskIds = m_tasks.keys();
-    for (const QString &taskId : taskIds) {
-        locker.unlock();
-        pauseDownload(taskId);
-        locker.relock();
-    }
+int AsulMultiDownloader::mirrorHedgeDelay() const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_mirrorHedgeDelay;
 }
 
-void AsulMultiDownloader::resumeAll()
+void AsulMultiDownloader::setProgressInterval(int msecs)
 {
     QMutexLocker locker(&m_mutex);
+    m_progressInterval = qMax(10, msecs);
+    m_progressTimer->setInterval(m_progressInterval);
+}
 
-    QStringList taskIds = m_tasks.keys();
-    for (const QString &taskId : taskIds) {
-        locker.unlock();
-        resumeDownload(taskId);
-        locker.relock();
-    }
+int AsulMultiDownloader::progressInterval() const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_progressInterval;
 }
 
-void AsulMultiDownloader::cancelAll()
+void AsulMultiDownloader::setGlobalRateLimit(qint64 bytesPerSecond)
 {
     QMutexLocker locker(&m_mutex);
+    m_bandwidth->setGlobalRate(bytesPerSecond);
+    processQueue();
+}
 
-    QStringList taskIds = m_tasks.keys();
-    for (const QString &taskId : taskIds) {
-        locker.unlock();
-        cancelDownload(taskId);
-        locker.relock();
-    }
+qint64 AsulMultiDownloader::globalRateLimit() const
+{
+    return m_bandwidth->globalRate();
 }
 
-void AsulMultiDownloader::clearFinishedTasks()
+void AsulMultiDownloader::setHostRateLimit(const QString &host, qint64 bytesPerSecond)
 {
     QMutexLocker locker(&m_mutex);
+    m_bandwidth->setHostRate(host, bytesPerSecond);
+    processQueue();
+}
 
-    QStringList toRemove;
-    for (auto it = m_taskStatus.begin(); it != m_taskStatus.end(); ++it) {
-        if (it.value() == DownloadStatus::Completed ||
-            it.value() == DownloadStatus::Failed ||
-            it.value() == DownloadStatus::Canceled) {
-            toRemove.append(it.key());
-        }
-    }
+qint64 AsulMultiDownloader::hostRateLimit(const QString &host) const
+{
+    return m_bandwidth->hostRate(host);
+}
 
-    for (const QString &taskId : toRemove) {
-        m_tasks.remove(taskId);
-        m_taskStatus.remove(taskId);
-        m_taskRetryCount.remove(taskId);
-    }
+void AsulMultiDownloader::setPriorityRateLimit(int priority, qint64 bytesPerSecond)
+{
+    QMutexLocker locker(&m_mutex);
+    m_bandwidth->setPriorityRate(priority, bytesPerSecond);
+    processQueue();
 }
 
-// ==================== 查询接口实现 ====================
+qint64 AsulMultiDownloader::priorityRateLimit(int priority) const
+{
+    return m_bandwidth->priorityRate(priority);
+}
 
-DownloadInfo AsulMultiDownloader::getDownloadInfo(const QString &taskId) const
+void AsulMultiDownloader::setRetryPolicy(std::shared_ptr<DownloadRetryPolicy> policy)
 {
     QMutexLocker locker(&m_mutex);
+    m_retryPolicy = policy ? std::move(policy) : std::make_shared<DownloadRetryPolicy>();
+}
 
-    DownloadInfo info;
+std::shared_ptr<DownloadRetryPolicy> AsulMultiDownloader::retryPolicy() const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_retryPolicy;
+}
 
-    if (!m_tasks.contains(taskId)) {
-        return info;
+void AsulMultiDownloader::setWorkerThreadCount(int count)
+{
+    QMutexLocker locker(&m_mutex);
+    if (m_shardsStarted) {
+        // 已有任务按句柄分配到现有线程，中途调整会打乱同一任务前后操作的顺序
+        qWarning() << "AsulMultiDownloader: worker thread count cannot change after downloads have started";
+        return;
     }
+    m_workerThreadCount = qMax(0, count);
+}
 
-    auto task = m_tasks[taskId];
-    info.taskId = taskId;
-    info.url = task->url();
-    info.savePath = task->savePath();
-    info.fileSize = task->fileSize();
-    info.downloadedSize = task->downloadedSize();
-    info.priority = task->priority();
-    info.supportRange = task->supportRange();
-    info.segmentCount = task->segmentCount();
-    info.errorString = task->errorString();
-
-    return info;
+int AsulMultiDownloader::workerThreadCount() const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_workerThreadCount;
 }
 
-DownloadStatus AsulMultiDownloader::getDownloadStatus(const QString &taskId) const
+void AsulMultiDownloader::setRequestCoalescingEnabled(bool enable)
 {
     QMutexLocker locker(&m_mutex);
+    m_coalescing = enable;
+}
 
-    if (!m_taskStatus.contains(taskId)) {
-        return DownloadStatus::Failed;
-    }
+bool AsulMultiDownloader::requestCoalescingEnabled() const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_coalescing;
+}
 
-    return m_taskStatus[taskId];
+void AsulMultiDownloader::setPrewarmConnectionsPerHost(int count)
+{
+    QMutexLocker locker(&m_mutex);
+    m_prewarmConnectionsPerHost = qMax(0, count);
 }
 
-double AsulMultiDownloader::getDownloadProgress(const QString &taskId) const
+int AsulMultiDownloader::prewarmConnectionsPerHost() const
 {
     QMutexLocker locker(&m_mutex);
+    return m_prewarmConnectionsPerHost;
+}
 
-    if (!m_tasks.contains(taskId)) {
-        return 0.0;
+void AsulMultiDownloader::setHttp2Enabled(bool enable)
+{
+    QMutexLocker locker(&m_mutex);
+    m_http2Enabled = enable;
+    if (m_http2Enabled) {
+        ensureHttp2NetworkManagers();
     }
+    processQueue();
+}
 
-    auto task = m_tasks[taskId];
-    qint64 fileSize = task->fileSize();
+bool AsulMultiDownloader::http2Enabled() const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_http2Enabled;
+}
 
-    if (fileSize <= 0) {
-        return 0.0;
+void AsulMultiDownloader::setHttp2ConnectionsPerHost(int count)
+{
+    QMutexLocker locker(&m_mutex);
+    m_http2ConnectionsPerHost = qMax(1, count);
+    if (m_http2Enabled) {
+        ensureHttp2NetworkManagers();
     }
-
-    return (task->downloadedSize() * 100.0) / fileSize;
+    processQueue();
 }
 
-qint64 AsulMultiDownloader::getDownloadSpeed(const QString &taskId) const
+int AsulMultiDownloader::http2ConnectionsPerHost() const
 {
-    // 这个方法需要额外的速度跟踪机制，暂时返回0
-    // 在实际应用中，可以维护一个时间窗口内的下载量来计算速度
-    Q_UNUSED(taskId);
-    return 0;
+    QMutexLocker locker(&m_mutex);
+    return m_http2ConnectionsPerHost;
 }
 
-QStringList AsulMultiDownloader::getAllTaskIds() const
+void AsulMultiDownloader::setHttp2MaxStreamsPerConnection(int count)
 {
     QMutexLocker locker(&m_mutex);
-    return m_tasks.keys();
+    m_http2MaxStreamsPerConnection = qMax(1, count);
+    processQueue();
 }
 
-DownloadStatistics AsulMultiDownloader::getStatistics() const
+int AsulMultiDownloader::http2MaxStreamsPerConnection() const
 {
     QMutexLocker locker(&m_mutex);
-    return m_statistics;
+    return m_http2MaxStreamsPerConnection;
 }
 
-// ==================== 私有槽函数实现 ====================
+// ==================== 下载控制接口实现 ====================
 
-void AsulMultiDownloader::onTaskFinished(const QString &taskId)
+void AsulMultiDownloader::prewarm(const QList<DownloadRequest> &requests)
 {
     QMutexLocker locker(&m_mutex);
 
-    if (!m_tasks.contains(taskId)) {
-        return;
+    // 去重：需要解析的域名，以及各请求当前会选择的镜像（scheme + host + port）
+    QSet<QString> hosts;
+    QList<QUrl> origins;
+    QSet<QUrl> seenOrigins;
+    QSet<QUrl> http2Origins;  // 有请求会通过HTTP/2下载的源
+    for (const DownloadRequest &request : requests) {
+        for (const QUrl &mirror : request.mirrors) {
+            if (!mirror.host().isEmpty()) {
+                hosts.insert(mirror.host());
+            }
+        }
+        const QUrl selected = selectMirror(request.mirrors);
+        if (selected.host().isEmpty()) {
+            continue;
+        }
+        QUrl origin;
+        origin.setScheme(selected.scheme());
+        origin.setHost(selected.host());
+        origin.setPort(selected.port());
+        if (http2For(request.transport) && origin.scheme() == QLatin1String("https")) {
+            http2Origins.insert(origin);
+        }
+        if (!seenOrigins.contains(origin)) {
+            seenOrigins.insert(origin);
+            origins.append(origin);
+        }
     }
 
-    // 状态守卫：仅处理 Downloading 状态的任务，防止重复处理
-    if (m_taskStatus[taskId] != DownloadStatus::Downloading) {
-        return;
+    // 各域名的解析在Qt的解析线程中并行进行，结果由所有网络管理器共享
+    for (const QString &host : std::as_const(hosts)) {
+        QHostInfo::lookupHost(host, this, [](const QHostInfo &) {});
     }
 
-    auto task = m_tasks[taskId];
-    m_taskStatus[taskId] = DownloadStatus::Completed;
-    updateHostConnections(task->url().host(), -1);
-    m_activeDownloads--;
-    m_statistics.completedTasks++;
-    m_taskLastProgress.remove(taskId);
+    if (m_prewarmConnectionsPerHost <= 0 || origins.isEmpty()) {
+        return;
+    }
 
-    emit downloadFinished(taskId, task->savePath());
+    // 连接属于各自的网络管理器：分摊到任务轮询使用的管理器上（工作线程的管理器在首次使用时创建）
+    ensureNetworkShards();
+    if (!http2Origins.isEmpty()) {
+        ensureHttp2NetworkManagers();
+    }
+    QList<QNetworkAccessManager*> managers;
+    QList<QNetworkAccessManager*> http2Managers;
+    if (m_shards.isEmpty()) {
+        managers = m_networkManagers;
+        http2Managers = m_http2NetworkManagers.mid(0, m_http2ConnectionsPerHost);
+    } else {
+        const int perShard = (m_http2ConnectionsPerHost + int(m_shards.size()) - 1) / int(m_shards.size());
+        for (const NetworkShard &shard : std::as_const(m_shards)) {
+            managers.append(shard.managers);
+            http2Managers.append(shard.http2Managers.mid(0, perShard));
+        }
+    }
+    if (managers.isEmpty()) {
+        return;
+    }
 
+    const int perHost = qMin(m_prewarmConnectionsPerHost, int(managers.size()));
+    for (const QUrl &origin : std::as_const(origins)) {
+        for (int i = 0; i < perHost; ++i) {
+            warmConnection(managers.at(m_prewarmCursor++ % managers.size()), origin, false);
+        }
+        // HTTP/2：每个管理器对每个Host只有一条连接，逐个建立即可
+        if (http2Origins.contains(origin)) {
+            for (QNetworkAccessManager *manager : std::as_const(http2Managers)) {
+                warmConnection(manager, origin, true);
+            }
+        }
+    }
+    m_prewarmCursor %= managers.size();
+}
+
+QString AsulMultiDownloader::addDownload(const QUrl &url, const QString &savePath, int priority, qint64 knownFileSize,
+                                         const QString &expectedSha1)
+{
+    return addDownload(QList<QUrl>{url}, savePath, priority, knownFileSize, expectedSha1);
+}
+
+QString AsulMultiDownloader::addDownload(const QList<QUrl> &mirrors, const QString &savePath, int priority,
+                                         qint64 knownFileSize, const QString &expectedSha1)
+{
+    if (mirrors.isEmpty()) {
+        return QString();
+    }
+
+    QMutexLocker locker(&m_mutex);
+
+    const QStringList taskIds = enqueueRequests({DownloadRequest(mirrors, savePath, knownFileSize, expectedSha1, priority)}, 0);
+    const QString taskId = taskIds.constFirst();
+
+    emit downloadAdded(taskId, m_records.value(handleForTaskId(taskId)).url);
+
+    // 尝试处理队列
     processQueue();
 
-    // 检查是否所有任务都完成了
-    checkAndEmitAllFinished();
+    return taskId;
 }
 
-void AsulMultiDownloader::onTaskFailed(const QString &taskId, const QString &error)
+QStringList AsulMultiDownloader::addDownloads(const QList<QUrl> &urls, const QStringList &savePaths, int priority)
+{
+    const int count = qMin(urls.size(), savePaths.size());
+    QList<DownloadRequest> requests;
+    requests.reserve(count);
+    for (int i = 0; i < count; ++i) {
+        requests.append(DownloadRequest({urls[i]}, savePaths[i], -1, QString(), priority));
+    }
+
+    QStringList taskIds;
+    {
+        QMutexLocker locker(&m_mutex);
+        taskIds = enqueueRequests(requests, 0);
+        processQueue();
+    }
+
+    emit downloadsAdded(taskIds);
+    return taskIds;
+}
+
+DownloadBatch *AsulMultiDownloader::addBatch(const QList<DownloadRequest> &requests)
+{
+    DownloadBatch *batch = new DownloadBatch(this);
+
+    QStringList taskIds;
+    {
+        QMutexLocker locker(&m_mutex);
+
+        // 先登记批次：合并到在途任务时需要把已下载的部分计入本批次
+        const quint32 batchId = ++m_batchCounter;
+        auto promise = std::make_shared<QPromise<DownloadResult>>();
+        promise->start();
+        batch->m_batchId = batchId;
+        batch->m_future = promise->future();
+        auto entry = m_batches.insert(batchId, BatchEntry{batch, 0, promise});
+        taskIds = enqueueRequests(requests, batchId, &batch->m_totalBytes);
+
+        batch->m_taskIds = taskIds;
+        if (taskIds.isEmpty()) {
+            promise->finish();
+            m_batches.erase(entry);
+        } else {
+            entry->pending = int(taskIds.size());
+        }
+
+        batch->m_taskFutures.reserve(taskIds.size());
+        for (const QString &taskId : std::as_const(taskIds)) {
+            auto taskPromise = std::make_shared<QPromise<DownloadResult>>();
+            taskPromise->start();
+            batch->m_taskFutures.append(taskPromise->future());
+            m_taskPromises.insert(handleForTaskId(taskId), taskPromise);
+        }
+
+        processQueue();
+    }
+
+    if (taskIds.isEmpty()) {
+        QMetaObject::invokeMethod(batch, [batch]() { emit batch->finished(true); }, Qt::QueuedConnection);
+    } else {
+        emit downloadsAdded(taskIds);
+    }
+
+    return batch;
+}
+
+QFuture<DownloadResult> AsulMultiDownloader::addDownloadAsync(const DownloadRequest &request)
+{
+    return addDownloadsAsync({request}).constFirst();
+}
+
+QList<QFuture<DownloadResult>> AsulMultiDownloader::addDownloadsAsync(const QList<DownloadRequest> &requests)
+{
+    QList<QFuture<DownloadResult>> futures;
+    futures.reserve(requests.size());
+
+    QStringList taskIds;
+    {
+        QMutexLocker locker(&m_mutex);
+
+        for (const DownloadRequest &request : requests) {
+            const QStringList added = enqueueRequests({request}, 0);
+            if (added.isEmpty()) {
+                DownloadResult result;
+                result.savePath = request.savePath;
+                result.errorString = QStringLiteral("No download URL");
+                futures.append(readyResult(result));
+                continue;
+            }
+
+            // 结果在任务进入终态时由 settleTask 填入
+            auto promise = std::make_shared<QPromise<DownloadResult>>();
+            promise->start();
+            futures.append(promise->future());
+            m_taskPromises.insert(handleForTaskId(added.constFirst()), promise);
+            taskIds.append(added.constFirst());
+        }
+
+        processQueue();
+    }
+
+    if (!taskIds.isEmpty()) {
+        emit downloadsAdded(taskIds);
+    }
+    return futures;
+}
+
+QStringList AsulMultiDownloader::enqueueRequests(const QList<DownloadRequest> &requests, quint32 batchId,
+                                                 qint64 *plannedBytes)
+{
+    // 注意：调用此方法时应已持有锁
+
+    QStringList taskIds;
+    taskIds.reserve(requests.size());
+    m_records.reserve(m_records.size() + requests.size());
+
+    for (const DownloadRequest &request : requests) {
+        if (request.mirrors.isEmpty()) {
+            continue;
+        }
+
+        // 同一文件已在下载中：挂到现有任务上，不再重复下载
+        const QString key = m_coalescing && !request.savePath.isEmpty() ? coalescingKey(request.savePath) : QString();
+        const quint64 existing = key.isEmpty() ? 0 : m_inflightPaths.value(key);
+        if (existing != 0 && !request.sink) {
+            bool alreadyMember = false;
+            if (attachRequest(existing, request, batchId, &alreadyMember)) {
+                if (!alreadyMember) {
+                    taskIds.append(m_records.value(existing).taskId);
+                    if (plannedBytes && request.size > 0) {
+                        *plannedBytes += request.size;
+                    }
+                }
+                continue;
+            }
+        }
+
+        // 排队阶段只保存记录，任务对象在启动时才创建
+        const quint64 handle = ++m_taskIdCounter;
+        TaskRecord &record = m_records[handle];
+        record.taskId = taskIdForHandle(handle);
+        record.url = selectMirror(request.mirrors);  // 从候选镜像中选择当前最健康的一个
+        record.mirrors = request.mirrors;
+        record.savePath = request.savePath;
+        record.expectedSha1 = request.sha1;
+        record.fileSize = request.size > 0 ? request.size : -1;
+        record.priority = request.priority;
+        record.batchId = batchId;
+        record.transport = request.transport;
+        record.sink = request.sink;
+
+        if (plannedBytes && request.size > 0) {
+            *plannedBytes += request.size;
+        }
+        taskIds.append(record.taskId);
+
+        // 接收器需要完整的数据流，不能挂到现有任务上：排在其后，等它提交文件后从磁盘回放，
+        // 避免两个任务同时写同一个目标文件
+        if (existing != 0 && request.sink) {
+            auto owner = m_records.find(existing);
+            if (owner != m_records.end() && owner->status == DownloadStatus::Paused) {
+                owner->status = DownloadStatus::Queued;
+                enqueueTask(existing);
+            }
+            record.waitingFor = existing;
+            m_pathWaiters.insert(existing, handle);
+            continue;
+        }
+
+        if (!key.isEmpty() && !m_inflightPaths.contains(key)) {
+            m_inflightPaths.insert(key, handle);
+        }
+        enqueueTask(handle);
+    }
+
+    // 之前的任务已全部结束时，重新启动统计和进度定时器
+    if (!taskIds.isEmpty() && m_allFinishedEmitted) {
+        m_allFinishedEmitted = false;
+        m_statisticsTimer->start(1000);
+        m_monitorTimer->start(1000);
+        m_progressTimer->start(m_progressInterval);
+    }
+
+    return taskIds;
+}
+
+void AsulMultiDownloader::settleBatchTask(TaskRecord &record, bool success, const QString &error)
+{
+    // 注意：调用此方法时应已持有锁
+
+    QList<quint32> batchIds;
+    if (!m_attachedBatches.isEmpty()) {
+        const quint64 handle = handleForTaskId(record.taskId);
+        batchIds = m_attachedBatches.values(handle);
+        m_attachedBatches.remove(handle);
+    }
+    if (record.batchId != 0) {
+        batchIds.prepend(record.batchId);
+    }
+    record.batchId = 0;
+    record.attachCount = 0;
+    if (batchIds.isEmpty()) {
+        return;
+    }
+
+    qint64 delta = 0;
+    if (success) {
+        const qint64 finalSize = record.fileSize > 0 ? record.fileSize : record.downloadedSize;
+        delta = finalSize - record.batchReported;
+        record.batchReported = finalSize;
+    }
+
+    for (quint32 batchId : std::as_const(batchIds)) {
+        notifyBatch(batchId, record, success, error, delta);
+    }
+}
+
+void AsulMultiDownloader::notifyBatch(quint32 batchId, const TaskRecord &record, bool success, const QString &error,
+                                      qint64 bytesDelta)
+{
+    // 注意：调用此方法时应已持有锁
+
+    auto it = m_batches.find(batchId);
+    if (it == m_batches.end()) {
+        return;
+    }
+
+    // 结果直接填入批次的 QFuture，即使句柄已被删除
+    QPointer<DownloadBatch> batch = it->batch;
+    if (it->promise) {
+        it->promise->addResult(resultFor(record, success, error));
+    }
+    if (--it->pending <= 0) {
+        if (it->promise) {
+            it->promise->finish();
+        }
+        m_batches.erase(it);
+    }
+    if (!batch) {
+        return;
+    }
+
+    // 经事件循环通知批次，处理函数可以安全地回调下载器
+    const QString taskId = record.taskId;
+    const QString savePath = record.savePath;
+    QMetaObject::invokeMethod(batch, [batch, taskId, savePath, success, error, bytesDelta]() {
+        if (batch) {
+            batch->settleTask(taskId, savePath, success, error, bytesDelta);
+        }
+    }, Qt::QueuedConnection);
+}
+
+void AsulMultiDownloader::settleTask(quint64 handle, TaskRecord &record, bool success, const QString &error)
+{
+    // 注意：调用此方法时应已持有锁
+
+    releaseInflightPath(handle, record);
+    releasePathWaiters(handle, record, success);
+
+    if (!m_taskPromises.isEmpty()) {
+        const auto promises = m_taskPromises.values(handle);
+        if (!promises.isEmpty()) {
+            m_taskPromises.remove(handle);
+            const DownloadResult result = resultFor(record, success, error);
+            for (const auto &promise : promises) {
+                promise->addResult(result);
+                promise->finish();
+            }
+        }
+    }
+
+    settleBatchTask(record, success, error);
+}
+
+DownloadResult AsulMultiDownloader::resultFor(const TaskRecord &record, bool success, const QString &error)
+{
+    DownloadResult result;
+    result.taskId = record.taskId;
+    result.savePath = record.savePath;
+    result.success = success;
+    result.errorString = error;
+    result.fileSize = record.fileSize > 0 ? record.fileSize : (success ? record.downloadedSize : -1);
+    return result;
+}
+
+void AsulMultiDownloader::cancelBatch(quint32 batchId, const QStringList &taskIds)
 {
     QMutexLocker locker(&m_mutex);
 
-    if (!m_tasks.contains(taskId)) {
+    for (const QString &taskId : taskIds) {
+        const quint64 handle = handleForTaskId(taskId);
+        auto it = m_records.find(handle);
+        if (it == m_records.end()) {
+            continue;
+        }
+
+        TaskRecord &record = it.value();
+        const bool primary = record.batchId == batchId;
+        if (!primary && !m_attachedBatches.contains(handle, batchId)) {
+            continue;  // 已结束
+        }
+
+        if (record.attachCount > 0) {
+            // 其他请求仍在等待该文件：只解除本批次的关联
+            if (primary) {
+                record.batchId = 0;
+            } else {
+                m_attachedBatches.remove(handle, batchId);
+            }
+            record.attachCount--;
+            notifyBatch(batchId, record, false, QStringLiteral("Download canceled"), 0);
+        } else {
+            cancelRecord(handle, record);
+        }
+    }
+}
+
+QString AsulMultiDownloader::coalescingKey(const QString &savePath)
+{
+    const QString path = QDir::cleanPath(QFileInfo(savePath).absoluteFilePath());
+#ifdef Q_OS_WIN
+    return path.toLower();
+#else
+    return path;
+#endif
+}
+
+bool AsulMultiDownloader::attachRequest(quint64 handle, const DownloadRequest &request, quint32 batchId,
+                                        bool *alreadyMember)
+{
+    // 注意：调用此方法时应已持有锁
+
+    auto it = m_records.find(handle);
+    if (it == m_records.end()) {
+        return false;
+    }
+
+    TaskRecord &record = it.value();
+    if (record.status != DownloadStatus::Queued && record.status != DownloadStatus::Downloading
+        && record.status != DownloadStatus::Paused) {
+        return false;
+    }
+
+    // 摘要不同说明期望的是另一份内容；已启动的任务无法再追加校验
+    if (!request.sha1.isEmpty() && record.expectedSha1.compare(request.sha1, Qt::CaseInsensitive) != 0) {
+        if (!record.expectedSha1.isEmpty() || record.task) {
+            return false;
+        }
+        record.expectedSha1 = request.sha1;
+    }
+
+    *alreadyMember = batchId != 0 && (record.batchId == batchId || m_attachedBatches.contains(handle, batchId));
+    if (*alreadyMember) {
+        return true;
+    }
+
+    if (!record.task && record.fileSize <= 0 && request.size > 0) {
+        record.fileSize = request.size;
+    }
+    for (const QUrl &mirror : request.mirrors) {
+        if (!record.mirrors.contains(mirror)) {
+            record.mirrors.append(mirror);
+        }
+    }
+
+    // 新请求的优先级更高时提前调度；暂停的任务有了新的等待方，重新排队
+    if (record.status == DownloadStatus::Paused) {
+        record.status = DownloadStatus::Queued;
+        record.priority = qMax(record.priority, request.priority);
+        enqueueTask(handle);
+    } else if (request.priority > record.priority && record.status == DownloadStatus::Queued
+               && removeQueuedTask(handle)) {
+        record.priority = request.priority;
+        enqueueTask(handle);
+    }
+
+    record.attachCount++;
+    if (batchId == 0) {
+        return true;
+    }
+
+    if (record.batchId == 0) {
+        record.batchId = batchId;
+    } else {
+        m_attachedBatches.insert(handle, batchId);
+    }
+
+    // 已经下载的部分计入新批次
+    QPointer<DownloadBatch> batch = m_batches.value(batchId).batch;
+    const qint64 received = record.batchReported;
+    if (batch && received > 0) {
+        QMetaObject::invokeMethod(batch, [batch, received]() {
+            if (batch) {
+                batch->addReceived(received);
+            }
+        }, Qt::QueuedConnection);
+    }
+    return true;
+}
+
+void AsulMultiDownloader::releaseInflightPath(quint64 handle, const TaskRecord &record)
+{
+    // 注意：调用此方法时应已持有锁
+
+    if (m_inflightPaths.isEmpty() || record.savePath.isEmpty()) {
         return;
     }
 
-    // 状态守卫：仅处理 Downloading 状态的任务，防止重复处理
-    if (m_taskStatus[taskId] != DownloadStatus::Downloading) {
+    const QString key = coalescingKey(record.savePath);
+    auto it = m_inflightPaths.find(key);
+    if (it != m_inflightPaths.end() && it.value() == handle) {
+        m_inflightPaths.erase(it);
+    }
+}
+
+void AsulMultiDownloader::releasePathWaiters(quint64 handle, const TaskRecord &record, bool success)
+{
+    // 注意：调用此方法时应已持有锁
+
+    if (m_pathWaiters.isEmpty()) {
         return;
     }
+    QList<quint64> waiters = m_pathWaiters.values(handle);
+    if (waiters.isEmpty()) {
+        return;
+    }
+    m_pathWaiters.remove(handle);
+    std::sort(waiters.begin(), waiters.end());  // 句柄递增，按提交顺序启动
+
+    // 成功时文件已提交，各方都从磁盘回放；失败或取消时由第一个等待方重新下载，其余继续排队
+    const QString key = coalescingKey(record.savePath);
+    quint64 owner = 0;
+    bool queued = false;
+    for (const quint64 waiter : std::as_const(waiters)) {
+        auto it = m_records.find(waiter);
+        if (it == m_records.end() || it->waitingFor != handle
+            || (it->status != DownloadStatus::Queued && it->status != DownloadStatus::Paused)) {
+            continue;  // 等待期间已取消
+        }
 
-    auto task = m_tasks[taskId];
-    updateHostConnections(task->url().host(), -1);
-    m_activeDownloads--;
+        TaskRecord &next = it.value();
+        if (!success && owner != 0) {
+            next.waitingFor = owner;
+            m_pathWaiters.insert(owner, waiter);
+            continue;
+        }
+
+        next.waitingFor = 0;
+        next.replayLocal = success;
+        if (!m_inflightPaths.contains(key)) {
+            m_inflightPaths.insert(key, waiter);
+        }
+        if (!success) {
+            owner = waiter;
+        }
+        if (next.status == DownloadStatus::Queued) {
+            enqueueTask(waiter);
+            queued = true;
+        }
+    }
+
+    if (queued) {
+        processQueue();
+    }
+}
 
-    // 检查是否需要重试
-    if (m_autoRetry && m_taskRetryCount[taskId] < m_maxRetryCount) {
-        m_taskRetryCount[taskId]++;
-        m_taskStatus[taskId] = DownloadStatus::Queued;
-        m_taskQueue.enqueue(taskId);
+void AsulMultiDownloader::pauseDownload(const QString &taskId)
+{
+    QMutexLocker locker(&m_mutex);
 
-        emit downloadRetrying(taskId, m_taskRetryCount[taskId]);
+    const quint64 handle = handleForTaskId(taskId);
+    auto it = m_records.find(handle);
+    if (it == m_records.end()) {
+        return;
+    }
 
+    TaskRecord &record = it.value();
+    if (record.status == DownloadStatus::Downloading) {
+        runOnTaskThread(record.task, [](DownloadTask *task) {
+            task->pause();
+            task->releaseLiveBytes();
+        });
+        forgetTaskProgress(taskId);
+        m_taskStartTime.remove(handle);
+        record.status = DownloadStatus::Paused;
+        updateHostConnections(record, -1);
+        updatePriorityConnections(record.priority, -1);
+        m_activeDownloads--;
+        retireTask(record);
         processQueue();
-    } else {
-        m_taskStatus[taskId] = DownloadStatus::Failed;
-        m_statistics.failedTasks++;
+        emit downloadPaused(taskId);
+    } else if (record.status == DownloadStatus::Queued) {
+        record.status = DownloadStatus::Paused;
+        removeQueuedTask(handle);
+    }
+}
 
-        emit downloadFailed(taskId, error);
+void AsulMultiDownloader::resumeDownload(const QString &taskId)
+{
+    QMutexLocker locker(&m_mutex);
+
+    const quint64 handle = handleForTaskId(taskId);
+    auto it = m_records.find(handle);
+    if (it == m_records.end()) {
+        return;
+    }
+
+    if (it->status == DownloadStatus::Paused) {
+        it->status = DownloadStatus::Queued;
+        if (it->waitingFor == 0) {
+            enqueueTask(handle);
+            processQueue();
+        }
+    }
+}
 
+void AsulMultiDownloader::cancelDownload(const QString &taskId)
+{
+    QMutexLocker locker(&m_mutex);
+
+    const quint64 handle = handleForTaskId(taskId);
+    auto it = m_records.find(handle);
+    if (it == m_records.end()) {
+        return;
+    }
+
+    cancelRecord(handle, it.value());
+}
+
+void AsulMultiDownloader::cancelRecord(quint64 handle, TaskRecord &record)
+{
+    // 注意：调用此方法时应已持有锁
+
+    const QString taskId = record.taskId;
+    const DownloadStatus previous = record.status;
+    if (record.status == DownloadStatus::Downloading) {
+        runOnTaskThread(record.task, [](DownloadTask *task) {
+            task->cancel();
+            task->releaseLiveBytes();
+        });
+        forgetTaskProgress(taskId);
+        m_taskStartTime.remove(handle);
+        record.status = DownloadStatus::Canceled;
+        updateHostConnections(record, -1);
+        updatePriorityConnections(record.priority, -1);
+        m_activeDownloads--;
+        retireTask(record);
         processQueue();
+    } else if (record.status == DownloadStatus::Queued) {
+        record.status = DownloadStatus::Canceled;
+        removeQueuedTask(handle);
+    } else {
+        record.status = DownloadStatus::Canceled;
+    }
 
-        // 检查是否所有任务都完成了（包括失败的任务）
-        checkAndEmitAllFinished();
+    if (previous == DownloadStatus::Downloading || previous == DownloadStatus::Queued
+        || previous == DownloadStatus::Paused) {
+        settleTask(handle, record, false, QStringLiteral("Download canceled"));
+    }
+
+    emit downloadCanceled(taskId);
+}
+
+void AsulMultiDownloader::pauseAll()
+{
+    QMutexLocker locker(&m_mutex);
+
+    QStringList taskIds;
+    taskIds.reserve(m_records.size());
+    for (const TaskRecord &record : std::as_const(m_records)) {
+        taskIds.append(record.taskId);
+    }
+
+    for (const QString &taskId : taskIds) {
+        locker.unlock();
+        pauseDownload(taskId);
+        locker.relock();
+    }
+}
+
+void AsulMultiDownloader::resumeAll()
+{
+    QMutexLocker locker(&m_mutex);
+
+    QStringList taskIds;
+    taskIds.reserve(m_records.size());
+    for (const TaskRecord &record : std::as_const(m_records)) {
+        taskIds.append(record.taskId);
+    }
+
+    for (const QString &taskId : taskIds) {
+        locker.unlock();
+        resumeDownload(taskId);
+        locker.relock();
+    }
+}
+
+void AsulMultiDownloader::cancelAll()
+{
+    QMutexLocker locker(&m_mutex);
+
+    QStringList taskIds;
+    taskIds.reserve(m_records.size());
+    for (const TaskRecord &record : std::as_const(m_records)) {
+        taskIds.append(record.taskId);
+    }
+
+    for (const QString &taskId : taskIds) {
+        locker.unlock();
+        cancelDownload(taskId);
+        locker.relock();
+    }
+}
+
+void AsulMultiDownloader::clearFinishedTasks()
+{
+    QMutexLocker locker(&m_mutex);
+
+    for (auto it = m_records.begin(); it != m_records.end();) {
+        if (it->status == DownloadStatus::Completed ||
+            it->status == DownloadStatus::Failed ||
+            it->status == DownloadStatus::Canceled) {
+            it = m_records.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+
+// ==================== 查询接口实现 ====================
+
+DownloadInfo AsulMultiDownloader::getDownloadInfo(const QString &taskId) const
+{
+    QMutexLocker locker(&m_mutex);
+
+    DownloadInfo info;
+
+    auto it = m_records.constFind(handleForTaskId(taskId));
+    if (it == m_records.constEnd()) {
+        return info;
+    }
+
+    const TaskRecord &record = it.value();
+    info.taskId = taskId;
+    info.url = record.url;
+    info.savePath = record.savePath;
+    info.priority = record.priority;
+
+    if (record.task) {
+        // 运行中：读取实时状态
+        info.fileSize = record.task->fileSize();
+        info.downloadedSize = record.task->downloadedSize();
+        info.supportRange = record.task->supportRange();
+        info.segmentCount = record.task->segmentCount();
+        info.errorString = record.task->errorString();
+    } else {
+        info.fileSize = record.fileSize;
+        info.downloadedSize = record.downloadedSize;
+        info.errorString = record.errorString;
+    }
+
+    return info;
+}
+
+DownloadStatus AsulMultiDownloader::getDownloadStatus(const QString &taskId) const
+{
+    QMutexLocker locker(&m_mutex);
+
+    auto it = m_records.constFind(handleForTaskId(taskId));
+    if (it == m_records.constEnd()) {
+        return DownloadStatus::Failed;
+    }
+
+    return it->status;
+}
+
+double AsulMultiDownloader::getDownloadProgress(const QString &taskId) const
+{
+    QMutexLocker locker(&m_mutex);
+
+    auto it = m_records.constFind(handleForTaskId(taskId));
+    if (it == m_records.constEnd()) {
+        return 0.0;
+    }
+
+    const qint64 fileSize = it->task ? it->task->fileSize() : it->fileSize;
+    const qint64 downloaded = it->task ? it->task->downloadedSize() : it->downloadedSize;
+
+    if (fileSize <= 0) {
+        return 0.0;
+    }
+
+    return (downloaded * 100.0) / fileSize;
+}
+
+qint64 AsulMultiDownloader::getDownloadSpeed(const QString &taskId) const
+{
+    // 这个方法需要额外的速度跟踪机制，暂时返回0
+    // 在实际应用中，可以维护一个时间窗口内的下载量来计算速度
+    Q_UNUSED(taskId);
+    return 0;
+}
+
+QStringList AsulMultiDownloader::getAllTaskIds() const
+{
+    QMutexLocker locker(&m_mutex);
+
+    QStringList taskIds;
+    taskIds.reserve(m_records.size());
+    for (const TaskRecord &record : m_records) {
+        taskIds.append(record.taskId);
+    }
+    return taskIds;
+}
+
+DownloadStatistics AsulMultiDownloader::getStatistics() const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_statistics;
+}
+
+// ==================== 私有槽函数实现 ====================
+
+void AsulMultiDownloader::onTaskFinished(const QString &taskId)
+{
+    QMutexLocker locker(&m_mutex);
+
+    const quint64 handle = handleForTaskId(taskId);
+    auto it = m_records.find(handle);
+
+    // 状态守卫：仅处理 Downloading 状态的任务，防止重复处理；
+    // 工作线程中的结果经事件循环到达，暂停或重试后重新启动的任务可能收到旧任务对象的迟到信号
+    if (it == m_records.end() || it->status != DownloadStatus::Downloading || !it->task
+        || sender() != it->task.get()) {
+        return;
+    }
+
+    TaskRecord &record = it.value();
+    auto task = record.task;
+    record.status = DownloadStatus::Completed;
+    updateHostConnections(record, -1);
+    updatePriorityConnections(record.priority, -1);
+    recordHostResult(record.url.host(), task->fileSize(), true);
+    recordMirrorResult(task->servedUrl().host(), true);
+    m_activeDownloads--;
+    m_statistics.completedTasks++;
+    m_completedBytes.fetch_add(task->fileSize() > 0 ? task->fileSize() : task->downloadedSize(),
+                               std::memory_order_relaxed);
+    task->releaseLiveBytes();
+    forgetTaskProgress(taskId);
+    m_taskStartTime.remove(handle);
+    retireTask(record);
+    record.sink.reset();  // 结果已在接收器中，由调用方持有
+    settleTask(handle, record, true, QString());
+
+    emit downloadFinished(taskId, record.savePath);
+
+    processQueue();
+
+    // 检查是否所有任务都完成了
+    checkAndEmitAllFinished();
+}
+
+void AsulMultiDownloader::onTaskFailed(const QString &taskId, const QString &error)
+{
+    QMutexLocker locker(&m_mutex);
+
+    const quint64 handle = handleForTaskId(taskId);
+    auto it = m_records.find(handle);
+
+    // 状态守卫：仅处理 Downloading 状态的任务，防止重复处理（同 onTaskFinished）
+    if (it == m_records.end() || it->status != DownloadStatus::Downloading || !it->task
+        || sender() != it->task.get()) {
+        return;
+    }
+
+    TaskRecord &record = it.value();
+    const DownloadFailure failure = record.task->failure();
+    updateHostConnections(record, -1);
+    updatePriorityConnections(record.priority, -1);
+    if (isCongestionFailure(failure)) {
+        recordHostResult(record.url.host(), 0, false);
+    }
+    recordMirrorResult(record.task->servedUrl().host(), false);
+    m_activeDownloads--;
+    record.task->releaseLiveBytes();
+    forgetTaskProgress(taskId);
+    m_taskStartTime.remove(handle);
+    retireTask(record);
+
+    if (m_autoRetry && scheduleRetry(handle, record, failure)) {
+        emit downloadRetrying(taskId, record.retryCount);
+
+        processQueue();
+    } else {
+        record.status = DownloadStatus::Failed;
+        m_statistics.failedTasks++;
+        record.sink.reset();
+        settleTask(handle, record, false, error);
+
+        emit downloadFailed(taskId, error);
+
+        processQueue();
+
+        // 检查是否所有任务都完成了（包括失败的任务）
+        checkAndEmitAllFinished();
+    }
+}
+
+void AsulMultiDownloader::onTaskProgress(const QString &taskId, qint64 received, qint64 total)
+{
+    // 高频路径：只更新卡住检测时间戳并合并进度，由 onFlushProgress 按间隔统一发射
+    const qint64 now = QDateTime::currentMSecsSinceEpoch();
+
+    QMutexLocker progressLocker(&m_progressMutex);
+    m_taskLastProgress[taskId] = now;
+
+    PendingProgress &pending = m_pendingProgress[taskId];
+    pending.received = received;
+    pending.total = total;
+    if (received > 0 && pending.firstDataAt == 0) {
+        pending.firstDataAt = now;
+    }
+}
+
+void AsulMultiDownloader::onRetryTimer()
+{
+    QMutexLocker locker(&m_mutex);
+
+    const qint64 now = QDateTime::currentMSecsSinceEpoch();
+
+    while (!m_delayedRetries.isEmpty() && m_delayedRetries.firstKey() <= now) {
+        const quint64 handle = m_delayedRetries.first();
+        m_delayedRetries.erase(m_delayedRetries.begin());
+
+        auto it = m_records.constFind(handle);
+        if (it != m_records.constEnd() && it->status == DownloadStatus::Queued) {
+            enqueueTask(handle);
+        }
+    }
+
+    for (auto it = m_hostThrottleUntil.begin(); it != m_hostThrottleUntil.end();) {
+        if (it.value() <= now) {
+            it = m_hostThrottleUntil.erase(it);
+        } else {
+            ++it;
+        }
+    }
+
+    processQueue();
+    armRetryTimer();
+    checkAndEmitAllFinished();
+}
+
+void AsulMultiDownloader::onFlushProgress()
+{
+    QHash<QString, PendingProgress> pending;
+    {
+        QMutexLocker progressLocker(&m_progressMutex);
+        if (m_pendingProgress.isEmpty()) {
+            return;
+        }
+        pending.swap(m_pendingProgress);
+    }
+
+    // 首个数据到达：记录该镜像的首字节延迟
+    {
+        QMutexLocker locker(&m_mutex);
+        for (auto it = pending.constBegin(); it != pending.constEnd() && !m_taskStartTime.isEmpty(); ++it) {
+            if (it->firstDataAt == 0) {
+                continue;
+            }
+            const quint64 handle = handleForTaskId(it.key());
+            auto startIt = m_taskStartTime.find(handle);
+            if (startIt == m_taskStartTime.end()) {
+                continue;
+            }
+            auto recordIt = m_records.constFind(handle);
+            if (recordIt != m_records.constEnd() && recordIt->task) {
+                recordMirrorLatency(recordIt->task->servedUrl().host(), it->firstDataAt - startIt.value());
+            }
+            m_taskStartTime.erase(startIt);
+        }
+
+        // 按批次累计进度增量，每个批次每个间隔只通知一次
+        if (!m_batches.isEmpty()) {
+            QHash<quint32, qint64> batchDeltas;
+            for (auto it = pending.constBegin(); it != pending.constEnd(); ++it) {
+                const quint64 handle = handleForTaskId(it.key());
+                auto recordIt = m_records.find(handle);
+                if (recordIt == m_records.end()) {
+                    continue;
+                }
+                const QList<quint32> attached = m_attachedBatches.isEmpty() ? QList<quint32>()
+                                                                            : m_attachedBatches.values(handle);
+                if (recordIt->batchId == 0 && attached.isEmpty()) {
+                    continue;
+                }
+                const qint64 delta = it->received - recordIt->batchReported;
+                recordIt->batchReported = it->received;
+                if (recordIt->batchId != 0) {
+                    batchDeltas[recordIt->batchId] += delta;
+                }
+                for (quint32 batchId : attached) {
+                    batchDeltas[batchId] += delta;
+                }
+            }
+            for (auto it = batchDeltas.constBegin(); it != batchDeltas.constEnd(); ++it) {
+                QPointer<DownloadBatch> batch = m_batches.value(it.key()).batch;
+                const qint64 delta = it.value();
+                if (batch && delta != 0) {
+                    QMetaObject::invokeMethod(batch, [batch, delta]() {
+                        if (batch) {
+                            batch->addReceived(delta);
+                        }
+                    }, Qt::QueuedConnection);
+                }
+            }
+        }
+    }
+
+    QList<DownloadProgressSnapshot> snapshots;
+    snapshots.reserve(pending.size());
+    for (auto it = pending.constBegin(); it != pending.constEnd(); ++it) {
+        snapshots.append({it.key(), it->received, it->total});
+        emit downloadProgress(it.key(), it->received, it->total);
+    }
+    emit downloadProgressBatch(snapshots);
+}
+
+void AsulMultiDownloader::forgetTaskProgress(const QString &taskId)
+{
+    QMutexLocker progressLocker(&m_progressMutex);
+    m_taskLastProgress.remove(taskId);
+    m_pendingProgress.remove(taskId);
+}
+
+void AsulMultiDownloader::onUpdateStatistics()
+{
+    QMutexLocker locker(&m_mutex);
+
+    m_statistics.activeDownloads = m_activeDownloads;
+    m_statistics.queuedDownloads = m_queuedCount + int(m_delayedRetries.size());
+
+    // 计算总下载量：已完成任务用fileSize（精确），进行中任务用downloadedSize（实时）
+    // 两者均由任务增量维护，无需遍历任务列表；Queued/Failed/Paused的任务不计入
+    const qint64 totalDownloaded = m_completedBytes.load(std::memory_order_relaxed)
+                                   + qMax<qint64>(0, m_liveBytes.load(std::memory_order_relaxed));
+    m_statistics.totalDownloaded = totalDownloaded;
+
+    // 计算下载速度
+    qint64 currentTime = QDateTime::currentMSecsSinceEpoch();
+    if (m_lastSpeedCheck > 0) {
+        qint64 timeDiff = currentTime - m_lastSpeedCheck;
+        if (timeDiff >= 1000) {  // 至少1秒
+            qint64 bytesDiff = totalDownloaded - m_lastBytesDownloaded;
+            if (bytesDiff < 0) bytesDiff = 0;  // 防止负速度（重试时downloadedSize重置）
+            // 计算速度（字节/秒）
+            m_statistics.totalDownloadSpeed = (bytesDiff * 1000) / timeDiff;
+
+            // 限制最大速度显示（避免显示不合理的高速度）
+            if (m_statistics.totalDownloadSpeed > 1024 * 1024 * 1024) {
+                m_statistics.totalDownloadSpeed = 0;
+            }
+
+            m_lastSpeedCheck = currentTime;
+            m_lastBytesDownloaded = totalDownloaded;
+        }
+    } else {
+        m_lastSpeedCheck = currentTime;
+        m_lastBytesDownloaded = totalDownloaded;
+        m_statistics.totalDownloadSpeed = 0;
+    }
+
+    emit statisticsChanged(m_statistics);
+}
+
+// ==================== 私有方法实现 ====================
+
+void AsulMultiDownloader::processQueue()
+{
+    // 注意：调用此方法时应已持有锁
+
+    const int maxActive = qMin(m_maxConcurrentDownloads, rateLimitedSlots(m_bandwidth->globalRate()));
+    while (m_queuedCount > 0 && m_activeDownloads < maxActive) {
+        const quint64 handle = dequeueNextTask();
+
+        if (handle == 0) {
+            // 剩余任务所在的Host均已达到连接上限，等待连接释放
+            break;
+        }
+
+        if (!m_records.contains(handle)) {
+            continue;
+        }
+
+        startDownloadTask(handle);
+    }
+}
+
+void AsulMultiDownloader::enqueueTask(quint64 handle)
+{
+    // 注意：调用此方法时应已持有锁
+
+    auto recordIt = m_records.constFind(handle);
+    if (recordIt == m_records.constEnd()) {
+        return;
+    }
+
+    const QString host = recordIt->url.host();
+    PriorityBucket &bucket = m_readyQueues[recordIt->priority];
+
+    auto queueIt = bucket.hostQueues.find(host);
+    if (queueIt == bucket.hostQueues.end()) {
+        queueIt = bucket.hostQueues.insert(host, QQueue<quint64>());
+        bucket.hostRing.append(host);
+    }
+
+    queueIt->enqueue(handle);
+    m_queuedCount++;
+}
+
+bool AsulMultiDownloader::removeQueuedTask(quint64 handle)
+{
+    // 注意：调用此方法时应已持有锁
+
+    auto recordIt = m_records.constFind(handle);
+    if (recordIt == m_records.constEnd()) {
+        return false;
+    }
+
+    // 退避中的任务不在就绪队列里
+    for (auto delayedIt = m_delayedRetries.begin(); delayedIt != m_delayedRetries.end(); ++delayedIt) {
+        if (delayedIt.value() == handle) {
+            m_delayedRetries.erase(delayedIt);
+            return true;
+        }
+    }
+
+    auto bucketIt = m_readyQueues.find(recordIt->priority);
+    if (bucketIt == m_readyQueues.end()) {
+        return false;
+    }
+
+    PriorityBucket &bucket = bucketIt.value();
+    const QString host = recordIt->url.host();
+    auto queueIt = bucket.hostQueues.find(host);
+    if (queueIt == bucket.hostQueues.end() || !queueIt->removeOne(handle)) {
+        return false;
+    }
+
+    m_queuedCount--;
+
+    if (queueIt->isEmpty()) {
+        bucket.hostQueues.erase(queueIt);
+        const int slot = bucket.hostRing.indexOf(host);
+        bucket.hostRing.removeAt(slot);
+        if (slot < bucket.cursor) {
+            bucket.cursor--;
+        }
+        if (bucket.cursor >= bucket.hostRing.size()) {
+            bucket.cursor = 0;
+        }
+    }
+
+    if (bucket.hostRing.isEmpty()) {
+        m_readyQueues.erase(bucketIt);
+    }
+
+    return true;
+}
+
+quint64 AsulMultiDownloader::dequeueNextTask()
+{
+    // 注意：调用此方法时应已持有锁
+    // 高优先级先调度；同一优先级内各Host轮转，连接已满的Host跳过，
+    // 若某优先级的Host全部已满，则继续尝试更低优先级的其他Host
+
+    for (auto it = m_readyQueues.end(); it != m_readyQueues.begin();) {
+        --it;
+        PriorityBucket &bucket = it.value();
+        const int hostCount = bucket.hostRing.size();
+
+        // 该优先级限速下的在途任务已满
+        if (m_priorityConnections.value(it.key(), 0) >= rateLimitedSlots(m_bandwidth->priorityRate(it.key()))) {
+            continue;
+        }
+
+        for (int step = 0; step < hostCount; ++step) {
+            const int slot = (bucket.cursor + step) % hostCount;
+            const QString host = bucket.hostRing.at(slot);
+
+            if (!canStartDownload(host)) {
+                continue;
+            }
+
+            // HTTP/2请求复用少量连接，每个Host的在途流数不超过 连接数 × 每连接流数
+            QQueue<quint64> &queue = bucket.hostQueues[host];
+            const auto next = m_records.constFind(queue.head());
+            if (next != m_records.constEnd() && http2For(next->transport)
+                && m_hostHttp2Streams.value(host, 0) >= http2StreamLimit()) {
+                continue;
+            }
+
+            const quint64 handle = queue.dequeue();
+            m_queuedCount--;
+
+            if (queue.isEmpty()) {
+                bucket.hostQueues.remove(host);
+                bucket.hostRing.removeAt(slot);
+                bucket.cursor = bucket.hostRing.isEmpty() ? 0 : slot % bucket.hostRing.size();
+            } else {
+                bucket.cursor = (slot + 1) % hostCount;
+            }
+
+            if (bucket.hostRing.isEmpty()) {
+                m_readyQueues.erase(it);
+            }
+
+            return handle;
+        }
+    }
+
+    return 0;
+}
+
+void AsulMultiDownloader::startDownloadTask(quint64 handle)
+{
+    ensureNetworkShards();
+
+    TaskRecord &record = m_records[handle];
+    record.task = createTask(handle, record);
+    record.status = DownloadStatus::Downloading;
+
+    const qint64 now = QDateTime::currentMSecsSinceEpoch();
+    m_taskStartTime[handle] = now;
+    {
+        QMutexLocker progressLocker(&m_progressMutex);
+        m_taskLastProgress[record.taskId] = now;  // 初始化卡住检测时间戳
+    }
+    updateHostConnections(record, 1);
+    updatePriorityConnections(record.priority, 1);
+    m_activeDownloads++;
+
+    armMirrorHedge(record, record.task.get());
+
+    // 启动任务（持有副本，防止启动过程中同步失败导致记录中的指针被释放）
+    auto task = record.task;
+    runOnTaskThread(task, [](DownloadTask *t) { t->start(); });
+}
+
+std::shared_ptr<DownloadTask> AsulMultiDownloader::createTask(quint64 handle, const TaskRecord &record)
+{
+    // 任务对象可能在自身信号的处理过程中被释放，因此延迟到事件循环中删除
+    std::shared_ptr<DownloadTask> task(
+        new DownloadTask(record.taskId, record.url, record.savePath, record.priority, this),
+        [](DownloadTask *t) { t->deleteLater(); });
+    task->setTimeout(m_downloadTimeout);
+    task->setLargeFileThreshold(record.transport.largeFileThreshold >= 0 ? record.transport.largeFileThreshold
+                                                                          : m_largeFileThreshold);
+    task->setMultiThreadAllowed(!shouldDisableMultiThread(record.url));
+
+    // 同一句柄总是分配到同一个工作线程，暂停、取消与随后的重新启动按顺序执行
+    const int shard = m_shards.isEmpty() ? -1 : int(handle % quint64(m_shards.size()));
+    if (shard >= 0) {
+        const NetworkShard &target = m_shards.at(shard);
+        task->setParent(nullptr);
+        task->moveToThread(target.thread);
+        const quint64 slot = handle / quint64(m_shards.size());
+        task->m_networkManager = target.managers.at(int(slot % quint64(target.managers.size())));
+    }
+    if (http2For(record.transport)) {
+        ensureHttp2NetworkManagers();  // 全局未启用时由请求首次使用时创建
+        task->setHttp2NetworkManager(getHttp2NetworkManager(shard));
+    }
+
+    // 设置已知文件大小（跳过HEAD请求优化）
+    if (record.fileSize > 0) {
+        task->setKnownFileSize(record.fileSize);
+    }
+
+    // 设置期望摘要（下载过程中流式校验）
+    if (!record.expectedSha1.isEmpty()) {
+        task->setExpectedSha1(record.expectedSha1);
+    }
+    if (record.sink) {
+        task->setSink(record.sink);
+        task->setReplayLocal(record.replayLocal);
+    }
+
+    // 设置分段数
+    task->setSegmentCount(record.transport.segmentCount > 0 ? record.transport.segmentCount : m_segmentCount);
+    task->setDirectSegmentWrite(m_directSegmentWrite);
+    task->setAdaptiveSegments(m_adaptiveSegments);
+    task->setRangedProbe(m_rangedProbe);
+
+    // 连接信号：进度在任务所在线程中直接合并（onTaskProgress 线程安全），
+    // 开始、完成、失败经事件循环回到下载器所在线程；暂停由 pauseDownload 直接通知
+    connect(task.get(), &DownloadTask::started, this, &AsulMultiDownloader::downloadStarted);
+    connect(task.get(), &DownloadTask::progress, this, &AsulMultiDownloader::onTaskProgress, Qt::DirectConnection);
+    connect(task.get(), &DownloadTask::finished, this, &AsulMultiDownloader::onTaskFinished);
+    connect(task.get(), &DownloadTask::failed, this, &AsulMultiDownloader::onTaskFailed);
+    connect(task.get(), &DownloadTask::resumed, this, &AsulMultiDownloader::downloadResumed);
+
+    return task;
+}
+
+void AsulMultiDownloader::retireTask(TaskRecord &record)
+{
+    // 注意：调用此方法时应已持有锁
+
+    if (!record.task) {
+        return;
+    }
+
+    record.fileSize = record.task->fileSize();
+    record.downloadedSize = record.task->downloadedSize();
+    record.errorString = record.task->errorString();
+
+    // 断开后，任务对象在删除前发出的迟到信号不再影响记录
+    record.task->disconnect(this);
+    record.task.reset();
+}
+
+QString AsulMultiDownloader::taskIdForHandle(quint64 handle)
+{
+    // 只由句柄决定：合并到在途任务的请求拿到的ID与该任务之后发出的信号一致
+    return QStringLiteral("task_%1").arg(handle);
+}
+
+quint64 AsulMultiDownloader::handleForTaskId(const QString &taskId)
+{
+    const qsizetype separator = taskId.lastIndexOf(QLatin1Char('_'));
+    if (separator < 0) {
+        return 0;
+    }
+    return QStringView(taskId).sliced(separator + 1).toULongLong();
+}
+
+bool AsulMultiDownloader::ensureDirectory(const QString &dirPath)
+{
+    QMutexLocker locker(&m_dirMutex);
+
+    if (m_knownDirs.contains(dirPath)) {
+        return true;
+    }
+
+    if (!QDir().mkpath(dirPath)) {
+        return false;
+    }
+
+    m_knownDirs.insert(dirPath);
+    return true;
+}
+
+void AsulMultiDownloader::forgetDirectory(const QString &dirPath)
+{
+    QMutexLocker locker(&m_dirMutex);
+    m_knownDirs.remove(dirPath);
+}
+
+void AsulMultiDownloader::updateHostConnections(TaskRecord &record, int delta)
+{
+    const QString host = record.url.host();
+
+    // HTTP/2请求另计流数：启动时按请求的传输设置决定，结束时按同一标记归还
+    if (delta > 0) {
+        record.http2Stream = http2For(record.transport);
+    }
+    if (record.http2Stream) {
+        int &streams = m_hostHttp2Streams[host];
+        streams += delta;
+        if (streams <= 0) {
+            m_hostHttp2Streams.remove(host);
+        }
+        if (delta < 0) {
+            record.http2Stream = false;
+        }
+    }
+
+    if (!m_hostConnections.contains(host)) {
+        m_hostConnections[host] = 0;
+    }
+
+    m_hostConnections[host] += delta;
+
+    if (m_adaptiveConcurrency && delta > 0) {
+        HostCongestion &state = m_hostCongestion[host];
+        if (state.limit <= 0) {
+            state.limit = kInitialHostLimit;
+            state.windowStart = QDateTime::currentMSecsSinceEpoch();
+        }
+        state.peakInFlight = qMax(state.peakInFlight, m_hostConnections[host]);
+    }
+
+    if (m_hostConnections[host] <= 0) {
+        m_hostConnections.remove(host);
+    }
+}
+
+void AsulMultiDownloader::updatePriorityConnections(int priority, int delta)
+{
+    int &count = m_priorityConnections[priority];
+    count += delta;
+    if (count <= 0) {
+        m_priorityConnections.remove(priority);
+    }
+}
+
+int AsulMultiDownloader::rateLimitedSlots(qint64 bytesPerSecond)
+{
+    if (bytesPerSecond <= 0) {
+        return INT_MAX;
+    }
+    return int(qBound<qint64>(1, bytesPerSecond / kMinPacedBytesPerTask, INT_MAX));
+}
+
+int AsulMultiDownloader::getHostConnections(const QString &host) const
+{
+    return m_hostConnections.value(host, 0);
+}
+
+bool AsulMultiDownloader::canStartDownload(const QString &host) const
+{
+    return getHostConnections(host) < effectiveHostLimit(host) && !isHostThrottled(host);
+}
+
+bool AsulMultiDownloader::isHostThrottled(const QString &host) const
+{
+    auto it = m_hostThrottleUntil.constFind(host);
+    return it != m_hostThrottleUntil.constEnd() && it.value() > QDateTime::currentMSecsSinceEpoch();
+}
+
+bool AsulMultiDownloader::scheduleRetry(quint64 handle, TaskRecord &record, const DownloadFailure &failure)
+{
+    // 注意：调用此方法时应已持有锁
+
+    const DownloadFailureKind kind = m_retryPolicy->classify(failure);
+    const qint64 now = QDateTime::currentMSecsSinceEpoch();
+
+    qint64 delay = 0;
+    if (kind == DownloadFailureKind::Throttled) {
+        // 服务端限流：该Host在等待期内不再启动任何任务
+        delay = m_retryPolicy->retryDelay(failure, kind, record.retryCount + 1);
+        const QString host = record.url.host();
+        qint64 &until = m_hostThrottleUntil[host];
+        until = qMax(until, now + delay);
+        qDebug() << QString("[RETRY] Host %1 throttled (HTTP %2), pausing for %3ms")
+                    .arg(host).arg(failure.httpStatus).arg(until - now);
+    }
+
+    // 有其他镜像时先立即切换镜像，每个镜像都至少尝试一次后才消耗重试次数
+    if (failoverMirror(record)) {
+        record.status = DownloadStatus::Queued;
+        enqueueTask(handle);
+        armRetryTimer();
+        return true;
+    }
+
+    if (kind == DownloadFailureKind::Permanent || record.retryCount >= m_maxRetryCount) {
+        armRetryTimer();
+        return false;
+    }
+
+    record.retryCount++;
+    if (kind == DownloadFailureKind::Transient) {
+        delay = m_retryPolicy->retryDelay(failure, kind, record.retryCount);
+    }
+
+    record.status = DownloadStatus::Queued;
+    if (delay > 0) {
+        m_delayedRetries.insert(now + delay, handle);
+    } else {
+        enqueueTask(handle);
+    }
+    armRetryTimer();
+    return true;
+}
+
+void AsulMultiDownloader::armRetryTimer()
+{
+    // 注意：调用此方法时应已持有锁
+
+    qint64 next = std::numeric_limits<qint64>::max();
+    if (!m_delayedRetries.isEmpty()) {
+        next = m_delayedRetries.firstKey();
+    }
+    for (const qint64 until : std::as_const(m_hostThrottleUntil)) {
+        next = qMin(next, until);
+    }
+
+    if (next == std::numeric_limits<qint64>::max()) {
+        m_retryTimer->stop();
+        return;
+    }
+
+    const qint64 delay = qMax<qint64>(0, next - QDateTime::currentMSecsSinceEpoch());
+    m_retryTimer->start(int(qMin<qint64>(delay, INT_MAX)));
+}
+
+int AsulMultiDownloader::effectiveHostLimit(const QString &host) const
+{
+    const int ceiling = qMin(hostConnectionLimit(), rateLimitedSlots(m_bandwidth->hostRate(host)));
+    if (!m_adaptiveConcurrency) {
+        return ceiling;
+    }
+
+    auto it = m_hostCongestion.constFind(host);
+    const double limit = (it == m_hostCongestion.constEnd()) ? kInitialHostLimit : it->limit;
+    return qBound(1, int(limit), ceiling);
+}
+
+void AsulMultiDownloader::recordHostResult(const QString &host, qint64 bytes, bool success)
+{
+    if (!m_adaptiveConcurrency) {
+        return;
+    }
+
+    HostCongestion &state = m_hostCongestion[host];
+    if (state.limit <= 0) {
+        state.limit = kInitialHostLimit;
+        state.windowStart = QDateTime::currentMSecsSinceEpoch();
+    }
+    if (success) {
+        state.successes++;
+        state.bytes += qMax<qint64>(0, bytes);
+    } else {
+        state.errors++;
+    }
+}
+
+bool AsulMultiDownloader::isCongestionFailure(const DownloadFailure &failure) const
+{
+    // 404、校验不一致、本地写入失败等与对端负载无关，不应拖慢同一Host上的其他任务
+    const DownloadFailureKind kind = m_retryPolicy->classify(failure);
+    if (kind == DownloadFailureKind::Throttled) {
+        return true;
+    }
+    if (kind != DownloadFailureKind::Transient) {
+        return false;
+    }
+    if (failure.httpStatus == 408 || failure.httpStatus >= 500) {
+        return true;
+    }
+
+    switch (failure.networkError) {
+    case QNetworkReply::TimeoutError:
+    case QNetworkReply::RemoteHostClosedError:
+    case QNetworkReply::ConnectionRefusedError:
+    case QNetworkReply::TemporaryNetworkFailureError:
+    case QNetworkReply::ProxyTimeoutError:
+        return true;
+    default:
+        return false;
+    }
+}
+
+void AsulMultiDownloader::adjustHostConcurrency()
+{
+    const qint64 now = QDateTime::currentMSecsSinceEpoch();
+    const double ceiling = hostConnectionLimit();
+
+    for (auto it = m_hostCongestion.begin(); it != m_hostCongestion.end(); ++it) {
+        HostCongestion &state = it.value();
+        const qint64 elapsed = now - state.windowStart;
+        if (elapsed < 1000 || (state.successes == 0 && state.errors == 0)) {
+            // 窗口太短或没有任何结果，继续累计
+            continue;
+        }
+
+        const qint64 goodput = (state.bytes * 1000) / elapsed;
+        const bool limited = state.peakInFlight >= int(state.limit);
+
+        if (state.errors > 0) {
+            // 乘性减：超时、连接重置、限流和5xx都说明已超过对端承受能力
+            state.limit = qMax(kMinHostLimit, state.limit * kHostLimitDecrease);
+            state.slowStart = false;
+        } else if (limited) {
+            if (state.lastGoodput > 0 && goodput < state.lastGoodput * kGoodputDropRatio) {
+                // 提高并发反而吞吐下降：退回一步并结束慢启动
+                state.limit = qMax(kMinHostLimit, state.limit - kHostLimitIncrease);
+                state.slowStart = false;
+            } else if (state.slowStart) {
+                state.limit = qMin(ceiling, state.limit * 2);
+            } else {
+                state.limit = qMin(ceiling, state.limit + kHostLimitIncrease);
+            }
+        }
+
+        state.lastGoodput = goodput;
+        state.successes = 0;
+        state.errors = 0;
+        state.bytes = 0;
+        state.peakInFlight = getHostConnections(it.key());
+        state.windowStart = now;
+    }
+}
+
+int AsulMultiDownloader::hostConnectionLimit() const
+{
+    return m_maxConnectionsPerHost;
+}
+
+int AsulMultiDownloader::http2StreamLimit() const
+{
+    // HTTP/2请求复用少量连接，上限为 连接数 × 每连接流数（不论全局开关，按各请求的传输设置计入）
+    return qMin(m_maxConnectionsPerHost, m_http2ConnectionsPerHost * m_http2MaxStreamsPerConnection);
+}
+
+QUrl AsulMultiDownloader::selectMirror(const QList<QUrl> &mirrors, const QString &avoidHost) const
+{
+    // 注意：调用此方法时应已持有锁
+    // 评分 = 首字节延迟 / 成功率 × 排序惩罚，越低越好；冷却中和需要回避的镜像仅在别无选择时使用
+
+    const qint64 now = QDateTime::currentMSecsSinceEpoch();
+    QUrl best;
+    double bestScore = 0;
+    bool bestUsable = false;
+
+    for (int i = 0; i < mirrors.size(); ++i) {
+        const QUrl &candidate = mirrors.at(i);
+        const QString host = candidate.host();
+        const MirrorHealth health = m_mirrorHealth.value(host);
+
+        const bool usable = health.cooldownUntil <= now && host != avoidHost;
+        const double latency = health.latencyMs > 0 ? health.latencyMs : kMirrorDefaultLatencyMs;
+        const double score = latency / qMax(0.05, health.successRate) * (1.0 + kMirrorRankPenalty * i);
+
+        if (best.isEmpty() || (usable && !bestUsable) || (usable == bestUsable && score < bestScore)) {
+            best = candidate;
+            bestScore = score;
+            bestUsable = usable;
+        }
+    }
+
+    return best;
+}
+
+void AsulMultiDownloader::recordMirrorResult(const QString &host, bool success)
+{
+    // 注意：调用此方法时应已持有锁
+
+    if (host.isEmpty()) {
+        return;
+    }
+
+    MirrorHealth &health = m_mirrorHealth[host];
+    health.successRate = health.successRate * (1.0 - kMirrorEwmaAlpha) + (success ? kMirrorEwmaAlpha : 0.0);
+
+    if (success) {
+        health.consecutiveFailures = 0;
+        health.cooldownUntil = 0;
+    } else if (++health.consecutiveFailures >= kMirrorCooldownFailures) {
+        health.cooldownUntil = QDateTime::currentMSecsSinceEpoch() + kMirrorCooldownMs;
+    }
+}
+
+void AsulMultiDownloader::recordMirrorLatency(const QString &host, qint64 msecs)
+{
+    // 注意：调用此方法时应已持有锁
+
+    if (host.isEmpty() || msecs < 0) {
+        return;
+    }
+
+    MirrorHealth &health = m_mirrorHealth[host];
+    health.latencyMs = health.latencyMs > 0
+        ? health.latencyMs * (1.0 - kMirrorEwmaAlpha) + msecs * kMirrorEwmaAlpha
+        : double(msecs);
+}
+
+bool AsulMultiDownloader::failoverMirror(TaskRecord &record)
+{
+    // 注意：调用此方法时应已持有锁，且任务不在运行、不在就绪队列中
+
+    if (record.mirrors.size() < 2) {
+        return false;
+    }
+
+    // 每个镜像提供一次免费切换，之后的失败按普通重试计数
+    if (record.mirrorSwitches >= record.mirrors.size() - 1) {
+        return false;
+    }
+
+    const QUrl next = selectMirror(record.mirrors, record.url.host());
+    if (next.host() == record.url.host()) {
+        return false;
+    }
+
+    record.mirrorSwitches++;
+    qDebug() << QString("[MIRROR] Task %1 failing over: %2 -> %3")
+                .arg(record.taskId, record.url.host(), next.host());
+    record.url = next;
+    return true;
+}
+
+void AsulMultiDownloader::armMirrorHedge(const TaskRecord &record, DownloadTask *task)
+{
+    // 注意：调用此方法时应已持有锁
+
+    if (!m_mirrorHedging || record.mirrors.size() < 2) {
+        return;
+    }
+
+    const QUrl alternate = selectMirror(record.mirrors, record.url.host());
+    const MirrorHealth alternateHealth = m_mirrorHealth.value(alternate.host());
+    if (alternate.host() == record.url.host()
+        || alternateHealth.cooldownUntil > QDateTime::currentMSecsSinceEpoch()) {
+        return;
+    }
+
+    // 延迟取配置值与当前镜像平均首字节延迟3倍的较大者，避免健康但偏慢的镜像频繁触发对冲
+    const double latency = m_mirrorHealth.value(record.url.host()).latencyMs;
+    task->setHedge(alternate, qMax(m_mirrorHedgeDelay, int(latency * 3)));
+}
+
+// ==================== DownloadBatch 实现 ====================
+
+DownloadBatch::DownloadBatch(AsulMultiDownloader *downloader)
+    : QObject(downloader)
+    , m_downloader(downloader)
+    , m_batchId(0)
+    , m_completed(0)
+    , m_failed(0)
+    , m_totalBytes(0)
+    , m_receivedBytes(0)
+{
+}
+
+void DownloadBatch::cancel()
+{
+    // 批次可能已被移到调用方线程，取消操作在下载器所在线程中执行
+    AsulMultiDownloader *downloader = m_downloader;
+    const quint32 batchId = m_batchId;
+    const QStringList taskIds = m_taskIds;
+    QMetaObject::invokeMethod(downloader, [downloader, batchId, taskIds]() {
+        downloader->cancelBatch(batchId, taskIds);
+    });
+}
+
+void DownloadBatch::addReceived(qint64 delta)
+{
+    m_receivedBytes += delta;
+    emit progress(m_receivedBytes, m_totalBytes, m_completed, m_failed, int(m_taskIds.size()));
+}
+
+void DownloadBatch::settleTask(const QString &taskId, const QString &savePath, bool success, const QString &error,
+                               qint64 bytesDelta)
+{
+    m_receivedBytes += bytesDelta;
+    if (success) {
+        m_completed++;
+        emit taskFinished(taskId, savePath);
+    } else {
+        m_failed++;
+        m_lastError = error;
+        emit taskFailed(taskId, error);
+    }
+
+    emit progress(m_receivedBytes, m_totalBytes, m_completed, m_failed, int(m_taskIds.size()));
+
+    if (isFinished()) {
+        emit finished(m_failed == 0);
+    }
+}
+
+// ==================== DownloadTask 实现 ====================
+
+DownloadTask::DownloadTask(const QString &taskId, const QUrl &url,
+                         const QString &savePath, int priority, QObject *parent)
+    : QObject(parent)
+    , m_taskId(taskId)
+    , m_url(url)
+    , m_savePath(savePath)
+    , m_priority(priority)
+    , m_attempt(0)
+    , m_servedUrl(url)
+    , m_hedgeDelay(0)
+    , m_hedgeReply(nullptr)
+    , m_hedgeTimer(nullptr)
+    , m_firstByteSeen(false)
+    , m_buffered(false)
+    , m_timeout(30000)
+    , m_bandwidth(nullptr)
+    , m_throttleTimer(nullptr)
+    , m_downloader(nullptr)
+    , m_diskWriter(nullptr)
+    , m_fileCommitter(nullptr)
+    , m_largeFileThreshold(std::numeric_limits<qint64>::max())
+    , m_multiThreadAllowed(true)
+    , m_http2Manager(nullptr)
+    , m_writeOffset(0)
+    , m_replayLocal(false)
+    , m_fileSize(-1)
+    , m_downloadedSize(0)
+    , m_liveBytes(nullptr)
+    , m_liveCounted(false)
+    , m_supportRange(false)
+    , m_segmentCount(1)
+    , m_networkManager(nullptr)
+    , m_reply(nullptr)
+    , m_file(nullptr)
+    , m_ownsNetworkManager(false)
+    , m_completedSegments(0)
+    , m_directSegmentWrite(true)
+    , m_adaptiveSegments(true)
+    , m_rangedProbe(true)
+    , m_hedgeCount(0)
+    , m_lastHedgeCheck(0)
+    , m_resumable(false)
+    , m_journalBaseBytes(0)
+    , m_lastJournalSave(0)
+    , m_digest(QCryptographicHash::Sha1)
+    , m_digestOffset(0)
+    , m_pendingDigestBytes(0)
+    , m_isPaused(false)
+    , m_isCanceled(false)
+{
+    // 从父对象（AsulMultiDownloader）获取共享的网络管理器；
+    // 管理器使用工作线程时会在移动任务后改用该线程的网络管理器
+    AsulMultiDownloader *downloader = qobject_cast<AsulMultiDownloader*>(parent);
+    if (downloader) {
+        m_downloader = downloader;
+        m_networkManager = downloader->getNetworkManager();
+        m_ownsNetworkManager = false;
+        m_liveBytes = &downloader->m_liveBytes;
+        m_bandwidth = downloader->m_bandwidth.get();
+        m_diskWriter = downloader->m_diskWriter.get();
+        m_fileCommitter = downloader->m_fileCommitter.get();
+    } else {
+        // 如果无法获取，创建自己的（兜底方案）
+        m_networkManager = NetworkService::getInstance()->createManager(this);
+        m_ownsNetworkManager = true;
+    }
+}
+
+DownloadTask::~DownloadTask()
+{
+    cancel();
+    closeFile();
+
+    // 注意：不需要显式释放网络管理器
+    // - 如果是从池中借用的（m_ownsNetworkManager == false），池会一直持有这些管理器
+    // - 如果是自己创建的（m_ownsNetworkManager == true），Qt的父子关系会自动删除
+}
+
+void DownloadTask::start()
+{
+    QMutexLocker locker(&m_mutex);
+
+    if (m_isPaused || m_isCanceled) {
+        return;
+    }
+
+    // === 清理上一次尝试的残留状态（重试安全）===
+    m_attempt++;
+    if (!m_stagingLock) {
+        m_stagingPath = uniqueStagingPathFor(m_savePath);
+    }
+    if (m_attempt == 1 && !m_savePath.isEmpty()) {
+        removeOrphanedStagingFiles(m_savePath);
+    }
+    if (m_reply) {
+        m_reply->disconnect();  // 先断开所有信号，防止abort()同步触发finished信号导致死锁
+        m_reply->abort();
+        m_reply->deleteLater();
+        m_reply = nullptr;
+    }
+    dropHedgeReply();
+    m_firstByteSeen = false;
+    setServedUrl(m_url);
+    m_buffered = false;
+    m_buffer = QByteArray();
+
+    for (auto segment : m_segments) {
+        segment->cancel();
+        segment->deleteLater();
+    }
+    m_segments.clear();
+    m_segmentProgress.clear();
+    m_completedSegments = 0;
+
+    closeFile();
+
+    releaseLiveBytes();
+    {
+        QMutexLocker stateLocker(&m_stateMutex);
+        m_downloadedSize = 0;
+    }
+    m_liveCounted = true;
+    setError(QString(), DownloadFailure());
+    resetDigest();
+    if (m_sink) {
+        m_sink->reset();
+    }
+    // === 清理完成 ===
+
+    // 确保保存目录存在（管理器缓存已确认的目录，同一目录下的大量小文件只需检查一次）
+    if (!m_savePath.isEmpty()) {
+        const QString dirPath = QFileInfo(m_savePath).absolutePath();
+        if (m_downloader) {
+            m_downloader->ensureDirectory(dirPath);
+        } else {
+            QDir().mkpath(dirPath);
+        }
+    }
+
+    emit started(m_taskId);
+
+    // 同一文件刚由排在前面的任务下载并提交：直接从磁盘回放给接收器
+    if (m_replayLocal && m_sink && !m_savePath.isEmpty()) {
+        m_replayLocal = false;  // 回放不可用时本次及之后的重试都走网络
+        bool ok = false;
+        if (replayCommittedFile(&ok)) {
+            locker.unlock();
+            if (ok) {
+                emit finished(m_taskId);
+            } else {
+                emit failed(m_taskId, m_errorString);
+            }
+            return;
+        }
+        m_sink->reset();
+    }
+
+    // 优化：如果已知文件大小且小于分段阈值，直接单线程下载，跳过HEAD请求；
+    // 使用接收器时数据必须按顺序到达，同样只能单线程下载
+    if ((m_fileSize > 0 && m_fileSize <= m_largeFileThreshold) || m_sink) {
+        // 小文件，已知大小，无需HEAD探测，直接下载
+        setSupportRange(false);
+        setSegmentCount(1);
+        locker.unlock();
+        startSingleDownload();
+        return;
+    }
+
+    // 大文件或未知大小时探测文件大小和是否支持Range
+    QNetworkRequest request(m_url);
+    request.setAttribute(QNetworkRequest::RedirectPolicyAttribute,
+                        QNetworkRequest::NoLessSafeRedirectPolicy);
+    request.setAttribute(QNetworkRequest::Http2AllowedAttribute, false);  // 强制HTTP/1.1，避免HTTP/2流限制
+    request.setTransferTimeout(m_timeout);
+    NetworkService::getInstance()->prepareRequest(request);  // 复用与该Host上次连接的TLS会话
+
+    if (m_rangedProbe) {
+        // 带Range的GET：响应头给出大小和Range支持，正文直接作为下载流继续接收，省去一次HEAD往返
+        request.setRawHeader("Range", "bytes=0-");
+        m_reply = m_networkManager->get(request);
+        if (m_bandwidth) {
+            m_bandwidth->prepare(m_reply, false);
+        }
+        connect(m_reply, &QNetworkReply::readyRead, this, &DownloadTask::onProbeResponse);
+        connect(m_reply, &QNetworkReply::finished, this, &DownloadTask::onProbeResponse);
+        return;
+    }
+
+    m_reply = m_networkManager->head(request);
+    // 注意：只连接 finished 信号。不连接 errorOccurred，避免 error+finished 双重触发
+    // onHeadFinished 内部已检查 m_reply->error() 来处理错误
+    connect(m_reply, &QNetworkReply::finished, this, &DownloadTask::onHeadFinished);
+}
+
+void DownloadTask::pause()
+{
+    QMutexLocker locker(&m_mutex);
+
+    m_isPaused = true;
+
+    if (m_reply) {
+        m_reply->disconnect();  // 先断开信号，防止abort()同步触发finished信号导致死锁
+        m_reply->abort();
+        m_reply->deleteLater();
+        m_reply = nullptr;
+    }
+    dropHedgeReply();
+
+    // 直写模式：记录断点，恢复时只下载缺失区间
+    if (m_directSegmentWrite && m_file && !m_segments.isEmpty()) {
+        saveJournal();
+    }
+
+    // 取消所有分段下载
+    for (auto segment : m_segments) {
+        segment->cancel();
+        segment->deleteLater();
+    }
+    m_segments.clear();
+
+    closeFile();
+
+    emit paused(m_taskId);
+}
+
+void DownloadTask::resume()
+{
+    QMutexLocker locker(&m_mutex);
+
+    m_isPaused = false;
+
+    // 重新开始下载
+    locker.unlock();
+    start();
+}
+
+void DownloadTask::cancel()
+{
+    QMutexLocker locker(&m_mutex);
+
+    m_isCanceled = true;
+
+    if (m_reply) {
+        m_reply->disconnect();  // 先断开信号，防止abort()同步触发finished信号导致死锁
+        m_reply->abort();
+        m_reply->deleteLater();
+        m_reply = nullptr;
+    }
+    dropHedgeReply();
+
+    // 直写模式的断点记录随临时文件一起删除
+    const bool discardPreallocated = m_directSegmentWrite && m_file && !m_segments.isEmpty();
+
+    // 取消所有分段下载
+    for (auto segment : m_segments) {
+        segment->cancel();
+        segment->deleteLater();
+    }
+    m_segments.clear();
+
+    if (m_file) {
+        closeFile();
+
+        QFile::remove(m_stagingPath);
+        if (discardPreallocated && m_resumable) {
+            DownloadResumeJournal::remove(m_savePath);
+        }
+    }
+}
+
+void DownloadTask::interrupt()
+{
+    QMutexLocker locker(&m_mutex);
+
+    if (m_reply) {
+        m_reply->disconnect();  // 先断开信号，防止abort()同步触发finished信号导致死锁
+        m_reply->abort();
+        m_reply->deleteLater();
+        m_reply = nullptr;
+    }
+    dropHedgeReply();
+
+    // 与 pause() 相同：保留已下载的数据和断点记录，但不改变暂停/取消状态
+    if (m_directSegmentWrite && m_file && !m_segments.isEmpty()) {
+        saveJournal();
+    }
+
+    for (auto segment : m_segments) {
+        segment->cancel();
+        segment->deleteLater();
+    }
+    m_segments.clear();
+
+    closeFile();
+}
+
+void DownloadTask::onHeadFinished()
+{
+    if (!m_reply) {
+        return;
+    }
+
+    QMutexLocker locker(&m_mutex);
+
+    if (m_reply->error() != QNetworkReply::NoError) {
+        setError(m_reply->errorString(), DownloadFailure::fromReply(m_reply));
+        m_reply->deleteLater();
+        m_reply = nullptr;
+        locker.unlock();
+        emit failed(m_taskId, m_errorString);
+        return;
+    }
+
+    // 获取文件大小
+    setFileSize(m_reply->header(QNetworkRequest::ContentLengthHeader).toLongLong());
+
+    // 检查是否支持Range
+    QString acceptRanges = m_reply->rawHeader("Accept-Ranges");
+    setSupportRange(acceptRanges.toLower() == "bytes");
+
+    // 记录校验标识，用于判断断点续传的数据是否仍然有效
+    m_etag = QString::fromLatin1(m_reply->rawHeader("ETag"));
+    m_lastModified = QString::fromLatin1(m_reply->rawHeader("Last-Modified"));
+
+    m_reply->deleteLater();
+    m_reply = nullptr;
+
+    locker.unlock();
+    startTransfer(nullptr);
+}
+
+void DownloadTask::onProbeResponse()
+{
+    if (!m_reply) {
+        return;
+    }
+
+    QMutexLocker locker(&m_mutex);
+
+    const int status = m_reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
+    const bool ok = m_reply->error() == QNetworkReply::NoError && status >= 200 && status < 300;
+    if (!ok && !m_reply->isFinished()) {
+        // 错误页面：丢弃正文（限速时接收缓冲区有上限，不读取会卡住），等请求结束后按失败处理
+        m_reply->readAll();
+        return;
+    }
+
+    // 首批数据或请求结束时响应已确定，之后的数据由分段或单线程下载接收
+    QNetworkReply *probe = m_reply;
+    m_reply = nullptr;
+    probe->disconnect(this);
+
+    if (!ok) {
+        if (status == 416) {
+            // 空文件不满足 bytes=0-，改用不带Range的请求下载
+            discardReply(probe);
+            setSupportRange(false);
+            setSegmentCount(1);
+            locker.unlock();
+            startSingleDownload();
+            return;
+        }
+        setError(probe->errorString(), DownloadFailure::fromReply(probe));
+        probe->deleteLater();
+        locker.unlock();
+        emit failed(m_taskId, m_errorString);
+        return;
+    }
+
+    if (status == 206) {
+        // 部分内容：Content-Range 给出总大小，且必须从文件开头开始
+        qint64 start = -1;
+        qint64 total = -1;
+        if (!parseContentRange(probe->rawHeader("Content-Range"), &start, &total) || start != 0) {
+            setError(QString("Unexpected Content-Range: %1")
+                         .arg(QString::fromLatin1(probe->rawHeader("Content-Range"))));
+            discardReply(probe);
+            locker.unlock();
+            emit failed(m_taskId, m_errorString);
+            return;
+        }
+        setFileSize(total);
+        setSupportRange(true);
+    } else {
+        // 服务器忽略Range返回完整内容：不支持分段，按单线程继续接收
+        const QVariant length = probe->header(QNetworkRequest::ContentLengthHeader);
+        setFileSize(length.isValid() ? length.toLongLong() : -1);
+        setSupportRange(false);
+    }
+
+    // 记录校验标识，用于判断断点续传的数据是否仍然有效
+    m_etag = QString::fromLatin1(probe->rawHeader("ETag"));
+    m_lastModified = QString::fromLatin1(probe->rawHeader("Last-Modified"));
+
+    locker.unlock();
+    startTransfer(probe);
+}
+
+void DownloadTask::startTransfer(QNetworkReply *probe)
+{
+    QMutexLocker locker(&m_mutex);
+
+    // 根据文件大小决定下载策略（PCL优化：域名策略由管理器在创建任务时给出）
+    const bool disableMultiThread = !m_multiThreadAllowed;
+
+    // 已结束的探测请求已收到全部正文，直接按单线程收尾
+    if (m_downloader && m_fileSize > m_largeFileThreshold && m_supportRange
+        && (!disableMultiThread || m_directSegmentWrite) && !(probe && probe->isFinished())) {
+        // 大文件，使用分段下载；域名禁用多线程时以单个分段下载，仍可断点续传
+        if (disableMultiThread) {
+            setSegmentCount(1);
+        }
+        locker.unlock();
+        startSegmentedDownload(probe);
+    } else {
+        // 小文件、不支持Range或域名禁用多线程，使用单线程下载
+        setSegmentCount(1);
+        locker.unlock();
+        startSingleDownload(probe);
+    }
+}
+
+void DownloadTask::startSingleDownload(QNetworkReply *probe)
+{
+    QMutexLocker locker(&m_mutex);
+
+    if (m_isPaused || m_isCanceled) {
+        discardReply(probe);
+        return;
+    }
+
+    // 已知大小的小文件：正文缓存在内存中，校验通过后一次性写入，不提前创建文件；
+    // 没有保存路径时正文只写入接收器
+    m_buffered = !m_savePath.isEmpty() && m_fileSize > 0 && m_fileSize <= kBufferedWriteBytes;
+    m_writeOffset = 0;
+    if (m_buffered) {
+        m_buffer.reserve(m_fileSize);
+    } else if (!m_savePath.isEmpty()) {
+        // 打开临时文件（数据按偏移交给写入器，不使用 QFile 的缓冲区）；已知大小时预留空间
+        m_file = new QFile(m_stagingPath);
+        if (!openStagingFile(m_file, QIODevice::WriteOnly | QIODevice::Unbuffered)
+            || (m_fileSize > 0 && !preallocateFile(m_file, m_fileSize, true))) {
+            setError(QString("Cannot open file: %1").arg(m_savePath));
+            m_file->close();
+            delete m_file;
+            m_file = nullptr;
+            discardReply(probe);
+            locker.unlock();
+            emit failed(m_taskId, m_errorString);
+            return;
+        }
+    }
+
+    if (probe) {
+        // 沿用探测请求：它已从文件开头开始返回正文
+        m_reply = probe;
+    } else {
+        // HTTP/2模式：已知大小的小文件通过少量连接多路复用，其余仍强制HTTP/1.1
+        const bool useHttp2 = m_http2Manager && m_fileSize > 0 && m_fileSize <= m_largeFileThreshold;
+
+        // 开始下载
+        QNetworkRequest request(m_url);
+        request.setAttribute(QNetworkRequest::RedirectPolicyAttribute,
+                            QNetworkRequest::NoLessSafeRedirectPolicy);
+        request.setAttribute(QNetworkRequest::Http2AllowedAttribute, useHttp2);
+        request.setTransferTimeout(m_timeout);
+        NetworkService::getInstance()->prepareRequest(request);
+
+        QNetworkAccessManager *manager = useHttp2 ? m_http2Manager : m_networkManager;
+        m_reply = manager->get(request);
+        if (m_bandwidth) {
+            m_bandwidth->prepare(m_reply, useHttp2);
+        }
+    }
+    connect(m_reply, &QNetworkReply::downloadProgress, this, &DownloadTask::onDownloadProgress);
+    connect(m_reply, &QNetworkReply::finished, this, &DownloadTask::onDownloadFinished);
+    // 注意：不连接 errorOccurred，避免 error+finished 双重触发导致回复指针错乱
+    // onDownloadFinished 内部已检查 m_reply->error() 来处理错误
+    connect(m_reply, &QNetworkReply::readyRead, this, [this, reply = m_reply]() {
+        onSingleReadyRead(reply);
+    });
+
+    if (probe) {
+        // 探测请求已到达的数据（或已发出的结束信号）不会再触发，在事件循环中补处理一次
+        QMetaObject::invokeMethod(this, [this, probe]() {
+            if (probe != m_reply) {
+                return;
+            }
+            if (probe->isFinished()) {
+                onDownloadFinished();
+            } else {
+                onSingleReadyRead(probe);
+            }
+        }, Qt::QueuedConnection);
+    }
+
+    // 多镜像对冲：首字节迟到时向另一个镜像再发一次请求
+    if (!m_hedgeUrl.isEmpty()) {
+        if (!m_hedgeTimer) {
+            m_hedgeTimer = new QTimer(this);
+            m_hedgeTimer->setSingleShot(true);
+            connect(m_hedgeTimer, &QTimer::timeout, this, &DownloadTask::onHedgeTimeout);
+        }
+        m_hedgeTimer->start(m_hedgeDelay);
+    }
+}
+
+void DownloadTask::setDownloadedSize(qint64 size)
+{
+    if (m_liveBytes && m_liveCounted) {
+        m_liveBytes->fetch_add(size - m_downloadedSize, std::memory_order_relaxed);
+    }
+    QMutexLocker stateLocker(&m_stateMutex);
+    m_downloadedSize = size;
+}
+
+void DownloadTask::setFileSize(qint64 size)
+{
+    QMutexLocker stateLocker(&m_stateMutex);
+    m_fileSize = size;
+}
+
+void DownloadTask::setSupportRange(bool supportRange)
+{
+    QMutexLocker stateLocker(&m_stateMutex);
+    m_supportRange = supportRange;
+}
+
+void DownloadTask::setSegmentCount(int count)
+{
+    QMutexLocker stateLocker(&m_stateMutex);
+    m_segmentCount = count;
+}
+
+void DownloadTask::setServedUrl(const QUrl &url)
+{
+    QMutexLocker stateLocker(&m_stateMutex);
+    m_servedUrl = url;
+}
+
+void DownloadTask::setError(const QString &error)
+{
+    QMutexLocker stateLocker(&m_stateMutex);
+    m_errorString = error;
+}
+
+void DownloadTask::setError(const QString &error, const DownloadFailure &failure)
+{
+    QMutexLocker stateLocker(&m_stateMutex);
+    m_errorString = error;
+    m_failure = failure;
+}
+
+QUrl DownloadTask::servedUrl() const
+{
+    QMutexLocker stateLocker(&m_stateMutex);
+    return m_servedUrl;
+}
+
+qint64 DownloadTask::fileSize() const
+{
+    QMutexLocker stateLocker(&m_stateMutex);
+    return m_fileSize;
+}
+
+qint64 DownloadTask::downloadedSize() const
+{
+    QMutexLocker stateLocker(&m_stateMutex);
+    return m_downloadedSize;
+}
+
+bool DownloadTask::supportRange() const
+{
+    QMutexLocker stateLocker(&m_stateMutex);
+    return m_supportRange;
+}
+
+int DownloadTask::segmentCount() const
+{
+    QMutexLocker stateLocker(&m_stateMutex);
+    return m_segmentCount;
+}
+
+QString DownloadTask::errorString() const
+{
+    QMutexLocker stateLocker(&m_stateMutex);
+    return m_errorString;
+}
+
+DownloadFailure DownloadTask::failure() const
+{
+    QMutexLocker stateLocker(&m_stateMutex);
+    return m_failure;
+}
+
+bool DownloadTask::closeFile()
+{
+    if (!m_file) {
+        return true;
+    }
+
+    const bool ok = !m_diskWriter || m_diskWriter->release(m_file);
+    m_file->close();
+    delete m_file;
+    m_file = nullptr;
+    return ok;
+}
+
+void DownloadTask::releaseLiveBytes()
+{
+    if (m_liveBytes && m_liveCounted) {
+        m_liveBytes->fetch_sub(m_downloadedSize, std::memory_order_relaxed);
+    }
+    m_liveCounted = false;
+}
+
+void DownloadTask::onSingleReadyRead(QNetworkReply *reply)
+{
+    QMutexLocker locker(&m_mutex);
+
+    // 首个有效响应决定由哪个请求提供数据，另一个立即取消
+    if (!m_firstByteSeen && (reply == m_reply || reply == m_hedgeReply)) {
+        const int status = reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
+        const bool ok = status >= 200 && status < 300;
+
+        if (reply == m_hedgeReply) {
+            if (!ok) {
+                // 对冲镜像没有该文件，放弃对冲，继续等待主请求
+                dropHedgeReply();
+                return;
+            }
+            promoteHedgeReply();
+        }
+
+        if (ok) {
+            m_firstByteSeen = true;
+            dropHedgeReply();
+        }
+    }
+
+    if (reply != m_reply) {
+        return;
+    }
+
+    int retryMs = 0;
+    const QByteArray data = m_bandwidth ? m_bandwidth->read(m_reply, m_servedUrl.host(), m_priority, &retryMs)
+                                        : m_reply->readAll();
+    if (m_buffered) {
+        updateDigest(m_buffer.size(), data);
+        m_buffer.append(data);
+    } else if (!data.isEmpty()) {
+        updateDigest(m_writeOffset, data);
+        if (m_file && !writeAt(m_diskWriter, m_file, m_writeOffset, data)) {
+            // 写入失败（如磁盘已满），不再继续接收
+            setError(QString("Failed to write file: %1").arg(m_savePath));
+            abortSingleDownload();
+            locker.unlock();
+            emit failed(m_taskId, m_errorString);
+            return;
+        }
+        m_writeOffset += data.size();
+    }
+
+    if (!writeSink(data)) {
+        abortSingleDownload();
+        locker.unlock();
+        emit failed(m_taskId, m_errorString);
+        return;
+    }
+
+    if (retryMs > 0) {
+        scheduleThrottledRead(retryMs);
+    }
+}
+
+void DownloadTask::abortSingleDownload()
+{
+    if (m_reply) {
+        m_reply->disconnect();  // 先断开信号，防止abort()同步触发finished信号导致死锁
+        m_reply->abort();
+        m_reply->deleteLater();
+        m_reply = nullptr;
+    }
+    dropHedgeReply();
+    m_buffer = QByteArray();
+    closeFile();
+}
+
+bool DownloadTask::writeSink(const QByteArray &data)
+{
+    if (!m_sink || data.isEmpty() || m_sink->write(data)) {
+        return true;
+    }
+    setError(m_sink->errorString());
+    return false;
+}
+
+bool DownloadTask::replayCommittedFile(bool *ok)
+{
+    QFile file(m_savePath);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+
+    QCryptographicHash hash(QCryptographicHash::Sha1);
+    qint64 total = 0;
+    while (!file.atEnd()) {
+        const QByteArray chunk = file.read(kReplayChunkBytes);
+        if (chunk.isEmpty()) {
+            return false;
+        }
+        hash.addData(chunk);
+        total += chunk.size();
+        if (!writeSink(chunk)) {
+            *ok = false;
+            return true;
+        }
+    }
+
+    // 文件在提交后被改动过：接收器已收到的数据由调用方 reset，改为重新下载
+    if (!m_expectedSha1.isEmpty() && hash.result().toHex() != m_expectedSha1) {
+        return false;
+    }
+    if (!m_sink->finish()) {
+        setError(m_sink->errorString());
+        *ok = false;
+        return true;
+    }
+
+    setFileSize(total);
+    setDownloadedSize(total);
+    *ok = true;
+    return true;
+}
+
+void DownloadTask::scheduleThrottledRead(int msecs)
+{
+    if (!m_throttleTimer) {
+        m_throttleTimer = new QTimer(this);
+        m_throttleTimer->setSingleShot(true);
+        connect(m_throttleTimer, &QTimer::timeout, this, [this]() {
+            if (m_reply) {
+                onSingleReadyRead(m_reply);
+            }
+        });
+    }
+
+    if (!m_throttleTimer->isActive()) {
+        m_throttleTimer->start(msecs);
+    }
+}
+
+void DownloadTask::onHedgeTimeout()
+{
+    QMutexLocker locker(&m_mutex);
+
+    if (m_firstByteSeen || !m_reply || m_hedgeReply || m_hedgeUrl.isEmpty() || m_isPaused || m_isCanceled) {
+        return;
+    }
+
+    qDebug() << QString("[MIRROR] Task %1 no first byte after %2ms, hedging to %3")
+                .arg(m_taskId).arg(m_hedgeDelay).arg(m_hedgeUrl.host());
+
+    QNetworkRequest request(m_hedgeUrl);
+    request.setAttribute(QNetworkRequest::RedirectPolicyAttribute,
+                        QNetworkRequest::NoLessSafeRedirectPolicy);
+    request.setAttribute(QNetworkRequest::Http2AllowedAttribute, false);
+    request.setTransferTimeout(m_timeout);
+    NetworkService::getInstance()->prepareRequest(request);
+
+    QNetworkReply *hedge = m_networkManager->get(request);
+    m_hedgeReply = hedge;
+    if (m_bandwidth) {
+        m_bandwidth->prepare(hedge, false);
+    }
+
+    connect(hedge, &QNetworkReply::readyRead, this, [this, hedge]() {
+        onSingleReadyRead(hedge);
+    });
+    connect(hedge, &QNetworkReply::downloadProgress, this, [this, hedge](qint64 received, qint64 total) {
+        if (hedge == m_reply) {
+            onDownloadProgress(received, total);
+        }
+    });
+    connect(hedge, &QNetworkReply::finished, this, [this, hedge]() {
+        if (hedge == m_reply) {
+            onDownloadFinished();
+            return;
+        }
+
+        QMutexLocker locker(&m_mutex);
+        if (hedge != m_hedgeReply) {
+            return;
+        }
+
+        // 对冲请求在主请求之前完成且没有数据（空文件），直接由它收尾
+        const int status = hedge->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
+        if (hedge->error() == QNetworkReply::NoError && status >= 200 && status < 300 && !m_firstByteSeen) {
+            promoteHedgeReply();
+            m_firstByteSeen = true;
+            locker.unlock();
+            onDownloadFinished();
+        } else {
+            dropHedgeReply();
+        }
+    });
+}
+
+bool DownloadTask::promoteHedgeReply()
+{
+    if (!m_hedgeReply) {
+        return false;
+    }
+
+    if (m_reply) {
+        m_reply->disconnect();  // 先断开信号，防止abort()同步触发finished信号导致死锁
+        m_reply->abort();
+        m_reply->deleteLater();
+    }
+
+    m_reply = m_hedgeReply;
+    m_hedgeReply = nullptr;
+    setServedUrl(m_hedgeUrl);
+
+    // 主请求可能已写入错误页面，等排队的写入完成后从头开始
+    if (m_file) {
+        if (m_diskWriter) {
+            m_diskWriter->flush(m_file);
+        }
+        m_file->resize(0);
+        m_writeOffset = 0;
+    }
+    m_buffer.clear();
+    if (m_sink) {
+        m_sink->reset();
+    }
+    setDownloadedSize(0);
+    resetDigest();
+
+    return true;
+}
+
+void DownloadTask::dropHedgeReply()
+{
+    if (m_hedgeTimer) {
+        m_hedgeTimer->stop();
+    }
+
+    if (m_hedgeReply) {
+        m_hedgeReply->disconnect();  // 先断开信号，防止abort()同步触发finished信号导致死锁
+        m_hedgeReply->abort();
+        m_hedgeReply->deleteLater();
+        m_hedgeReply = nullptr;
+    }
+}
+
+void DownloadTask::startSegmentedDownload(QNetworkReply *probe)
+{
+    QMutexLocker locker(&m_mutex);
+
+    if (m_isPaused || m_isCanceled) {
+        discardReply(probe);
+        return;
+    }
+
+    if (m_fileSize <= 0) {
+        // 文件大小未知，回退到单线程下载
+        locker.unlock();
+        startSingleDownload(probe);
+        return;
+    }
+
+    if (!m_directSegmentWrite) {
+        // 分段文件模式：均分区间，每段写入 .partN，完成后合并（探测请求不参与）
+        discardReply(probe);
+        qint64 segmentSize = m_fileSize / m_segmentCount;
+        m_segmentProgress.resize(m_segmentCount);
+        m_segmentProgress.fill(0);
+
+        for (int i = 0; i < m_segmentCount; ++i) {
+            qint64 start = i * segmentSize;
+            qint64 end = (i == m_segmentCount - 1) ? m_fileSize - 1 : (start + segmentSize - 1);
+
+            QString segmentPath = m_stagingPath + QString(".part%1").arg(i);
+
+            auto segment = new SegmentDownloader(i, m_url, segmentPath, start, end, m_timeout, this);
+            connect(segment, &SegmentDownloader::finished, this, &DownloadTask::onSegmentFinished);
+            connect(segment, &SegmentDownloader::error, this, &DownloadTask::onSegmentError);
+            connect(segment, &SegmentDownloader::progress, this, &DownloadTask::onSegmentProgress);
+
+            m_segments.append(segment);
+        }
+
+        for (auto segment : m_segments) {
+            segment->start();
+        }
+        return;
+    }
+
+    // 直写模式：读取断点续传日志，校验标识与文件大小一致时只下载缺失区间
+    DownloadResumeJournal current;
+    current.url = m_url.toString();
+    current.fileSize = m_fileSize;
+    current.etag = m_etag;
+    current.lastModified = m_lastModified;
+
+    // 同一文件的其他写入方（另一个任务或进程）持有续传锁时，本次写入各自的临时文件且不续传
+    m_resumable = claimResumableStaging();
+    DownloadResumeJournal saved;
+    if (!m_resumable) {
+        qDebug() << QString("[RESUME] %1: another writer holds the resume journal").arg(m_savePath);
+    } else if (DownloadResumeJournal::load(m_savePath, &saved) && saved.matches(current)
+               && QFileInfo(m_stagingPath).size() == m_fileSize) {
+        current.completed = saved.completed;
+        qDebug() << QString("[RESUME] %1: %2 of %3 bytes already on disk")
+                        .arg(m_savePath).arg(current.completedBytes()).arg(m_fileSize);
+    } else {
+        DownloadResumeJournal::remove(m_savePath);
+    }
+    m_journal = current;
+    m_journalBaseBytes = m_journal.completedBytes();
+    m_lastJournalSave = QDateTime::currentMSecsSinceEpoch();
+
+    // 按已知大小预分配临时文件，各分段共享该文件并在各自偏移处写入
+    m_file = new QFile(m_stagingPath);
+    if (!openStagingFile(m_file, QIODevice::ReadWrite | QIODevice::Unbuffered)
+        || !preallocateFile(m_file, m_fileSize, false)) {
+        setError(QString("Cannot preallocate file: %1").arg(m_savePath));
+        m_file->close();
+        delete m_file;
+        m_file = nullptr;
+        discardReply(probe);
+        locker.unlock();
+        emit failed(m_taskId, m_errorString);
+        return;
+    }
+
+    const QList<DownloadResumeJournal::Range> ranges = DownloadResumeJournal::splitRanges(
+        m_journal.missingRanges(), m_segmentCount, kMinSegmentBytes);
+
+    setDownloadedSize(m_journalBaseBytes);
+    m_segmentProgress.clear();
+
+    if (ranges.isEmpty()) {
+        // 上次已全部下载完成，只需校验收尾（异步执行，避免在调度器持锁时同步发射完成信号）
+        discardReply(probe);
+        locker.unlock();
+        QMetaObject::invokeMethod(this, [this]() { finishDirectSegments(); }, Qt::QueuedConnection);
+        return;
+    }
+
+    // If-Range：服务端文件已变化时会返回200而非206，分段据此失败，不会写入旧文件
+    m_ifRange = !m_etag.isEmpty() && !m_etag.startsWith(QLatin1String("W/"))
+                    ? m_etag.toLatin1()
+                    : m_lastModified.toLatin1();
+    m_hedgePartner.clear();
+    m_hedgeCount = 0;
+    m_lastHedgeCheck = QDateTime::currentMSecsSinceEpoch();
+
+    // 创建并启动分段下载器；缺失区间从文件开头开始时，第0段直接接管探测请求
+    for (const auto &range : ranges) {
+        QNetworkReply *reply = range.first == 0 ? std::exchange(probe, nullptr) : nullptr;
+        addDirectSegment(range.first, range.second, reply);
+    }
+    discardReply(probe);
+}
+
+SegmentDownloader *DownloadTask::addDirectSegment(qint64 start, qint64 end, QNetworkReply *probe)
+{
+    // 注意：调用此方法时应已持有锁
+    const int index = m_segments.size();
+    QString segmentPath = m_stagingPath + QString(".part%1").arg(index);
+
+    auto segment = new SegmentDownloader(index, m_url, segmentPath, start, end, m_timeout, this);
+    segment->setSharedFile(m_file);
+    segment->setIfRange(m_ifRange);
+    connect(segment, &SegmentDownloader::finished, this, &DownloadTask::onSegmentFinished);
+    connect(segment, &SegmentDownloader::error, this, &DownloadTask::onSegmentError);
+    connect(segment, &SegmentDownloader::progress, this, &DownloadTask::onSegmentProgress);
+
+    m_segments.append(segment);
+    m_segmentProgress.append(0);
+    if (probe) {
+        segment->adopt(probe);
+    } else {
+        segment->start();
+    }
+    return segment;
+}
+
+int DownloadTask::runningSegmentCount() const
+{
+    int count = 0;
+    for (auto segment : m_segments) {
+        if (segment->isRunning()) {
+            count++;
+        }
+    }
+    return count;
+}
+
+void DownloadTask::retireHedgePartner(int segmentIndex)
+{
+    // 注意：调用此方法时应已持有锁
+    if (!m_hedgePartner.contains(segmentIndex)) {
+        return;
+    }
+    const int partner = m_hedgePartner.take(segmentIndex);
+    if (partner < 0 || partner >= m_segments.size()) {
+        return;
+    }
+    m_hedgePartner.remove(partner);
+
+    // 两者合起来已覆盖整个区间，另一方不再需要
+    SegmentDownloader *segment = m_segments[partner];
+    if (segment->isRunning()) {
+        segment->cancel();
+    }
+}
+
+void DownloadTask::stealWork()
+{
+    // 注意：调用此方法时应已持有锁
+    // 有连接空闲下来时，把剩余最多的分段后半段交给新连接
+    SegmentDownloader *victim = nullptr;
+    for (auto segment : m_segments) {
+        if (!segment->isRunning() || m_hedgePartner.contains(segment->index())) {
+            continue;
+        }
+        if (!victim || segment->remainingBytes() > victim->remainingBytes()) {
+            victim = segment;
+        }
+    }
+
+    if (!victim || victim->remainingBytes() < 2 * kMinSegmentBytes) {
+        return;
+    }
+
+    const qint64 oldEnd = victim->rangeEnd();
+    const qint64 mid = victim->rangeStart() + victim->bytesReceived() + victim->remainingBytes() / 2;
+    victim->setRangeEnd(mid - 1);
+    addDirectSegment(mid, oldEnd);
+
+    qDebug() << QString("[SPLIT] %1: segment %2 split at %3, new segment covers %4-%5")
+                    .arg(m_savePath).arg(victim->index()).arg(mid).arg(mid).arg(oldEnd);
+}
+
+void DownloadTask::hedgeSlowSegment()
+{
+    // 注意：调用此方法时应已持有锁
+    const qint64 now = QDateTime::currentMSecsSinceEpoch();
+    if (now - m_lastHedgeCheck < kHedgeCheckIntervalMs || m_hedgeCount >= kMaxHedgesPerTask) {
+        return;
+    }
+    m_lastHedgeCheck = now;
+
+    // 只比较已运行足够久的分段，刚建立的连接速度不具参考性
+    QList<SegmentDownloader*> candidates;
+    qint64 totalThroughput = 0;
+    for (auto segment : m_segments) {
+        if (segment->isRunning() && segment->elapsedMs() >= kHedgeMinAgeMs) {
+            candidates.append(segment);
+            totalThroughput += segment->throughput();
+        }
+    }
+    if (candidates.size() < 2) {
+        return;
+    }
+
+    SegmentDownloader *slowest = nullptr;
+    for (auto segment : candidates) {
+        if (m_hedgePartner.contains(segment->index()) || segment->remainingBytes() < kMinSegmentBytes) {
+            continue;
+        }
+        const qint64 siblingAverage = (totalThroughput - segment->throughput()) / (candidates.size() - 1);
+        if (segment->throughput() * kHedgeSlowRatio < siblingAverage
+            && (!slowest || segment->throughput() < slowest->throughput())) {
+            slowest = segment;
+        }
+    }
+
+    if (!slowest) {
+        return;
+    }
+
+    // 对冲：用新连接从慢分段当前位置起重新请求剩余部分，谁先完成就取消另一方
+    const qint64 from = slowest->rangeStart() + slowest->bytesReceived();
+    SegmentDownloader *hedge = addDirectSegment(from, slowest->rangeEnd());
+    m_hedgePartner.insert(slowest->index(), hedge->index());
+    m_hedgePartner.insert(hedge->index(), slowest->index());
+    m_hedgeCount++;
+
+    qDebug() << QString("[HEDGE] %1: segment %2 at %3 B/s, hedged from %4")
+                    .arg(m_savePath).arg(slowest->index()).arg(slowest->throughput()).arg(from);
+}
+
+void DownloadTask::onDownloadProgress(qint64 bytesReceived, qint64 bytesTotal)
+{
+    QMutexLocker locker(&m_mutex);
+    setDownloadedSize(bytesReceived);
+
+    if (bytesTotal > 0) {
+        setFileSize(bytesTotal);
+    }
+
+    locker.unlock();
+    emit progress(m_taskId, bytesReceived, bytesTotal);
+}
+
+void DownloadTask::onDownloadFinished()
+{
+    if (!m_reply) {
+        return;
+    }
+
+    QMutexLocker locker(&m_mutex);
+
+    if (m_reply->error() != QNetworkReply::NoError) {
+        if (m_hedgeReply && !m_firstByteSeen) {
+            // 主请求失败但对冲请求仍在进行：由对冲请求接管
+            promoteHedgeReply();
+            return;
+        }
+        dropHedgeReply();
+
+        setError(m_reply->errorString(), DownloadFailure::fromReply(m_reply));
+        m_reply->deleteLater();
+        m_reply = nullptr;
+        m_buffer = QByteArray();
+
+        closeFile();
+
+        locker.unlock();
+        emit failed(m_taskId, m_errorString);
+        return;
+    }
+
+    dropHedgeReply();
+
+    if (m_buffered) {
+        // 小文件：先校验内存中的正文，通过后一次写入
+        const QByteArray data = m_reply->readAll();
+        if (m_bandwidth) {
+            m_bandwidth->charge(m_servedUrl.host(), m_priority, data.size());
+        }
+        updateDigest(m_buffer.size(), data);
+        m_buffer.append(data);
+        m_reply->deleteLater();
+        m_reply = nullptr;
+
+        const bool ok = writeSink(data) && compareDigest() && writeBufferedFile();
+        m_buffer = QByteArray();
+        if (!ok) {
+            locker.unlock();
+            emit failed(m_taskId, m_errorString);
+            return;
+        }
+    } else {
+        // 写入剩余数据，等待写入器全部落盘后再校验
+        const QByteArray data = m_reply->readAll();
+        if (m_bandwidth) {
+            m_bandwidth->charge(m_servedUrl.host(), m_priority, data.size());
+        }
+        bool written = true;
+        if (!data.isEmpty()) {
+            updateDigest(m_writeOffset, data);
+            written = !m_file || writeAt(m_diskWriter, m_file, m_writeOffset, data);
+            m_writeOffset += data.size();
+        }
+        written = closeFile() && written;
+
+        m_reply->deleteLater();
+        m_reply = nullptr;
+
+        if (!written) {
+            setError(QString("Failed to write file: %1").arg(m_savePath));
+            QFile::remove(m_stagingPath);
+            locker.unlock();
+            emit failed(m_taskId, m_errorString);
+            return;
+        }
+
+        if (!writeSink(data)) {
+            QFile::remove(m_stagingPath);
+            locker.unlock();
+            emit failed(m_taskId, m_errorString);
+            return;
+        }
+
+        // 只写入接收器时流式摘要已覆盖全部数据，无需从磁盘补读
+        if (!(m_savePath.isEmpty() ? compareDigest() : verifyDigest())) {
+            QFile::remove(m_stagingPath);
+            locker.unlock();
+            emit failed(m_taskId, m_errorString);
+            return;
+        }
+    }
+
+    // 校验通过后再让接收器收尾（例如确认zip数据完整）
+    if (m_sink && !m_sink->finish()) {
+        setError(m_sink->errorString());
+        QFile::remove(m_stagingPath);
+        locker.unlock();
+        emit failed(m_taskId, m_errorString);
+        return;
+    }
+
+    // 修复：任务完成时用实际文件大小更新downloadedSize，确保统计准确
+    if (m_fileSize > 0) {
+        setDownloadedSize(m_fileSize);
+    } else if (m_savePath.isEmpty()) {
+        setDownloadedSize(m_writeOffset);
+        setFileSize(m_writeOffset);
+    } else {
+        // 文件大小未知时，读取实际写入的文件大小
+        QFileInfo fi(m_stagingPath);
+        if (fi.exists()) {
+            setDownloadedSize(fi.size());
+            setFileSize(fi.size());
+        }
+    }
+
+    locker.unlock();
+    commitStagedFile();
+}
+
+void DownloadTask::onDownloadError(QNetworkReply::NetworkError error)
+{
+    Q_UNUSED(error);
+
+    if (!m_reply) {
+        return;
+    }
+
+    QMutexLocker locker(&m_mutex);
+    setError(m_reply->errorString());
+
+    closeFile();
+
+    locker.unlock();
+    emit failed(m_taskId, m_errorString);
+}
+
+void DownloadTask::onSegmentFinished(int segmentIndex)
+{
+    QMutexLocker locker(&m_mutex);
+
+    m_completedSegments++;
+
+    if (!m_directSegmentWrite) {
+        if (m_completedSegments == m_segments.size()) {
+            // 所有分段下载完成，合并分段文件
+            locker.unlock();
+            mergeSegments();
+        }
+        return;
+    }
+
+    // 直写模式：取消与之竞速的对冲请求，并把空闲出的连接用于拆分剩余最多的分段
+    retireHedgePartner(segmentIndex);
+    if (m_adaptiveSegments && m_segmentCount > 1) {
+        stealWork();
+    }
+
+    if (runningSegmentCount() == 0) {
+        // 所有区间均已写入，直接收尾
+        locker.unlock();
+        finishDirectSegments();
+    }
+}
+
+void DownloadTask::onSegmentError(int segmentIndex, const QString &error)
+{
+    QMutexLocker locker(&m_mutex);
+
+    // 对冲中的一方失败时，由另一方继续完成该区间
+    if (m_directSegmentWrite && m_hedgePartner.contains(segmentIndex)) {
+        const int partner = m_hedgePartner.take(segmentIndex);
+        m_hedgePartner.remove(partner);
+        if (partner >= 0 && partner < m_segments.size() && m_segments[partner]->isRunning()) {
+            qDebug() << QString("[HEDGE] %1: segment %2 failed (%3), continuing with segment %4")
+                            .arg(m_savePath).arg(segmentIndex).arg(error).arg(partner);
+            return;
+        }
+    }
+
+    const DownloadFailure failure = segmentIndex >= 0 && segmentIndex < m_segments.size()
+                                        ? m_segments[segmentIndex]->failure()
+                                        : m_failure;
+    setError(QString("Segment %1 download failed: %2").arg(segmentIndex).arg(error), failure);
+
+    // 取消所有其他分段
+    for (auto segment : m_segments) {
+        segment->cancel();
+        segment->setSharedFile(nullptr);
+    }
+
+    // 直写模式：保留已写入的数据并记录断点，重试时只请求缺失区间
+    if (m_directSegmentWrite && m_file) {
+        saveJournal();
+        closeFile();
+    }
+
+    locker.unlock();
+    emit failed(m_taskId, m_errorString);
+}
+
+void DownloadTask::onSegmentProgress(int segmentIndex, qint64 bytesReceived, qint64 bytesTotal)
+{
+    QMutexLocker locker(&m_mutex);
+
+    if (segmentIndex >= 0 && segmentIndex < m_segmentProgress.size()) {
+        m_segmentProgress[segmentIndex] = bytesReceived;
+    }
+
+    qint64 totalReceived = 0;
+    if (m_directSegmentWrite) {
+        // 直写模式下分段可能被拆分或对冲，按区间并集计算（含续传前已在磁盘上的部分）
+        totalReceived = coverageSnapshot().completedBytes();
+
+        // 定期落盘断点续传日志，进程意外退出后也能从此处继续
+        const qint64 now = QDateTime::currentMSecsSinceEpoch();
+        if (now - m_lastJournalSave >= kJournalSaveIntervalMs) {
+            m_lastJournalSave = now;
+            saveJournal();
+        }
+
+        if (m_adaptiveSegments && m_segmentCount > 1) {
+            hedgeSlowSegment();
+        }
+    } else {
+        // 计算总进度
+        for (qint64 progress : m_segmentProgress) {
+            totalReceived += progress;
+        }
+    }
+
+    setDownloadedSize(totalReceived);
+
+    locker.unlock();
+    emit progress(m_taskId, totalReceived, m_fileSize);
+}
+
+void DownloadTask::mergeSegments()
+{
+    QMutexLocker locker(&m_mutex);
+
+    // 打开目标文件
+    QFile outFile(m_stagingPath);
+    if (!openStagingFile(&outFile, QIODevice::WriteOnly)) {
+        setError(QString("Cannot create target file: %1").arg(m_savePath));
+        locker.unlock();
+        emit failed(m_taskId, m_errorString);
+        return;
+    }
+
+    // 依次读取并写入每个分段文件
+    for (int i = 0; i < m_segmentCount; ++i) {
+        QString segmentPath = m_stagingPath + QString(".part%1").arg(i);
+        QFile segmentFile(segmentPath);
+
+        if (!segmentFile.open(QIODevice::ReadOnly)) {
+            setError(QString("Cannot open segment file: %1").arg(segmentPath));
+            outFile.close();
+            locker.unlock();
+            emit failed(m_taskId, m_errorString);
+            return;
+        }
+
+        // 读取并写入数据（顺带补齐下载时未能按序计算的摘要）
+        while (!segmentFile.atEnd()) {
+            QByteArray data = segmentFile.read(8192);
+            updateDigest(outFile.pos(), data);
+            outFile.write(data);
+        }
+
+        segmentFile.close();
+        segmentFile.remove();  // 删除分段文件
+    }
+
+    outFile.close();
+
+    if (!verifyDigest()) {
+        QFile::remove(m_stagingPath);
+        locker.unlock();
+        emit failed(m_taskId, m_errorString);
+        return;
+    }
+
+    // 修复：分段下载完成时也更新downloadedSize
+    if (m_fileSize > 0) {
+        setDownloadedSize(m_fileSize);
+    }
+
+    locker.unlock();
+    commitStagedFile();
+}
+
+void DownloadTask::finishDirectSegments()
+{
+    QMutexLocker locker(&m_mutex);
+
+    // 分段已全部交给写入器，等待落盘后关闭共享文件即可
+    for (auto segment : m_segments) {
+        segment->setSharedFile(nullptr);
+    }
+    const bool written = closeFile();
+
+    // 无论校验结果如何，断点记录都已失效
+    if (m_resumable) {
+        DownloadResumeJournal::remove(m_savePath);
+    }
+
+    if (!written) {
+        setError(QString("Failed to write file: %1").arg(m_savePath));
+        QFile::remove(m_stagingPath);
+        locker.unlock();
+        emit failed(m_taskId, m_errorString);
+        return;
+    }
+
+    if (!verifyDigest()) {
+        QFile::remove(m_stagingPath);
+        locker.unlock();
+        emit failed(m_taskId, m_errorString);
+        return;
+    }
+
+    if (m_fileSize > 0) {
+        setDownloadedSize(m_fileSize);
+    }
+
+    locker.unlock();
+    commitStagedFile();
+}
+
+void DownloadTask::commitStagedFile()
+{
+    if (m_savePath.isEmpty()) {
+        emit finished(m_taskId);
+        return;
+    }
+
+    if (!m_fileCommitter) {
+        QString error;
+        const bool ok = FileCommitter::commitNow(m_stagingPath, m_savePath, &error);
+        onFileCommitted(m_attempt, ok, error);
+        return;
+    }
+
+    // 提交结果回到任务所在线程处理；任务在此之前被删除时事件随之丢弃
+    QPointer<DownloadTask> self(this);
+    const quint32 attempt = m_attempt;
+    m_fileCommitter->commit(m_stagingPath, m_savePath, [self, attempt](bool ok, const QString &error) {
+        if (DownloadTask *task = self.data()) {
+            QMetaObject::invokeMethod(task, [task, attempt, ok, error]() {
+                task->onFileCommitted(attempt, ok, error);
+            }, Qt::QueuedConnection);
+        }
+    });
+}
+
+void DownloadTask::onFileCommitted(quint32 attempt, bool ok, const QString &error)
+{
+    QMutexLocker locker(&m_mutex);
+
+    // 提交期间任务被暂停、取消或重新启动：结果由新的尝试决定
+    if (attempt != m_attempt || m_isPaused || m_isCanceled) {
+        return;
+    }
+
+    if (!ok) {
+        setError(error);
+        QFile::remove(m_stagingPath);
+        locker.unlock();
+        emit failed(m_taskId, m_errorString);
+        return;
+    }
+
+    locker.unlock();
+    emit finished(m_taskId);
+}
+
+DownloadResumeJournal DownloadTask::coverageSnapshot() const
+{
+    // 注意：调用此方法时应已持有锁
+    DownloadResumeJournal snapshot = m_journal;
+    for (auto segment : m_segments) {
+        if (segment->bytesReceived() > 0) {
+            snapshot.addCompleted(segment->rangeStart(), segment->rangeStart() + segment->bytesReceived() - 1);
+        }
     }
+    return snapshot;
 }
 
-void AsulMultiDownloader::onTaskProgress(const QString &taskId, qint64 received, qint64 total)
+void DownloadTask::saveJournal()
 {
-    // 更新卡住检测时间戳
-    {
-        QMutexLocker locker(&m_mutex);
-        m_taskLastProgress[taskId] = QDateTime::currentMSecsSinceEpoch();
+    // 注意：调用此方法时应已持有锁
+    if (!m_directSegmentWrite || !m_resumable || m_journal.fileSize <= 0) {
+        return;
+    }
+
+    // 日志只记录已经落盘的区间：先取快照，再等待此前排队的写入完成
+    const DownloadResumeJournal snapshot = coverageSnapshot();
+    if (m_file && m_diskWriter && !m_diskWriter->flush(m_file)) {
+        return;
     }
-    emit downloadProgress(taskId, received, total);
+    snapshot.save(m_savePath);
 }
 
-void AsulMultiDownloader::onUpdateStatistics()
+bool DownloadTask::claimResumableStaging()
 {
-    QMutexLocker locker(&m_mutex);
-
-    m_statistics.activeDownloads = m_activeDownloads;
-    m_statistics.queuedDownloads = m_taskQueue.size();
-
-    // 计算总下载量：已完成任务用fileSize（精确），进行中任务用downloadedSize（实时）
-    qint64 totalDownloaded = 0;
-    for (auto it = m_tasks.begin(); it != m_tasks.end(); ++it) {
-        DownloadStatus status = m_taskStatus.value(it.key(), DownloadStatus::Queued);
-        if (status == DownloadStatus::Completed) {
-            // 已完成任务：用fileSize确保不因重试重置而回退
-            totalDownloaded += it.value()->fileSize() > 0 ? it.value()->fileSize() : it.value()->downloadedSize();
-        } else if (status == DownloadStatus::Downloading) {
-            // 进行中任务：用实时进度
-            totalDownloaded += it.value()->downloadedSize();
-        }
-        // Queued/Failed/Paused的任务不计入当前下载量
+    // 注意：调用此方法时应已持有锁
+    if (m_stagingLock) {
+        return true;
     }
-    m_statistics.totalDownloaded = totalDownloaded;
 
-    // 计算下载速度
-    qint64 currentTime = QDateTime::currentMSecsSinceEpoch();
-    if (m_lastSpeedCheck > 0) {
-        qint64 timeDiff = currentTime - m_lastSpeedCheck;
-        if (timeDiff >= 1000) {  // 至少1秒
-            qint64 bytesDiff = totalDownloaded - m_lastBytesDownloaded;
-            if (bytesDiff < 0) bytesDiff = 0;  // 防止负速度（重试时downloadedSize重置）
-            // 计算速度（字节/秒）
-            m_statistics.totalDownloadSpeed = (bytesDiff * 1000) / timeDiff;
-
-            // 限制最大速度显示（避免显示不合理的高速度）
-            if (m_statistics.totalDownloadSpeed > 1024 * 1024 * 1024) {
-                m_statistics.totalDownloadSpeed = 0;
-            }
-
-            m_lastSpeedCheck = currentTime;
-            m_lastBytesDownloaded = totalDownloaded;
-        }
-    } else {
-        m_lastSpeedCheck = currentTime;
-        m_lastBytesDownloaded = totalDownloaded;
-        m_statistics.totalDownloadSpeed = 0;
+    const QString stablePath = stagingPathFor(m_savePath);
+    auto lock = std::make_unique<QLockFile>(stablePath + QStringLiteral(".lock"));
+    lock->setStaleLockTime(0);  // 只按持有进程是否存活判断，长时间的下载不会被误判为过期
+    if (!lock->tryLock(0)) {
+        return false;
     }
 
-    emit statisticsChanged(m_statistics);
+    // 直写文件在探测之后才创建，此前还没有写入过本次尝试的临时文件
+    m_stagingLock = std::move(lock);
+    m_stagingPath = stablePath;
+    return true;
 }
 
-// ==================== 私有方法实现 ====================
+void DownloadTask::resetDigest()
+{
+    m_digest.reset();
+    m_digestOffset = 0;
+    m_pendingDigest.clear();
+    m_pendingDigestBytes = 0;
+}
 
-void AsulMultiDownloader::processQueue()
+void DownloadTask::updateDigest(qint64 offset, const QByteArray &data)
 {
-    // 注意：调用此方法时应已持有锁
+    if (m_expectedSha1.isEmpty() || data.isEmpty()) {
+        return;
+    }
 
-    while (!m_taskQueue.isEmpty() && m_activeDownloads < m_maxConcurrentDownloads) {
-        QString taskId = m_taskQueue.dequeue();
+    const qint64 end = offset + data.size();
+    if (end <= m_digestOffset) {
+        // 已计算过的区间（如合并分段时重复读到）
+        return;
+    }
 
-        if (!m_tasks.contains(taskId)) {
-            continue;
+    if (offset > m_digestOffset) {
+        // 前面的数据尚未到达，暂存；超出上限则留到完成时从磁盘补读
+        if (m_pendingDigestBytes + data.size() <= kMaxPendingDigestBytes
+            && !m_pendingDigest.contains(offset)) {
+            m_pendingDigest.insert(offset, data);
+            m_pendingDigestBytes += data.size();
         }
+        return;
+    }
 
-        auto task = m_tasks[taskId];
-        QString host = task->url().host();
+    m_digest.addData(QByteArrayView(data).sliced(m_digestOffset - offset));
+    m_digestOffset = end;
 
-        // 检查是否可以启动下载（考虑Host连接限制）
-        if (!canStartDownload(host)) {
-            // 重新入队，等待下次处理
-            m_taskQueue.enqueue(taskId);
+    // 依次消化已经连续的暂存数据
+    while (!m_pendingDigest.isEmpty()) {
+        auto it = m_pendingDigest.begin();
+        if (it.key() > m_digestOffset) {
             break;
         }
-
-        startDownloadTask(task);
+        const qint64 chunkEnd = it.key() + it.value().size();
+        if (chunkEnd > m_digestOffset) {
+            m_digest.addData(QByteArrayView(it.value()).sliced(m_digestOffset - it.key()));
+            m_digestOffset = chunkEnd;
+        }
+        m_pendingDigestBytes -= it.value().size();
+        m_pendingDigest.erase(it);
     }
 }
 
-void AsulMultiDownloader::startDownloadTask(std::shared_ptr<DownloadTask> task)
+bool DownloadTask::openStagingFile(QFile *file, QIODevice::OpenMode mode)
 {
-    QString taskId = task->taskId();
-    QString host = task->url().host();
-
-    m_taskStatus[taskId] = DownloadStatus::Downloading;
-    m_taskLastProgress[taskId] = QDateTime::currentMSecsSinceEpoch();  // 初始化卡住检测时间戳
-    updateHostConnections(host, 1);
-    m_activeDownloads++;
+    if (file->open(mode)) {
+        return true;
+    }
 
-    // 启动任务
-    task->start();
+    // 保存目录在运行期间被删除（例如删除后重新安装）：管理器缓存的目录已失效，重新创建后再试一次
+    const QString dirPath = QFileInfo(file->fileName()).absolutePath();
+    if (QFileInfo::exists(dirPath)) {
+        return false;
+    }
+    if (m_downloader) {
+        m_downloader->forgetDirectory(dirPath);
+        if (!m_downloader->ensureDirectory(dirPath)) {
+            return false;
+        }
+    } else if (!QDir().mkpath(dirPath)) {
+        return false;
+    }
+    return file->open(mode);
 }
 
-QString AsulMultiDownloader::generateTaskId()
+bool DownloadTask::writeBufferedFile()
 {
-    m_taskIdCounter++;
-    return QString("task_%1_%2")
-        .arg(QDateTime::currentMSecsSinceEpoch())
-        .arg(m_taskIdCounter);
+    QFile file(m_stagingPath);
+    if (!openStagingFile(&file, QIODevice::WriteOnly)) {
+        setError(QString("Cannot open file: %1").arg(m_savePath));
+        return false;
+    }
+
+    if (file.write(m_buffer) != m_buffer.size()) {
+        setError(QString("Failed to write file: %1").arg(m_savePath));
+        file.close();
+        QFile::remove(m_stagingPath);
+        return false;
+    }
+
+    file.close();
+    return true;
 }
 
-void AsulMultiDownloader::updateHostConnections(const QString &host, int delta)
+bool DownloadTask::verifyDigest()
 {
-    if (!m_hostConnections.contains(host)) {
-        m_hostConnections[host] = 0;
+    if (m_expectedSha1.isEmpty()) {
+        return true;
     }
 
-    m_hostConnections[host] += delta;
-
-    if (m_hostConnections[host] <= 0) {
-        m_hostConnections.remove(host);
+    // 从磁盘补读流式计算未覆盖到的区间（通常为空）
+    QFile file(m_stagingPath);
+    if (!file.open(QIODevice::ReadOnly)) {
+        setError(QString("Cannot open file for SHA-1 check: %1").arg(m_savePath));
+        return false;
     }
-}
+    const qint64 total = file.size();
+    while (m_digestOffset < total) {
+        if (!file.seek(m_digestOffset)) {
+            break;
+        }
+        const QByteArray data = file.read(qMin<qint64>(1024 * 1024, total - m_digestOffset));
+        if (data.isEmpty()) {
+            break;
+        }
+        updateDigest(m_digestOffset, data);
+    }
+    file.close();
 
-int AsulMultiDownloader::getHostConnections(const QString &host) const
-{
-    return m_hostConnections.value(host, 0);
+    return compareDigest();
 }
 
-bool AsulMultiDownloader::canStartDownload(const QString &host) const
+bool DownloadTask::compareDigest()
 {
-    return getHostConnections(host) < m_maxConnectionsPerHost;
+    if (m_expectedSha1.isEmpty()) {
+        return true;
+    }
+
+    const QByteArray actual = m_digest.result().toHex();
+    resetDigest();
+
+    if (actual != m_expectedSha1) {
+        setError(QString("SHA-1 mismatch for %1: expected %2, got %3")
+                     .arg(m_savePath, QString::fromLatin1(m_expectedSha1), QString::fromLatin1(actual)));
+        return false;
+    }
+
+    return true;
 }
 
-// ==================== DownloadTask 实现 ====================
+// ==================== SegmentDownloader 实现 ====================
 
-DownloadTask::DownloadTask(const QString &taskId, const QUrl &url,
-                         const QString &savePath, int priority, QObject *parent)
+SegmentDownloader::SegmentDownloader(int index, const QUrl &url, const QString &filePath,
+                                   qint64 start, qint64 end, int timeout, QObject *parent)
     : QObject(parent)
-    , m_taskId(taskId)
+    , m_index(index)
     , m_url(url)
-    , m_savePath(savePath)
-    , m_priority(priority)
-    , m_timeout(30000)
-    , m_fileSize(-1)
-    , m_downloadedSize(0)
-    , m_supportRange(false)
-    , m_segmentCount(1)
+    , m_filePath(filePath)
+    , m_start(start)
+    , m_end(end)
+    , m_bytesReceived(0)
+    , m_timeout(timeout)
     , m_networkManager(nullptr)
     , m_reply(nullptr)
     , m_file(nullptr)
+    , m_sharedFile(nullptr)
     , m_ownsNetworkManager(false)
-    , m_completedSegments(0)
-    , m_isPaused(false)
+    , m_rangeShrunk(false)
+    , m_bandwidth(nullptr)
+    , m_diskWriter(nullptr)
+    , m_priority(0)
+    , m_throttleTimer(nullptr)
     , m_isCanceled(false)
 {
-    // 从父对象（AsulMultiDownloader）获取共享的网络管理器
-    AsulMultiDownloader *downloader = qobject_cast<AsulMultiDownloader*>(parent);
-    if (downloader) {
-        m_networkManager = downloader->getNetworkManager();
-        m_ownsNetworkManager = false;
-    } else {
-        // 如果无法获取，创建自己的（兜底方案）
-        m_networkManager = new QNetworkAccessManager(this);
+    // 尝试从DownloadTask所属的管理器获取共享的网络管理器（按当前线程选择）
+    DownloadTask *task = qobject_cast<DownloadTask*>(parent);
+    if (task) {
+        m_priority = task->priority();
+        AsulMultiDownloader *downloader = task->m_downloader;
+        if (downloader) {
+            m_networkManager = downloader->getNetworkManager();
+            m_ownsNetworkManager = false;
+            m_bandwidth = downloader->m_bandwidth.get();
+            m_diskWriter = downloader->m_diskWriter.get();
+        }
+    }
+
+    // 如果无法获取，创建自己的（兜底方案）
+    if (!m_networkManager) {
+        m_networkManager = NetworkService::getInstance()->createManager(this);
         m_ownsNetworkManager = true;
     }
 }
 
-DownloadTask::~DownloadTask()
+SegmentDownloader::~SegmentDownloader()
 {
     cancel();
 
-    if (m_file) {
-        m_file->close();
-        delete m_file;
-        m_file = nullptr;
-    }
-
     // 注意：不需要显式释放网络管理器
     // - 如果是从池中借用的（m_ownsNetworkManager == false），池会一直持有这些管理器
     // - 如果是自己创建的（m_ownsNetworkManager == true），Qt的父子关系会自动删除
 }
 
-void DownloadTask::start()
+void SegmentDownloader::start()
 {
-    QMutexLocker locker(&m_mutex);
-
-    if (m_isPaused || m_isCanceled) {
+    if (m_isCanceled) {
         return;
     }
 
-    // === 清理上一次尝试的残留状态（重试安全）===
-    if (m_reply) {
-        m_reply->disconnect();  // 先断开所有信号，防止abort()同步触发finished信号导致死锁
-        m_reply->abort();
-        m_reply->deleteLater();
-        m_reply = nullptr;
-    }
-
-    for (auto segment : m_segments) {
-        segment->cancel();
-        segment->deleteLater();
+    // 打开文件（直写模式下写入共享的目标文件，无需单独的分段文件；数据按偏移交给写入器，不使用缓冲区）
+    if (!m_sharedFile) {
+        m_file = new QFile(m_filePath);
+        if (!m_file->open(QIODevice::WriteOnly | QIODevice::Unbuffered)) {
+            QString error = QString("Cannot open file: %1").arg(m_filePath);
+            delete m_file;
+            m_file = nullptr;
+            emit this->error(m_index, error);
+            return;
+        }
     }
-    m_segments.clear();
-    m_segmentProgress.clear();
-    m_completedSegments = 0;
 
-    if (m_file) {
-        m_file->close();
-        delete m_file;
-        m_file = nullptr;
+    // 创建请求，设置Range头
+    QNetworkRequest request(m_url);
+    request.setAttribute(QNetworkRequest::RedirectPolicyAttribute,
+                        QNetworkRequest::NoLessSafeRedirectPolicy);
+    request.setAttribute(QNetworkRequest::Http2AllowedAttribute, false);  // 强制HTTP/1.1
+    request.setTransferTimeout(m_timeout);
+    NetworkService::getInstance()->prepareRequest(request);
+    request.setRawHeader("Range", QString("bytes=%1-%2").arg(m_start).arg(m_end).toUtf8());
+    if (!m_ifRange.isEmpty()) {
+        request.setRawHeader("If-Range", m_ifRange);
     }
 
-    m_downloadedSize = 0;
-    m_errorString.clear();
-    // === 清理完成 ===
-
-    // 确保保存目录存在
-    QFileInfo fileInfo(m_savePath);
-    QDir dir = fileInfo.absoluteDir();
-    if (!dir.exists()) {
-        dir.mkpath(".");
+    m_elapsed.start();
+    m_reply = m_networkManager->get(request);
+    if (m_bandwidth) {
+        m_bandwidth->prepare(m_reply, false);
     }
+    connect(m_reply, &QNetworkReply::readyRead, this, &SegmentDownloader::onReadyRead);
+    connect(m_reply, &QNetworkReply::finished, this, &SegmentDownloader::onFinished);
+    // 注意：不连接 errorOccurred，避免 error+finished 双重触发
+    // onFinished 内部已检查 m_reply->error() 来处理错误
+}
 
-    emit started(m_taskId);
-
-    // 优化：如果已知文件大小且小于分段阈值，直接单线程下载，跳过HEAD请求
-    AsulMultiDownloader *downloader = qobject_cast<AsulMultiDownloader*>(parent());
-    if (m_fileSize > 0 && downloader && m_fileSize <= downloader->m_largeFileThreshold) {
-        // 小文件，已知大小，无需HEAD探测，直接下载
-        m_supportRange = false;
-        m_segmentCount = 1;
-        locker.unlock();
-        startSingleDownload();
+void SegmentDownloader::adopt(QNetworkReply *reply)
+{
+    if (m_isCanceled || !m_sharedFile) {
+        // 只有直写模式的分段可以接管；其余情况放弃探测请求，自行发起请求
+        discardReply(reply);
+        start();
         return;
     }
 
-    // 大文件或未知大小时发送HEAD请求获取文件大小和是否支持Range
-    QNetworkRequest request(m_url);
-    request.setAttribute(QNetworkRequest::RedirectPolicyAttribute,
-                        QNetworkRequest::NoLessSafeRedirectPolicy);
-    request.setAttribute(QNetworkRequest::Http2AllowedAttribute, false);  // 强制HTTP/1.1，避免HTTP/2流限制
-    request.setTransferTimeout(m_timeout);
+    // 探测请求会一直发送到文件末尾，与被拆分缩短的区间一样收满本分段后即结束
+    m_rangeShrunk = true;
+    m_elapsed.start();
+    m_reply = reply;
+    connect(m_reply, &QNetworkReply::readyRead, this, &SegmentDownloader::onReadyRead);
+    connect(m_reply, &QNetworkReply::finished, this, &SegmentDownloader::onFinished);
 
-    m_reply = m_networkManager->head(request);
-    // 注意：只连接 finished 信号。不连接 errorOccurred，避免 error+finished 双重触发
-    // onHeadFinished 内部已检查 m_reply->error() 来处理错误
-    connect(m_reply, &QNetworkReply::finished, this, &DownloadTask::onHeadFinished);
+    // 已到达的数据不会再触发readyRead；任务此时持锁，进度信号需在事件循环中再发出
+    QMetaObject::invokeMethod(this, &SegmentDownloader::onReadyRead, Qt::QueuedConnection);
 }
 
-void DownloadTask::pause()
+void SegmentDownloader::cancel()
 {
-    QMutexLocker locker(&m_mutex);
-
-    m_isPaused = true;
+    m_isCanceled = true;
 
     if (m_reply) {
         m_reply->disconnect();  // 先断开信号，防止abort()同步触发finished信号导致死锁
@@ -774,528 +4327,1003 @@ void DownloadTask::pause()
         m_reply = nullptr;
     }
 
-    // 取消所有分段下载
-    for (auto segment : m_segments) {
-        segment->cancel();
-        segment->deleteLater();
-    }
-    m_segments.clear();
+    closeFile();
+}
 
-    if (m_file) {
-        m_file->close();
-        delete m_file;
-        m_file = nullptr;
+bool SegmentDownloader::closeFile()
+{
+    if (!m_file) {
+        return true;
     }
 
-    emit paused(m_taskId);
+    const bool ok = !m_diskWriter || m_diskWriter->release(m_file);
+    m_file->close();
+    delete m_file;
+    m_file = nullptr;
+    return ok;
 }
 
-void DownloadTask::resume()
+bool SegmentDownloader::writeChunk(const QByteArray &data)
 {
-    QMutexLocker locker(&m_mutex);
+    // 服务器忽略Range返回200时，数据会覆盖其他分段，直接判定失败
+    const int status = m_reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
+    if (status != 206) {
+        return false;
+    }
 
-    m_isPaused = false;
+    // 只保留本分段范围内的数据，防止越界写入相邻分段
+    const qint64 remaining = (m_end - m_start + 1) - m_bytesReceived;
+    const QByteArray chunk = data.size() > remaining ? data.left(remaining) : data;
+    if (chunk.isEmpty()) {
+        return true;
+    }
 
-    // 重新开始下载
-    locker.unlock();
-    start();
+    const qint64 offset = m_start + m_bytesReceived;
+    if (auto *task = qobject_cast<DownloadTask*>(parent())) {
+        task->updateDigest(offset, chunk);
+    }
+
+    // 交给写入器落盘；返回false表示此前的写入已经失败
+    if (m_sharedFile) {
+        if (!writeAt(m_diskWriter, m_sharedFile, offset, chunk)) {
+            return false;
+        }
+    } else if (m_file) {
+        if (!writeAt(m_diskWriter, m_file, m_bytesReceived, chunk)) {
+            return false;
+        }
+    }
+
+    m_bytesReceived += chunk.size();
+    return true;
 }
 
-void DownloadTask::cancel()
+void SegmentDownloader::onReadyRead()
 {
-    QMutexLocker locker(&m_mutex);
+    if ((!m_file && !m_sharedFile) || !m_reply) {
+        return;
+    }
 
-    m_isCanceled = true;
+    int retryMs = 0;
+    const QByteArray data = m_bandwidth ? m_bandwidth->read(m_reply, m_url.host(), m_priority, &retryMs)
+                                        : m_reply->readAll();
+    if (!writeChunk(data)) {
+        QString errorString = QString("Segment write failed at offset %1").arg(m_start + m_bytesReceived);
+        m_reply->disconnect();
+        m_reply->abort();
+        m_reply->deleteLater();
+        m_reply = nullptr;
+        emit error(m_index, errorString);
+        return;
+    }
 
-    if (m_reply) {
-        m_reply->disconnect();  // 先断开信号，防止abort()同步触发finished信号导致死锁
+    qint64 total = m_end - m_start + 1;
+    emit progress(m_index, m_bytesReceived, total);
+
+    // 区间被拆分缩短后，收满即结束，不再等待服务端发完原请求的剩余部分
+    if (m_rangeShrunk && m_reply && m_bytesReceived >= total) {
+        m_reply->disconnect();
         m_reply->abort();
         m_reply->deleteLater();
         m_reply = nullptr;
+        emit finished(m_index);
+        return;
     }
 
-    // 取消所有分段下载
-    for (auto segment : m_segments) {
-        segment->cancel();
-        segment->deleteLater();
+    // 令牌不足，剩余数据留在接收缓冲区，稍后再读
+    if (retryMs > 0) {
+        if (!m_throttleTimer) {
+            m_throttleTimer = new QTimer(this);
+            m_throttleTimer->setSingleShot(true);
+            connect(m_throttleTimer, &QTimer::timeout, this, &SegmentDownloader::onReadyRead);
+        }
+        if (!m_throttleTimer->isActive()) {
+            m_throttleTimer->start(retryMs);
+        }
     }
-    m_segments.clear();
+}
 
-    if (m_file) {
-        m_file->close();
-        delete m_file;
-        m_file = nullptr;
+void SegmentDownloader::setRangeEnd(qint64 end)
+{
+    if (end < m_end) {
+        m_end = qMax(end, m_start + m_bytesReceived - 1);
+        m_rangeShrunk = true;
     }
 }
 
-void DownloadTask::onHeadFinished()
+qint64 SegmentDownloader::throughput() const
+{
+    const qint64 elapsed = elapsedMs();
+    return elapsed > 0 ? (m_bytesReceived * 1000) / elapsed : 0;
+}
+
+qint64 SegmentDownloader::elapsedMs() const
+{
+    return m_elapsed.isValid() ? m_elapsed.elapsed() : 0;
+}
+
+void SegmentDownloader::onFinished()
 {
     if (!m_reply) {
         return;
     }
 
-    QMutexLocker locker(&m_mutex);
-
     if (m_reply->error() != QNetworkReply::NoError) {
-        m_errorString = m_reply->errorString();
+        QString errorString = m_reply->errorString();
+        m_failure = DownloadFailure::fromReply(m_reply);
+
+        if (m_file) {
+            closeFile();
+            QFile::remove(m_filePath);
+        }
+
         m_reply->deleteLater();
         m_reply = nullptr;
-        locker.unlock();
-        emit failed(m_taskId, m_errorString);
+
+        emit error(m_index, errorString);
         return;
     }
 
-    // 获取文件大小
-    m_fileSize = m_reply->header(QNetworkRequest::ContentLengthHeader).toLongLong();
-
-    // 检查是否支持Range
-    QString acceptRanges = m_reply->rawHeader("Accept-Ranges");
-    m_supportRange = (acceptRanges.toLower() == "bytes");
+    // 写入剩余数据
+    if (m_file || m_sharedFile) {
+        const QByteArray data = m_reply->readAll();
+        if (m_bandwidth) {
+            m_bandwidth->charge(m_url.host(), m_priority, data.size());
+        }
+        if (!writeChunk(data)) {
+            m_reply->deleteLater();
+            m_reply = nullptr;
+            emit error(m_index, QString("Segment write failed at offset %1").arg(m_start + m_bytesReceived));
+            return;
+        }
+    }
+    if (!closeFile()) {
+        m_reply->deleteLater();
+        m_reply = nullptr;
+        emit error(m_index, QString("Segment write failed: %1").arg(m_filePath));
+        return;
+    }
 
     m_reply->deleteLater();
     m_reply = nullptr;
 
-    // 根据文件大小决定下载策略
-    AsulMultiDownloader *downloader = qobject_cast<AsulMultiDownloader*>(parent());
-
-    // PCL优化：检查域名策略
-    bool disableMultiThread = downloader && downloader->shouldDisableMultiThread(m_url);
-
-    if (downloader && m_fileSize > downloader->largeFileThreshold() && m_supportRange && !disableMultiThread) {
-        // 大文件，使用分段下载（除非域名在禁用列表中）
-        locker.unlock();
-        startSegmentedDownload();
-    } else {
-        // 小文件、不支持Range或域名禁用多线程，使用单线程下载
-        m_segmentCount = 1;
-        locker.unlock();
-        startSingleDownload();
+    if (m_bytesReceived != m_end - m_start + 1) {
+        emit error(m_index, QString("Segment incomplete: %1 of %2 bytes")
+                                .arg(m_bytesReceived).arg(m_end - m_start + 1));
+        return;
     }
+
+    emit finished(m_index);
 }
 
-void DownloadTask::startSingleDownload()
+void SegmentDownloader::onError(QNetworkReply::NetworkError errorCode)
 {
-    QMutexLocker locker(&m_mutex);
+    Q_UNUSED(errorCode);
 
-    if (m_isPaused || m_isCanceled) {
+    if (!m_reply) {
         return;
     }
 
-    // 打开文件
-    m_file = new QFile(m_savePath);
-    if (!m_file->open(QIODevice::WriteOnly)) {
-        m_errorString = QString("Cannot open file: %1").arg(m_savePath);
-        delete m_file;
-        m_file = nullptr;
-        locker.unlock();
-        emit failed(m_taskId, m_errorString);
-        return;
+    QString errorString = m_reply->errorString();
+
+    if (m_file) {
+        closeFile();
+        QFile::remove(m_filePath);
     }
 
-    // 开始下载
-    QNetworkRequest request(m_url);
-    request.setAttribute(QNetworkRequest::RedirectPolicyAttribute,
-                        QNetworkRequest::NoLessSafeRedirectPolicy);
-    request.setAttribute(QNetworkRequest::Http2AllowedAttribute, false);  // 强制HTTP/1.1
-    request.setTransferTimeout(m_timeout);
+    emit error(m_index, errorString);
+}
 
-    m_reply = m_networkManager->get(request);
-    connect(m_reply, &QNetworkReply::downloadProgress, this, &DownloadTask::onDownloadProgress);
-    connect(m_reply, &QNetworkReply::finished, this, &DownloadTask::onDownloadFinished);
-    // 注意：不连接 errorOccurred，避免 error+finished 双重触发导致回复指针错乱
-    // onDownloadFinished 内部已检查 m_reply->error() 来处理错误
-    connect(m_reply, &QNetworkReply::readyRead, this, [this]() {
-        if (m_file && m_reply) {
-            m_file->write(m_reply->readAll());
-        }
-    });
+// ==================== DownloadResumeJournal 实现 ====================
+
+QString DownloadResumeJournal::journalPath(const QString &savePath)
+{
+    return savePath + QStringLiteral(".resume");
 }
 
-void DownloadTask::startSegmentedDownload()
+bool DownloadResumeJournal::exists(const QString &savePath)
 {
-    QMutexLocker locker(&m_mutex);
+    return QFileInfo::exists(journalPath(savePath));
+}
 
-    if (m_isPaused || m_isCanceled) {
-        return;
+bool DownloadResumeJournal::load(const QString &savePath, DownloadResumeJournal *out)
+{
+    QFile file(journalPath(savePath));
+    if (!file.open(QIODevice::ReadOnly)) {
+        return false;
     }
 
-    if (m_fileSize <= 0) {
-        // 文件大小未知，回退到单线程下载
-        locker.unlock();
-        startSingleDownload();
-        return;
+    QJsonParseError parseError;
+    const QJsonDocument doc = QJsonDocument::fromJson(file.readAll(), &parseError);
+    if (parseError.error != QJsonParseError::NoError || !doc.isObject()) {
+        return false;
     }
 
-    // 计算每个分段的大小
-    qint64 segmentSize = m_fileSize / m_segmentCount;
-    m_segmentProgress.resize(m_segmentCount);
-    m_segmentProgress.fill(0);
-
-    // 创建分段下载器
-    for (int i = 0; i < m_segmentCount; ++i) {
-        qint64 start = i * segmentSize;
-        qint64 end = (i == m_segmentCount - 1) ? m_fileSize - 1 : (start + segmentSize - 1);
+    const QJsonObject obj = doc.object();
+    DownloadResumeJournal journal;
+    journal.url = obj.value(QStringLiteral("url")).toString();
+    journal.fileSize = obj.value(QStringLiteral("size")).toVariant().toLongLong();
+    journal.etag = obj.value(QStringLiteral("etag")).toString();
+    journal.lastModified = obj.value(QStringLiteral("lastModified")).toString();
+
+    const QJsonArray ranges = obj.value(QStringLiteral("completed")).toArray();
+    for (const auto &val : ranges) {
+        const QJsonArray pair = val.toArray();
+        if (pair.size() != 2) {
+            continue;
+        }
+        journal.addCompleted(pair.at(0).toVariant().toLongLong(), pair.at(1).toVariant().toLongLong());
+    }
 
-        QString segmentPath = m_savePath + QString(".part%1").arg(i);
+    if (out) {
+        *out = journal;
+    }
+    return true;
+}
 
-        auto segment = new SegmentDownloader(i, m_url, segmentPath, start, end, m_timeout, this);
-        connect(segment, &SegmentDownloader::finished, this, &DownloadTask::onSegmentFinished);
-        connect(segment, &SegmentDownloader::error, this, &DownloadTask::onSegmentError);
-        connect(segment, &SegmentDownloader::progress, this, &DownloadTask::onSegmentProgress);
+void DownloadResumeJournal::remove(const QString &savePath)
+{
+    QFile::remove(journalPath(savePath));
+}
 
-        m_segments.append(segment);
+bool DownloadResumeJournal::save(const QString &savePath) const
+{
+    QJsonArray ranges;
+    for (const Range &range : completed) {
+        ranges.append(QJsonArray{QString::number(range.first), QString::number(range.second)});
     }
 
-    // 启动所有分段下载
-    for (auto segment : m_segments) {
-        segment->start();
+    QJsonObject obj;
+    obj.insert(QStringLiteral("url"), url);
+    obj.insert(QStringLiteral("size"), QString::number(fileSize));
+    obj.insert(QStringLiteral("etag"), etag);
+    obj.insert(QStringLiteral("lastModified"), lastModified);
+    obj.insert(QStringLiteral("completed"), ranges);
+
+    // 原子替换，避免进程中途退出留下半份日志
+    QSaveFile file(journalPath(savePath));
+    if (!file.open(QIODevice::WriteOnly)) {
+        return false;
     }
+    file.write(QJsonDocument(obj).toJson(QJsonDocument::Compact));
+    return file.commit();
 }
 
-void DownloadTask::onDownloadProgress(qint64 bytesReceived, qint64 bytesTotal)
+bool DownloadResumeJournal::matches(const DownloadResumeJournal &other) const
 {
-    QMutexLocker locker(&m_mutex);
-    m_downloadedSize = bytesReceived;
-
-    if (bytesTotal > 0) {
-        m_fileSize = bytesTotal;
+    if (fileSize <= 0 || fileSize != other.fileSize) {
+        return false;
     }
-
-    locker.unlock();
-    emit progress(m_taskId, bytesReceived, bytesTotal);
+    if (!etag.isEmpty() || !other.etag.isEmpty()) {
+        return etag == other.etag;
+    }
+    if (!lastModified.isEmpty() || !other.lastModified.isEmpty()) {
+        return lastModified == other.lastModified;
+    }
+    // 服务端未提供任何校验标识，只能以URL判断
+    return url == other.url;
 }
 
-void DownloadTask::onDownloadFinished()
+void DownloadResumeJournal::addCompleted(qint64 first, qint64 last)
 {
-    if (!m_reply) {
+    if (first < 0 || last < first) {
         return;
     }
 
-    QMutexLocker locker(&m_mutex);
-
-    if (m_reply->error() != QNetworkReply::NoError) {
-        m_errorString = m_reply->errorString();
-        m_reply->deleteLater();
-        m_reply = nullptr;
-
-        if (m_file) {
-            m_file->close();
-            delete m_file;
-            m_file = nullptr;
+    // 插入后合并重叠或相邻的区间，保持有序
+    QList<Range> merged;
+    Range pending(first, last);
+    bool inserted = false;
+    for (const Range &range : completed) {
+        if (range.second + 1 < pending.first) {
+            merged.append(range);
+        } else if (pending.second + 1 < range.first) {
+            if (!inserted) {
+                merged.append(pending);
+                inserted = true;
+            }
+            merged.append(range);
+        } else {
+            pending.first = qMin(pending.first, range.first);
+            pending.second = qMax(pending.second, range.second);
         }
+    }
+    if (!inserted) {
+        merged.append(pending);
+    }
+    completed = merged;
+}
 
-        locker.unlock();
-        emit failed(m_taskId, m_errorString);
-        return;
+qint64 DownloadResumeJournal::completedBytes() const
+{
+    qint64 total = 0;
+    for (const Range &range : completed) {
+        total += range.second - range.first + 1;
     }
+    return total;
+}
 
-    // 写入剩余数据
-    if (m_file && m_reply) {
-        m_file->write(m_reply->readAll());
-        m_file->close();
-        delete m_file;
-        m_file = nullptr;
+QList<DownloadResumeJournal::Range> DownloadResumeJournal::missingRanges() const
+{
+    QList<Range> missing;
+    if (fileSize <= 0) {
+        return missing;
     }
 
-    m_reply->deleteLater();
-    m_reply = nullptr;
+    qint64 cursor = 0;
+    for (const Range &range : completed) {
+        if (range.first >= fileSize) {
+            break;
+        }
+        if (range.first > cursor) {
+            missing.append(Range(cursor, range.first - 1));
+        }
+        cursor = qMax(cursor, range.second + 1);
+    }
+    if (cursor < fileSize) {
+        missing.append(Range(cursor, fileSize - 1));
+    }
+    return missing;
+}
 
-    // 修复：任务完成时用实际文件大小更新downloadedSize，确保统计准确
-    if (m_fileSize > 0) {
-        m_downloadedSize = m_fileSize;
-    } else {
-        // 文件大小未知时，读取实际写入的文件大小
-        QFileInfo fi(m_savePath);
-        if (fi.exists()) {
-            m_downloadedSize = fi.size();
-            m_fileSize = fi.size();
+QList<DownloadResumeJournal::Range> DownloadResumeJournal::splitRanges(QList<Range> ranges, int count, qint64 minBytes)
+{
+    while (ranges.size() < count) {
+        int largest = -1;
+        qint64 largestSize = 0;
+        for (int i = 0; i < ranges.size(); ++i) {
+            const qint64 size = ranges[i].second - ranges[i].first + 1;
+            if (size > largestSize) {
+                largest = i;
+                largestSize = size;
+            }
+        }
+        if (largest < 0 || largestSize < 2 * qMax<qint64>(1, minBytes)) {
+            break;
         }
+
+        const Range range = ranges[largest];
+        const qint64 mid = range.first + largestSize / 2;
+        ranges[largest] = Range(range.first, mid - 1);
+        ranges.insert(largest + 1, Range(mid, range.second));
     }
+    return ranges;
+}
 
-    locker.unlock();
-    emit finished(m_taskId);
+// ==================== DownloadRetryPolicy 实现 ====================
+
+DownloadFailure DownloadFailure::fromReply(QNetworkReply *reply)
+{
+    DownloadFailure failure;
+    if (!reply) {
+        return failure;
+    }
+
+    failure.networkError = reply->error();
+    failure.httpStatus = reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
+    if (reply->hasRawHeader("Retry-After")) {
+        failure.retryAfterMs = parseRetryAfter(reply->rawHeader("Retry-After"));
+    }
+    return failure;
 }
 
-void DownloadTask::onDownloadError(QNetworkReply::NetworkError error)
+qint64 DownloadFailure::parseRetryAfter(const QByteArray &value)
 {
-    Q_UNUSED(error);
+    const QByteArray trimmed = value.trimmed();
+    if (trimmed.isEmpty()) {
+        return -1;
+    }
 
-    if (!m_reply) {
-        return;
+    // delta-seconds
+    bool ok = false;
+    const qint64 seconds = trimmed.toLongLong(&ok);
+    if (ok) {
+        return seconds >= 0 ? seconds * 1000 : -1;
     }
 
-    QMutexLocker locker(&m_mutex);
-    m_errorString = m_reply->errorString();
+    // HTTP-date，例如 "Wed, 21 Oct 2015 07:28:00 GMT"
+    const QDateTime when = QDateTime::fromString(QString::fromLatin1(trimmed), Qt::RFC2822Date);
+    if (!when.isValid()) {
+        return -1;
+    }
+    return qMax<qint64>(0, QDateTime::currentDateTimeUtc().msecsTo(when));
+}
 
-    if (m_file) {
-        m_file->close();
-        delete m_file;
-        m_file = nullptr;
+DownloadFailureKind DownloadRetryPolicy::classify(const DownloadFailure &failure) const
+{
+    const int status = failure.httpStatus;
+
+    if (status == 429 || status == 503 || failure.retryAfterMs >= 0) {
+        return DownloadFailureKind::Throttled;
+    }
+    if (status == 408 || status == 425 || status >= 500) {
+        return DownloadFailureKind::Transient;
+    }
+    if (status >= 400) {
+        return DownloadFailureKind::Permanent;
     }
 
-    locker.unlock();
-    emit failed(m_taskId, m_errorString);
+    switch (failure.networkError) {
+    case QNetworkReply::ServiceUnavailableError:
+        return DownloadFailureKind::Throttled;
+    case QNetworkReply::ContentNotFoundError:
+    case QNetworkReply::ContentGoneError:
+    case QNetworkReply::ContentAccessDenied:
+    case QNetworkReply::ContentOperationNotPermittedError:
+    case QNetworkReply::AuthenticationRequiredError:
+    case QNetworkReply::ProtocolUnknownError:
+    case QNetworkReply::ProtocolInvalidOperationError:
+        return DownloadFailureKind::Permanent;
+    default:
+        // 超时、连接被拒绝/重置、DNS失败、校验不一致、本地写入失败等
+        return DownloadFailureKind::Transient;
+    }
 }
 
-void DownloadTask::onSegmentFinished(int segmentIndex)
+qint64 DownloadRetryPolicy::retryDelay(const DownloadFailure &failure, DownloadFailureKind kind, int attempt) const
 {
-    QMutexLocker locker(&m_mutex);
+    if (kind == DownloadFailureKind::Permanent) {
+        return 0;
+    }
 
-    m_completedSegments++;
+    // 指数退避 + 等值抖动：一半固定、一半随机，避免同时失败的任务同时重试
+    const qint64 base = kind == DownloadFailureKind::Throttled ? kThrottledBaseDelayMs : kRetryBaseDelayMs;
+    const int shift = qBound(0, attempt - 1, 16);
+    const qint64 ceiling = qMin(kRetryMaxDelayMs, base << shift);
+    qint64 delay = ceiling / 2 + QRandomGenerator::global()->bounded(ceiling / 2 + 1);
 
-    if (m_completedSegments == m_segmentCount) {
-        // 所有分段下载完成，合并文件
-        locker.unlock();
-        mergeSegments();
+    if (kind == DownloadFailureKind::Throttled && failure.retryAfterMs >= 0) {
+        delay = qMax(delay, qMin(failure.retryAfterMs, kMaxRetryAfterMs));
     }
+    return delay;
 }
 
-void DownloadTask::onSegmentError(int segmentIndex, const QString &error)
+// ==================== BandwidthLimiter 实现 ====================
+
+BandwidthLimiter::BandwidthLimiter()
+    : m_active(false)
 {
-    QMutexLocker locker(&m_mutex);
+    m_clock.start();
+}
 
-    m_errorString = QString("Segment %1 download failed: %2").arg(segmentIndex).arg(error);
+double BandwidthLimiter::capacity(const Bucket &bucket)
+{
+    // 允许短时突发，但至少能容纳一次最小读取
+    return qMax<double>(double(bucket.rate) * kRateBurstMs / 1000.0, kMinPacedReadBytes);
+}
 
-    // 取消所有其他分段
-    for (auto segment : m_segments) {
-        segment->cancel();
+void BandwidthLimiter::refill(Bucket &bucket, qint64 now) const
+{
+    const qint64 elapsed = now - bucket.lastRefill;
+    if (elapsed > 0) {
+        bucket.tokens = qMin(capacity(bucket), bucket.tokens + double(bucket.rate) * elapsed / 1000.0);
+        bucket.lastRefill = now;
+    }
+}
+
+void BandwidthLimiter::setRate(Bucket &bucket, qint64 bytesPerSecond)
+{
+    const qint64 now = m_clock.elapsed();
+    if (bucket.rate > 0) {
+        refill(bucket, now);
+    } else {
+        bucket.tokens = 0;
     }
+    bucket.rate = bytesPerSecond;
+    bucket.lastRefill = now;
+    bucket.tokens = qMin(bucket.tokens, capacity(bucket));
+}
 
-    locker.unlock();
-    emit failed(m_taskId, m_errorString);
+void BandwidthLimiter::updateActive()
+{
+    m_active.store(m_global.rate > 0 || !m_hosts.isEmpty() || !m_priorities.isEmpty(),
+                   std::memory_order_relaxed);
 }
 
-void DownloadTask::onSegmentProgress(int segmentIndex, qint64 bytesReceived, qint64 bytesTotal)
+void BandwidthLimiter::setGlobalRate(qint64 bytesPerSecond)
 {
     QMutexLocker locker(&m_mutex);
+    setRate(m_global, qMax<qint64>(0, bytesPerSecond));
+    updateActive();
+}
 
-    if (segmentIndex >= 0 && segmentIndex < m_segmentProgress.size()) {
-        m_segmentProgress[segmentIndex] = bytesReceived;
-    }
+qint64 BandwidthLimiter::globalRate() const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_global.rate;
+}
 
-    // 计算总进度
-    qint64 totalReceived = 0;
-    for (qint64 progress : m_segmentProgress) {
-        totalReceived += progress;
+void BandwidthLimiter::setHostRate(const QString &host, qint64 bytesPerSecond)
+{
+    QMutexLocker locker(&m_mutex);
+    if (bytesPerSecond <= 0) {
+        m_hosts.remove(host);
+    } else {
+        setRate(m_hosts[host], bytesPerSecond);
     }
+    updateActive();
+}
 
-    m_downloadedSize = totalReceived;
+qint64 BandwidthLimiter::hostRate(const QString &host) const
+{
+    QMutexLocker locker(&m_mutex);
+    auto it = m_hosts.constFind(host);
+    return it == m_hosts.constEnd() ? 0 : it->rate;
+}
 
-    locker.unlock();
-    emit progress(m_taskId, totalReceived, m_fileSize);
+void BandwidthLimiter::setPriorityRate(int priority, qint64 bytesPerSecond)
+{
+    QMutexLocker locker(&m_mutex);
+    if (bytesPerSecond <= 0) {
+        m_priorities.remove(priority);
+    } else {
+        setRate(m_priorities[priority], bytesPerSecond);
+    }
+    updateActive();
 }
 
-void DownloadTask::mergeSegments()
+qint64 BandwidthLimiter::priorityRate(int priority) const
 {
     QMutexLocker locker(&m_mutex);
+    auto it = m_priorities.constFind(priority);
+    return it == m_priorities.constEnd() ? 0 : it->rate;
+}
 
-    // 打开目标文件
-    QFile outFile(m_savePath);
-    if (!outFile.open(QIODevice::WriteOnly)) {
-        m_errorString = QString("Cannot create target file: %1").arg(m_savePath);
-        locker.unlock();
-        emit failed(m_taskId, m_errorString);
-        return;
+int BandwidthLimiter::collect(const QString &host, int priority, Bucket **out)
+{
+    int count = 0;
+    if (m_global.rate > 0) {
+        out[count++] = &m_global;
+    }
+    auto hostIt = m_hosts.find(host);
+    if (hostIt != m_hosts.end()) {
+        out[count++] = &hostIt.value();
     }
+    auto priorityIt = m_priorities.find(priority);
+    if (priorityIt != m_priorities.end()) {
+        out[count++] = &priorityIt.value();
+    }
+    return count;
+}
 
-    // 依次读取并写入每个分段文件
-    for (int i = 0; i < m_segmentCount; ++i) {
-        QString segmentPath = m_savePath + QString(".part%1").arg(i);
-        QFile segmentFile(segmentPath);
+void BandwidthLimiter::prepare(QNetworkReply *reply, bool http2) const
+{
+    if (reply && !http2 && isActive()) {
+        reply->setReadBufferSize(kPacedReadBufferBytes);
+    }
+}
 
-        if (!segmentFile.open(QIODevice::ReadOnly)) {
-            m_errorString = QString("Cannot open segment file: %1").arg(segmentPath);
-            outFile.close();
-            locker.unlock();
-            emit failed(m_taskId, m_errorString);
-            return;
-        }
+QByteArray BandwidthLimiter::read(QNetworkReply *reply, const QString &host, int priority, int *retryMs)
+{
+    if (!isActive()) {
+        return reply->readAll();
+    }
 
-        // 读取并写入数据
-        while (!segmentFile.atEnd()) {
-            QByteArray data = segmentFile.read(8192);
-            outFile.write(data);
-        }
+    const qint64 available = reply->bytesAvailable();
+    if (available <= 0) {
+        return QByteArray();
+    }
+
+    QMutexLocker locker(&m_mutex);
+
+    Bucket *buckets[3];
+    const int count = collect(host, priority, buckets);
+    if (count == 0) {
+        locker.unlock();
+        return reply->readAll();
+    }
 
-        segmentFile.close();
-        segmentFile.remove();  // 删除分段文件
+    const qint64 now = m_clock.elapsed();
+    double allowed = double(available);
+    for (int i = 0; i < count; ++i) {
+        refill(*buckets[i], now);
+        allowed = qMin(allowed, qMax(0.0, buckets[i]->tokens));
     }
 
-    outFile.close();
+    // 令牌不足一次最小读取时先不读，攒够再读，避免大量零碎的小读取
+    qint64 grant = qint64(allowed);
+    if (grant < qMin(available, kMinPacedReadBytes)) {
+        grant = 0;
+    }
 
-    // 修复：分段下载完成时也更新downloadedSize
-    if (m_fileSize > 0) {
-        m_downloadedSize = m_fileSize;
+    for (int i = 0; i < count; ++i) {
+        buckets[i]->tokens -= double(grant);
+    }
+
+    if (grant < available && retryMs) {
+        // 估算所有桶攒够下一次读取所需令牌的时间
+        const double need = double(qMin(available - grant, kMinPacedReadBytes));
+        double waitMs = 1;
+        for (int i = 0; i < count; ++i) {
+            const double deficit = need - buckets[i]->tokens;
+            if (deficit > 0) {
+                waitMs = qMax(waitMs, deficit * 1000.0 / double(buckets[i]->rate));
+            }
+        }
+        *retryMs = qMin(int(std::ceil(waitMs)), kMaxPacedWaitMs);
     }
 
     locker.unlock();
-    emit finished(m_taskId);
+    return grant > 0 ? reply->read(grant) : QByteArray();
 }
 
-// ==================== SegmentDownloader 实现 ====================
-
-SegmentDownloader::SegmentDownloader(int index, const QUrl &url, const QString &filePath,
-                                   qint64 start, qint64 end, int timeout, QObject *parent)
-    : QObject(parent)
-    , m_index(index)
-    , m_url(url)
-    , m_filePath(filePath)
-    , m_start(start)
-    , m_end(end)
-    , m_bytesReceived(0)
-    , m_timeout(timeout)
-    , m_networkManager(nullptr)
-    , m_reply(nullptr)
-    , m_file(nullptr)
-    , m_ownsNetworkManager(false)
-    , m_isCanceled(false)
+void BandwidthLimiter::charge(const QString &host, int priority, qint64 bytes)
 {
-    // 尝试从DownloadTask的父对象（AsulMultiDownloader）获取共享的网络管理器
-    DownloadTask *task = qobject_cast<DownloadTask*>(parent);
-    if (task) {
-        AsulMultiDownloader *downloader = qobject_cast<AsulMultiDownloader*>(task->parent());
-        if (downloader) {
-            m_networkManager = downloader->getNetworkManager();
-            m_ownsNetworkManager = false;
-        }
+    if (bytes <= 0 || !isActive()) {
+        return;
     }
 
-    // 如果无法获取，创建自己的（兜底方案）
-    if (!m_networkManager) {
-        m_networkManager = new QNetworkAccessManager(this);
-        m_ownsNetworkManager = true;
+    QMutexLocker locker(&m_mutex);
+
+    Bucket *buckets[3];
+    const int count = collect(host, priority, buckets);
+    const qint64 now = m_clock.elapsed();
+    for (int i = 0; i < count; ++i) {
+        refill(*buckets[i], now);
+        buckets[i]->tokens -= double(bytes);
     }
 }
 
-SegmentDownloader::~SegmentDownloader()
+// ==================== DiskWriter 实现 ====================
+
+DiskWriter::DiskWriter(qint64 maxQueuedBytes)
+    : m_queuedBytes(0)
+    , m_maxQueuedBytes(qMax<qint64>(1, maxQueuedBytes))
+    , m_stopping(false)
+    , m_ring(nullptr)
+    , m_ioUring(false)
+    , m_thread(nullptr)
 {
-    cancel();
+#ifdef AMCS_HAVE_LIBURING
+    m_ring = new io_uring;
+    if (io_uring_queue_init(kMaxWriteBatch, m_ring, 0) < 0) {
+        // 内核不支持或被禁用（例如容器的seccomp策略），退回到普通写入
+        delete m_ring;
+        m_ring = nullptr;
+    }
+    m_ioUring.store(m_ring != nullptr, std::memory_order_relaxed);
+#endif
 
-    // 注意：不需要显式释放网络管理器
-    // - 如果是从池中借用的（m_ownsNetworkManager == false），池会一直持有这些管理器
-    // - 如果是自己创建的（m_ownsNetworkManager == true），Qt的父子关系会自动删除
+    m_thread = QThread::create([this]() { run(); });
+    m_thread->setObjectName(QStringLiteral("AsulMultiDownloader-DiskWriter"));
+    m_thread->start();
 }
 
-void SegmentDownloader::start()
+DiskWriter::~DiskWriter()
 {
-    if (m_isCanceled) {
-        return;
+    {
+        QMutexLocker locker(&m_mutex);
+        m_stopping = true;
+        m_wakeWriter.wakeAll();
     }
+    m_thread->wait();
+    delete m_thread;
 
-    // 打开文件
-    m_file = new QFile(m_filePath);
-    if (!m_file->open(QIODevice::WriteOnly)) {
-        QString error = QString("Cannot open file: %1").arg(m_filePath);
-        delete m_file;
-        m_file = nullptr;
-        emit this->error(m_index, error);
-        return;
+#ifdef AMCS_HAVE_LIBURING
+    if (m_ring) {
+        io_uring_queue_exit(m_ring);
+        delete m_ring;
     }
-
-    // 创建请求，设置Range头
-    QNetworkRequest request(m_url);
-    request.setAttribute(QNetworkRequest::RedirectPolicyAttribute,
-                        QNetworkRequest::NoLessSafeRedirectPolicy);
-    request.setAttribute(QNetworkRequest::Http2AllowedAttribute, false);  // 强制HTTP/1.1
-    request.setTransferTimeout(m_timeout);
-    request.setRawHeader("Range", QString("bytes=%1-%2").arg(m_start).arg(m_end).toUtf8());
-
-    m_reply = m_networkManager->get(request);
-    connect(m_reply, &QNetworkReply::readyRead, this, &SegmentDownloader::onReadyRead);
-    connect(m_reply, &QNetworkReply::finished, this, &SegmentDownloader::onFinished);
-    // 注意：不连接 errorOccurred，避免 error+finished 双重触发
-    // onFinished 内部已检查 m_reply->error() 来处理错误
+#endif
 }
 
-void SegmentDownloader::cancel()
+bool DiskWriter::write(QFile *file, qint64 offset, const QByteArray &data)
 {
-    m_isCanceled = true;
+    if (data.isEmpty()) {
+        return true;
+    }
 
-    if (m_reply) {
-        m_reply->disconnect();  // 先断开信号，防止abort()同步触发finished信号导致死锁
-        m_reply->abort();
-        m_reply->deleteLater();
-        m_reply = nullptr;
+    QMutexLocker locker(&m_mutex);
+
+    // 排队数据过多时等待写入线程消化（单块超过上限时只在队列为空时放行）
+    while (m_queuedBytes > 0 && m_queuedBytes + data.size() > m_maxQueuedBytes) {
+        m_written.wait(&m_mutex);
     }
 
-    if (m_file) {
-        m_file->close();
-        delete m_file;
-        m_file = nullptr;
+    FileState &state = m_files[file];
+    if (state.failed) {
+        return false;
     }
+    state.pending++;
+    m_queuedBytes += data.size();
+    m_jobs.enqueue({file, offset, data});
+    m_wakeWriter.wakeOne();
+    return true;
 }
 
-void SegmentDownloader::onReadyRead()
+bool DiskWriter::flush(QFile *file)
 {
-    if (!m_file || !m_reply) {
-        return;
+    QMutexLocker locker(&m_mutex);
+
+    for (;;) {
+        auto it = m_files.constFind(file);
+        if (it == m_files.constEnd()) {
+            return true;
+        }
+        if (it->pending == 0) {
+            return !it->failed;
+        }
+        m_written.wait(&m_mutex);
     }
+}
 
-    QByteArray data = m_reply->readAll();
-    m_file->write(data);
-    m_bytesReceived += data.size();
+bool DiskWriter::release(QFile *file)
+{
+    const bool ok = flush(file);
 
-    qint64 total = m_end - m_start + 1;
-    emit progress(m_index, m_bytesReceived, total);
+    QMutexLocker locker(&m_mutex);
+    m_files.remove(file);
+    return ok;
 }
 
-void SegmentDownloader::onFinished()
+void DiskWriter::run()
 {
-    if (!m_reply) {
-        return;
+    QList<Job> batch;
+    QList<bool> results;
+
+    for (;;) {
+        {
+            QMutexLocker locker(&m_mutex);
+            while (m_jobs.isEmpty() && !m_stopping) {
+                m_wakeWriter.wait(&m_mutex);
+            }
+            if (m_jobs.isEmpty()) {
+                return;  // 正在停止且数据已全部写完
+            }
+            // 一次取出一批，持锁期间不做磁盘操作；已失败文件的数据直接丢弃
+            while (!m_jobs.isEmpty() && batch.size() < kMaxWriteBatch) {
+                Job job = m_jobs.dequeue();
+                FileState &state = m_files[job.file];
+                if (state.failed) {
+                    state.pending--;
+                    m_queuedBytes -= job.data.size();
+                    continue;
+                }
+                batch.append(std::move(job));
+            }
+            if (batch.isEmpty()) {
+                m_written.wakeAll();
+                continue;
+            }
+        }
+
+        results.fill(false, batch.size());
+        writeBatch(batch, &results);
+
+        QMutexLocker locker(&m_mutex);
+        for (int i = 0; i < batch.size(); ++i) {
+            FileState &state = m_files[batch.at(i).file];
+            state.pending--;
+            if (!results.at(i)) {
+                state.failed = true;
+            }
+            m_queuedBytes -= batch.at(i).data.size();
+        }
+        batch.clear();
+        m_written.wakeAll();
     }
+}
 
-    if (m_reply->error() != QNetworkReply::NoError) {
-        QString errorString = m_reply->errorString();
+bool DiskWriter::writeJob(const Job &job)
+{
+    return job.file->seek(job.offset) && job.file->write(job.data) == job.data.size();
+}
 
-        if (m_file) {
-            m_file->close();
-            delete m_file;
-            m_file = nullptr;
-            QFile::remove(m_filePath);
+#ifdef AMCS_HAVE_LIBURING
+namespace
+{
+// 同步补写 io_uring 短写剩余的部分
+bool pwriteAll(int fd, const char *data, qint64 size, qint64 offset)
+{
+    while (size > 0) {
+        const ssize_t written = ::pwrite(fd, data, size_t(size), off_t(offset));
+        if (written < 0 && errno == EINTR) {
+            continue;
         }
+        if (written <= 0) {
+            return false;
+        }
+        data += written;
+        size -= written;
+        offset += written;
+    }
+    return true;
+}
+} // namespace
+#endif
 
-    m_reply->deleteLater();
-        m_reply = nullptr;
+void DiskWriter::writeBatch(const QList<Job> &jobs, QList<bool> *results)
+{
+#ifdef AMCS_HAVE_LIBURING
+    if (m_ring) {
+        // 一次提交整批写入，由内核并行完成，写入线程只等待一次
+        for (int i = 0; i < jobs.size(); ++i) {
+            const Job &job = jobs.at(i);
+            io_uring_sqe *sqe = io_uring_get_sqe(m_ring);
+            io_uring_prep_write(sqe, job.file->handle(), job.data.constData(), unsigned(job.data.size()),
+                                quint64(job.offset));
+            io_uring_sqe_set_data(sqe, reinterpret_cast<void *>(quintptr(i)));
+        }
 
-        emit error(m_index, errorString);
+        const int submitted = io_uring_submit_and_wait(m_ring, jobs.size());
+        const int completed = qMax(0, submitted);
+        for (int done = 0; done < completed; ++done) {
+            io_uring_cqe *cqe = nullptr;
+            if (io_uring_wait_cqe(m_ring, &cqe) < 0) {
+                break;
+            }
+            const int i = int(reinterpret_cast<quintptr>(io_uring_cqe_get_data(cqe)));
+            const int res = cqe->res;
+            io_uring_cqe_seen(m_ring, cqe);
+
+            const Job &job = jobs.at(i);
+            if (res == job.data.size()) {
+                (*results)[i] = true;
+            } else if (res >= 0 || res == -EINTR || res == -EAGAIN) {
+                // 短写或被打断：剩余部分同步补写
+                const qint64 offset = qMax(0, res);
+                (*results)[i] = pwriteAll(job.file->handle(), job.data.constData() + offset,
+                                          job.data.size() - offset, job.offset + offset);
+            }
+        }
+
+        if (completed == jobs.size()) {
+            return;
+        }
+
+        // 提交失败：放弃 io_uring（未提交的请求随之丢弃），其余数据同步写入
+        qWarning() << "DiskWriter: io_uring submission failed, falling back to synchronous writes";
+        io_uring_queue_exit(m_ring);
+        delete m_ring;
+        m_ring = nullptr;
+        m_ioUring.store(false, std::memory_order_relaxed);
+        for (int i = 0; i < jobs.size(); ++i) {
+            if (!results->at(i)) {
+                const Job &job = jobs.at(i);
+                (*results)[i] = pwriteAll(job.file->handle(), job.data.constData(), job.data.size(), job.offset);
+            }
+        }
         return;
     }
+#endif
 
-    // 写入剩余数据
-    if (m_file && m_reply) {
-        QByteArray data = m_reply->readAll();
-        m_file->write(data);
-        m_bytesReceived += data.size();
-        m_file->close();
-        delete m_file;
-        m_file = nullptr;
+    for (int i = 0; i < jobs.size(); ++i) {
+        (*results)[i] = writeJob(jobs.at(i));
     }
+}
 
-    m_reply->deleteLater();
-    m_reply = nullptr;
+// ==================== FileCommitter 实现 ====================
 
-    emit finished(m_index);
+FileCommitter::FileCommitter()
+    : m_stopping(false)
+    , m_thread(nullptr)
+{
+    m_thread = QThread::create([this]() { run(); });
+    m_thread->setObjectName(QStringLiteral("AsulMultiDownloader-FileCommitter"));
+    m_thread->start();
 }
 
-void SegmentDownloader::onError(QNetworkReply::NetworkError errorCode)
+FileCommitter::~FileCommitter()
 {
-    Q_UNUSED(errorCode);
+    {
+        QMutexLocker locker(&m_mutex);
+        m_stopping = true;
+        m_wakeCommitter.wakeAll();
+    }
+    m_thread->wait();
+    delete m_thread;
+}
 
-    if (!m_reply) {
-        return;
+void FileCommitter::commit(const QString &stagingPath, const QString &finalPath, Callback callback)
+{
+    QMutexLocker locker(&m_mutex);
+    m_jobs.append({stagingPath, finalPath, std::move(callback)});
+    m_wakeCommitter.wakeOne();
+}
+
+bool FileCommitter::commitNow(const QString &stagingPath, const QString &finalPath, QString *error)
+{
+    if (!syncFile(stagingPath)) {
+        *error = QString("Failed to sync file: %1").arg(finalPath);
+        return false;
+    }
+    if (!replaceFile(stagingPath, finalPath)) {
+        *error = QString("Failed to rename file: %1").arg(finalPath);
+        return false;
     }
+    syncDirectory(QFileInfo(finalPath).absolutePath());
+    return true;
+}
 
-    QString errorString = m_reply->errorString();
+void FileCommitter::run()
+{
+    QList<Job> batch;
 
-    if (m_file) {
-        m_file->close();
-        delete m_file;
-        m_file = nullptr;
-        QFile::remove(m_filePath);
+    for (;;) {
+        {
+            QMutexLocker locker(&m_mutex);
+            while (m_jobs.isEmpty() && !m_stopping) {
+                m_wakeCommitter.wait(&m_mutex);
+            }
+            if (m_jobs.isEmpty()) {
+                return;  // 正在停止且文件已全部提交
+            }
+            // 稍等片刻，让同时完成的文件并入同一组（正在停止时不再等待）
+            QDeadlineTimer deadline(kCommitWindowMs);
+            while (!m_stopping && m_jobs.size() < kMaxCommitBatch && m_wakeCommitter.wait(&m_mutex, deadline)) {
+            }
+            if (m_jobs.size() <= kMaxCommitBatch) {
+                batch.swap(m_jobs);
+            } else {
+                batch = m_jobs.first(kMaxCommitBatch);
+                m_jobs.remove(0, kMaxCommitBatch);
+            }
+        }
+
+        commitBatch(batch);
+        batch.clear();
     }
+}
 
-    emit error(m_index, errorString);
+void FileCommitter::commitBatch(const QList<Job> &jobs)
+{
+    QStringList errors;
+    errors.resize(jobs.size());
+
+    // 1. 数据落盘，必须先于改名完成，否则断电后可能出现内容不完整的目标文件
+#ifdef Q_OS_LINUX
+    // 只落盘本组的文件：先对一批文件发起回写，让设备并行处理，再逐个 fdatasync 等待完成；
+    // 不使用 syncfs，避免把同一文件系统上其他进程的脏数据也一起刷出
+    for (int first = 0; first < jobs.size(); first += kSyncBatchFiles) {
+        const int last = qMin(int(jobs.size()), first + kSyncBatchFiles);
+        int fds[kSyncBatchFiles];
+        for (int i = first; i < last; ++i) {
+            const int fd = ::open(QFile::encodeName(jobs.at(i).stagingPath).constData(), O_RDONLY | O_CLOEXEC);
+            fds[i - first] = fd;
+            if (fd < 0) {
+                errors[i] = QString("Failed to sync file: %1").arg(jobs.at(i).finalPath);
+            } else {
+                ::sync_file_range(fd, 0, 0, SYNC_FILE_RANGE_WRITE);
+            }
+        }
+        for (int i = first; i < last; ++i) {
+            const int fd = fds[i - first];
+            if (fd < 0) {
+                continue;
+            }
+            if (::fdatasync(fd) != 0) {
+                errors[i] = QString("Failed to sync file: %1").arg(jobs.at(i).finalPath);
+            }
+            ::close(fd);
+        }
+    }
+#else
+    for (int i = 0; i < jobs.size(); ++i) {
+        if (!syncFile(jobs.at(i).stagingPath)) {
+            errors[i] = QString("Failed to sync file: %1").arg(jobs.at(i).finalPath);
+        }
+    }
+#endif
+
+    // 2. 原子改名，然后每个目录只落盘一次
+    QSet<QString> directories;
+    for (int i = 0; i < jobs.size(); ++i) {
+        if (!errors.at(i).isEmpty()) {
+            continue;
+        }
+        if (replaceFile(jobs.at(i).stagingPath, jobs.at(i).finalPath)) {
+            directories.insert(QFileInfo(jobs.at(i).finalPath).absolutePath());
+        } else {
+            errors[i] = QString("Failed to rename file: %1").arg(jobs.at(i).finalPath);
+        }
+    }
+    for (const QString &dirPath : std::as_const(directories)) {
+        syncDirectory(dirPath);
+    }
+
+    for (int i = 0; i < jobs.size(); ++i) {
+        jobs.at(i).callback(errors.at(i).isEmpty(), errors.at(i));
+    }
 }
 
 // ==================== PCL优化：监控和动态调度实现 ====================
@@ -1304,6 +5332,12 @@ void AsulMultiDownloader::onMonitorDownloads()
 {
     QMutexLocker locker(&m_mutex);
 
+    // === 自适应并发调整 ===
+    if (m_adaptiveConcurrency) {
+        adjustHostConcurrency();
+        processQueue();
+    }
+
     if (!m_speedMonitoringEnabled) {
         return;
     }
@@ -1313,50 +5347,63 @@ void AsulMultiDownloader::onMonitorDownloads()
     const qint64 stallTimeoutMs = 15000;  // 15秒无进度即判定为卡住
     qint64 now = QDateTime::currentMSecsSinceEpoch();
     QStringList stalledTasks;
-    for (auto it = m_taskStatus.begin(); it != m_taskStatus.end(); ++it) {
-        if (it.value() == DownloadStatus::Downloading) {
-            const QString &taskId = it.key();
-            qint64 lastActive = m_taskLastProgress.value(taskId, 0);
-            if (lastActive == 0) {
-                // 首次记录
-                m_taskLastProgress[taskId] = now;
-            } else if (now - lastActive > stallTimeoutMs) {
-                stalledTasks.append(taskId);
+    {
+        // 只遍历运行中的任务（m_taskLastProgress 在启动时加入、结束时移除）
+        QMutexLocker progressLocker(&m_progressMutex);
+        for (auto it = m_taskLastProgress.begin(); it != m_taskLastProgress.end();) {
+            auto recordIt = m_records.constFind(handleForTaskId(it.key()));
+            if (recordIt == m_records.constEnd() || recordIt->status != DownloadStatus::Downloading) {
+                // 任务结束后才到达的进度留下的记录
+                it = m_taskLastProgress.erase(it);
+                continue;
             }
+            if (now - it.value() > stallTimeoutMs) {
+                stalledTasks.append(it.key());
+            }
+            ++it;
         }
     }
 
     for (const QString &taskId : stalledTasks) {
-        if (!m_tasks.contains(taskId)) continue;
-        auto task = m_tasks[taskId];
+        const quint64 handle = handleForTaskId(taskId);
+        auto recordIt = m_records.find(handle);
+        if (recordIt == m_records.end() || !recordIt->task) continue;
+        TaskRecord &record = recordIt.value();
 
         qDebug() << QString("[STALL] Task %1 stalled for >%2s, forcing retry: %3")
-                    .arg(taskId).arg(stallTimeoutMs / 1000).arg(task->url().toString());
-
-        // 强制取消当前网络请求并重置状态以允许重试
-        task->cancel();
-        task->m_isCanceled = false;
-        task->m_isPaused = false;
-
-        updateHostConnections(task->url().host(), -1);
+                    .arg(taskId).arg(stallTimeoutMs / 1000).arg(record.url.toString());
+
+        // 中断当前网络请求（保留断点）以允许重试
+        runOnTaskThread(record.task, [](DownloadTask *task) {
+            task->interrupt();
+            task->releaseLiveBytes();
+        });
+
+        updateHostConnections(record, -1);
+        updatePriorityConnections(record.priority, -1);
+        recordHostResult(record.url.host(), 0, false);
+        recordMirrorResult(record.task->servedUrl().host(), false);
         m_activeDownloads--;
-        m_taskLastProgress.remove(taskId);
-
-        // 重试或标记失败
-        if (m_taskRetryCount[taskId] < m_maxRetryCount) {
-            m_taskRetryCount[taskId]++;
-            m_taskStatus[taskId] = DownloadStatus::Queued;
-            m_taskQueue.enqueue(taskId);
-        } else {
-            m_taskStatus[taskId] = DownloadStatus::Failed;
+        forgetTaskProgress(taskId);
+        m_taskStartTime.remove(handle);
+        retireTask(record);
+
+        // 切换镜像、退避重试或标记失败
+        DownloadFailure failure;
+        failure.networkError = QNetworkReply::TimeoutError;
+        if (!scheduleRetry(handle, record, failure)) {
+            const QString error = QString("Task stalled: no progress for %1 seconds").arg(stallTimeoutMs / 1000);
+            record.status = DownloadStatus::Failed;
             m_statistics.failedTasks++;
-            emit downloadFailed(taskId, QString("Task stalled: no progress for %1 seconds").arg(stallTimeoutMs / 1000));
+            record.sink.reset();
+            settleTask(handle, record, false, error);
+            emit downloadFailed(taskId, error);
             checkAndEmitAllFinished();
         }
     }
 
     // 尝试处理队列中的任务
-    if (m_activeDownloads < m_maxConcurrentDownloads && !m_taskQueue.isEmpty()) {
+    if (m_activeDownloads < m_maxConcurrentDownloads && m_queuedCount > 0) {
         processQueue();
     }
 }
@@ -1409,34 +5456,154 @@ bool AsulMultiDownloader::shouldDisableMultiThread(const QUrl &url) const
 QNetworkAccessManager* AsulMultiDownloader::getNetworkManager()
 {
     // Fix: Remove mutex lock to avoid recursive locking deadlock
-    // m_networkManagers is read-only after constructor, so this is safe
+    // m_networkManagers 和各工作线程的管理器池在任务启动前创建，之后只读
+
+    // 网络管理器只能在其所在线程中使用：工作线程中的调用使用该线程自己的池
+    const QList<QNetworkAccessManager*> *pool = &m_networkManagers;
+    QThread *current = QThread::currentThread();
+    for (const NetworkShard &shard : m_shards) {
+        if (shard.thread == current) {
+            pool = &shard.managers;
+            break;
+        }
+    }
 
-    if (m_networkManagers.isEmpty()) {
+    if (pool->isEmpty()) {
         return nullptr;
     }
 
     // 使用thread-safe的轮询分配
     // 原子计数器确保线程安全，modulo防止溢出
     static std::atomic<int> index{0};
-    int currentIndex = index.fetch_add(1) % m_networkManagers.size();
+    int currentIndex = index.fetch_add(1) % pool->size();
 
-    return m_networkManagers[currentIndex];
+    return pool->at(currentIndex);
 }
 
-void AsulMultiDownloader::checkAndEmitAllFinished()
+QNetworkAccessManager* AsulMultiDownloader::getHttp2NetworkManager(int shard)
+{
+    // 注意：调用此方法时应已持有锁（池只在持锁的配置接口中增长）
+    // Qt 对同一Host的HTTP/2请求在每个管理器内只使用一条连接，轮询即把流分摊到各连接；
+    // 工作线程之间不能共享连接，每个线程分得配置连接数中的一份（至少一条）
+    const QList<QNetworkAccessManager*> &pool = shard < 0 ? m_http2NetworkManagers
+                                                           : m_shards.at(shard).http2Managers;
+    const int perShard = shard < 0 ? m_http2ConnectionsPerHost
+                                   : (m_http2ConnectionsPerHost + int(m_shards.size()) - 1) / int(m_shards.size());
+    const int count = qMin(perShard, int(pool.size()));
+    if (count <= 0) {
+        return nullptr;
+    }
+
+    static std::atomic<int> index{0};
+    return pool.at(index.fetch_add(1) % count);
+}
+
+void AsulMultiDownloader::warmConnection(QNetworkAccessManager *manager, const QUrl &origin, bool http2)
+{
+    QMetaObject::invokeMethod(manager, [manager, origin, http2]() {
+        const bool encrypted = origin.scheme() == QLatin1String("https");
+        const quint16 port = quint16(origin.port(encrypted ? 443 : 80));
+#if QT_CONFIG(ssl)
+        if (encrypted) {
+            // ALPN 决定连接能否用于HTTP/2请求：普通管理器上的请求都禁用了HTTP/2，预热连接也一样
+            QSslConfiguration config = NetworkService::getInstance()->sslConfiguration(origin);
+            if (http2) {
+                config.setAllowedNextProtocols({QSslConfiguration::ALPNProtocolHTTP2,
+                                                QSslConfiguration::NextProtocolHttp1_1});
+            } else {
+                config.setAllowedNextProtocols({QSslConfiguration::NextProtocolHttp1_1});
+            }
+            manager->connectToHostEncrypted(origin.host(), port, config);
+            return;
+        }
+#else
+        Q_UNUSED(http2);
+#endif
+        manager->connectToHost(origin.host(), port);
+    }, Qt::QueuedConnection);
+}
+
+void AsulMultiDownloader::ensureHttp2NetworkManagers()
+{
+    if (m_shards.isEmpty()) {
+        while (m_http2NetworkManagers.size() < m_http2ConnectionsPerHost) {
+            m_http2NetworkManagers.append(NetworkService::getInstance()->createManager(this));
+        }
+        return;
+    }
+
+    const int perShard = (m_http2ConnectionsPerHost + int(m_shards.size()) - 1) / int(m_shards.size());
+    for (NetworkShard &shard : m_shards) {
+        while (shard.http2Managers.size() < perShard) {
+            auto *manager = NetworkService::getInstance()->createManager();
+            manager->moveToThread(shard.thread);
+            shard.http2Managers.append(manager);
+        }
+    }
+}
+
+bool AsulMultiDownloader::http2For(const DownloadTransport &transport) const
+{
+    return transport.http2.value_or(m_http2Enabled);
+}
+
+void AsulMultiDownloader::ensureNetworkShards()
 {
     // 注意：调用此方法时应已持有锁
+    if (m_shardsStarted) {
+        return;
+    }
+    m_shardsStarted = true;
 
-    // 检查是否所有任务都完成了（包括成功和失败的任务）
-    bool allFinished = true;
-    for (auto status : m_taskStatus) {
-        if (status == DownloadStatus::Queued || status == DownloadStatus::Downloading) {
-            allFinished = false;
-            break;
+    if (m_workerThreadCount <= 0) {
+        return;
+    }
+
+    // 每个工作线程拥有自己的网络管理器（Qt 对每个管理器的每个Host限制HTTP/1.1连接数，因此仍需多个）
+    const int managersPerShard = qMax(kMinManagersPerShard, m_networkManagerPoolSize / m_workerThreadCount);
+    for (int i = 0; i < m_workerThreadCount; ++i) {
+        NetworkShard shard;
+        shard.thread = new QThread(this);
+        shard.thread->setObjectName(QStringLiteral("AsulMultiDownloader-Worker-%1").arg(i));
+        for (int j = 0; j < managersPerShard; ++j) {
+            auto *manager = NetworkService::getInstance()->createManager();
+            manager->moveToThread(shard.thread);
+            shard.managers.append(manager);
         }
+        shard.thread->start();
+        m_shards.append(shard);
+    }
+
+    if (m_http2Enabled) {
+        ensureHttp2NetworkManagers();
+    }
+
+    qInfo() << "AsulMultiDownloader: using" << m_workerThreadCount << "worker threads,"
+            << (m_diskWriter->usesIoUring() ? "io_uring" : "synchronous") << "disk writes";
+}
+
+void AsulMultiDownloader::stopNetworkShards()
+{
+    for (const NetworkShard &shard : std::as_const(m_shards)) {
+        // 经事件循环发出退出请求，保证此前排队的中断/取消先执行；
+        // 线程结束时删除其中等待删除的任务对象
+        QThread *thread = shard.thread;
+        QMetaObject::invokeMethod(shard.managers.first(), [thread]() { thread->quit(); }, Qt::QueuedConnection);
+        thread->wait();
+        qDeleteAll(shard.http2Managers);
+        qDeleteAll(shard.managers);
     }
+    m_shards.clear();
+}
+
+void AsulMultiDownloader::checkAndEmitAllFinished()
+{
+    // 注意：调用此方法时应已持有锁
 
-    if (allFinished && m_taskQueue.isEmpty() && !m_allFinishedEmitted) {
+    // 检查是否所有任务都完成了（包括成功和失败的任务）：没有运行中和排队中的任务
+    const bool allFinished = m_activeDownloads == 0;
+
+    if (allFinished && m_queuedCount == 0 && m_delayedRetries.isEmpty() && !m_allFinishedEmitted) {
         m_allFinishedEmitted = true;
 
         // Stop timers to allow event loop to exit
@@ -1446,6 +5613,9 @@ void AsulMultiDownloader::checkAndEmitAllFinished()
         if (m_monitorTimer) {
             m_monitorTimer->stop();
         }
+        if (m_progressTimer) {
+            m_progressTimer->stop();
+        }
 
         emit allDownloadsFinished();
     }
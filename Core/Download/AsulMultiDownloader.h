@@ -6,20 +6,39 @@
 #include <QNetworkRequest>
 #include <QNetworkReply>
 #include <QFile>
+#include <QLockFile>
 #include <QQueue>
 #include <QHash>
+#include <QSet>
+#include <QMap>
 #include <QMutex>
+#include <QWaitCondition>
 #include <QThread>
 #include <QThreadPool>
 #include <QRunnable>
 #include <QUrl>
 #include <QTimer>
 #include <QDateTime>
+#include <QElapsedTimer>
+#include <QCryptographicHash>
+#include <QPair>
+#include <QPointer>
+#include <QFuture>
+#include <QPromise>
+#include <atomic>
+#include <functional>
 #include <memory>
+#include <optional>
 
 // 前向声明
 class DownloadTask;
 class SegmentDownloader;
+class BandwidthLimiter;
+class DiskWriter;
+class FileCommitter;
+class DownloadBatch;
+class DownloadSink;
+struct io_uring;
 
 /**
  * @brief 下载任务信息结构
@@ -70,10 +89,112 @@ struct DownloadStatistics {
           totalDownloaded(0), completedTasks(0), failedTasks(0) {}
 };
 
+/**
+ * @brief 单个任务的进度快照（批量进度信号使用）
+ */
+struct DownloadProgressSnapshot {
+    QString taskId;              // 任务ID
+    qint64 bytesReceived;        // 已接收字节数
+    qint64 bytesTotal;           // 总字节数（-1表示未知）
+};
+
+/**
+ * @brief 单个请求的传输设置（未设置的项沿用下载器的全局配置）
+ *
+ * 共享下载器的各调用方按请求指定，不影响其他调用方在途的下载
+ */
+struct DownloadTransport {
+    std::optional<bool> http2;           // 小文件是否使用HTTP/2多路复用（参见 setHttp2Enabled）
+    qint64 largeFileThreshold = -1;      // 分段下载阈值（-1表示沿用 setLargeFileThreshold）
+    int segmentCount = 0;                // 大文件分段数（0表示沿用 setSegmentCountForLargeFile）
+};
+
+/**
+ * @brief 批量添加时的单个下载描述
+ */
+struct DownloadRequest {
+    QList<QUrl> mirrors;         // 候选URL（按偏好排序，不能为空）
+    QString savePath;            // 保存路径
+    qint64 size = -1;            // 已知文件大小（-1表示未知）
+    QString sha1;                // 期望的SHA-1（十六进制，为空表示不校验）
+    int priority = 0;            // 优先级，同时作为流量类别（参见 setPriorityRateLimit）
+    std::shared_ptr<DownloadSink> sink;  // 数据接收器（为空表示只写入文件；savePath为空时只写入接收器）
+    DownloadTransport transport;         // 传输设置（合并到在途任务时沿用该任务的设置）
+
+    DownloadRequest() = default;
+    DownloadRequest(const QList<QUrl> &mirrors, const QString &savePath, qint64 size = -1,
+                    const QString &sha1 = QString(), int priority = 0)
+        : mirrors(mirrors), savePath(savePath), size(size), sha1(sha1), priority(priority) {}
+};
+
+/**
+ * @brief 单个任务的最终结果（QFuture 接口使用）
+ */
+struct DownloadResult {
+    QString taskId;              // 任务ID（请求无效时为空）
+    QString savePath;            // 保存路径
+    bool success = false;        // 是否成功
+    QString errorString;         // 失败原因（成功时为空；取消时为 "Download canceled"）
+    qint64 fileSize = -1;        // 文件大小（-1表示未知）
+};
+
+/**
+ * @brief 失败类型（决定是否重试以及如何退避）
+ */
+enum class DownloadFailureKind {
+    Permanent,       // 永久错误（如404、403），重试无意义
+    Transient,       // 临时错误（如超时、连接重置、5xx），指数退避后重试
+    Throttled        // 服务端限流（429、503或带Retry-After），按服务端要求等待并放慢该Host
+};
+
+/**
+ * @brief 一次失败的详细信息
+ */
+struct DownloadFailure {
+    QNetworkReply::NetworkError networkError = QNetworkReply::NoError;  // 网络错误（非网络原因的失败为NoError）
+    int httpStatus = 0;                  // HTTP状态码（0表示没有响应）
+    qint64 retryAfterMs = -1;            // 服务端Retry-After（毫秒，-1表示未提供）
+
+    static DownloadFailure fromReply(QNetworkReply *reply);
+    static qint64 parseRetryAfter(const QByteArray &value);  // 支持秒数和HTTP日期两种格式，无效时返回-1
+};
+
+/**
+ * @brief 重试策略
+ *
+ * 默认实现：4xx（408、425、429除外）和"内容不存在/拒绝访问"等错误视为永久错误；
+ * 429、503或带Retry-After的响应视为限流；其余视为临时错误。
+ * 退避时间按重试次数指数增长并带随机抖动，限流时不短于Retry-After。
+ * 可继承后通过 AsulMultiDownloader::setRetryPolicy 替换，方法可能在任意线程调用
+ */
+class DownloadRetryPolicy
+{
+public:
+    virtual ~DownloadRetryPolicy() = default;
+
+    /**
+     * @brief 对失败进行分类
+     * @param failure 失败信息
+     * @return 失败类型
+     */
+    virtual DownloadFailureKind classify(const DownloadFailure &failure) const;
+
+    /**
+     * @brief 计算重试前的等待时间
+     * @param failure 失败信息
+     * @param kind classify 的结果
+     * @param attempt 即将进行的第几次重试（从1开始）
+     * @return 等待时间（毫秒）
+     */
+    virtual qint64 retryDelay(const DownloadFailure &failure, DownloadFailureKind kind, int attempt) const;
+};
+
 /**
  * @brief AsulMultiDownloader - 高性能多线程下载管理器
  *
  * 支持大文件分段下载、小文件并发下载，智能线程调度
+ * 下载期间数据写入同目录下每次尝试各自的临时文件，校验通过后原子改名为保存路径，
+ * 保存路径上出现的文件总是完整的（进程崩溃或断电后也不会留下半个文件）
  * 面向Qt 6.7.3标准开发
  */
 class AsulMultiDownloader : public QObject
@@ -225,19 +346,312 @@ public:
      */
     QStringList noMultiThreadHosts() const;
 
+    /**
+     * @brief 设置分段下载是否直接写入目标文件
+     *
+     * 启用时按已知大小预分配临时文件，各分段在各自偏移处定位写入，完成后无需合并；
+     * 禁用时沿用每段写入 .partN 临时文件、最后合并的方式
+     * @param enable 是否启用（默认true）
+     */
+    void setDirectSegmentWriteEnabled(bool enable);
+
+    /**
+     * @brief 获取分段下载是否直接写入目标文件
+     * @return 当前设置
+     */
+    bool directSegmentWriteEnabled() const;
+
+    /**
+     * @brief 设置是否启用动态分段（仅直写模式）
+     *
+     * 某个分段完成时，把剩余最多的分段后半段交给新连接；某个分段速度远低于其他分段时，
+     * 对其剩余区间发起对冲请求，先完成的一方生效
+     * @param enable 是否启用（默认true）
+     */
+    void setAdaptiveSegmentsEnabled(bool enable);
+
+    /**
+     * @brief 获取是否启用动态分段
+     * @return 当前设置
+     */
+    bool adaptiveSegmentsEnabled() const;
+
+    /**
+     * @brief 设置是否用带Range的GET代替HEAD探测大文件和未知大小的文件
+     *
+     * 启用时直接发送 GET + "Range: bytes=0-"，由响应的状态码、Content-Range 和 Content-Length
+     * 判断文件大小与是否支持Range：需要分段时该响应直接作为第0段继续接收，否则作为单线程下载继续，
+     * 每个文件省去一次HEAD往返（及其重定向）；禁用时沿用先HEAD再下载的方式
+     * @param enable 是否启用（默认true）
+     */
+    void setRangedProbeEnabled(bool enable);
+
+    /**
+     * @brief 获取是否用带Range的GET代替HEAD探测
+     * @return 当前设置
+     */
+    bool rangedProbeEnabled() const;
+
+    /**
+     * @brief 设置是否启用HTTP/2多路复用传输（小文件）
+     *
+     * 启用后，不超过大文件阈值且大小已知的文件通过少量HTTP/2连接多路复用下载，
+     * 每个Host的在途HTTP/2请求数受"连接数 × 每连接流数"限制；大文件分段下载仍使用HTTP/1.1。
+     * 这是请求未指定 DownloadTransport::http2 时的默认值
+     * @param enable 是否启用（默认false）
+     */
+    void setHttp2Enabled(bool enable);
+
+    /**
+     * @brief 获取是否启用HTTP/2多路复用传输
+     * @return 当前设置
+     */
+    bool http2Enabled() const;
+
+    /**
+     * @brief 设置HTTP/2模式下每个Host使用的连接数
+     * @param count 连接数（默认2）
+     */
+    void setHttp2ConnectionsPerHost(int count);
+
+    /**
+     * @brief 获取HTTP/2模式下每个Host使用的连接数
+     * @return 当前连接数
+     */
+    int http2ConnectionsPerHost() const;
+
+    /**
+     * @brief 设置HTTP/2模式下每个连接的最大并发流数
+     * @param count 流数（默认100）
+     */
+    void setHttp2MaxStreamsPerConnection(int count);
+
+    /**
+     * @brief 获取HTTP/2模式下每个连接的最大并发流数
+     * @return 当前流数
+     */
+    int http2MaxStreamsPerConnection() const;
+
+    /**
+     * @brief 设置是否启用自适应的每Host并发控制
+     *
+     * 每秒按各Host的有效吞吐和失败/超时情况调整其在途任务上限：
+     * 无错误时先指数增长（慢启动），之后加性增长；出现错误时乘性减半。
+     * 上限不会超过 setMaxConnectionsPerHost 设置的值
+     * @param enable 是否启用（默认true）
+     */
+    void setAdaptiveConcurrencyEnabled(bool enable);
+
+    /**
+     * @brief 获取是否启用自适应的每Host并发控制
+     * @return 当前设置
+     */
+    bool adaptiveConcurrencyEnabled() const;
+
+    /**
+     * @brief 获取某个Host当前允许的在途任务数
+     * @param host 域名
+     * @return 在途任务上限
+     */
+    int hostConcurrencyLimit(const QString &host) const;
+
+    /**
+     * @brief 设置是否对多镜像任务发起对冲请求
+     *
+     * 任务启动后若在对冲延迟内仍未收到首字节，则向另一个健康的镜像再发一次请求，
+     * 先返回数据的一方胜出，另一方被取消。仅作用于单连接下载
+     * @param enable 是否启用（默认false）
+     */
+    void setMirrorHedgingEnabled(bool enable);
+
+    /**
+     * @brief 获取是否启用多镜像对冲请求
+     * @return 当前设置
+     */
+    bool mirrorHedgingEnabled() const;
+
+    /**
+     * @brief 设置对冲请求的最小延迟
+     *
+     * 实际延迟取该值与当前镜像平均首字节延迟3倍中的较大者
+     * @param msecs 毫秒（默认2000）
+     */
+    void setMirrorHedgeDelay(int msecs);
+
+    /**
+     * @brief 获取对冲请求的最小延迟
+     * @return 毫秒
+     */
+    int mirrorHedgeDelay() const;
+
+    /**
+     * @brief 设置进度上报间隔
+     *
+     * 各任务的进度先在内部合并，每个间隔只为有变化的任务发射一次 downloadProgress，
+     * 并附带一次 downloadProgressBatch
+     * @param msecs 毫秒（默认100，最小10）
+     */
+    void setProgressInterval(int msecs);
+
+    /**
+     * @brief 获取进度上报间隔
+     * @return 毫秒
+     */
+    int progressInterval() const;
+
+    /**
+     * @brief 设置全局下载限速
+     *
+     * 通过按令牌读取网络数据实现：令牌不足时暂不读取，接收缓冲区填满后由TCP流控让服务端放慢发送，
+     * 不阻塞任何线程。全局、每Host、每优先级的限速同时生效，可在下载过程中随时调整。
+     * 限速生效时同时按速率收紧在途任务数，保证每个在途任务都能持续收到数据
+     * @param bytesPerSecond 字节/秒（0表示不限速，默认0）
+     */
+    void setGlobalRateLimit(qint64 bytesPerSecond);
+
+    /**
+     * @brief 获取全局下载限速
+     * @return 字节/秒（0表示不限速）
+     */
+    qint64 globalRateLimit() const;
+
+    /**
+     * @brief 设置某个Host的下载限速
+     * @param host 域名
+     * @param bytesPerSecond 字节/秒（0表示不限速）
+     */
+    void setHostRateLimit(const QString &host, qint64 bytesPerSecond);
+
+    /**
+     * @brief 获取某个Host的下载限速
+     * @param host 域名
+     * @return 字节/秒（0表示不限速）
+     */
+    qint64 hostRateLimit(const QString &host) const;
+
+    /**
+     * @brief 设置某个优先级的下载限速
+     *
+     * 作用于以该优先级添加的所有任务，例如为后台预取、修复使用单独的低优先级并限速，
+     * 前台任务不受影响
+     * @param priority 任务优先级
+     * @param bytesPerSecond 字节/秒（0表示不限速）
+     */
+    void setPriorityRateLimit(int priority, qint64 bytesPerSecond);
+
+    /**
+     * @brief 获取某个优先级的下载限速
+     * @param priority 任务优先级
+     * @return 字节/秒（0表示不限速）
+     */
+    qint64 priorityRateLimit(int priority) const;
+
+    /**
+     * @brief 设置重试策略
+     *
+     * 任务失败时先按策略分类：永久错误只尝试切换镜像、不再重试；临时错误按退避时间延迟后重新排队；
+     * 限流时该Host在等待期内不再启动新任务
+     * @param policy 策略对象（为空时恢复默认策略）
+     */
+    void setRetryPolicy(std::shared_ptr<DownloadRetryPolicy> policy);
+
+    /**
+     * @brief 获取当前重试策略
+     * @return 策略对象
+     */
+    std::shared_ptr<DownloadRetryPolicy> retryPolicy() const;
+
+    /**
+     * @brief 设置网络工作线程数
+     *
+     * 任务按句柄固定分配到各工作线程，网络请求、数据接收和摘要计算都在工作线程中进行，
+     * 收到的数据交给独立的磁盘写入线程落盘（Linux 上可用时使用 io_uring）；
+     * 下载器所在线程只处理合并后的进度和任务结果。只能在第一个任务启动前设置
+     * @param count 线程数（0表示全部在下载器所在线程中运行，默认为CPU核心数的一半，1~4）
+     */
+    void setWorkerThreadCount(int count);
+
+    /**
+     * @brief 获取网络工作线程数
+     * @return 线程数
+     */
+    int workerThreadCount() const;
+
+    /**
+     * @brief 设置是否合并重复的下载请求
+     *
+     * 启用时，保存路径（规范化后）与某个未结束的任务相同、且摘要一致的新请求不再单独下载，
+     * 而是挂到该任务上：返回同一个任务ID，结果同时通知所有相关的批次。
+     * 带数据接收器的请求需要完整的数据流，不挂到现有任务上，而是排在其后：
+     * 现有任务成功提交文件后从磁盘回放给接收器，失败时再自行下载，同一文件始终只有一个写入方
+     * @param enable 是否启用（默认true）
+     */
+    void setRequestCoalescingEnabled(bool enable);
+
+    /**
+     * @brief 获取是否合并重复的下载请求
+     * @return 当前设置
+     */
+    bool requestCoalescingEnabled() const;
+
+    /**
+     * @brief 设置预热时每个Host预先建立的连接数（参见 prewarm）
+     *
+     * 连接分摊到任务轮询使用的各网络管理器上
+     * @param count 连接数（默认4，0表示只预解析域名）
+     */
+    void setPrewarmConnectionsPerHost(int count);
+
+    /**
+     * @brief 获取预热时每个Host预先建立的连接数
+     * @return 当前设置
+     */
+    int prewarmConnectionsPerHost() const;
+
     // ==================== 下载控制接口 ====================
 
+    /**
+     * @brief 按下载计划预热域名解析和连接
+     *
+     * 并行解析所有候选镜像的域名（结果进入Qt进程级的DNS缓存），并向每个请求当前会选择的
+     * 镜像预先建立 TCP/TLS 连接，首批请求无需再等待解析和握手。
+     * 只发起连接、不等待完成；应在计划确定后、提交之前尽早调用
+     * @param requests 下载计划（只使用 mirrors）
+     */
+    void prewarm(const QList<DownloadRequest> &requests);
+
     /**
      * @brief 添加下载任务
      * @param url 下载URL
      * @param savePath 保存路径
-     * @param priority 优先级（默认0）
+     * @param priority 优先级（默认0，数值越大越先调度）
+     * @param knownFileSize 已知文件大小（-1表示未知）
+     * @param expectedSha1 期望的SHA-1（十六进制，为空表示不校验）；边下载边计算，不一致时任务失败并按重试策略处理
      * @return 任务ID
      */
-    QString addDownload(const QUrl &url, const QString &savePath, int priority = 0, qint64 knownFileSize = -1);
+    QString addDownload(const QUrl &url, const QString &savePath, int priority = 0, qint64 knownFileSize = -1,
+                        const QString &expectedSha1 = QString());
+
+    /**
+     * @brief 添加带多个候选镜像的下载任务
+     *
+     * 候选URL按偏好排序（例如官方源、BMCLAPI、自定义源）。每次启动时根据各镜像的
+     * 成功率和首字节延迟选择最合适的一个；失败或卡住时自动切换到其他镜像，
+     * 每个镜像至少获得一次尝试机会（不占用重试次数）
+     * @param mirrors 候选URL列表（不能为空）
+     * @param savePath 保存路径
+     * @param priority 优先级（默认0，数值越大越先调度）
+     * @param knownFileSize 已知文件大小（-1表示未知）
+     * @param expectedSha1 期望的SHA-1（十六进制，为空表示不校验）
+     * @return 任务ID（mirrors为空时返回空字符串）
+     */
+    QString addDownload(const QList<QUrl> &mirrors, const QString &savePath, int priority = 0,
+                        qint64 knownFileSize = -1, const QString &expectedSha1 = QString());
 
     /**
      * @brief 批量添加下载任务
+     *
+     * 一次加锁完成入队，只发射一次 downloadsAdded（不逐个发射 downloadAdded）
      * @param urls URL列表
      * @param savePaths 保存路径列表
      * @param priority 优先级（默认0）
@@ -245,6 +659,37 @@ public:
      */
     QStringList addDownloads(const QList<QUrl> &urls, const QStringList &savePaths, int priority = 0);
 
+    /**
+     * @brief 批量添加带完整描述的下载任务，并返回批次句柄
+     *
+     * 一次加锁完成入队，只发射一次 downloadsAdded。批次句柄汇总本批任务的进度、
+     * 完成和失败，所有任务结束后发射 DownloadBatch::finished。
+     * mirrors 为空的描述会被跳过；与未结束任务重复的描述合并到该任务（参见 setRequestCoalescingEnabled）
+     * @param requests 下载描述列表
+     * @return 批次句柄（父对象为下载器，可由调用方提前删除）
+     */
+    DownloadBatch *addBatch(const QList<DownloadRequest> &requests);
+
+    /**
+     * @brief 添加下载任务，返回其结果的 QFuture
+     *
+     * 任务进入终态（完成、最终失败或取消）时由下载器直接填入结果，不经过调用方的事件循环；
+     * 可用 QFuture::then(QThreadPool*, ...) 在线程池中继续处理（解析、解压、计算摘要），
+     * 不必等待其他任务结束。下载器析构时仍未完成的 QFuture 被取消
+     * @param request 下载描述（mirrors 为空时直接返回失败结果）
+     * @return 只包含一个结果的 QFuture
+     */
+    QFuture<DownloadResult> addDownloadAsync(const DownloadRequest &request);
+
+    /**
+     * @brief 批量添加下载任务，每个描述对应一个 QFuture
+     *
+     * 一次加锁完成入队，只发射一次 downloadsAdded；各任务的结果互不等待（参见 addDownloadAsync）
+     * @param requests 下载描述列表
+     * @return 与 requests 顺序相同的 QFuture 列表
+     */
+    QList<QFuture<DownloadResult>> addDownloadsAsync(const QList<DownloadRequest> &requests);
+
     /**
      * @brief 暂停下载任务
      * @param taskId 任务ID
@@ -335,6 +780,12 @@ signals:
      */
     void downloadAdded(const QString &taskId, const QUrl &url);
 
+    /**
+     * @brief 批量添加信号
+     * @param taskIds 本次添加的任务ID列表
+     */
+    void downloadsAdded(const QStringList &taskIds);
+
     /**
      * @brief 任务开始信号
      * @param taskId 任务ID
@@ -349,6 +800,14 @@ signals:
      */
     void downloadProgress(const QString &taskId, qint64 bytesReceived, qint64 bytesTotal);
 
+    /**
+     * @brief 批量下载进度信号
+     *
+     * 每个进度上报间隔发射一次，包含该间隔内有进度变化的所有任务的最新快照
+     * @param snapshots 进度快照列表
+     */
+    void downloadProgressBatch(const QList<DownloadProgressSnapshot> &snapshots);
+
     /**
      * @brief 任务速度更新信号
      * @param taskId 任务ID
@@ -414,23 +873,115 @@ private slots:
     void onTaskProgress(const QString &taskId, qint64 received, qint64 total);
     void onUpdateStatistics();
     void onMonitorDownloads();  // 新增：监控线程，参考PCL
+    void onFlushProgress();     // 按间隔发射合并后的进度
+    void onRetryTimer();        // 退避到期的任务重新排队、解除到期的Host限流
 
     // Allow DownloadTask to access private methods
     friend class DownloadTask;
     friend class SegmentDownloader;
 
 private:
+    /**
+     * @brief 任务记录
+     *
+     * 排队中的任务只保存这份紧凑记录；DownloadTask 对象（及其网络请求、信号连接）
+     * 仅在任务运行期间存在，结束、暂停或等待重试时销毁，相关状态回写到记录中
+     */
+    struct TaskRecord {
+        QString taskId;                      // 对外任务ID
+        QUrl url;                            // 当前选用的URL
+        QList<QUrl> mirrors;                 // 候选URL（仅一个时与url相同）
+        QString savePath;
+        QString expectedSha1;
+        QString errorString;                 // 最近一次失败原因
+        qint64 fileSize = -1;                // 已知或探测到的文件大小
+        qint64 downloadedSize = 0;           // 任务对象销毁时的已下载字节数
+        int priority = 0;
+        DownloadStatus status = DownloadStatus::Queued;
+        quint16 retryCount = 0;
+        quint16 mirrorSwitches = 0;          // 已进行的镜像切换次数
+        quint32 batchId = 0;                 // 所属批次（0表示不属于任何批次；合并进来的其他批次见 m_attachedBatches）
+        qint64 batchReported = 0;            // 已计入批次进度的字节数
+        quint16 attachCount = 0;             // 合并到该任务的其他请求数（其中一方取消时只解除关联）
+        quint64 waitingFor = 0;              // 排在同一保存路径的在途任务之后（带接收器的重复请求），该任务结束前不启动
+        bool replayLocal = false;            // 前一个任务已提交该文件：从磁盘回放给接收器，不再下载
+        bool http2Stream = false;            // 在途时占用该Host的一个HTTP/2流名额
+        DownloadTransport transport;         // 请求指定的传输设置
+        std::shared_ptr<DownloadSink> sink;  // 数据接收器（可能为空）
+        std::shared_ptr<DownloadTask> task;  // 运行中的任务对象（未运行时为空）
+    };
+
+    /**
+     * @brief 批次的未结束任务数（句柄本身可能已被调用方删除）
+     */
+    struct BatchEntry {
+        QPointer<DownloadBatch> batch;
+        int pending = 0;
+        std::shared_ptr<QPromise<DownloadResult>> promise;  // 按完成顺序给出各任务结果
+    };
+
     // 内部方法
+    QStringList enqueueRequests(const QList<DownloadRequest> &requests, quint32 batchId,
+                                qint64 *plannedBytes = nullptr);  // 调用时应已持有锁
+    void settleBatchTask(TaskRecord &record, bool success, const QString &error);       // 任务进入终态时通知批次（调用时应已持有锁）
+    void notifyBatch(quint32 batchId, const TaskRecord &record, bool success, const QString &error,
+                     qint64 bytesDelta);                                                // 通知单个批次（调用时应已持有锁）
+    void settleTask(quint64 handle, TaskRecord &record, bool success, const QString &error);  // 任务进入终态：释放合并路径，通知批次和 QFuture（调用时应已持有锁）
+    static DownloadResult resultFor(const TaskRecord &record, bool success, const QString &error);
+    void cancelRecord(quint64 handle, TaskRecord &record);                              // 取消任务（调用时应已持有锁）
+    void cancelBatch(quint32 batchId, const QStringList &taskIds);                      // 取消批次：与其他请求共享的任务只解除关联
+
+    // 请求合并（调用时应已持有锁）
+    static QString coalescingKey(const QString &savePath);                              // 规范化的保存路径
+    bool attachRequest(quint64 handle, const DownloadRequest &request, quint32 batchId,
+                       bool *alreadyMember);                                            // 返回false表示不能合并
+    void releaseInflightPath(quint64 handle, const TaskRecord &record);                 // 任务进入终态时调用
+    void releasePathWaiters(quint64 handle, const TaskRecord &record, bool success);    // 启动排在该任务之后的同路径请求
     void processQueue();
-    void startDownloadTask(std::shared_ptr<DownloadTask> task);
-    QString generateTaskId();
-    void updateHostConnections(const QString &host, int delta);
+    void enqueueTask(quint64 handle);                // 按优先级和Host放入就绪队列
+    bool removeQueuedTask(quint64 handle);           // 从就绪队列中移除
+    quint64 dequeueNextTask();                       // 选出下一个可启动的任务（无则返回0）
+    void startDownloadTask(quint64 handle);
+    std::shared_ptr<DownloadTask> createTask(quint64 handle, const TaskRecord &record);  // 为即将启动的记录创建任务对象
+    void retireTask(TaskRecord &record);             // 回写任务状态并释放任务对象
+    static QString taskIdForHandle(quint64 handle);  // 任务ID只由句柄决定
+    static quint64 handleForTaskId(const QString &taskId);  // 无效ID返回0
+    bool ensureDirectory(const QString &dirPath);    // 创建目录，已确认存在的目录直接返回（线程安全）
+    void forgetDirectory(const QString &dirPath);    // 目录已被删除：下次 ensureDirectory 重新创建（线程安全）
+    void updateHostConnections(TaskRecord &record, int delta);  // 任务开始/结束时更新Host在途数（HTTP/2请求同时计入流数）
+    void updatePriorityConnections(int priority, int delta);
     int getHostConnections(const QString &host) const;
+    static int rateLimitedSlots(qint64 bytesPerSecond);  // 限速下允许的在途任务数（不限速时为INT_MAX）
     bool canStartDownload(const QString &host) const;
     bool shouldDisableMultiThread(const QUrl &url) const;  // 新增：域名策略检查
     qint64 calculateCurrentSpeed();  // 新增：计算当前速度
     void checkAndEmitAllFinished();  // 检查是否所有任务完成并发射信号
-    QNetworkAccessManager* getNetworkManager();  // 获取共享的网络管理器
+    QNetworkAccessManager* getNetworkManager();  // 获取调用线程可用的共享网络管理器
+    QNetworkAccessManager* getHttp2NetworkManager(int shard);  // 获取HTTP/2专用的网络管理器（每个管理器对每个Host一条连接，调用时应已持有锁）
+    void ensureHttp2NetworkManagers();                // 按配置补足HTTP/2网络管理器（调用时应已持有锁）
+    bool http2For(const DownloadTransport &transport) const;  // 请求是否使用HTTP/2（调用时应已持有锁）
+    void warmConnection(QNetworkAccessManager *manager, const QUrl &origin, bool http2);  // 在管理器所在线程中预先建立一条连接
+    void ensureNetworkShards();                       // 首次启动任务时创建工作线程（调用时应已持有锁）
+    void stopNetworkShards();                         // 执行完各工作线程中排队的操作后停止线程
+    int hostConnectionLimit() const;                  // 每个Host允许的在途任务数（配置上限）
+    int http2StreamLimit() const;                     // 每个Host允许的在途HTTP/2请求数
+    int effectiveHostLimit(const QString &host) const;  // 叠加自适应控制后的在途任务数
+    void recordHostResult(const QString &host, qint64 bytes, bool success);  // 记录任务结果（调用时应已持有锁）
+    bool isCongestionFailure(const DownloadFailure &failure) const;  // 失败是否说明对端过载（超时、连接重置、限流、5xx）
+    void adjustHostConcurrency();                     // 按上一个窗口的结果调整各Host上限（调用时应已持有锁）
+
+    // 镜像健康度（调用时应已持有锁）
+    QUrl selectMirror(const QList<QUrl> &mirrors, const QString &avoidHost = QString()) const;
+    void recordMirrorResult(const QString &host, bool success);
+    void recordMirrorLatency(const QString &host, qint64 msecs);
+    bool failoverMirror(TaskRecord &record);                               // 切换到其他镜像，返回是否切换成功
+    void armMirrorHedge(const TaskRecord &record, DownloadTask *task);     // 为即将启动的任务选择对冲镜像
+
+    // 重试（调用时应已持有锁）
+    bool scheduleRetry(quint64 handle, TaskRecord &record, const DownloadFailure &failure);  // 返回false表示不再重试
+    void armRetryTimer();                                        // 按最早的到期时间启动重试定时器
+    bool isHostThrottled(const QString &host) const;
+    void forgetTaskProgress(const QString &taskId);            // 任务离开运行状态时清理进度数据
 
     // 配置参数
     int m_maxConcurrentDownloads;
@@ -440,6 +991,14 @@ private:
     int m_downloadTimeout;
     bool m_autoRetry;
     int m_maxRetryCount;
+    bool m_directSegmentWrite;           // 分段直接定位写入目标文件
+    bool m_adaptiveSegments;             // 分段工作窃取与慢分段对冲
+    bool m_rangedProbe;                  // 用带Range的GET代替HEAD探测
+    bool m_http2Enabled;                 // 小文件使用HTTP/2多路复用
+    int m_http2ConnectionsPerHost;       // HTTP/2每个Host的连接数
+    int m_http2MaxStreamsPerConnection;  // HTTP/2每个连接的并发流数
+    int m_prewarmConnectionsPerHost;     // 预热时每个Host建立的连接数
+    int m_prewarmCursor;                 // 下一条预热连接使用的网络管理器位置
 
     // PCL优化参数
     bool m_speedMonitoringEnabled;       // 速度监控开关
@@ -453,34 +1012,413 @@ private:
 
     QStringList m_noMultiThreadHosts;    // 禁用多线程的域名列表
 
+    /**
+     * @brief 同一优先级的就绪队列
+     *
+     * 每个Host一条FIFO队列，Host之间轮转调度；
+     * 某个Host连接已满时跳过它，不会阻塞其他Host的任务
+     */
+    struct PriorityBucket {
+        QHash<QString, QQueue<quint64>> hostQueues;  // Host -> 就绪任务队列
+        QStringList hostRing;                        // Host轮转顺序
+        int cursor = 0;                              // 下一次调度起始的Host位置
+    };
+
     // 任务管理
-    QHash<QString, std::shared_ptr<DownloadTask>> m_tasks;
-    QQueue<QString> m_taskQueue;
-    QHash<QString, DownloadStatus> m_taskStatus;
-    QHash<QString, int> m_taskRetryCount;
-    QHash<QString, qint64> m_taskLastProgress;  // taskId -> 最后进度更新时间戳（用于卡住检测）
+    QHash<quint64, TaskRecord> m_records;     // 句柄 -> 任务记录
+    QHash<QString, quint64> m_inflightPaths;  // 规范化保存路径 -> 未结束的任务句柄
+    QMultiHash<quint64, quint32> m_attachedBatches;  // 句柄 -> 合并到该任务的其他批次
+    QMultiHash<quint64, quint64> m_pathWaiters;      // 在途任务句柄 -> 排在其后的同路径请求
+    QMultiHash<quint64, std::shared_ptr<QPromise<DownloadResult>>> m_taskPromises;  // 句柄 -> 等待该任务结果的 QPromise
+    bool m_coalescing;                        // 是否合并重复请求
+    QMap<int, PriorityBucket> m_readyQueues;  // 优先级 -> 就绪队列（从高到低调度）
+    int m_queuedCount;                        // 就绪队列中的任务总数
+    QHash<QString, qint64> m_taskLastProgress;  // taskId -> 最后进度更新时间戳（仅运行中的任务，由 m_progressMutex 保护）
+
+    /**
+     * @brief 单个Host的自适应并发状态（AIMD）
+     */
+    struct HostCongestion {
+        double limit = 0;           // 当前在途任务上限
+        bool slowStart = true;      // 首次出错前按倍数增长
+        int peakInFlight = 0;       // 本窗口内在途任务峰值（判断上限是否成为瓶颈）
+        int successes = 0;          // 本窗口完成数
+        int errors = 0;             // 本窗口失败/超时数
+        qint64 bytes = 0;           // 本窗口完成的字节数
+        qint64 lastGoodput = 0;     // 上一个有效窗口的吞吐（字节/秒）
+        qint64 windowStart = 0;     // 本窗口开始时间
+    };
+
+    /**
+     * @brief 单个镜像（按Host区分）的健康度
+     */
+    struct MirrorHealth {
+        double successRate = 1.0;     // 成功率的指数滑动平均
+        double latencyMs = 0;         // 首字节延迟的指数滑动平均（0表示尚无样本）
+        int consecutiveFailures = 0;  // 连续失败次数
+        qint64 cooldownUntil = 0;     // 冷却截止时间，期间不主动选择该镜像
+    };
+
+    QHash<QString, MirrorHealth> m_mirrorHealth;  // Host -> 镜像健康度
+    QHash<quint64, qint64> m_taskStartTime;       // 句柄 -> 本次启动时间（用于测量首字节延迟）
+    bool m_mirrorHedging;                         // 是否启用多镜像对冲
+    int m_mirrorHedgeDelay;                       // 对冲最小延迟（毫秒）
+
+    std::shared_ptr<DownloadRetryPolicy> m_retryPolicy;  // 重试策略
+    QMultiMap<qint64, quint64> m_delayedRetries;  // 重试时间 -> 句柄（退避中，不在就绪队列里）
+    QHash<QString, qint64> m_hostThrottleUntil;   // Host -> 限流截止时间，期间不启动新任务
+    QTimer *m_retryTimer;                         // 退避/限流到期定时器
+
+    bool m_adaptiveConcurrency;                  // 是否启用自适应并发
+    QHash<QString, HostCongestion> m_hostCongestion;  // Host -> 自适应并发状态
 
     // 线程和网络管理
     QHash<QString, int> m_hostConnections;  // Host -> 当前连接数
+    QHash<QString, int> m_hostHttp2Streams; // Host -> 在途HTTP/2请求数（同时计入 m_hostConnections）
+    QHash<int, int> m_priorityConnections;  // 优先级 -> 在途任务数
     int m_activeDownloads;
     QList<QNetworkAccessManager*> m_networkManagers;  // 共享的网络管理器池
     int m_networkManagerPoolSize;                      // 网络管理器池大小
+    QList<QNetworkAccessManager*> m_http2NetworkManagers;  // HTTP/2网络管理器池（大小即每个Host的连接数）
+
+    /**
+     * @brief 网络工作线程及其专用的网络管理器（网络管理器只能在其所在线程中使用）
+     */
+    struct NetworkShard {
+        QThread *thread = nullptr;
+        QList<QNetworkAccessManager*> managers;       // 创建后不再变化，工作线程中只读访问
+        QList<QNetworkAccessManager*> http2Managers;  // 只在持锁时由下载器所在线程访问
+    };
+
+    QList<NetworkShard> m_shards;        // 工作线程（首个任务启动后不再变化）
+    int m_workerThreadCount;             // 配置的工作线程数（0表示不使用工作线程）
+    bool m_shardsStarted;                // 是否已创建工作线程（之后不再接受线程数的修改）
+    std::unique_ptr<DiskWriter> m_diskWriter;  // 异步磁盘写入器（任务和分段直接使用，自带锁）
+    std::unique_ptr<FileCommitter> m_fileCommitter;  // 完成文件的分组落盘与改名（任务直接使用，自带锁）
 
     // 统计信息
     DownloadStatistics m_statistics;
     QTimer *m_statisticsTimer;
     QTimer *m_monitorTimer;              // 新增：监控定时器
     bool m_allFinishedEmitted;           // 防止重复发射完成信号
+    std::atomic<qint64> m_liveBytes;     // 运行中任务已下载字节数之和（由各任务增量更新）
+    std::atomic<qint64> m_completedBytes;  // 已完成任务的字节数之和
+    std::unique_ptr<BandwidthLimiter> m_bandwidth;  // 限速器（任务和分段直接使用，自带锁）
+
+    /**
+     * @brief 尚未上报的任务进度（每个任务只保留最新值）
+     */
+    struct PendingProgress {
+        qint64 received = 0;
+        qint64 total = -1;
+        qint64 firstDataAt = 0;  // 本间隔内首次收到数据的时间（用于测量首字节延迟）
+    };
+
+    QHash<QString, PendingProgress> m_pendingProgress;  // taskId -> 待上报进度（由 m_progressMutex 保护）
+    QTimer *m_progressTimer;             // 进度上报定时器
+    int m_progressInterval;              // 进度上报间隔（毫秒）
 
     // 线程安全
     mutable QMutex m_mutex;
+    QMutex m_progressMutex;              // 仅保护进度相关的高频数据；需要同时持有时先锁 m_mutex
+    QMutex m_dirMutex;                   // 保护 m_knownDirs
+    QSet<QString> m_knownDirs;           // 已确认存在的保存目录
 
     // 任务ID计数器
     quint64 m_taskIdCounter;
+
+    QHash<quint32, BatchEntry> m_batches;  // 批次ID -> 批次
+    quint32 m_batchCounter;
+
+    friend class DownloadBatch;
+};
+
+/**
+ * @brief 一批下载任务的句柄
+ *
+ * 由 AsulMultiDownloader::addBatch 创建，父对象为下载器（经 DownloadService::submit 创建时没有父对象，
+ * 属于调用线程）。汇总本批任务的进度，
+ * 全部任务结束（完成、失败或取消）后发射一次 finished。
+ * 所有信号都经事件循环异步发射，处理函数中可以安全地调用下载器的任何接口
+ */
+class DownloadBatch : public QObject
+{
+    Q_OBJECT
+
+public:
+    QStringList taskIds() const { return m_taskIds; }
+    int totalCount() const { return int(m_taskIds.size()); }
+    int completedCount() const { return m_completed; }
+    int failedCount() const { return m_failed; }
+    qint64 totalBytes() const { return m_totalBytes; }        // 已知大小之和
+    qint64 receivedBytes() const { return m_receivedBytes; }
+    bool isFinished() const { return m_completed + m_failed >= m_taskIds.size(); }
+    QString lastError() const { return m_lastError; }
+
+    /**
+     * @brief 本批各任务的结果
+     *
+     * 任务结束时由下载器直接填入（按完成顺序，与信号相互独立），全部结束后完成；
+     * 合并重复请求时同一个任务只出现一次
+     */
+    QFuture<DownloadResult> future() const { return m_future; }
+
+    /**
+     * @brief 各任务单独的结果（与 taskIds() 顺序相同）
+     *
+     * 每个文件结束时立即完成，可分别用 QFuture::then(QThreadPool*, ...) 接续处理
+     */
+    QList<QFuture<DownloadResult>> taskFutures() const { return m_taskFutures; }
+
+    /**
+     * @brief 取消本批所有未结束的任务
+     *
+     * 同时被其他请求等待的任务（参见 AsulMultiDownloader::setRequestCoalescingEnabled）继续下载，
+     * 只在本批次中记为失败
+     */
+    void cancel();
+
+signals:
+    /**
+     * @brief 批次进度信号（按下载器的进度上报间隔合并）
+     */
+    void progress(qint64 receivedBytes, qint64 totalBytes, int completedCount, int failedCount, int totalCount);
+
+    void taskFinished(const QString &taskId, const QString &savePath);
+    void taskFailed(const QString &taskId, const QString &error);
+
+    /**
+     * @brief 本批所有任务都已结束
+     * @param success 是否全部成功
+     */
+    void finished(bool success);
+
+private:
+    explicit DownloadBatch(AsulMultiDownloader *downloader);
+
+    void addReceived(qint64 delta);
+    void settleTask(const QString &taskId, const QString &savePath, bool success, const QString &error,
+                    qint64 bytesDelta);
+
+    AsulMultiDownloader *m_downloader;
+    quint32 m_batchId;
+    QStringList m_taskIds;
+    int m_completed;
+    int m_failed;
+    qint64 m_totalBytes;
+    qint64 m_receivedBytes;
+    QString m_lastError;
+    QFuture<DownloadResult> m_future;
+    QList<QFuture<DownloadResult>> m_taskFutures;
+
+    friend class AsulMultiDownloader;
 };
 
 // ==================== 内部类定义 ====================
 
+/**
+ * @brief 断点续传日志（内部使用）
+ *
+ * 以 "<保存路径>.resume" 的形式与目标文件放在一起，记录临时文件中已完成的字节区间和服务端的
+ * ETag / Last-Modified。重试、恢复或新进程再次下载同一文件时只请求缺失的区间
+ */
+struct DownloadResumeJournal {
+    using Range = QPair<qint64, qint64>;  // [first, last] 闭区间
+
+    QString url;                 // 下载URL（无校验标识时用于比对）
+    qint64 fileSize = -1;        // 文件总大小
+    QString etag;                // 服务端ETag
+    QString lastModified;        // 服务端Last-Modified
+    QList<Range> completed;      // 已完成的区间（有序、不重叠）
+
+    static QString journalPath(const QString &savePath);
+    static bool exists(const QString &savePath);
+    static bool load(const QString &savePath, DownloadResumeJournal *out);
+    static void remove(const QString &savePath);
+    bool save(const QString &savePath) const;
+
+    /**
+     * @brief 判断另一份记录描述的是否为同一份服务端文件
+     */
+    bool matches(const DownloadResumeJournal &other) const;
+
+    void addCompleted(qint64 first, qint64 last);
+    qint64 completedBytes() const;
+    QList<Range> missingRanges() const;
+
+    /**
+     * @brief 反复对半拆分最大的区间，直到区间数达到 count 或无法再拆
+     * @param minBytes 拆分后每段的最小字节数
+     */
+    static QList<Range> splitRanges(QList<Range> ranges, int count, qint64 minBytes);
+};
+
+/**
+ * @brief 分层令牌桶限速器（内部使用）
+ *
+ * 全局、每Host、每优先级各有一个令牌桶，一次读取需同时从所有生效的桶中扣除令牌。
+ * 读取方只从 QNetworkReply 中取出被授予的字节数，其余数据留在接收缓冲区，
+ * 缓冲区满后Qt停止读取套接字，由TCP流控降低服务端的发送速度。线程安全
+ */
+class BandwidthLimiter
+{
+public:
+    BandwidthLimiter();
+
+    void setGlobalRate(qint64 bytesPerSecond);
+    qint64 globalRate() const;
+    void setHostRate(const QString &host, qint64 bytesPerSecond);
+    qint64 hostRate(const QString &host) const;
+    void setPriorityRate(int priority, qint64 bytesPerSecond);
+    qint64 priorityRate(int priority) const;
+    bool isActive() const { return m_active.load(std::memory_order_relaxed); }
+
+    /**
+     * @brief 限速生效时限制请求的接收缓冲区，使未读取的数据反压到TCP层
+     * @param http2 HTTP/2请求共享同一连接，不限制单个流的缓冲区以免拖慢其他流
+     */
+    void prepare(QNetworkReply *reply, bool http2) const;
+
+    /**
+     * @brief 按令牌从 reply 中读取数据
+     * @param retryMs 仍有数据未读取时，输出建议的下次读取延迟（毫秒）；否则不修改
+     * @return 本次允许读取的数据（令牌不足时可能为空）
+     */
+    QByteArray read(QNetworkReply *reply, const QString &host, int priority, int *retryMs);
+
+    /**
+     * @brief 扣除已经绕过限速读取的字节数（例如请求完成时一次取出的剩余数据），允许透支
+     */
+    void charge(const QString &host, int priority, qint64 bytes);
+
+private:
+    struct Bucket {
+        qint64 rate = 0;        // 字节/秒
+        double tokens = 0;      // 可用令牌（透支时为负）
+        qint64 lastRefill = 0;  // 上次补充时间（m_clock 毫秒）
+    };
+
+    static double capacity(const Bucket &bucket);
+    void refill(Bucket &bucket, qint64 now) const;
+    void setRate(Bucket &bucket, qint64 bytesPerSecond);
+    int collect(const QString &host, int priority, Bucket **out);  // 收集生效的桶（调用时应已持有锁）
+    void updateActive();                                            // 调用时应已持有锁
+
+    Bucket m_global;
+    QHash<QString, Bucket> m_hosts;
+    QHash<int, Bucket> m_priorities;
+    QElapsedTimer m_clock;
+    std::atomic<bool> m_active;
+    mutable QMutex m_mutex;
+};
+
+/**
+ * @brief 异步磁盘写入器（内部使用）
+ *
+ * 网络线程只把收到的数据连同文件偏移交给写入器，由独立的写入线程按批落盘；
+ * Linux 上编译时找到 liburing 且内核支持时使用 io_uring 一次提交一批写入，否则逐块写入。
+ * 排队数据超过上限时 write() 阻塞调用方，反压到网络线程和TCP接收窗口。线程安全
+ *
+ * 调用方需保证：文件交给写入器后不再直接读写，关闭或删除 QFile 之前先调用 release()
+ */
+class DiskWriter
+{
+public:
+    explicit DiskWriter(qint64 maxQueuedBytes);
+    ~DiskWriter();  // 写完所有排队的数据后停止写入线程
+
+    bool usesIoUring() const { return m_ioUring.load(std::memory_order_relaxed); }
+
+    /**
+     * @brief 排队一次写入
+     * @return 该文件之前的写入已失败时返回false（本次不再排队）
+     */
+    bool write(QFile *file, qint64 offset, const QByteArray &data);
+
+    /**
+     * @brief 等待该文件排队的写入全部完成
+     * @return 是否全部写入成功
+     */
+    bool flush(QFile *file);
+
+    /**
+     * @brief 等待写入完成并清除该文件的状态，之后调用方可以关闭文件
+     * @return 是否全部写入成功
+     */
+    bool release(QFile *file);
+
+private:
+    struct Job {
+        QFile *file;
+        qint64 offset;
+        QByteArray data;
+    };
+
+    struct FileState {
+        int pending = 0;      // 排队和正在写入的块数
+        bool failed = false;  // 是否有写入失败
+    };
+
+    void run();                                           // 写入线程主循环
+    void writeBatch(const QList<Job> &jobs, QList<bool> *results);  // 写入一批数据（写入线程中调用，不持锁）
+    static bool writeJob(const Job &job);                 // 同步写入单块
+
+    QMutex m_mutex;
+    QWaitCondition m_wakeWriter;  // 有新数据或正在停止
+    QWaitCondition m_written;     // 有数据写完
+    QQueue<Job> m_jobs;
+    QHash<QFile*, FileState> m_files;
+    qint64 m_queuedBytes;
+    qint64 m_maxQueuedBytes;
+    bool m_stopping;
+    io_uring *m_ring;             // 仅写入线程使用（为空表示不使用 io_uring）
+    std::atomic<bool> m_ioUring;
+    QThread *m_thread;
+};
+
+/**
+ * @brief 完成文件提交器（内部使用）
+ *
+ * 任务先写入同目录下的临时文件（每次尝试各自一个，可续传的直写文件为持锁的"保存路径 + .download"），校验通过后交给提交器：
+ * 提交线程把短时间内到达的一组文件一起落盘，再原子改名为目标文件并落盘所在目录，
+ * 目标路径上出现的文件总是完整的。Linux 上先对整组文件发起回写再逐个 fdatasync，
+ * 其他平台逐个文件刷盘（仍在提交线程中，不阻塞网络线程）；每个目录只落盘一次。线程安全
+ */
+class FileCommitter
+{
+public:
+    using Callback = std::function<void(bool ok, const QString &error)>;
+
+    FileCommitter();
+    ~FileCommitter();  // 提交完所有排队的文件后停止提交线程
+
+    /**
+     * @brief 排队提交一个文件，完成后在提交线程中调用 callback
+     */
+    void commit(const QString &stagingPath, const QString &finalPath, Callback callback);
+
+    /**
+     * @brief 在当前线程中立即提交单个文件（任务不属于管理器时使用）
+     */
+    static bool commitNow(const QString &stagingPath, const QString &finalPath, QString *error);
+
+private:
+    struct Job {
+        QString stagingPath;
+        QString finalPath;
+        Callback callback;
+    };
+
+    void run();                          // 提交线程主循环
+    static void commitBatch(const QList<Job> &jobs);  // 落盘并改名一组文件（提交线程中调用，不持锁）
+
+    QMutex m_mutex;
+    QWaitCondition m_wakeCommitter;  // 有新文件或正在停止
+    QList<Job> m_jobs;
+    bool m_stopping;
+    QThread *m_thread;
+};
+
 /**
  * @brief 下载任务类（内部使用）
  */
@@ -497,20 +1435,37 @@ public:
     void pause();
     void resume();
     void cancel();
+    void interrupt();  // 中断当前传输但保留断点（用于卡住重试、析构）
 
     QString taskId() const { return m_taskId; }
     QUrl url() const { return m_url; }
     QString savePath() const { return m_savePath; }
     int priority() const { return m_priority; }
-    qint64 fileSize() const { return m_fileSize; }
-    qint64 downloadedSize() const { return m_downloadedSize; }
-    bool supportRange() const { return m_supportRange; }
-    int segmentCount() const { return m_segmentCount; }
-    QString errorString() const { return m_errorString; }
 
-    void setSegmentCount(int count) { m_segmentCount = count; }
+    // 以下状态可能在任务运行期间从其他线程读取，由 m_stateMutex 保护
+    QUrl servedUrl() const;  // 实际提供数据的URL（对冲胜出时与url()不同）
+    qint64 fileSize() const;
+    qint64 downloadedSize() const;
+    bool supportRange() const;
+    int segmentCount() const;
+    QString errorString() const;
+    DownloadFailure failure() const;  // 最近一次失败的网络错误和HTTP状态
+
+    void setSegmentCount(int count);
     void setTimeout(int msecs) { m_timeout = msecs; }
     void setKnownFileSize(qint64 size) { m_fileSize = size; }
+    void setDirectSegmentWrite(bool enable) { m_directSegmentWrite = enable; }
+    void setAdaptiveSegments(bool enable) { m_adaptiveSegments = enable; }
+    void setRangedProbe(bool enable) { m_rangedProbe = enable; }
+    void setSink(const std::shared_ptr<DownloadSink> &sink) { m_sink = sink; }  // 设置后单线程按顺序下载
+    void setReplayLocal(bool enable) { m_replayLocal = enable; }  // 先尝试把已提交的目标文件回放给接收器
+    void setExpectedSha1(const QString &sha1) { m_expectedSha1 = sha1.trimmed().toLower().toLatin1(); }
+    QByteArray expectedSha1() const { return m_expectedSha1; }
+    void setHedge(const QUrl &url, int delayMs) { m_hedgeUrl = url; m_hedgeDelay = delayMs; }
+    void setLargeFileThreshold(qint64 bytes) { m_largeFileThreshold = bytes; }
+    void setMultiThreadAllowed(bool allowed) { m_multiThreadAllowed = allowed; }
+    void setHttp2NetworkManager(QNetworkAccessManager *manager) { m_http2Manager = manager; }  // 为空表示不使用HTTP/2
+    void releaseLiveBytes();  // 从管理器的运行中字节数里扣除本任务的贡献（幂等，下次 start() 时恢复计数）
 
 signals:
     void started(const QString &taskId);
@@ -522,29 +1477,99 @@ signals:
 
 private slots:
     void onHeadFinished();
+    void onProbeResponse();  // 带Range的GET探测收到首批数据或结束
     void onDownloadProgress(qint64 bytesReceived, qint64 bytesTotal);
     void onDownloadFinished();
     void onDownloadError(QNetworkReply::NetworkError error);
     void onSegmentFinished(int segmentIndex);
     void onSegmentError(int segmentIndex, const QString &error);
     void onSegmentProgress(int segmentIndex, qint64 bytesReceived, qint64 bytesTotal);
+    void onHedgeTimeout();
 
 private:
-    void startSingleDownload();
-    void startSegmentedDownload();
+    void startTransfer(QNetworkReply *probe);  // 按探测结果选择分段或单线程下载（调用时不持锁）
+    void startSingleDownload(QNetworkReply *probe = nullptr);  // probe：沿用探测请求作为下载流
+    void setDownloadedSize(qint64 size);  // 更新已下载字节数并同步到管理器的计数器
+    void setFileSize(qint64 size);
+    void setSupportRange(bool supportRange);
+    void setServedUrl(const QUrl &url);
+    void setError(const QString &error);
+    void setError(const QString &error, const DownloadFailure &failure);
+    bool closeFile();  // 等待排队的写入完成后关闭目标文件，返回写入是否全部成功（调用时应已持有锁）
+    void onSingleReadyRead(QNetworkReply *reply);
+    void abortSingleDownload();  // 单线程下载中途写入失败：停止接收并关闭文件（调用时应已持有锁）
+    bool writeSink(const QByteArray &data);  // 写入接收器，失败时记录错误（调用时应已持有锁）
+    bool replayCommittedFile(bool *ok);      // 把已提交的目标文件回放给接收器；返回false表示文件不可用，应改为下载（调用时应已持有锁）
+    bool promoteHedgeReply();  // 对冲请求取代主请求（调用时应已持有锁）
+    void dropHedgeReply();     // 放弃对冲请求（调用时应已持有锁）
+    void startSegmentedDownload(QNetworkReply *probe = nullptr);  // probe：可用时作为第0段继续接收
     void mergeSegments();
+    void finishDirectSegments();  // 直写模式：所有分段完成后收尾（无合并）
+    void saveJournal();           // 直写模式：落盘断点续传日志（调用时应已持有锁）
+    bool claimResumableStaging(); // 直写模式：独占固定的临时文件和断点日志，已被其他写入方占用时返回false（调用时应已持有锁）
+    DownloadResumeJournal coverageSnapshot() const;  // 续传前区间 + 各分段已写入区间的并集
+
+    // 动态分段（直写模式，调用时应已持有锁）
+    SegmentDownloader *addDirectSegment(qint64 start, qint64 end, QNetworkReply *probe = nullptr);  // 创建并启动写入共享文件的分段
+    int runningSegmentCount() const;
+    void retireHedgePartner(int segmentIndex);  // 一方完成后取消与之竞速的另一方
+    void stealWork();                           // 拆分剩余最多的分段，后半段交给新连接
+    void hedgeSlowSegment();                    // 对明显慢于其他分段的分段发起对冲请求
+
+    // 流式SHA-1校验（调用方保证在任务所在线程调用，不加锁）
+    void resetDigest();
+    void updateDigest(qint64 offset, const QByteArray &data);  // 按文件偏移喂入数据，乱序数据暂存
+    bool verifyDigest();                                        // 补齐未覆盖的区间并比对结果
+    bool compareDigest();                                       // 直接比对已计算的摘要（数据已全部喂入时）
+    bool openStagingFile(QFile *file, QIODevice::OpenMode mode);  // 打开临时文件，保存目录已被删除时重新创建后再试一次
+    bool writeBufferedFile();                                   // 将内存中的小文件正文一次写入磁盘
+
+    void commitStagedFile();  // 校验通过后把临时文件提交为目标文件，完成后发射 finished（调用时不持锁）
+    void onFileCommitted(quint32 attempt, bool ok, const QString &error);
+    void scheduleThrottledRead(int msecs);                      // 限速时稍后继续读取接收缓冲区
 
     QString m_taskId;
     QUrl m_url;
     QString m_savePath;
+    QString m_stagingPath;        // 本次尝试写入的临时文件（保存路径为空时为空；每次尝试不同，只有持有续传锁时为固定路径）
+    std::unique_ptr<QLockFile> m_stagingLock;  // 固定临时文件和断点日志的独占锁（未持有时为空）
     int m_priority;
+    quint32 m_attempt;            // 每次启动递增，丢弃上一次尝试迟到的提交结果
+
+    // 多镜像相关
+    QUrl m_servedUrl;             // 实际提供数据的URL
+    QUrl m_hedgeUrl;              // 首字节迟到时用于对冲的URL（为空表示不对冲）
+    int m_hedgeDelay;             // 对冲延迟（毫秒）
+    QNetworkReply *m_hedgeReply;  // 进行中的对冲请求
+    QTimer *m_hedgeTimer;         // 对冲计时器
+    bool m_firstByteSeen;         // 本次启动是否已收到有效数据
+
+    // 小文件快速路径
+    bool m_buffered;              // 正文先缓存在内存中，完成后一次写入
+    QByteArray m_buffer;          // 已接收的正文
     int m_timeout;
 
+    BandwidthLimiter *m_bandwidth;  // 管理器的限速器（可能为空）
+    QTimer *m_throttleTimer;        // 令牌不足时延迟读取
+
+    AsulMultiDownloader *m_downloader;  // 所属管理器（可能为空）
+    DiskWriter *m_diskWriter;           // 管理器的磁盘写入器（为空时在当前线程同步写入）
+    FileCommitter *m_fileCommitter;     // 管理器的文件提交器（为空时在当前线程同步提交）
+    qint64 m_largeFileThreshold;        // 创建时的大文件阈值
+    bool m_multiThreadAllowed;          // 该URL是否允许多线程分段
+    QNetworkAccessManager *m_http2Manager;  // HTTP/2网络管理器（为空表示不使用HTTP/2）
+    qint64 m_writeOffset;               // 单线程下载时下一块数据的文件偏移
+    std::shared_ptr<DownloadSink> m_sink;  // 数据接收器（可能为空）
+    bool m_replayLocal;                 // 下次启动时先从已提交的目标文件回放
+
     qint64 m_fileSize;
     qint64 m_downloadedSize;
+    std::atomic<qint64> *m_liveBytes;  // 管理器的运行中字节计数器（可能为空）
+    bool m_liveCounted;                // m_downloadedSize 是否已计入 m_liveBytes
     bool m_supportRange;
     int m_segmentCount;
     QString m_errorString;
+    DownloadFailure m_failure;
 
     QNetworkAccessManager *m_networkManager;  // 从池中借用的网络管理器
     QNetworkReply *m_reply;
@@ -555,13 +1580,37 @@ private:
     QList<SegmentDownloader*> m_segments;
     QList<qint64> m_segmentProgress;
     int m_completedSegments;
+    bool m_directSegmentWrite;  // 分段直接写入预分配的临时文件（m_file 由各分段共享）
+    bool m_adaptiveSegments;    // 工作窃取与慢分段对冲
+    bool m_rangedProbe;         // 用带Range的GET代替HEAD探测
+    QByteArray m_ifRange;       // 分段请求使用的If-Range校验值
+    QHash<int, int> m_hedgePartner;  // 分段索引 <-> 与之竞速的对冲分段索引（双向）
+    int m_hedgeCount;           // 本次启动已发起的对冲次数
+    qint64 m_lastHedgeCheck;    // 上次对冲检查时间
+
+    // 断点续传相关
+    QString m_etag;                    // 探测响应中的ETag
+    QString m_lastModified;            // 探测响应中的Last-Modified
+    DownloadResumeJournal m_journal;   // 本次启动时已完成的区间
+    bool m_resumable;                  // 本次尝试持有续传锁，读写断点日志
+    qint64 m_journalBaseBytes;         // 本次启动前已在磁盘上的字节数
+    qint64 m_lastJournalSave;          // 上次落盘时间
+
+    // SHA-1校验相关
+    QByteArray m_expectedSha1;             // 期望摘要（小写十六进制）
+    QCryptographicHash m_digest;           // 已按顺序计算到 m_digestOffset 的摘要
+    qint64 m_digestOffset;                 // 摘要已覆盖的字节数
+    QMap<qint64, QByteArray> m_pendingDigest;  // 偏移 -> 尚未轮到的分段数据
+    qint64 m_pendingDigestBytes;           // 暂存数据总量
 
     bool m_isPaused;
     bool m_isCanceled;
 
     QMutex m_mutex;
+    mutable QMutex m_stateMutex;  // 只保护跨线程读取的状态，持有时不再获取其他锁
 
     friend class AsulMultiDownloader;  // 允许管理器访问私有成员（卡住检测等）
+    friend class SegmentDownloader;    // 分段下载器直接喂入摘要数据
 };
 
 /**
@@ -579,8 +1628,41 @@ public:
     void start();
     void cancel();
     int index() const { return m_index; }
+
+    /**
+     * @brief 接管已返回206的 "Range: bytes=0-" 探测请求代替 start()，收满 [start, end] 后结束
+     * @param reply 探测请求（所有权转移给分段）
+     */
+    void adopt(QNetworkReply *reply);
     qint64 bytesReceived() const { return m_bytesReceived; }
 
+    /**
+     * @brief 使用共享的目标文件，按 [start, end] 偏移定位写入（不再创建独立的分段文件）
+     * @param file 已打开的目标文件，由 DownloadTask 持有
+     */
+    void setSharedFile(QFile *file) { m_sharedFile = file; }
+
+    /**
+     * @brief 设置If-Range校验值（ETag或Last-Modified），服务端文件已变化时不会返回部分内容
+     */
+    void setIfRange(const QByteArray &validator) { m_ifRange = validator; }
+
+    qint64 rangeStart() const { return m_start; }
+    qint64 rangeEnd() const { return m_end; }
+    qint64 remainingBytes() const { return (m_end - m_start + 1) - m_bytesReceived; }
+    bool isRunning() const { return m_reply != nullptr; }
+
+    /**
+     * @brief 缩短分段的结束位置（工作窃取），收满新区间后立即结束
+     * @param end 新的结束偏移（闭区间），不会早于已写入的位置
+     */
+    void setRangeEnd(qint64 end);
+
+    DownloadFailure failure() const { return m_failure; }  // 失败时的网络错误和HTTP状态
+
+    qint64 throughput() const;  // 自启动以来的平均速度（字节/秒）
+    qint64 elapsedMs() const;   // 自启动以来经过的毫秒数
+
 signals:
     void finished(int index);
     void error(int index, const QString &errorString);
@@ -592,6 +1674,9 @@ private slots:
     void onError(QNetworkReply::NetworkError error);
 
 private:
+    bool writeChunk(const QByteArray &data);  // 写入本分段范围内的数据并更新摘要
+    bool closeFile();                         // 等待排队的写入完成后关闭分段文件，返回写入是否全部成功
+
     int m_index;
     QUrl m_url;
     QString m_filePath;
@@ -599,11 +1684,20 @@ private:
     qint64 m_end;
     qint64 m_bytesReceived;
     int m_timeout;
+    DownloadFailure m_failure;
 
     QNetworkAccessManager *m_networkManager;  // 从池中借用的网络管理器
     QNetworkReply *m_reply;
     QFile *m_file;
+    QFile *m_sharedFile;        // 共享的目标文件（直写模式，不归本对象所有）
+    QByteArray m_ifRange;       // If-Range校验值
     bool m_ownsNetworkManager;  // 是否拥有网络管理器（需要释放）
+    bool m_rangeShrunk;         // 区间是否被拆分缩短过
+    QElapsedTimer m_elapsed;    // 启动计时（用于速度比较）
+    BandwidthLimiter *m_bandwidth;  // 管理器的限速器（可能为空）
+    DiskWriter *m_diskWriter;       // 管理器的磁盘写入器（为空时在当前线程同步写入）
+    int m_priority;                 // 所属任务的优先级（用于限速）
+    QTimer *m_throttleTimer;        // 令牌不足时延迟读取
 
     bool m_isCanceled;
 };
@@ -614,6 +1708,13 @@ using ::AsulMultiDownloader;
 using ::DownloadInfo;
 using ::DownloadStatistics;
 using ::DownloadStatus;
+using ::DownloadResumeJournal;
+using ::DownloadRequest;
+using ::DownloadResult;
+using ::DownloadBatch;
+using ::DownloadFailureKind;
+using ::DownloadFailure;
+using ::DownloadRetryPolicy;
 } // namespace AMCS::Core::Download
 
 #endif // ASULMULTIDOWNLOADER_H
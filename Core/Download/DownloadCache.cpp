@@ -0,0 +1,341 @@
+#include "DownloadCache.h"
+#include "AsulMultiDownloader.h"
+#include <QCryptographicHash>
+#include <QDateTime>
+#include <QDir>
+#include <QDirIterator>
+#include <QFile>
+#include <QFileInfo>
+#include <QRandomGenerator>
+#include <QDebug>
+#include <algorithm>
+#include <filesystem>
+#include <system_error>
+
+#if defined(Q_OS_LINUX)
+#include <fcntl.h>
+#include <linux/fs.h>
+#include <sys/ioctl.h>
+#include <unistd.h>
+#elif defined(Q_OS_MACOS)
+#include <sys/attr.h>
+#include <sys/clonefile.h>
+#endif
+
+namespace
+{
+std::filesystem::path toFsPath(const QString &path)
+{
+#ifdef Q_OS_WIN
+    return std::filesystem::path(path.toStdWString());
+#else
+    return std::filesystem::path(QFile::encodeName(path).toStdString());
+#endif
+}
+
+// 写时复制克隆（仅支持的文件系统上成功，例如 Btrfs / XFS / APFS）
+bool reflinkFile(const QString &sourcePath, const QString &targetPath)
+{
+#if defined(Q_OS_LINUX) && defined(FICLONE)
+    const QByteArray src = QFile::encodeName(sourcePath);
+    const QByteArray dst = QFile::encodeName(targetPath);
+    int srcFd = ::open(src.constData(), O_RDONLY | O_CLOEXEC);
+    if (srcFd < 0) {
+        return false;
+    }
+    int dstFd = ::open(dst.constData(), O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, 0644);
+    if (dstFd < 0) {
+        ::close(srcFd);
+        return false;
+    }
+    const bool ok = ::ioctl(dstFd, FICLONE, srcFd) == 0;
+    ::close(dstFd);
+    ::close(srcFd);
+    if (!ok) {
+        ::unlink(dst.constData());
+    }
+    return ok;
+#elif defined(Q_OS_MACOS)
+    return ::clonefile(QFile::encodeName(sourcePath).constData(),
+                       QFile::encodeName(targetPath).constData(), 0) == 0;
+#else
+    Q_UNUSED(sourcePath);
+    Q_UNUSED(targetPath);
+    return false;
+#endif
+}
+
+QString tempPathFor(const QString &path)
+{
+    return QStringLiteral("%1.%2.tmp").arg(path).arg(QRandomGenerator::global()->generate(), 8, 16, QLatin1Char('0'));
+}
+
+// 对象旁的空标记文件，表示其内容已按SHA-1校验过
+QString verifiedMarkerFor(const QString &objectPath)
+{
+    return objectPath + QStringLiteral(".verified");
+}
+
+void markVerified(const QString &objectPath)
+{
+    QFile marker(verifiedMarkerFor(objectPath));
+    if (marker.open(QIODevice::WriteOnly)) {
+        marker.close();
+    }
+}
+
+bool fileMatchesSha1(const QString &path, const QString &sha1)
+{
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+    QCryptographicHash hash(QCryptographicHash::Sha1);
+    if (!hash.addData(&file)) {
+        return false;
+    }
+    return QString::fromLatin1(hash.result().toHex()).compare(sha1, Qt::CaseInsensitive) == 0;
+}
+
+// 原子地以 sourcePath 替换 targetPath（目标不存在时等同于改名）
+bool replaceFile(const QString &sourcePath, const QString &targetPath)
+{
+    std::error_code ec;
+    std::filesystem::rename(toFsPath(sourcePath), toFsPath(targetPath), ec);
+    return !ec;
+}
+} // namespace
+
+DownloadCache::DownloadCache(const QString &rootDir, qint64 maxBytes)
+    : m_rootDir(rootDir.isEmpty() ? QString() : QDir::cleanPath(rootDir))
+    , m_maxBytes(maxBytes)
+{
+}
+
+bool DownloadCache::isValidSha1(const QString &sha1)
+{
+    if (sha1.size() != 40) {
+        return false;
+    }
+    for (const QChar ch : sha1) {
+        if (!((ch >= QLatin1Char('0') && ch <= QLatin1Char('9')) ||
+              (ch >= QLatin1Char('a') && ch <= QLatin1Char('f')) ||
+              (ch >= QLatin1Char('A') && ch <= QLatin1Char('F')))) {
+            return false;
+        }
+    }
+    return true;
+}
+
+QString DownloadCache::objectPath(const QString &sha1) const
+{
+    if (!isEnabled() || !isValidSha1(sha1)) {
+        return QString();
+    }
+    const QString key = sha1.toLower();
+    return m_rootDir + QStringLiteral("/objects/") + key.left(2) + QLatin1Char('/') + key;
+}
+
+bool DownloadCache::contains(const QString &sha1, qint64 expectedSize) const
+{
+    const QString path = objectPath(sha1);
+    if (path.isEmpty()) {
+        return false;
+    }
+    QFileInfo info(path);
+    return info.isFile() && (expectedSize < 0 || info.size() == expectedSize);
+}
+
+void DownloadCache::dropObject(const QString &path)
+{
+    QFile::remove(verifiedMarkerFor(path));
+    QFile::remove(path);
+}
+
+bool DownloadCache::verifyObject(const QString &sha1, const QString &path)
+{
+    if (QFileInfo::exists(verifiedMarkerFor(path))) {
+        return true;
+    }
+    if (!fileMatchesSha1(path, sha1)) {
+        qWarning() << "DownloadCache: dropping corrupt object" << path;
+        dropObject(path);
+        return false;
+    }
+    markVerified(path);
+    return true;
+}
+
+void DownloadCache::touch(const QString &path)
+{
+    std::error_code ec;
+    std::filesystem::last_write_time(toFsPath(path), std::filesystem::file_time_type::clock::now(), ec);
+}
+
+DownloadCache::LinkMode DownloadCache::linkOrCopy(const QString &sourcePath, const QString &targetPath)
+{
+    std::error_code ec;
+    std::filesystem::create_hard_link(toFsPath(sourcePath), toFsPath(targetPath), ec);
+    if (!ec) {
+        return LinkMode::Hardlink;
+    }
+
+    // 跨文件系统或不支持硬链接时依次退回到克隆和复制
+    if (reflinkFile(sourcePath, targetPath)) {
+        return LinkMode::Reflink;
+    }
+    if (QFile::copy(sourcePath, targetPath)) {
+        return LinkMode::Copy;
+    }
+    return LinkMode::None;
+}
+
+DownloadCache::LinkMode DownloadCache::fetch(const QString &sha1, const QString &targetPath, qint64 expectedSize) const
+{
+    const QString path = objectPath(sha1);
+    if (path.isEmpty() || targetPath.isEmpty()) {
+        return LinkMode::None;
+    }
+
+    QFileInfo info(path);
+    if (!info.isFile()) {
+        return LinkMode::None;
+    }
+    if (expectedSize >= 0 && info.size() != expectedSize) {
+        qWarning() << "DownloadCache: dropping corrupt object" << path;
+        dropObject(path);
+        return LinkMode::None;
+    }
+    // 对象会以硬链接方式共享给多个游戏目录，首次取出前校验内容
+    if (!verifyObject(sha1, path)) {
+        return LinkMode::None;
+    }
+
+    const QString targetDir = QFileInfo(targetPath).absolutePath();
+    if (!QDir().mkpath(targetDir)) {
+        return LinkMode::None;
+    }
+
+    // 先放到临时名下再替换，避免目标处出现半个文件
+    const QString tempPath = tempPathFor(targetPath);
+    const LinkMode mode = linkOrCopy(path, tempPath);
+    if (mode == LinkMode::None) {
+        QFile::remove(tempPath);
+        return LinkMode::None;
+    }
+
+    if (!replaceFile(tempPath, targetPath)) {
+        QFile::remove(tempPath);
+        return LinkMode::None;
+    }
+    DownloadResumeJournal::remove(targetPath);
+
+    touch(path);
+    return mode;
+}
+
+DownloadCache::LinkMode DownloadCache::store(const QString &sha1, const QString &sourcePath)
+{
+    const QString path = objectPath(sha1);
+    if (path.isEmpty() || !QFileInfo(sourcePath).isFile()) {
+        return LinkMode::None;
+    }
+
+    if (QFileInfo::exists(path) && verifyObject(sha1, path)) {
+        touch(path);
+        return LinkMode::Hardlink;
+    }
+
+    if (!fileMatchesSha1(sourcePath, sha1)) {
+        qWarning() << "DownloadCache: refusing to store" << sourcePath << "- content does not match" << sha1;
+        return LinkMode::None;
+    }
+
+    if (!QDir().mkpath(QFileInfo(path).absolutePath())) {
+        return LinkMode::None;
+    }
+
+    const QString tempPath = tempPathFor(path);
+    const LinkMode mode = linkOrCopy(sourcePath, tempPath);
+    if (mode == LinkMode::None) {
+        QFile::remove(tempPath);
+        return LinkMode::None;
+    }
+
+    // 其他进程可能同时放入了同一个对象，内容相同，保留先到的即可
+    if (!QFile::rename(tempPath, path)) {
+        QFile::remove(tempPath);
+        return QFileInfo::exists(path) ? mode : LinkMode::None;
+    }
+    markVerified(path);
+    return mode;
+}
+
+qint64 DownloadCache::totalBytes() const
+{
+    if (!isEnabled()) {
+        return 0;
+    }
+
+    qint64 total = 0;
+    QDirIterator it(m_rootDir + QStringLiteral("/objects"), QDir::Files, QDirIterator::Subdirectories);
+    while (it.hasNext()) {
+        it.next();
+        total += it.fileInfo().size();
+    }
+    return total;
+}
+
+qint64 DownloadCache::evict()
+{
+    if (!isEnabled() || m_maxBytes <= 0) {
+        return 0;
+    }
+
+    struct Entry {
+        QString path;
+        qint64 size;
+        qint64 lastUsed;
+    };
+
+    QList<Entry> entries;
+    qint64 total = 0;
+    QDirIterator it(m_rootDir + QStringLiteral("/objects"), QDir::Files, QDirIterator::Subdirectories);
+    while (it.hasNext()) {
+        it.next();
+        const QFileInfo info = it.fileInfo();
+        if (!isValidSha1(info.fileName())) {
+            continue;  // 校验标记，或其他进程放入过程中的临时文件
+        }
+        // 仍链接在某个游戏目录中的对象删除后不释放空间，不计入也不淘汰
+        std::error_code ec;
+        const auto links = std::filesystem::hard_link_count(toFsPath(info.filePath()), ec);
+        if (ec || links > 1) {
+            continue;
+        }
+        entries.append({info.filePath(), info.size(), info.lastModified().toMSecsSinceEpoch()});
+        total += info.size();
+    }
+
+    if (total <= m_maxBytes) {
+        return 0;
+    }
+
+    std::sort(entries.begin(), entries.end(), [](const Entry &a, const Entry &b) {
+        return a.lastUsed < b.lastUsed;
+    });
+
+    qint64 freed = 0;
+    for (const Entry &entry : entries) {
+        if (total - freed <= m_maxBytes) {
+            break;
+        }
+        if (QFile::remove(entry.path)) {
+            QFile::remove(verifiedMarkerFor(entry.path));
+            freed += entry.size;
+        }
+    }
+
+    qInfo() << "DownloadCache: evicted" << freed << "bytes from" << m_rootDir;
+    return freed;
+}
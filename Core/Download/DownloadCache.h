@@ -0,0 +1,108 @@
+#ifndef DOWNLOADCACHE_H
+#define DOWNLOADCACHE_H
+
+#include <QString>
+
+/**
+ * @brief 按SHA-1寻址的本机共享下载缓存
+ *
+ * 多个游戏目录（各自的 libraries / assets/objects）共用同一份文件：
+ * 安装时先尝试从缓存中以硬链接（或写时复制克隆、或普通复制）的方式取出文件，
+ * 未命中才走网络；下载完成的文件再放回缓存。
+ *
+ * 目录结构：<根目录>/objects/<SHA-1前两位>/<SHA-1>，旁边的 <SHA-1>.verified 表示内容已校验过
+ *
+ * 缓存中的文件只读使用；通过硬链接取出的文件与缓存共享同一份数据，不应被原地修改。
+ */
+class DownloadCache
+{
+public:
+    /**
+     * @brief 文件从缓存取出或放入缓存的方式
+     */
+    enum class LinkMode {
+        None,        // 失败
+        Hardlink,    // 硬链接（不占额外空间）
+        Reflink,     // 写时复制克隆（Linux FICLONE / macOS clonefile）
+        Copy         // 普通复制
+    };
+
+    /**
+     * @brief 构造缓存
+     * @param rootDir 缓存根目录（为空表示禁用）
+     * @param maxBytes 缓存容量上限（<=0 表示不限制）
+     */
+    explicit DownloadCache(const QString &rootDir, qint64 maxBytes = 0);
+
+    bool isEnabled() const { return !m_rootDir.isEmpty(); }
+    QString rootDir() const { return m_rootDir; }
+    qint64 maxBytes() const { return m_maxBytes; }
+
+    /**
+     * @brief 获取某个对象在缓存中的路径
+     * @param sha1 十六进制SHA-1
+     * @return 路径（SHA-1无效时为空）
+     */
+    QString objectPath(const QString &sha1) const;
+
+    /**
+     * @brief 判断缓存中是否有该对象
+     * @param sha1 十六进制SHA-1
+     * @param expectedSize 期望大小（-1表示不检查）
+     */
+    bool contains(const QString &sha1, qint64 expectedSize = -1) const;
+
+    /**
+     * @brief 从缓存取出文件到目标路径
+     *
+     * 目标位置已有的文件（例如不完整的下载及其断点记录）会被原子地替换。
+     * 缓存中大小不符的对象视为损坏并删除；尚未校验过的对象先计算SHA-1，不一致时同样删除
+     * @param sha1 十六进制SHA-1
+     * @param targetPath 目标路径
+     * @param expectedSize 期望大小（-1表示不检查）
+     * @return 使用的方式；未命中或失败返回 LinkMode::None
+     */
+    LinkMode fetch(const QString &sha1, const QString &targetPath, qint64 expectedSize = -1) const;
+
+    /**
+     * @brief 将已下载并校验过的文件放入缓存
+     *
+     * 优先以硬链接方式放入，不额外占用空间；缓存中已有该对象时直接返回。
+     * 放入前校验文件内容，与SHA-1不一致时拒绝放入
+     * @param sha1 十六进制SHA-1
+     * @param sourcePath 源文件路径
+     * @return 使用的方式；失败返回 LinkMode::None
+     */
+    LinkMode store(const QString &sha1, const QString &sourcePath);
+
+    /**
+     * @brief 按最近使用时间淘汰对象，直到总大小不超过容量上限
+     *
+     * 命中的对象会刷新修改时间，因此最久未被使用的对象最先被淘汰。
+     * 仍以硬链接方式存在于游戏目录中的对象删除后不释放空间，既不计入总大小也不淘汰
+     * @return 释放的字节数
+     */
+    qint64 evict();
+
+    /**
+     * @brief 统计缓存中所有对象的总大小
+     */
+    qint64 totalBytes() const;
+
+private:
+    static bool isValidSha1(const QString &sha1);
+    static LinkMode linkOrCopy(const QString &sourcePath, const QString &targetPath);  // 目标不得已存在
+    static void touch(const QString &path);
+    static bool verifyObject(const QString &sha1, const QString &path);  // 未校验过时计算SHA-1，不一致则删除对象
+    static void dropObject(const QString &path);                        // 删除对象及其校验标记
+
+    QString m_rootDir;
+    qint64 m_maxBytes;
+};
+
+namespace AMCS::Core::Download
+{
+using ::DownloadCache;
+} // namespace AMCS::Core::Download
+
+#endif // DOWNLOADCACHE_H
@@ -0,0 +1,92 @@
+#include "DownloadService.h"
+#include <QCoreApplication>
+
+DownloadService::DownloadService()
+    : m_downloader(new AsulMultiDownloader)
+{
+    // 所有调用方共用安装时的配置：优先级区分客户端、库文件和资源文件
+    m_downloader->setMaxConcurrentDownloads(512);
+    m_downloader->setMaxConnectionsPerHost(512);
+    m_downloader->setLargeFileThreshold(5LL * 1024 * 1024);
+    m_downloader->setSegmentCountForLargeFile(8);
+    m_downloader->setMirrorHedgingEnabled(true);
+    // HTTP/2 由各请求的 DownloadTransport 选择，连接池按安装时的用量准备
+    m_downloader->setHttp2ConnectionsPerHost(4);
+    m_downloader->setHttp2MaxStreamsPerConnection(64);
+
+    // 下载器的定时器和结果处理不依赖任何调用方的事件循环
+    m_thread.setObjectName(QStringLiteral("DownloadService"));
+    m_downloader->moveToThread(&m_thread);
+    m_thread.start();
+
+    // 单例不会被析构，在 QCoreApplication 析构时停止线程（保留断点续传记录）
+    qAddPostRoutine([]() { DownloadService::getInstance()->shutdown(); });
+}
+
+DownloadService::~DownloadService()
+{
+    shutdown();
+}
+
+DownloadBatch *DownloadService::submit(const QList<DownloadRequest> &requests)
+{
+    QThread *caller = QThread::currentThread();
+    DownloadBatch *batch = nullptr;
+    runOnServiceThread([&]() {
+        batch = m_downloader->addBatch(requests);
+        // 交给调用方：之后的信号经事件循环在调用线程中处理
+        batch->setParent(nullptr);
+        batch->moveToThread(caller);
+    });
+    return batch;
+}
+
+QFuture<DownloadResult> DownloadService::download(const DownloadRequest &request)
+{
+    QFuture<DownloadResult> future;
+    runOnServiceThread([&]() { future = m_downloader->addDownloadAsync(request); });
+    return future;
+}
+
+void DownloadService::prewarm(const QList<DownloadRequest> &requests)
+{
+    runOnServiceThread([&]() { m_downloader->prewarm(requests); });
+}
+
+void DownloadService::configure(const std::function<void(AsulMultiDownloader *)> &fn)
+{
+    runOnServiceThread([&]() { fn(m_downloader); });
+}
+
+DownloadStatistics DownloadService::statistics() const
+{
+    // getStatistics 自带锁，可在任意线程调用
+    return m_downloader ? m_downloader->getStatistics() : DownloadStatistics();
+}
+
+void DownloadService::runOnServiceThread(const std::function<void()> &fn)
+{
+    if (!m_downloader) {
+        return;
+    }
+
+    if (QThread::currentThread() == &m_thread) {
+        fn();
+    } else {
+        QMetaObject::invokeMethod(m_downloader, fn, Qt::BlockingQueuedConnection);
+    }
+}
+
+void DownloadService::shutdown()
+{
+    if (!m_downloader) {
+        return;
+    }
+
+    // 在下载器所在线程中析构（中断进行中的任务、停止工作线程）；线程结束前会处理该删除
+    m_downloader->deleteLater();
+    m_downloader = nullptr;
+
+    m_thread.quit();
+    m_thread.wait();
+}
@@ -0,0 +1,83 @@
+#ifndef DOWNLOADSERVICE_H
+#define DOWNLOADSERVICE_H
+
+#include <QObject>
+#include <QThread>
+
+#include <functional>
+
+#include "AsulMultiDownloader.h"
+#include "../Common/singleton.h"
+
+/**
+ * @brief 进程内共享的下载服务
+ *
+ * 持有一个运行在独立线程中的 AsulMultiDownloader，进程内的安装和单文件下载都经由它进行：
+ * 每Host连接数、自适应并发、镜像健康度和限速由所有调用方共享；保存路径和摘要相同的
+ * 重复请求合并到在途任务上，不会重复下载、也不会并发写入同一个文件。
+ *
+ * 接口可在任意线程调用；批次句柄移交给调用线程，其信号在调用线程中发射
+ */
+class DownloadService : public QObject
+{
+    Q_OBJECT
+
+    Q_SINGLETON_CREATE(DownloadService)
+
+public:
+    ~DownloadService() override;
+
+    /**
+     * @brief 提交一批下载
+     *
+     * 批次句柄没有父对象、属于调用线程，由调用方在 DownloadBatch::finished 之后删除
+     * @param requests 下载描述列表
+     * @return 批次句柄（服务已关闭时返回nullptr）
+     */
+    DownloadBatch *submit(const QList<DownloadRequest> &requests);
+
+    /**
+     * @brief 提交单个下载，返回其结果的 QFuture（参见 AsulMultiDownloader::addDownloadAsync）
+     * @param request 下载描述
+     * @return 结果（服务已关闭时为已取消的 QFuture）
+     */
+    QFuture<DownloadResult> download(const DownloadRequest &request);
+
+    /**
+     * @brief 按下载计划预热域名解析和连接（参见 AsulMultiDownloader::prewarm）
+     *
+     * 预热的连接由共享下载器持有，之后任意调用方的请求都可以复用
+     * @param requests 下载计划（只使用 mirrors）
+     */
+    void prewarm(const QList<DownloadRequest> &requests);
+
+    /**
+     * @brief 在下载器所在线程中修改共享配置（调用线程等待其完成）
+     *
+     * 配置对所有调用方（包括其在途的批次）生效；只影响自身下载的设置应通过 DownloadRequest::transport 指定
+     * @param fn 配置函数
+     */
+    void configure(const std::function<void(AsulMultiDownloader *)> &fn);
+
+    /**
+     * @brief 获取共享下载器的统计信息（包含所有调用方的任务）
+     * @return 统计信息
+     */
+    DownloadStatistics statistics() const;
+
+private:
+    DownloadService();
+
+    void runOnServiceThread(const std::function<void()> &fn);  // 在下载器所在线程中同步执行
+    void shutdown();                                            // 应用退出时释放下载器并停止线程
+
+    QThread m_thread;
+    AsulMultiDownloader *m_downloader;  // 位于 m_thread 中（关闭后为空）
+};
+
+namespace AMCS::Core::Download
+{
+using ::DownloadService;
+} // namespace AMCS::Core::Download
+
+#endif // DOWNLOADSERVICE_H
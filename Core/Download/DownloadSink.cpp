@@ -0,0 +1,415 @@
+#include "DownloadSink.h"
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <QtEndian>
+#include <limits>
+#include <utility>
+
+#include <zlib.h>
+
+namespace
+{
+constexpr quint32 kLocalHeaderSignature = 0x04034b50;
+constexpr quint32 kCentralHeaderSignature = 0x02014b50;
+constexpr quint32 kEndOfCentralDirSignature = 0x06054b50;
+constexpr quint32 kDataDescriptorSignature = 0x08074b50;
+constexpr quint16 kZip64ExtraTag = 0x0001;
+constexpr quint16 kFlagEncrypted = 0x0001;
+constexpr quint16 kFlagDataDescriptor = 0x0008;
+constexpr quint16 kFlagUtf8 = 0x0800;
+constexpr quint16 kMethodStored = 0;
+constexpr quint16 kMethodDeflated = 8;
+constexpr int kLocalHeaderSize = 30;
+constexpr int kInflateChunk = 64 * 1024;
+constexpr qint64 kCompactThreshold = 1024 * 1024;  // 已处理的数据超过该值时从缓冲区移除
+
+quint16 readLe16(const uchar *p)
+{
+    return qFromLittleEndian<quint16>(p);
+}
+
+quint32 readLe32(const uchar *p)
+{
+    return qFromLittleEndian<quint32>(p);
+}
+
+quint64 readLe64(const uchar *p)
+{
+    return qFromLittleEndian<quint64>(p);
+}
+} // namespace
+
+// ==================== MemoryDownloadSink 实现 ====================
+
+void MemoryDownloadSink::reset()
+{
+    m_data.clear();
+    m_errorString.clear();
+}
+
+bool MemoryDownloadSink::write(const QByteArray &data)
+{
+    m_data.append(data);
+    return true;
+}
+
+bool MemoryDownloadSink::finish()
+{
+    return true;
+}
+
+// ==================== HashDownloadSink 实现 ====================
+
+HashDownloadSink::HashDownloadSink(QCryptographicHash::Algorithm algorithm)
+    : m_hash(algorithm)
+    , m_size(0)
+{
+}
+
+void HashDownloadSink::reset()
+{
+    m_hash.reset();
+    m_result.clear();
+    m_size = 0;
+    m_errorString.clear();
+}
+
+bool HashDownloadSink::write(const QByteArray &data)
+{
+    m_hash.addData(data);
+    m_size += data.size();
+    return true;
+}
+
+bool HashDownloadSink::finish()
+{
+    m_result = m_hash.result().toHex();
+    return true;
+}
+
+// ==================== ZipExtractDownloadSink 实现 ====================
+
+struct ZipExtractDownloadSink::Inflater {
+    z_stream stream;
+    Bytef out[kInflateChunk];
+
+    Inflater()
+    {
+        stream = z_stream();
+        inflateInit2(&stream, -MAX_WBITS);  // zip 中是不带 zlib 头的原始 Deflate 数据
+    }
+
+    ~Inflater()
+    {
+        inflateEnd(&stream);
+    }
+};
+
+ZipExtractDownloadSink::ZipExtractDownloadSink(EntryFilter filter)
+    : m_filter(std::move(filter))
+    , m_state(State::Header)
+    , m_failed(false)
+    , m_pos(0)
+    , m_flags(0)
+    , m_method(0)
+    , m_crc(0)
+    , m_remaining(0)
+    , m_zip64(false)
+    , m_actualCrc(0)
+    , m_inflater(std::make_unique<Inflater>())
+{
+}
+
+ZipExtractDownloadSink::~ZipExtractDownloadSink() = default;
+
+void ZipExtractDownloadSink::reset()
+{
+    closeOutput(false);
+    for (const QString &path : std::as_const(m_extracted)) {
+        QFile::remove(path);
+    }
+    m_extracted.clear();
+
+    m_input.clear();
+    m_pos = 0;
+    m_state = State::Header;
+    m_failed = false;
+    m_errorString.clear();
+}
+
+bool ZipExtractDownloadSink::write(const QByteArray &data)
+{
+    if (m_failed) {
+        return false;
+    }
+    if (m_state == State::Done || data.isEmpty()) {
+        return true;  // 中央目录及之后的数据不需要
+    }
+
+    m_input.append(data);
+    while (!m_failed && step()) {
+    }
+
+    // 移除已处理的数据，未处理的部分（例如不完整的文件头）留到下次
+    if (m_pos >= m_input.size()) {
+        m_input.clear();
+        m_pos = 0;
+    } else if (m_pos > kCompactThreshold) {
+        m_input.remove(0, m_pos);
+        m_pos = 0;
+    }
+    return !m_failed;
+}
+
+bool ZipExtractDownloadSink::finish()
+{
+    if (m_failed) {
+        return false;
+    }
+    if (m_state != State::Done && !(m_state == State::Header && available() == 0)) {
+        return fail(QStringLiteral("Truncated zip archive"));
+    }
+    return true;
+}
+
+bool ZipExtractDownloadSink::step()
+{
+    switch (m_state) {
+    case State::Header:
+        return readHeader();
+    case State::Data:
+        return readData();
+    case State::Descriptor:
+        return readDescriptor();
+    case State::Done:
+        break;
+    }
+    return false;
+}
+
+bool ZipExtractDownloadSink::readHeader()
+{
+    if (available() < 4) {
+        return false;
+    }
+
+    const quint32 signature = readLe32(cursor());
+    if (signature == kCentralHeaderSignature || signature == kEndOfCentralDirSignature) {
+        m_state = State::Done;
+        m_pos = m_input.size();
+        return false;
+    }
+    if (signature != kLocalHeaderSignature) {
+        return fail(QStringLiteral("Invalid zip local file header"));
+    }
+    if (available() < kLocalHeaderSize) {
+        return false;
+    }
+
+    const uchar *p = cursor();
+    const quint16 flags = readLe16(p + 6);
+    const quint16 method = readLe16(p + 8);
+    const quint32 crc = readLe32(p + 14);
+    quint64 compressedSize = readLe32(p + 18);
+    const quint64 uncompressedSize = readLe32(p + 22);
+    const int nameLength = readLe16(p + 26);
+    const int extraLength = readLe16(p + 28);
+    if (available() < kLocalHeaderSize + nameLength + extraLength) {
+        return false;
+    }
+
+    const QByteArray rawName(reinterpret_cast<const char *>(p + kLocalHeaderSize), nameLength);
+    m_entryName = (flags & kFlagUtf8) ? QString::fromUtf8(rawName) : QString::fromLatin1(rawName);
+
+    // Zip64：原大小、压缩后大小依次出现在扩展字段中（仅对应的32位字段为0xFFFFFFFF时）
+    m_zip64 = false;
+    const uchar *extra = p + kLocalHeaderSize + nameLength;
+    for (int i = 0; i + 4 <= extraLength;) {
+        const quint16 tag = readLe16(extra + i);
+        const int size = readLe16(extra + i + 2);
+        if (i + 4 + size > extraLength) {
+            break;
+        }
+        if (tag == kZip64ExtraTag) {
+            m_zip64 = true;
+            int field = i + 4;
+            if (uncompressedSize == 0xFFFFFFFFu && field + 8 <= i + 4 + size) {
+                field += 8;
+            }
+            if (compressedSize == 0xFFFFFFFFu && field + 8 <= i + 4 + size) {
+                compressedSize = readLe64(extra + field);
+            }
+        }
+        i += 4 + size;
+    }
+
+    if (flags & kFlagEncrypted) {
+        return fail(QStringLiteral("Encrypted zip entry is not supported: %1").arg(m_entryName));
+    }
+    if (method != kMethodStored && method != kMethodDeflated) {
+        return fail(QStringLiteral("Unsupported compression method %1 for zip entry: %2").arg(method).arg(m_entryName));
+    }
+    const bool hasDescriptor = flags & kFlagDataDescriptor;
+    if (hasDescriptor && method == kMethodStored) {
+        // 存储方式的条目没有结束标记，数据长度只在描述符和中央目录中，无法流式定位
+        return fail(QStringLiteral("Stored zip entry with data descriptor is not supported: %1").arg(m_entryName));
+    }
+
+    m_pos += kLocalHeaderSize + nameLength + extraLength;
+    m_flags = flags;
+    m_method = method;
+    m_crc = crc;
+    m_remaining = hasDescriptor ? -1 : qint64(compressedSize);
+    m_actualCrc = crc32(0L, Z_NULL, 0);
+    if (method == kMethodDeflated) {
+        inflateReset(&m_inflater->stream);
+    }
+
+    // 选择解压目标（目录条目没有数据需要写出）
+    const bool isDirectory = m_entryName.endsWith(QLatin1Char('/')) || m_entryName.endsWith(QLatin1Char('\\'));
+    const QString target = (isDirectory || !m_filter) ? QString() : m_filter(m_entryName);
+    if (!target.isEmpty()) {
+        if (!QDir().mkpath(QFileInfo(target).absolutePath())) {
+            return fail(QStringLiteral("Failed to create dir: %1").arg(QFileInfo(target).absolutePath()));
+        }
+        m_output = std::make_unique<QSaveFile>(target);
+        if (!m_output->open(QIODevice::WriteOnly)) {
+            m_output.reset();
+            return fail(QStringLiteral("Failed to write: %1").arg(target));
+        }
+    }
+
+    m_state = State::Data;
+    return true;
+}
+
+bool ZipExtractDownloadSink::readData()
+{
+    if (m_method == kMethodStored) {
+        const qint64 count = qMin(available(), m_remaining);
+        if (count > 0) {
+            if (!output(reinterpret_cast<const char *>(cursor()), count)) {
+                return false;
+            }
+            m_pos += count;
+            m_remaining -= count;
+        }
+        if (m_remaining > 0) {
+            return false;
+        }
+        return finishEntry(m_crc);
+    }
+
+    const qint64 count = m_remaining >= 0 ? qMin(available(), m_remaining) : available();
+    if (count == 0 && m_remaining != 0) {
+        return false;
+    }
+
+    z_stream &stream = m_inflater->stream;
+    stream.next_in = const_cast<Bytef *>(cursor());
+    stream.avail_in = uInt(qMin<qint64>(count, std::numeric_limits<uInt>::max()));
+    const uInt offered = stream.avail_in;
+
+    int ret = Z_OK;
+    do {
+        stream.next_out = m_inflater->out;
+        stream.avail_out = kInflateChunk;
+        ret = inflate(&stream, Z_NO_FLUSH);
+        if (ret != Z_OK && ret != Z_STREAM_END && ret != Z_BUF_ERROR) {
+            return fail(QStringLiteral("Corrupt deflate data in zip entry: %1").arg(m_entryName));
+        }
+        const qint64 produced = kInflateChunk - stream.avail_out;
+        if (produced > 0 && !output(reinterpret_cast<const char *>(m_inflater->out), produced)) {
+            return false;
+        }
+    } while (ret == Z_OK && (stream.avail_in > 0 || stream.avail_out == 0));
+
+    const qint64 consumed = offered - stream.avail_in;
+    m_pos += consumed;
+    if (m_remaining >= 0) {
+        m_remaining -= consumed;
+    }
+
+    if (ret == Z_STREAM_END) {
+        if (m_remaining > 0) {
+            return fail(QStringLiteral("Zip entry size mismatch: %1").arg(m_entryName));
+        }
+        if (m_flags & kFlagDataDescriptor) {
+            m_state = State::Descriptor;
+            return true;
+        }
+        return finishEntry(m_crc);
+    }
+    if (m_remaining == 0) {
+        return fail(QStringLiteral("Truncated deflate data in zip entry: %1").arg(m_entryName));
+    }
+    return false;
+}
+
+bool ZipExtractDownloadSink::readDescriptor()
+{
+    if (available() < 4) {
+        return false;
+    }
+
+    // 描述符的签名是可选的；Zip64 条目的大小字段为8字节
+    const bool hasSignature = readLe32(cursor()) == kDataDescriptorSignature;
+    const int size = (hasSignature ? 4 : 0) + 4 + (m_zip64 ? 16 : 8);
+    if (available() < size) {
+        return false;
+    }
+
+    const quint32 crc = readLe32(cursor() + (hasSignature ? 4 : 0));
+    m_pos += size;
+    return finishEntry(crc);
+}
+
+bool ZipExtractDownloadSink::finishEntry(quint32 expectedCrc)
+{
+    if (m_actualCrc != expectedCrc) {
+        return fail(QStringLiteral("CRC mismatch for zip entry: %1").arg(m_entryName));
+    }
+    const QString target = m_output ? m_output->fileName() : QString();
+    if (!closeOutput(true)) {
+        return fail(QStringLiteral("Failed to write: %1").arg(target));
+    }
+    m_state = State::Header;
+    return true;
+}
+
+bool ZipExtractDownloadSink::output(const char *data, qint64 size)
+{
+    m_actualCrc = crc32(m_actualCrc, reinterpret_cast<const Bytef *>(data), uInt(size));
+    if (m_output && m_output->write(data, size) != size) {
+        return fail(QStringLiteral("Failed to write: %1").arg(m_output->fileName()));
+    }
+    return true;
+}
+
+bool ZipExtractDownloadSink::closeOutput(bool commit)
+{
+    if (!m_output) {
+        return true;
+    }
+
+    std::unique_ptr<QSaveFile> file = std::move(m_output);
+    if (!commit) {
+        file->cancelWriting();
+        return true;
+    }
+    if (!file->commit()) {
+        return false;
+    }
+    m_extracted.append(file->fileName());
+    return true;
+}
+
+bool ZipExtractDownloadSink::fail(const QString &error)
+{
+    closeOutput(false);
+    m_failed = true;
+    m_errorString = error;
+    return false;
+}
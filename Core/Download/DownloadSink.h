@@ -0,0 +1,165 @@
+#ifndef DOWNLOADSINK_H
+#define DOWNLOADSINK_H
+
+#include <QByteArray>
+#include <QCryptographicHash>
+#include <QString>
+#include <QStringList>
+
+#include <functional>
+#include <memory>
+
+class QSaveFile;
+
+/**
+ * @brief 下载数据接收器
+ *
+ * 通过 DownloadRequest::sink 交给下载器后，任务收到的正文按顺序写入接收器：
+ * 保存路径为空时只写入接收器，不在磁盘上生成文件；否则同时写入文件（例如保存
+ * 版本JSON的同时直接解析，或保存natives jar的同时解压）。
+ * 使用接收器的任务始终单线程下载（数据必须按顺序到达）。
+ *
+ * 方法在任务所在线程中调用（可能是下载器的工作线程）；调用方应在任务完成信号
+ * 之后再读取结果，任务失败时结果无效。
+ */
+class DownloadSink
+{
+public:
+    virtual ~DownloadSink() = default;
+
+    /**
+     * @brief 开始一次新的尝试（首次启动、重试或切换镜像时调用），丢弃之前收到的数据
+     */
+    virtual void reset() = 0;
+
+    /**
+     * @brief 按顺序写入一块正文
+     * @return 是否成功（失败时任务以 errorString() 失败）
+     */
+    virtual bool write(const QByteArray &data) = 0;
+
+    /**
+     * @brief 全部正文已写入且通过校验
+     * @return 是否成功（失败时任务以 errorString() 失败）
+     */
+    virtual bool finish() = 0;
+
+    QString errorString() const { return m_errorString; }
+
+protected:
+    QString m_errorString;
+};
+
+/**
+ * @brief 把正文保存在内存中（元数据等小文件）
+ */
+class MemoryDownloadSink : public DownloadSink
+{
+public:
+    void reset() override;
+    bool write(const QByteArray &data) override;
+    bool finish() override;
+
+    QByteArray data() const { return m_data; }
+
+private:
+    QByteArray m_data;
+};
+
+/**
+ * @brief 只计算摘要、不保存正文（校验远端文件时使用）
+ */
+class HashDownloadSink : public DownloadSink
+{
+public:
+    explicit HashDownloadSink(QCryptographicHash::Algorithm algorithm = QCryptographicHash::Sha1);
+
+    void reset() override;
+    bool write(const QByteArray &data) override;
+    bool finish() override;
+
+    QByteArray result() const { return m_result; }  // 小写十六进制（完成后有效）
+    qint64 size() const { return m_size; }          // 收到的字节数
+
+private:
+    QCryptographicHash m_hash;
+    QByteArray m_result;
+    qint64 m_size;
+};
+
+/**
+ * @brief 边下载边解压 zip 中选定的条目
+ *
+ * 按本地文件头顺序解析到达的数据，不等待中央目录；支持存储和 Deflate 两种方式、
+ * 数据描述符（Deflate条目）和 Zip64 大小字段，并校验每个条目的 CRC-32。
+ * 每个条目先写入临时文件，完整且校验通过后再替换目标，多个接收器并发解压到
+ * 同一目录时不会出现半个文件。reset() 时删除本接收器已解压的文件
+ */
+class ZipExtractDownloadSink : public DownloadSink
+{
+public:
+    /**
+     * @brief 条目选择函数
+     * @param entryPath zip 中的条目路径
+     * @return 解压到的绝对路径（为空表示跳过该条目）
+     */
+    using EntryFilter = std::function<QString(const QString &entryPath)>;
+
+    explicit ZipExtractDownloadSink(EntryFilter filter);
+    ~ZipExtractDownloadSink() override;
+
+    void reset() override;
+    bool write(const QByteArray &data) override;
+    bool finish() override;
+
+    QStringList extractedFiles() const { return m_extracted; }  // 本次尝试已解压的文件
+
+private:
+    enum class State {
+        Header,      // 等待本地文件头
+        Data,        // 条目数据
+        Descriptor,  // 数据描述符
+        Done         // 已到中央目录，忽略其余数据
+    };
+
+    bool step();  // 处理一步，数据不足时返回false
+    bool readHeader();
+    bool readData();
+    bool readDescriptor();
+    bool finishEntry(quint32 expectedCrc);
+    bool output(const char *data, qint64 size);
+    bool closeOutput(bool commit);  // 提交或丢弃当前条目的临时文件
+    bool fail(const QString &error);
+    qint64 available() const { return m_input.size() - m_pos; }
+    const uchar *cursor() const { return reinterpret_cast<const uchar *>(m_input.constData()) + m_pos; }
+
+    EntryFilter m_filter;
+    State m_state;
+    bool m_failed;
+    QByteArray m_input;  // 尚未处理的数据（从 m_pos 开始）
+    qint64 m_pos;
+
+    // 当前条目
+    QString m_entryName;
+    quint16 m_flags;
+    quint16 m_method;
+    quint32 m_crc;           // 本地文件头中的CRC（使用数据描述符时无效）
+    qint64 m_remaining;      // 剩余的压缩数据字节数（-1表示由数据描述符给出）
+    bool m_zip64;
+    quint32 m_actualCrc;
+    std::unique_ptr<QSaveFile> m_output;  // 为空表示跳过该条目
+    struct Inflater;
+    std::unique_ptr<Inflater> m_inflater;
+
+    QStringList m_extracted;
+};
+
+namespace AMCS::Core::Download
+{
+using ::DownloadSink;
+using ::MemoryDownloadSink;
+using ::HashDownloadSink;
+using ::ZipExtractDownloadSink;
+} // namespace AMCS::Core::Download
+
+#endif // DOWNLOADSINK_H
@@ -0,0 +1,126 @@
+#include "InstallCheckpoint.h"
+
+#include <QDir>
+#include <QFile>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QSaveFile>
+
+namespace AMCS::Core::Launcher
+{
+namespace
+{
+constexpr int kFormatVersion = 1;
+} // namespace
+
+QString InstallCheckpoint::checkpointPath(const QString &versionDir, const QString &saveName)
+{
+    return QDir(versionDir).absoluteFilePath(saveName + QStringLiteral(".install"));
+}
+
+bool InstallCheckpoint::load(const QString &path, InstallCheckpoint *out)
+{
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+
+    QJsonParseError parseError;
+    const QJsonDocument doc = QJsonDocument::fromJson(file.readAll(), &parseError);
+    if (parseError.error != QJsonParseError::NoError || !doc.isObject()) {
+        return false;
+    }
+
+    const QJsonObject obj = doc.object();
+    if (obj.value(QStringLiteral("format")).toInt() != kFormatVersion) {
+        return false;
+    }
+
+    InstallCheckpoint checkpoint;
+    checkpoint.planKey = obj.value(QStringLiteral("planKey")).toString();
+
+    const QJsonArray items = obj.value(QStringLiteral("items")).toArray();
+    checkpoint.items.reserve(items.size());
+    for (const auto &val : items) {
+        const QJsonObject itemObj = val.toObject();
+        Item item;
+        for (const auto &url : itemObj.value(QStringLiteral("mirrors")).toArray()) {
+            item.mirrors.append(QUrl(url.toString()));
+        }
+        item.savePath = itemObj.value(QStringLiteral("path")).toString();
+        item.size = itemObj.value(QStringLiteral("size")).toVariant().toLongLong();
+        item.sha1 = itemObj.value(QStringLiteral("sha1")).toString();
+        item.priority = itemObj.value(QStringLiteral("priority")).toInt();
+        item.extractNatives = itemObj.value(QStringLiteral("natives")).toBool();
+        item.done = itemObj.value(QStringLiteral("done")).toBool();
+        if (item.mirrors.isEmpty() || item.savePath.isEmpty()) {
+            return false;
+        }
+        checkpoint.items.append(item);
+    }
+
+    for (const auto &val : obj.value(QStringLiteral("nativeJars")).toArray()) {
+        checkpoint.nativeJars.append(val.toString());
+    }
+
+    if (out) {
+        *out = checkpoint;
+    }
+    return true;
+}
+
+void InstallCheckpoint::remove(const QString &path)
+{
+    QFile::remove(path);
+}
+
+bool InstallCheckpoint::save(const QString &path) const
+{
+    QJsonArray itemArray;
+    for (const Item &item : items) {
+        QJsonArray mirrors;
+        for (const QUrl &url : item.mirrors) {
+            mirrors.append(url.toString());
+        }
+        QJsonObject itemObj;
+        itemObj.insert(QStringLiteral("mirrors"), mirrors);
+        itemObj.insert(QStringLiteral("path"), item.savePath);
+        itemObj.insert(QStringLiteral("size"), QString::number(item.size));
+        itemObj.insert(QStringLiteral("sha1"), item.sha1);
+        itemObj.insert(QStringLiteral("priority"), item.priority);
+        if (item.extractNatives) {
+            itemObj.insert(QStringLiteral("natives"), true);
+        }
+        if (item.done) {
+            itemObj.insert(QStringLiteral("done"), true);
+        }
+        itemArray.append(itemObj);
+    }
+
+    QJsonObject obj;
+    obj.insert(QStringLiteral("format"), kFormatVersion);
+    obj.insert(QStringLiteral("planKey"), planKey);
+    obj.insert(QStringLiteral("items"), itemArray);
+    obj.insert(QStringLiteral("nativeJars"), QJsonArray::fromStringList(nativeJars));
+
+    // Replaced atomically so a crash mid-write leaves the previous checkpoint intact
+    QSaveFile file(path);
+    if (!file.open(QIODevice::WriteOnly)) {
+        return false;
+    }
+    file.write(QJsonDocument(obj).toJson(QJsonDocument::Compact));
+    return file.commit();
+}
+
+int InstallCheckpoint::remainingCount() const
+{
+    int remaining = 0;
+    for (const Item &item : items) {
+        if (!item.done) {
+            remaining += 1;
+        }
+    }
+    return remaining;
+}
+} // namespace AMCS::Core::Launcher
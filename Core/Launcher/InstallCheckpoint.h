@@ -0,0 +1,37 @@
+#pragma once
+
+#include <QList>
+#include <QString>
+#include <QStringList>
+#include <QUrl>
+
+namespace AMCS::Core::Launcher
+{
+// The download plan of an installMCVersion call, kept in the version dir while the install runs.
+// An interrupted install picks up the remaining files from it instead of re-parsing the asset index
+// and re-checking every library and asset object.
+struct InstallCheckpoint
+{
+    struct Item
+    {
+        QList<QUrl> mirrors;
+        QString savePath;
+        qint64 size = -1;
+        QString sha1;
+        int priority = 0;
+        bool extractNatives = false;  // natives jar unpacked while it downloads
+        bool done = false;            // downloaded and verified (against sha1 when it is known)
+    };
+
+    QString planKey;         // identifies the inputs the plan was built from
+    QList<Item> items;       // files that had to be fetched when the plan was built
+    QStringList nativeJars;  // every natives jar of the version, fetched now or already present
+
+    static QString checkpointPath(const QString &versionDir, const QString &saveName);
+    static bool load(const QString &path, InstallCheckpoint *out);
+    static void remove(const QString &path);
+    bool save(const QString &path) const;
+
+    int remainingCount() const;
+};
+} // namespace AMCS::Core::Launcher
@@ -1,7 +1,9 @@
 #include "LauncherCore.h"
 
 #include "../CoreSettings.h"
+#include "InstallCheckpoint.h"
 
+#include <QCryptographicHash>
 #include <QDir>
 #include <QFile>
 #include <QFileInfo>
@@ -11,15 +13,25 @@
 #include <QSet>
 #include <QSysInfo>
 #include <QEventLoop>
+#include <QFutureWatcher>
+#include <QThreadPool>
 #include <QTimer>
 #include <QUrl>
 #include <QProcess>
+#include <QSaveFile>
 #include <QMap>
+#include <QHash>
 
 #include <quazip/quazip.h>
 #include <quazip/quazipfile.h>
 
 #include "../Download/AsulMultiDownloader.h"
+#include "../Download/DownloadCache.h"
+#include "../Download/DownloadService.h"
+#include "../Download/DownloadSink.h"
+#include "../Network/MetadataCache.h"
+
+#include <memory>
 
 namespace AMCS::Core::Launcher
 {
@@ -193,6 +205,21 @@ static QUrl applyMirrorUrl(const QUrl &url, Api::McApi::VersionSource source)
     return QUrl(replaced);
 }
 
+// Ordered download candidates: the selected source first, the other one as failover when the user opted in
+static QList<QUrl> mirrorCandidates(const QUrl &url, Api::McApi::VersionSource source)
+{
+    if (url.isEmpty()) {
+        return {};
+    }
+
+    const QUrl mirrored = applyMirrorUrl(url, Api::McApi::VersionSource::BMCLApi);
+    const bool failover = AMCS::Core::CoreSettings::getInstance()->getMirrorFailover();
+    if (source == Api::McApi::VersionSource::BMCLApi) {
+        return (failover && mirrored != url) ? QList<QUrl>{mirrored, url} : QList<QUrl>{mirrored};
+    }
+    return (failover && mirrored != url) ? QList<QUrl>{url, mirrored} : QList<QUrl>{url};
+}
+
 static QUrl assetUrlFromHash(const QString &hash)
 {
     if (hash.length() < 2) {
@@ -214,18 +241,62 @@ static QUrl buildBmclapiVersionUrl(const QString &versionId, const QString &cate
                     .arg(versionId, category));
 }
 
-static bool loadJsonFile(const QString &filePath, QJsonObject *outJson, QString *errorString)
+// One entry per distinct set of mirror hosts the install will contact, known as soon as version.json is parsed
+static QList<AMCS::Core::Download::DownloadRequest> hostWarmupPlan(const QJsonObject &versionJson,
+                                                                   Api::McApi::VersionSource source)
 {
-    QFile file(filePath);
-    if (!file.open(QIODevice::ReadOnly)) {
-        if (errorString) {
-            *errorString = QStringLiteral("Failed to open JSON: %1").arg(filePath);
+    QList<QUrl> urls;
+    const QJsonObject downloads = versionJson.value(QStringLiteral("downloads")).toObject();
+    urls.append(QUrl(downloads.value(QStringLiteral("client")).toObject().value(QStringLiteral("url")).toString()));
+    urls.append(QUrl(versionJson.value(QStringLiteral("assetIndex")).toObject().value(QStringLiteral("url")).toString()));
+    urls.append(assetUrlFromHash(QStringLiteral("00")));
+    for (const auto &libVal : versionJson.value(QStringLiteral("libraries")).toArray()) {
+        const QJsonObject libDownloads = libVal.toObject().value(QStringLiteral("downloads")).toObject();
+        urls.append(QUrl(libDownloads.value(QStringLiteral("artifact")).toObject().value(QStringLiteral("url")).toString()));
+        const QJsonObject classifiers = libDownloads.value(QStringLiteral("classifiers")).toObject();
+        for (auto it = classifiers.constBegin(); it != classifiers.constEnd(); ++it) {
+            urls.append(QUrl(it.value().toObject().value(QStringLiteral("url")).toString()));
         }
-        return false;
     }
 
+    QList<AMCS::Core::Download::DownloadRequest> plan;
+    QSet<QString> seen;
+    for (const QUrl &url : std::as_const(urls)) {
+        const QList<QUrl> mirrors = mirrorCandidates(url, source);
+        QStringList hosts;
+        for (const QUrl &mirror : mirrors) {
+            hosts.append(mirror.host());
+        }
+        const QString key = hosts.join(QLatin1Char(' '));
+        if (mirrors.isEmpty() || seen.contains(key)) {
+            continue;
+        }
+        seen.insert(key);
+        plan.emplaceBack(mirrors, QString());
+    }
+    return plan;
+}
+
+// A checkpoint is reused only when the plan would be built from the same version.json, mirrors and target dirs
+static QString installPlanKey(const QJsonObject &versionJson, Api::McApi::VersionSource source,
+                              const QString &librariesDir, const QString &objectsDir)
+{
+    QCryptographicHash hash(QCryptographicHash::Sha1);
+    hash.addData(QJsonDocument(versionJson).toJson(QJsonDocument::Compact));
+    hash.addData(QByteArray::number(static_cast<int>(source)));
+    hash.addData(librariesDir.toUtf8());
+    hash.addData(objectsDir.toUtf8());
+    return QString::fromLatin1(hash.result().toHex());
+}
+
+// Version JSONs fetched within this window are not revalidated again (repeated installs and launches)
+constexpr int kMetadataMaxAgeSeconds = 10 * 60;
+constexpr int kMetadataTimeoutMs = 30000;
+
+static bool parseJsonObject(const QByteArray &data, QJsonObject *outJson, QString *errorString)
+{
     QJsonParseError parseError;
-    const QJsonDocument doc = QJsonDocument::fromJson(file.readAll(), &parseError);
+    const QJsonDocument doc = QJsonDocument::fromJson(data, &parseError);
     if (parseError.error != QJsonParseError::NoError || !doc.isObject()) {
         if (errorString) {
             *errorString = parseError.errorString();
@@ -239,14 +310,38 @@ static bool loadJsonFile(const QString &filePath, QJsonObject *outJson, QString
     return true;
 }
 
-static bool downloadFileSync(const QUrl &url, const QString &savePath, QString *errorString)
+static bool loadJsonFile(const QString &filePath, QJsonObject *outJson, QString *errorString)
+{
+    QFile file(filePath);
+    if (!file.open(QIODevice::ReadOnly)) {
+        if (errorString) {
+            *errorString = QStringLiteral("Failed to open JSON: %1").arg(filePath);
+        }
+        return false;
+    }
+    return parseJsonObject(file.readAll(), outJson, errorString);
+}
+
+static bool needsDownload(const QFileInfo &fileInfo, qint64 expectedSize)
+{
+    if (!fileInfo.exists() || (expectedSize > 0 && fileInfo.size() != expectedSize)) {
+        return true;
+    }
+    // Downloads are staged and renamed into place when complete, but a file left by an older
+    // version may still be a preallocated partial file with a resume journal next to it
+    return AMCS::Core::Download::DownloadResumeJournal::exists(fileInfo.absoluteFilePath());
+}
+
+static bool downloadFileSync(const QList<QUrl> &urls, const QString &savePath, QString *errorString,
+                             const QString &expectedSha1 = QString(),
+                             const std::shared_ptr<AMCS::Core::Download::DownloadSink> &sink = nullptr)
 {
     QFileInfo fileInfo(savePath);
     if (fileInfo.exists() && fileInfo.size() > 0) {
         return true;
     }
 
-    if (!url.isValid() || url.isEmpty()) {
+    if (urls.isEmpty() || !urls.first().isValid()) {
         if (errorString) {
             *errorString = QStringLiteral("Download URL is empty");
         }
@@ -261,30 +356,34 @@ static bool downloadFileSync(const QUrl &url, const QString &savePath, QString *
         return false;
     }
 
-    AMCS::Core::Download::AsulMultiDownloader downloader;
-    downloader.setMaxConcurrentDownloads(4);
-    downloader.setMaxConnectionsPerHost(4);
-    downloader.setLargeFileThreshold(512 * 1024);
-    downloader.setSegmentCountForLargeFile(2);
+    // The shared service attaches to a download of the same file that another caller already started
+    // Metadata and single files are small: split only past 512 KB and into two segments at most
+    AMCS::Core::Download::DownloadRequest request(urls, savePath, -1, expectedSha1, 10);
+    request.sink = sink;
+    request.transport.largeFileThreshold = 512 * 1024;
+    request.transport.segmentCount = 2;
+    const QFuture<AMCS::Core::Download::DownloadResult> future =
+        AMCS::Core::Download::DownloadService::getInstance()->download(request);
 
-    bool failed = false;
-    QString failure;
+    // The result is filled in by the download thread; keep this thread's events flowing meanwhile
     QEventLoop loop;
+    QFutureWatcher<AMCS::Core::Download::DownloadResult> watcher;
+    QObject::connect(&watcher, &QFutureWatcherBase::finished, &loop, &QEventLoop::quit);
+    watcher.setFuture(future);
+    if (!future.isFinished()) {
+        loop.exec();
+    }
 
-    QObject::connect(&downloader, &AMCS::Core::Download::AsulMultiDownloader::downloadFailed,
-                     [&](const QString &, const QString &error) {
-                         failed = true;
-                         failure = error;
-                     });
-
-    QObject::connect(&downloader, &AMCS::Core::Download::AsulMultiDownloader::allDownloadsFinished, &loop, &QEventLoop::quit);
-
-    downloader.addDownload(url, savePath, 10);
-    loop.exec();
-
-    if (failed) {
+    if (future.resultCount() == 0) {
         if (errorString) {
-            *errorString = failure;
+            *errorString = QStringLiteral("Download service is not available");
+        }
+        return false;
+    }
+    const AMCS::Core::Download::DownloadResult result = future.result();
+    if (!result.success) {
+        if (errorString) {
+            *errorString = result.errorString;
         }
         return false;
     }
@@ -292,6 +391,107 @@ static bool downloadFileSync(const QUrl &url, const QString &savePath, QString *
     return QFileInfo(savePath).exists();
 }
 
+// SHA-1 of the copy fetchJsonFile last wrote, kept next to it to tell a local edit from a stale copy
+static QString fetchedHashPath(const QString &savePath)
+{
+    return savePath + QStringLiteral(".sha1");
+}
+
+// Downloads a JSON document, keeping a copy at savePath, and parses it from memory instead of reading the file back.
+// An existing copy is reused only while it is current: against expectedSha1 when there is one, otherwise against
+// the document the server returns (revalidated through the metadata cache). A copy edited after it was fetched is kept
+static bool fetchJsonFile(const QList<QUrl> &urls, const QString &savePath, QJsonObject *outJson, QString *errorString,
+                          const QString &expectedSha1 = QString())
+{
+    if (!expectedSha1.isEmpty()) {
+        QFile file(savePath);
+        if (file.open(QIODevice::ReadOnly)) {
+            const QByteArray data = file.readAll();
+            file.close();
+            if (QCryptographicHash::hash(data, QCryptographicHash::Sha1).toHex()
+                == expectedSha1.toLatin1().toLower()) {
+                return parseJsonObject(data, outJson, errorString);
+            }
+            // Superseded (e.g. an asset index that was updated upstream)
+            QFile::remove(savePath);
+        }
+
+        auto sink = std::make_shared<AMCS::Core::Download::MemoryDownloadSink>();
+        if (!downloadFileSync(urls, savePath, errorString, expectedSha1, sink)) {
+            return false;
+        }
+        return parseJsonObject(sink->data(), outJson, errorString);
+    }
+
+    const QFileInfo fileInfo(savePath);
+    const bool haveCopy = fileInfo.exists() && fileInfo.size() > 0;
+    AMCS::Core::Network::MetadataCache::Policy policy;
+    policy.maxAgeSeconds = kMetadataMaxAgeSeconds;
+
+    QString lastError = QStringLiteral("Download URL is empty");
+    for (const QUrl &url : urls) {
+        QNetworkRequest request(url);
+        request.setTransferTimeout(kMetadataTimeoutMs);
+        const auto response = AMCS::Core::Network::MetadataCache::getInstance()->get(request, policy);
+        QJsonObject json;
+        if (!response.isValid()) {
+            lastError = response.errorString;
+            continue;
+        }
+        if (!parseJsonObject(response.body, &json, &lastError)) {
+            continue;
+        }
+
+        // The cache only says whether the server's copy changed; what decides is the file on disk
+        const QByteArray upstreamHash = QCryptographicHash::hash(response.body, QCryptographicHash::Sha1).toHex();
+        bool upToDate = false;
+        QByteArray fetchedHash;
+        if (haveCopy) {
+            QFile local(savePath);
+            QFile record(fetchedHashPath(savePath));
+            const QByteArray localData = local.open(QIODevice::ReadOnly) ? local.readAll() : QByteArray();
+            fetchedHash = record.open(QIODevice::ReadOnly) ? record.readAll().trimmed() : QByteArray();
+            const QByteArray localHash = QCryptographicHash::hash(localData, QCryptographicHash::Sha1).toHex();
+            upToDate = localHash == upstreamHash;
+            if (!upToDate && !fetchedHash.isEmpty() && localHash != fetchedHash) {
+                qInfo().noquote() << "[metadata] keeping locally edited" << savePath;
+                return parseJsonObject(localData, outJson, errorString);
+            }
+        }
+        if (!upToDate) {
+            if (!QDir().mkpath(fileInfo.absolutePath())) {
+                lastError = QStringLiteral("Failed to create dir: %1").arg(fileInfo.absolutePath());
+                break;
+            }
+            QSaveFile file(savePath);
+            if (!file.open(QIODevice::WriteOnly) || file.write(response.body) != response.body.size()
+                || !file.commit()) {
+                lastError = QStringLiteral("Failed to write: %1").arg(savePath);
+                break;
+            }
+        }
+        QSaveFile record(fetchedHashPath(savePath));
+        if (fetchedHash != upstreamHash
+            && (!record.open(QIODevice::WriteOnly) || record.write(upstreamHash) != upstreamHash.size()
+                || !record.commit())) {
+            qWarning().noquote() << "[metadata] failed to record hash of" << savePath;
+        }
+        if (outJson) {
+            *outJson = json;
+        }
+        return true;
+    }
+
+    if (haveCopy) {
+        qWarning().noquote() << "[metadata] using local copy of" << savePath << "-" << lastError;
+        return loadJsonFile(savePath, outJson, errorString);
+    }
+    if (errorString) {
+        *errorString = lastError;
+    }
+    return false;
+}
+
 static bool shouldSkipZipEntry(const QString &path)
 {
     const QString clean = QDir::cleanPath(path).replace('\\', '/');
@@ -310,6 +510,20 @@ static bool shouldSkipZipEntry(const QString &path)
     return false;
 }
 
+// Natives are flattened into the natives dir; returns an empty path for entries that are not extracted
+static QString nativeEntryTarget(const QString &destDir, const QString &entryPath)
+{
+    if (entryPath.endsWith('/') || entryPath.endsWith('\\') || shouldSkipZipEntry(entryPath)) {
+        return QString();
+    }
+
+    const QString fileName = QFileInfo(entryPath).fileName();
+    if (fileName.isEmpty()) {
+        return QString();
+    }
+    return QDir(destDir).absoluteFilePath(fileName);
+}
+
 static bool extractZipToDir(const QString &zipPath, const QString &destDir, QString *errorString)
 {
     QuaZip zip(zipPath);
@@ -330,20 +544,15 @@ static bool extractZipToDir(const QString &zipPath, const QString &destDir, QStr
             continue;
         }
 
-        if (filePath.endsWith('/') || filePath.endsWith('\\') || fileInfo.isSymbolicLink()) {
-            continue;
-        }
-        if (shouldSkipZipEntry(filePath)) {
+        if (fileInfo.isSymbolicLink()) {
             continue;
         }
 
-        const QString fileName = QFileInfo(filePath).fileName();
-        if (fileName.isEmpty()) {
+        const QString outPath = nativeEntryTarget(baseDir, filePath);
+        if (outPath.isEmpty()) {
             continue;
         }
 
-        const QString outPath = QDir(baseDir).absoluteFilePath(fileName);
-
         QuaZipFile zipFile(&zip);
         if (!zipFile.open(QIODevice::ReadOnly)) {
             if (errorString) {
@@ -544,146 +753,212 @@ bool LauncherCore::installMCVersion(const Api::McApi::MCVersion &version,
     const QString versionDir = QDir(versionsDir).absoluteFilePath(effectiveSaveName);
     const QString versionJsonPath = QDir(versionDir).absoluteFilePath(effectiveSaveName + QStringLiteral(".json"));
 
-    QUrl versionJsonUrl;
+    QList<QUrl> versionJsonUrls = mirrorCandidates(QUrl(version.url), source);
     if (source == Api::McApi::VersionSource::BMCLApi) {
-        versionJsonUrl = buildBmclapiVersionUrl(version.id, QStringLiteral("json"));
-    } else {
-        versionJsonUrl = applyMirrorUrl(QUrl(version.url), source);
-    }
-    if (!downloadFileSync(versionJsonUrl, versionJsonPath, &m_lastError)) {
-        return false;
+        versionJsonUrls.prepend(buildBmclapiVersionUrl(version.id, QStringLiteral("json")));
     }
-
     QJsonObject versionJson;
-    if (!loadJsonFile(versionJsonPath, &versionJson, &m_lastError)) {
+    if (!fetchJsonFile(versionJsonUrls, versionJsonPath, &versionJson, &m_lastError)) {
         return false;
     }
 
     const QJsonObject assetIndexObj = versionJson.value(QStringLiteral("assetIndex")).toObject();
     const QString assetIndexId = assetIndexObj.value(QStringLiteral("id")).toString();
     const QString assetIndexUrl = assetIndexObj.value(QStringLiteral("url")).toString();
+    const QString assetIndexSha1 = assetIndexObj.value(QStringLiteral("sha1")).toString();
     if (assetIndexId.isEmpty() || assetIndexUrl.isEmpty()) {
         m_lastError = QStringLiteral("version.json missing assetIndex");
         return false;
     }
 
-    const QString assetIndexPath = QDir(indexesDir).absoluteFilePath(assetIndexId + QStringLiteral(".json"));
-    if (!downloadFileSync(applyMirrorUrl(QUrl(assetIndexUrl), source), assetIndexPath, &m_lastError)) {
+    // The client, libraries and assets go through the process-wide download service; priorities order them
+    // (client > libraries > assets), and files another install is already fetching are downloaded only once.
+    // HTTP/2 is chosen per request so other callers of the shared downloader keep their own transport
+    auto *downloadService = AMCS::Core::Download::DownloadService::getInstance();
+    AMCS::Core::Download::DownloadTransport transport;
+    transport.http2 = settings->getHttp2AssetDownloads();
+    QList<AMCS::Core::Download::DownloadRequest> warmupPlan = hostWarmupPlan(versionJson, source);
+    for (AMCS::Core::Download::DownloadRequest &request : warmupPlan) {
+        request.transport = transport;
+    }
+    // Resolve every host and open warm connections while the asset index is fetched and the file list is built
+    downloadService->prewarm(warmupPlan);
+
+    AMCS::Core::Download::DownloadCache sharedCache(settings->getSharedCacheDir(), settings->getSharedCacheMaxBytes());
+    // Files with a known SHA-1 are linked in from the shared store when another game directory already has them
+    QHash<QString, QString> cacheKeys;
+    int cacheHits = 0;
+    auto takeFromCache = [&](const QString &sha1, const QString &savePath, qint64 size) {
+        if (!sharedCache.isEnabled() || sha1.isEmpty()) {
+            return false;
+        }
+        if (sharedCache.fetch(sha1, savePath, size > 0 ? size : -1)
+            != AMCS::Core::Download::DownloadCache::LinkMode::None) {
+            cacheHits += 1;
+            return true;
+        }
+        cacheKeys.insert(savePath, sha1);
         return false;
-    }
+    };
+
+    QList<AMCS::Core::Download::DownloadRequest> requests;
 
-    QJsonObject assetIndexJson;
-    if (!loadJsonFile(assetIndexPath, &assetIndexJson, &m_lastError)) {
+    const QString nativeDestDir = QDir(versionDir).absoluteFilePath(effectiveSaveName + QStringLiteral("-natives"));
+    if (!QDir().mkpath(nativeDestDir)) {
+        m_lastError = QStringLiteral("Failed to create natives dir");
         return false;
     }
 
-    AMCS::Core::Download::AsulMultiDownloader assetsDownloader;
-    AMCS::Core::Download::AsulMultiDownloader librariesDownloader;
-    AMCS::Core::Download::AsulMultiDownloader versionDownloader;
-
-    librariesDownloader.setMaxConcurrentDownloads(64);
-    librariesDownloader.setMaxConnectionsPerHost(64);
-    librariesDownloader.setLargeFileThreshold(5LL * 1024 * 1024);
-    librariesDownloader.setSegmentCountForLargeFile(4);
-
-    assetsDownloader.setMaxConcurrentDownloads(512);
-    assetsDownloader.setMaxConnectionsPerHost(512);
-    assetsDownloader.setLargeFileThreshold(1LL * 1024 * 1024);
-    assetsDownloader.setSegmentCountForLargeFile(4);
-
-    versionDownloader.setLargeFileThreshold(10LL * 1024 * 1024);
-    versionDownloader.setSegmentCountForLargeFile(8);
-
     emit installPhaseChanged(QStringLiteral("download"));
 
     QSet<QString> nativeJarPaths;
+    // Natives jars that are downloaded now are unpacked as they arrive instead of being reopened afterwards
+    QHash<QString, std::shared_ptr<AMCS::Core::Download::ZipExtractDownloadSink>> nativeSinks;
+    auto extractWhileDownloading = [&](const QString &jarPath) {
+        auto sink = std::make_shared<AMCS::Core::Download::ZipExtractDownloadSink>(
+            [nativeDestDir](const QString &entryPath) { return nativeEntryTarget(nativeDestDir, entryPath); });
+        requests.last().sink = sink;
+        nativeSinks.insert(jarPath, sink);
+    };
 
     int totalTasks = 0;
-    int completedTasks = 0;
-    int failedTasks = 0;
     qint64 plannedTotal = 0;
 
-    const QString jarPath = QDir(versionDir).absoluteFilePath(effectiveSaveName + QStringLiteral(".jar"));
-    const QJsonObject downloads = versionJson.value(QStringLiteral("downloads")).toObject();
-    const QJsonObject clientObj = downloads.value(QStringLiteral("client")).toObject();
-    QString clientUrl;
-    if (source == Api::McApi::VersionSource::BMCLApi) {
-        clientUrl = buildBmclapiVersionUrl(version.id, QStringLiteral("client")).toString();
-    } else {
-        clientUrl = applyMirrorUrl(QUrl(clientObj.value(QStringLiteral("url")).toString()), source).toString();
-    }
-    if (!clientUrl.isEmpty()) {
-        const qint64 size = clientObj.value(QStringLiteral("size")).toVariant().toLongLong();
-        QFileInfo fileInfo(jarPath);
-        if (!fileInfo.exists() || (size > 0 && fileInfo.size() != size)) {
-            versionDownloader.addDownload(QUrl(clientUrl), jarPath, 10, size);
+    // An interrupted install leaves its plan behind; with the same inputs only the unfinished files are left
+    const QString assetIndexPath = QDir(indexesDir).absoluteFilePath(assetIndexId + QStringLiteral(".json"));
+    const QString checkpointPath = InstallCheckpoint::checkpointPath(versionDir, effectiveSaveName);
+    const QString planKey = installPlanKey(versionJson, source, librariesDir, objectsDir);
+    InstallCheckpoint checkpoint;
+    const bool resumed = InstallCheckpoint::load(checkpointPath, &checkpoint)
+                         && checkpoint.planKey == planKey && QFileInfo::exists(assetIndexPath);
+
+    if (resumed) {
+        qInfo().noquote() << "[checkpoint] resuming install," << checkpoint.remainingCount() << "of"
+                          << checkpoint.items.size() << "files left";
+        for (InstallCheckpoint::Item &item : checkpoint.items) {
+            if (item.done) {
+                continue;
+            }
+            // Files are renamed into place only once complete, so one that is there now was finished
+            // after the last checkpoint write
+            if (!needsDownload(QFileInfo(item.savePath), item.size)
+                || takeFromCache(item.sha1, item.savePath, item.size)) {
+                item.done = true;
+                continue;
+            }
+            requests.emplaceBack(item.mirrors, item.savePath, item.size, item.sha1, item.priority);
+            if (item.extractNatives) {
+                extractWhileDownloading(item.savePath);
+            }
             totalTasks += 1;
-            if (size > 0) {
-                plannedTotal += size;
+            if (item.size > 0) {
+                plannedTotal += item.size;
             }
         }
-    }
-
-    const QJsonArray libraries = versionJson.value(QStringLiteral("libraries")).toArray();
-    int nativeLibCount = 0;
-    int nativeMatchCount = 0;
-    int nativeLogCount = 0;
-    for (const auto &libVal : libraries) {
-        const QJsonObject libObj = libVal.toObject();
-        const QJsonArray rules = libObj.value(QStringLiteral("rules")).toArray();
-        if (!ruleAllows(rules)) {
-            continue;
+        nativeJarPaths = QSet<QString>(checkpoint.nativeJars.cbegin(), checkpoint.nativeJars.cend());
+    } else {
+        QJsonObject assetIndexJson;
+        if (takeFromCache(assetIndexSha1, assetIndexPath, -1)) {
+            if (!loadJsonFile(assetIndexPath, &assetIndexJson, &m_lastError)) {
+                return false;
+            }
+        } else {
+            if (!fetchJsonFile(mirrorCandidates(QUrl(assetIndexUrl), source), assetIndexPath, &assetIndexJson,
+                               &m_lastError, assetIndexSha1)) {
+                return false;
+            }
+            if (sharedCache.isEnabled() && !assetIndexSha1.isEmpty()) {
+                sharedCache.store(assetIndexSha1, assetIndexPath);
+            }
         }
 
-        const QJsonObject libDownloads = libObj.value(QStringLiteral("downloads")).toObject();
-        const QJsonObject artifact = libDownloads.value(QStringLiteral("artifact")).toObject();
-        const QString artifactPath = artifact.value(QStringLiteral("path")).toString();
-        const QString artifactUrl = applyMirrorUrl(QUrl(artifact.value(QStringLiteral("url")).toString()), source).toString();
-        const qint64 artifactSize = artifact.value(QStringLiteral("size")).toVariant().toLongLong();
-        if (!artifactPath.isEmpty() && !artifactUrl.isEmpty()) {
-            const QString savePath = QDir(librariesDir).absoluteFilePath(artifactPath);
-            QFileInfo fileInfo(savePath);
-            if (!fileInfo.exists() || (artifactSize > 0 && fileInfo.size() != artifactSize)) {
-                librariesDownloader.addDownload(QUrl(artifactUrl), savePath, 5, artifactSize);
+        const QString jarPath = QDir(versionDir).absoluteFilePath(effectiveSaveName + QStringLiteral(".jar"));
+        const QJsonObject downloads = versionJson.value(QStringLiteral("downloads")).toObject();
+        const QJsonObject clientObj = downloads.value(QStringLiteral("client")).toObject();
+        QList<QUrl> clientUrls = mirrorCandidates(QUrl(clientObj.value(QStringLiteral("url")).toString()), source);
+        if (source == Api::McApi::VersionSource::BMCLApi) {
+            clientUrls.prepend(buildBmclapiVersionUrl(version.id, QStringLiteral("client")));
+        }
+        if (!clientUrls.isEmpty()) {
+            const qint64 size = clientObj.value(QStringLiteral("size")).toVariant().toLongLong();
+            const QString sha1 = clientObj.value(QStringLiteral("sha1")).toString();
+            QFileInfo fileInfo(jarPath);
+            if (needsDownload(fileInfo, size) && !takeFromCache(sha1, jarPath, size)) {
+                requests.emplaceBack(clientUrls, jarPath, size, sha1, 10);
                 totalTasks += 1;
-                if (artifactSize > 0) {
-                    plannedTotal += artifactSize;
+                if (size > 0) {
+                    plannedTotal += size;
                 }
             }
         }
 
-        const QString nativeKey = resolveNativeClassifier(libObj);
-        if (!nativeKey.isEmpty()) {
-            nativeLibCount += 1;
-            const QJsonObject classifiers = libDownloads.value(QStringLiteral("classifiers")).toObject();
-            const QJsonObject nativeObj = classifiers.value(nativeKey).toObject();
-            if (nativeObj.isEmpty() && nativeLogCount < 10) {
-                qInfo().noquote() << "[natives] missing classifier" << nativeKey
-                                 << "lib" << libObj.value(QStringLiteral("name")).toString();
-                nativeLogCount += 1;
+        const QJsonArray libraries = versionJson.value(QStringLiteral("libraries")).toArray();
+        int nativeLibCount = 0;
+        int nativeMatchCount = 0;
+        int nativeLogCount = 0;
+        for (const auto &libVal : libraries) {
+            const QJsonObject libObj = libVal.toObject();
+            const QJsonArray rules = libObj.value(QStringLiteral("rules")).toArray();
+            if (!ruleAllows(rules)) {
+                continue;
             }
-            const QString nativePath = nativeObj.value(QStringLiteral("path")).toString();
-            const QString nativeUrl = applyMirrorUrl(QUrl(nativeObj.value(QStringLiteral("url")).toString()), source).toString();
-            const qint64 nativeSize = nativeObj.value(QStringLiteral("size")).toVariant().toLongLong();
-            if (!nativePath.isEmpty() && !nativeUrl.isEmpty()) {
-                const QString savePath = QDir(librariesDir).absoluteFilePath(nativePath);
+
+            const QJsonObject libDownloads = libObj.value(QStringLiteral("downloads")).toObject();
+            const QJsonObject artifact = libDownloads.value(QStringLiteral("artifact")).toObject();
+            const QString artifactPath = artifact.value(QStringLiteral("path")).toString();
+            const QList<QUrl> artifactUrls = mirrorCandidates(QUrl(artifact.value(QStringLiteral("url")).toString()), source);
+            const qint64 artifactSize = artifact.value(QStringLiteral("size")).toVariant().toLongLong();
+            const QString artifactSha1 = artifact.value(QStringLiteral("sha1")).toString();
+            const QString nativeKey = resolveNativeClassifier(libObj);
+            const QString libName = libObj.value(QStringLiteral("name")).toString();
+            const QString classifier = libraryClassifierFromName(libName);
+            const bool artifactIsNative = nativeKey.isEmpty() && isNewFormatNativeArtifact(artifactPath, classifier)
+                                          && classifierMatchesOsAndArch(classifier);
+            if (!artifactPath.isEmpty() && !artifactUrls.isEmpty()) {
+                const QString savePath = QDir(librariesDir).absoluteFilePath(artifactPath);
                 QFileInfo fileInfo(savePath);
-                if (!fileInfo.exists() || (nativeSize > 0 && fileInfo.size() != nativeSize)) {
-                    librariesDownloader.addDownload(QUrl(nativeUrl), savePath, 5, nativeSize);
+                if (needsDownload(fileInfo, artifactSize) && !takeFromCache(artifactSha1, savePath, artifactSize)) {
+                    requests.emplaceBack(artifactUrls, savePath, artifactSize, artifactSha1, 5);
+                    if (artifactIsNative) {
+                        extractWhileDownloading(savePath);
+                    }
                     totalTasks += 1;
-                    if (nativeSize > 0) {
-                        plannedTotal += nativeSize;
+                    if (artifactSize > 0) {
+                        plannedTotal += artifactSize;
                     }
                 }
-                nativeJarPaths.insert(savePath);
-                nativeMatchCount += 1;
             }
-        } else {
-            const QString libName = libObj.value(QStringLiteral("name")).toString();
-            const QString classifier = libraryClassifierFromName(libName);
-            if (isNewFormatNativeArtifact(artifactPath, classifier)) {
+
+            if (!nativeKey.isEmpty()) {
                 nativeLibCount += 1;
-                if (classifierMatchesOsAndArch(classifier)) {
+                const QJsonObject classifiers = libDownloads.value(QStringLiteral("classifiers")).toObject();
+                const QJsonObject nativeObj = classifiers.value(nativeKey).toObject();
+                if (nativeObj.isEmpty() && nativeLogCount < 10) {
+                    qInfo().noquote() << "[natives] missing classifier" << nativeKey
+                                     << "lib" << libObj.value(QStringLiteral("name")).toString();
+                    nativeLogCount += 1;
+                }
+                const QString nativePath = nativeObj.value(QStringLiteral("path")).toString();
+                const QList<QUrl> nativeUrls = mirrorCandidates(QUrl(nativeObj.value(QStringLiteral("url")).toString()), source);
+                const qint64 nativeSize = nativeObj.value(QStringLiteral("size")).toVariant().toLongLong();
+                const QString nativeSha1 = nativeObj.value(QStringLiteral("sha1")).toString();
+                if (!nativePath.isEmpty() && !nativeUrls.isEmpty()) {
+                    const QString savePath = QDir(librariesDir).absoluteFilePath(nativePath);
+                    QFileInfo fileInfo(savePath);
+                    if (needsDownload(fileInfo, nativeSize) && !takeFromCache(nativeSha1, savePath, nativeSize)) {
+                        requests.emplaceBack(nativeUrls, savePath, nativeSize, nativeSha1, 5);
+                        extractWhileDownloading(savePath);
+                        totalTasks += 1;
+                        if (nativeSize > 0) {
+                            plannedTotal += nativeSize;
+                        }
+                    }
+                    nativeJarPaths.insert(savePath);
+                    nativeMatchCount += 1;
+                }
+            } else if (isNewFormatNativeArtifact(artifactPath, classifier)) {
+                nativeLibCount += 1;
+                if (artifactIsNative) {
                     if (!artifactPath.isEmpty()) {
                         const QString savePath = QDir(librariesDir).absoluteFilePath(artifactPath);
                         nativeJarPaths.insert(savePath);
@@ -696,93 +971,91 @@ bool LauncherCore::installMCVersion(const Api::McApi::MCVersion &version,
                 }
             }
         }
-    }
-    qInfo().noquote() << "[natives] libraries with natives:" << nativeLibCount
-                      << "matched:" << nativeMatchCount;
+        qInfo().noquote() << "[natives] libraries with natives:" << nativeLibCount
+                          << "matched:" << nativeMatchCount;
+
+        const QJsonObject objects = assetIndexJson.value(QStringLiteral("objects")).toObject();
+        for (auto it = objects.constBegin(); it != objects.constEnd(); ++it) {
+            const QJsonObject obj = it.value().toObject();
+            const QString hash = obj.value(QStringLiteral("hash")).toString();
+            if (hash.isEmpty()) {
+                continue;
+            }
+            const QUrl url = assetUrlFromHash(hash);
+            const QString prefix = hash.left(2);
+            const QString savePath = QDir(objectsDir).absoluteFilePath(prefix + QStringLiteral("/") + hash);
+            const qint64 size = obj.value(QStringLiteral("size")).toVariant().toLongLong();
+            QFileInfo fileInfo(savePath);
+            if (needsDownload(fileInfo, size) && !takeFromCache(hash, savePath, size)) {
+                requests.emplaceBack(mirrorCandidates(url, source), savePath, size, hash, 0);
+                totalTasks += 1;
+                if (size > 0) {
+                    plannedTotal += size;
+                }
+            }
+        }
 
-    const QJsonObject objects = assetIndexJson.value(QStringLiteral("objects")).toObject();
-    for (auto it = objects.constBegin(); it != objects.constEnd(); ++it) {
-        const QJsonObject obj = it.value().toObject();
-        const QString hash = obj.value(QStringLiteral("hash")).toString();
-        if (hash.isEmpty()) {
-            continue;
+        if (sharedCache.isEnabled()) {
+            qInfo().noquote() << "[cache] files taken from shared cache:" << cacheHits;
         }
-        const QUrl url = assetUrlFromHash(hash);
-        const QString prefix = hash.left(2);
-        const QString savePath = QDir(objectsDir).absoluteFilePath(prefix + QStringLiteral("/") + hash);
-        const qint64 size = obj.value(QStringLiteral("size")).toVariant().toLongLong();
-        QFileInfo fileInfo(savePath);
-        if (!fileInfo.exists() || (size > 0 && fileInfo.size() != size)) {
-            const QString mirrorUrl = applyMirrorUrl(url, source).toString();
-            assetsDownloader.addDownload(QUrl(mirrorUrl), savePath, 0, size);
-            totalTasks += 1;
-            if (size > 0) {
-                plannedTotal += size;
-            }
+
+        checkpoint.planKey = planKey;
+        for (const AMCS::Core::Download::DownloadRequest &request : std::as_const(requests)) {
+            InstallCheckpoint::Item item;
+            item.mirrors = request.mirrors;
+            item.savePath = request.savePath;
+            item.size = request.size;
+            item.sha1 = request.sha1;
+            item.priority = request.priority;
+            item.extractNatives = request.sink != nullptr;
+            checkpoint.items.append(item);
         }
+        checkpoint.nativeJars = QStringList(nativeJarPaths.cbegin(), nativeJarPaths.cend());
     }
+    checkpoint.save(checkpointPath);
 
-    bool librariesFinished = false;
-    bool assetsFinished = false;
-    bool versionFinished = false;
-    bool failed = false;
+    for (AMCS::Core::Download::DownloadRequest &request : requests) {
+        request.transport = transport;
+    }
 
     QEventLoop loop;
+    std::unique_ptr<AMCS::Core::Download::DownloadBatch> batch(downloadService->submit(requests));
+    if (!batch) {
+        m_lastError = QStringLiteral("Download service is not available");
+        return false;
+    }
 
-    auto tryFinishAll = [&]() {
-        if (librariesFinished && assetsFinished && versionFinished) {
-            loop.quit();
+    // Each file goes into the shared cache on the thread pool as soon as it lands
+    QList<QFuture<void>> cacheStores;
+    if (sharedCache.isEnabled()) {
+        const auto storeInCache = [&sharedCache, &cacheKeys](const AMCS::Core::Download::DownloadResult &result) {
+            const QString sha1 = cacheKeys.value(result.savePath);
+            if (result.success && !sha1.isEmpty()) {
+                sharedCache.store(sha1, result.savePath);
+            }
+        };
+        for (auto taskFuture : batch->taskFutures()) {
+            cacheStores.append(taskFuture.then(QThreadPool::globalInstance(), storeInCache));
         }
-    };
+    }
 
-    QObject::connect(&librariesDownloader, &AMCS::Core::Download::AsulMultiDownloader::downloadFailed,
-                     [&](const QString &, const QString &error) {
-                         failed = true;
-                         m_lastError = error;
-                         failedTasks += 1;
-                     });
-    QObject::connect(&assetsDownloader, &AMCS::Core::Download::AsulMultiDownloader::downloadFailed,
-                     [&](const QString &, const QString &error) {
-                         failed = true;
-                         m_lastError = error;
-                         failedTasks += 1;
-                     });
-    QObject::connect(&versionDownloader, &AMCS::Core::Download::AsulMultiDownloader::downloadFailed,
-                     [&](const QString &, const QString &error) {
-                         failed = true;
-                         m_lastError = error;
-                         failedTasks += 1;
-                     });
-
-    QObject::connect(&librariesDownloader, &AMCS::Core::Download::AsulMultiDownloader::downloadFinished,
-                     [&](const QString &, const QString &) { completedTasks += 1; });
-    QObject::connect(&assetsDownloader, &AMCS::Core::Download::AsulMultiDownloader::downloadFinished,
-                     [&](const QString &, const QString &) { completedTasks += 1; });
-    QObject::connect(&versionDownloader, &AMCS::Core::Download::AsulMultiDownloader::downloadFinished,
-                     [&](const QString &, const QString &) { completedTasks += 1; });
-
-    QObject::connect(&librariesDownloader, &AMCS::Core::Download::AsulMultiDownloader::allDownloadsFinished, [&]() {
-        librariesFinished = true;
-        tryFinishAll();
-    });
-    QObject::connect(&assetsDownloader, &AMCS::Core::Download::AsulMultiDownloader::allDownloadsFinished, [&]() {
-        assetsFinished = true;
-        tryFinishAll();
-    });
-    QObject::connect(&versionDownloader, &AMCS::Core::Download::AsulMultiDownloader::allDownloadsFinished, [&]() {
-        versionFinished = true;
-        tryFinishAll();
-    });
+    QObject::connect(batch.get(), &AMCS::Core::Download::DownloadBatch::finished, &loop, &QEventLoop::quit);
 
-    if (librariesDownloader.getAllTaskIds().isEmpty()) {
-        librariesFinished = true;
-    }
-    if (assetsDownloader.getAllTaskIds().isEmpty()) {
-        assetsFinished = true;
-    }
-    if (versionDownloader.getAllTaskIds().isEmpty()) {
-        versionFinished = true;
+    // Finished files are recorded as they land; the checkpoint is rewritten from the progress timer
+    QHash<QString, qsizetype> checkpointIndex;
+    for (qsizetype i = 0; i < checkpoint.items.size(); ++i) {
+        checkpointIndex.insert(checkpoint.items.at(i).savePath, i);
     }
+    bool checkpointDirty = false;
+    QObject::connect(batch.get(), &AMCS::Core::Download::DownloadBatch::taskFinished, &loop,
+                     [&](const QString &, const QString &savePath) {
+        const auto it = checkpointIndex.constFind(savePath);
+        if (it != checkpointIndex.cend()) {
+            checkpoint.items[it.value()].done = true;
+            checkpointDirty = true;
+        }
+    });
+    int progressTicks = 0;
 
     QTimer progressTimer;
     InstallProgress progress;
@@ -790,35 +1063,45 @@ bool LauncherCore::installMCVersion(const Api::McApi::MCVersion &version,
     progress.totalBytes = plannedTotal;
 
     QObject::connect(&progressTimer, &QTimer::timeout, [&]() {
-        auto libStats = librariesDownloader.getStatistics();
-        auto assetStats = assetsDownloader.getStatistics();
-        auto verStats = versionDownloader.getStatistics();
-        progress.downloadedBytes = libStats.totalDownloaded + assetStats.totalDownloaded + verStats.totalDownloaded;
-        progress.speedBytes = libStats.totalDownloadSpeed + assetStats.totalDownloadSpeed + verStats.totalDownloadSpeed;
-        progress.completedTasks = completedTasks;
-        progress.failedTasks = failedTasks;
+        progress.downloadedBytes = batch->receivedBytes();
+        progress.speedBytes = downloadService->statistics().totalDownloadSpeed;
+        progress.completedTasks = batch->completedCount();
+        progress.failedTasks = batch->failedCount();
         emit installProgressUpdated(progress);
+        if (++progressTicks % 4 == 0 && checkpointDirty) {
+            checkpoint.save(checkpointPath);
+            checkpointDirty = false;
+        }
     });
 
     progressTimer.start(500);
 
-    if (!librariesFinished || !assetsFinished || !versionFinished) {
+    if (!batch->isFinished()) {
         loop.exec();
     }
 
     progressTimer.stop();
 
-    if (failed) {
-        return false;
+    for (QFuture<void> &store : cacheStores) {
+        store.waitForFinished();
     }
+    sharedCache.evict();
 
-    emit installPhaseChanged(QStringLiteral("natives"));
+    if (checkpointDirty) {
+        checkpoint.save(checkpointPath);
+    }
 
-    const QString nativeDestDir = QDir(versionDir).absoluteFilePath(effectiveSaveName + QStringLiteral("-natives"));
-    if (!QDir().mkpath(nativeDestDir)) {
-        m_lastError = QStringLiteral("Failed to create natives dir");
+    if (batch->failedCount() > 0) {
+        m_lastError = batch->lastError();
+        // Partially unpacked natives would make the launcher skip extraction later
+        if (!nativeSinks.isEmpty()) {
+            QDir(nativeDestDir).removeRecursively();
+        }
         return false;
     }
+
+    emit installPhaseChanged(QStringLiteral("natives"));
+
     qInfo().noquote() << "[natives] matched jars:" << nativeJarPaths.size();
     for (const auto &nativeJar : nativeJarPaths) {
         qInfo().noquote() << "[natives] jar:" << nativeJar;
@@ -828,6 +1111,16 @@ bool LauncherCore::installMCVersion(const Api::McApi::MCVersion &version,
         return false;
     }
     for (const auto &nativeJar : nativeJarPaths) {
+        const auto sink = nativeSinks.value(nativeJar);
+        if (sink) {
+            // Already unpacked while downloading
+            if (sink->extractedFiles().isEmpty()) {
+                m_lastError = QStringLiteral("No native files extracted from: %1").arg(nativeJar);
+                return false;
+            }
+            continue;
+        }
+
         QFileInfo info(nativeJar);
         if (!info.exists()) {
             continue;
@@ -886,6 +1179,7 @@ bool LauncherCore::installMCVersion(const Api::McApi::MCVersion &version,
         }
     }
 
+    InstallCheckpoint::remove(checkpointPath);
     emit installPhaseChanged(QStringLiteral("done"));
     return true;
 }
@@ -0,0 +1,237 @@
+#include "MetadataCache.h"
+
+#include "NetworkService.h"
+#include "../CoreSettings.h"
+
+#include <QCryptographicHash>
+#include <QDebug>
+#include <QDir>
+#include <QEventLoop>
+#include <QFile>
+#include <QFileInfo>
+#include <QFutureWatcher>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QNetworkReply>
+#include <QPromise>
+#include <QSaveFile>
+#include <QThreadPool>
+
+#include <optional>
+
+namespace AMCS::Core::Network
+{
+namespace
+{
+QFuture<MetadataCache::Response> readyFuture(const MetadataCache::Response &response)
+{
+    QPromise<MetadataCache::Response> promise;
+    promise.start();
+    promise.addResult(response);
+    promise.finish();
+    return promise.future();
+}
+
+MetadataCache::Response waitFor(const QFuture<MetadataCache::Response> &future)
+{
+    // Replies are delivered through this thread's events
+    if (!future.isFinished()) {
+        QEventLoop loop;
+        QFutureWatcher<MetadataCache::Response> watcher;
+        QObject::connect(&watcher, &QFutureWatcherBase::finished, &loop, &QEventLoop::quit);
+        watcher.setFuture(future);
+        if (!future.isFinished()) {
+            loop.exec();
+        }
+    }
+    if (future.resultCount() == 0) {
+        MetadataCache::Response response;
+        response.errorString = QStringLiteral("Request canceled");
+        return response;
+    }
+    return future.result();
+}
+} // namespace
+
+MetadataCache::Response MetadataCache::get(QNetworkRequest request, const Policy &policy)
+{
+    return waitFor(getAsync(request, policy));
+}
+
+QFuture<MetadataCache::Response> MetadataCache::getAsync(QNetworkRequest request, const Policy &policy)
+{
+    const QString dir = directory();
+    if (dir.isEmpty()) {
+        return fetch(request, QString(), nullptr);
+    }
+
+    const QString path = entryPath(dir, request.url());
+    Entry stored;
+    const bool hasEntry = loadEntry(path, &stored);
+    if (hasEntry) {
+        const qint64 age = stored.fetchedAt.secsTo(QDateTime::currentDateTimeUtc());
+        if (age >= 0 && age <= qint64(policy.maxAgeSeconds) + policy.staleWhileRevalidateSeconds) {
+            if (age > policy.maxAgeSeconds) {
+                refreshInBackground(request, path);
+            }
+            Response response;
+            response.body = stored.body;
+            response.fromCache = true;
+            return readyFuture(response);
+        }
+    }
+
+    const bool staleIfError = hasEntry && policy.staleIfError;
+    const QUrl url = request.url();
+    return fetch(request, path, hasEntry ? &stored : nullptr)
+        .then([staleIfError, url, body = stored.body](Response response) {
+            if (!response.isValid() && staleIfError) {
+                qWarning().noquote() << "[metadata] serving stored copy of" << url.toString() << "-"
+                                     << response.errorString;
+                response.body = body;
+                response.fromCache = true;
+                response.changed = false;
+                response.errorString.clear();
+            }
+            return response;
+        });
+}
+
+QString MetadataCache::directory() const
+{
+    return CoreSettings::getInstance()->getMetadataCacheDir();
+}
+
+QString MetadataCache::entryPath(const QString &dir, const QUrl &url)
+{
+    const QByteArray key = QCryptographicHash::hash(url.toEncoded(), QCryptographicHash::Sha1).toHex();
+    return QDir(dir).absoluteFilePath(QString::fromLatin1(key));
+}
+
+bool MetadataCache::loadEntry(const QString &path, Entry *out)
+{
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+
+    // One line of compact JSON with the validators, followed by the body
+    const QByteArray header = file.readLine();
+    const QJsonDocument doc = QJsonDocument::fromJson(header);
+    if (!doc.isObject()) {
+        return false;
+    }
+    const QJsonObject obj = doc.object();
+    if (!obj.contains(QStringLiteral("fetchedAt"))) {
+        return false;
+    }
+    out->etag = obj.value(QStringLiteral("etag")).toString();
+    out->lastModified = obj.value(QStringLiteral("lastModified")).toString();
+    out->fetchedAt =
+        QDateTime::fromMSecsSinceEpoch(obj.value(QStringLiteral("fetchedAt")).toVariant().toLongLong()).toUTC();
+    out->body = file.readAll();
+    return true;
+}
+
+bool MetadataCache::saveEntry(const QString &path, const QUrl &url, const Entry &entry)
+{
+    if (!QDir().mkpath(QFileInfo(path).absolutePath())) {
+        return false;
+    }
+
+    QJsonObject obj;
+    obj.insert(QStringLiteral("url"), url.toString());
+    obj.insert(QStringLiteral("etag"), entry.etag);
+    obj.insert(QStringLiteral("lastModified"), entry.lastModified);
+    obj.insert(QStringLiteral("fetchedAt"), QString::number(entry.fetchedAt.toMSecsSinceEpoch()));
+
+    // Validators and body are replaced together so a concurrent reader never pairs them up wrongly
+    QSaveFile file(path);
+    if (!file.open(QIODevice::WriteOnly)) {
+        return false;
+    }
+    file.write(QJsonDocument(obj).toJson(QJsonDocument::Compact));
+    file.write("\n");
+    file.write(entry.body);
+    return file.commit();
+}
+
+QFuture<MetadataCache::Response> MetadataCache::fetch(QNetworkRequest request, const QString &path,
+                                                      const Entry *stored)
+{
+    if (stored) {
+        if (!stored->etag.isEmpty()) {
+            request.setRawHeader("If-None-Match", stored->etag.toUtf8());
+        }
+        if (!stored->lastModified.isEmpty()) {
+            request.setRawHeader("If-Modified-Since", stored->lastModified.toUtf8());
+        }
+    }
+
+    auto *network = NetworkService::getInstance();
+    network->prepareRequest(request);
+    QNetworkReply *reply = network->manager()->get(request);
+
+    // Continues in the reply's thread once it finished
+    const std::optional<Entry> previous = stored ? std::optional<Entry>(*stored) : std::nullopt;
+    return QtFuture::connect(reply, &QNetworkReply::finished).then([reply, path, previous]() {
+        return finishFetch(reply, path, previous ? &*previous : nullptr);
+    });
+}
+
+MetadataCache::Response MetadataCache::finishFetch(QNetworkReply *reply, const QString &path, const Entry *stored)
+{
+    reply->deleteLater();
+
+    Response response;
+    response.httpStatus = reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
+    if (reply->error() != QNetworkReply::NoError) {
+        response.errorString = reply->errorString();
+        return response;
+    }
+
+    Entry entry;
+    entry.fetchedAt = QDateTime::currentDateTimeUtc();
+    if (response.httpStatus == 304 && stored) {
+        entry.etag = stored->etag;
+        entry.lastModified = stored->lastModified;
+        entry.body = stored->body;
+        response.fromCache = true;
+    } else if (response.httpStatus == 200) {
+        entry.etag = QString::fromUtf8(reply->rawHeader("ETag"));
+        entry.lastModified = QString::fromUtf8(reply->rawHeader("Last-Modified"));
+        entry.body = reply->readAll();
+        response.changed = !stored || stored->body != entry.body;
+    } else {
+        response.errorString = QStringLiteral("Unexpected HTTP status %1").arg(response.httpStatus);
+        return response;
+    }
+
+    response.body = entry.body;
+    if (!path.isEmpty() && !saveEntry(path, reply->url(), entry)) {
+        qWarning().noquote() << "[metadata] failed to store" << reply->url().toString();
+    }
+    return response;
+}
+
+void MetadataCache::refreshInBackground(const QNetworkRequest &request, const QString &path)
+{
+    {
+        QMutexLocker locker(&m_mutex);
+        if (m_refreshing.contains(path)) {
+            return;
+        }
+        m_refreshing.insert(path);
+    }
+
+    // Pool threads are QThreads, so the request runs on that thread's own shared manager
+    QThreadPool::globalInstance()->start([this, request, path]() {
+        Entry stored;
+        const bool hasEntry = loadEntry(path, &stored);
+        waitFor(fetch(request, path, hasEntry ? &stored : nullptr));
+
+        QMutexLocker locker(&m_mutex);
+        m_refreshing.remove(path);
+    });
+}
+} // namespace AMCS::Core::Network
@@ -0,0 +1,74 @@
+#pragma once
+
+#include <QByteArray>
+#include <QDateTime>
+#include <QFuture>
+#include <QMutex>
+#include <QNetworkRequest>
+#include <QSet>
+#include <QString>
+
+#include "../Common/singleton.h"
+
+class QNetworkReply;
+
+namespace AMCS::Core::Network
+{
+// On-disk cache for small metadata documents (version manifest, version JSONs), kept in
+// CoreSettings::MetadataCacheDir. Entries remember the ETag / Last-Modified of the response and are
+// revalidated with If-None-Match / If-Modified-Since, so an unchanged document costs a 304.
+class MetadataCache
+{
+    Q_SINGLETON_CREATE(MetadataCache)
+
+public:
+    struct Policy
+    {
+        int maxAgeSeconds = 0;                // served without a request while younger than this
+        int staleWhileRevalidateSeconds = 0;  // then served as is while a refresh runs in the background
+        bool staleIfError = true;             // serve the stored copy when the server cannot be reached
+    };
+
+    struct Response
+    {
+        QByteArray body;
+        int httpStatus = 0;      // status of the network response (0 when no request was made)
+        bool fromCache = false;  // body is the stored copy
+        bool changed = false;    // body differs from the stored copy (or nothing was stored yet)
+        QString errorString;     // set when no body could be obtained
+
+        bool isValid() const { return errorString.isEmpty(); }
+    };
+
+    // GET through the calling thread's shared network manager; the result is delivered from that
+    // thread's event loop (immediately when the stored copy can be served)
+    QFuture<Response> getAsync(QNetworkRequest request, const Policy &policy);
+
+    // Blocking variant of getAsync
+    Response get(QNetworkRequest request, const Policy &policy);
+
+    QString directory() const;
+
+private:
+    MetadataCache() = default;
+
+    struct Entry
+    {
+        QString etag;
+        QString lastModified;
+        QDateTime fetchedAt;
+        QByteArray body;
+    };
+
+    static QString entryPath(const QString &dir, const QUrl &url);
+    static bool loadEntry(const QString &path, Entry *out);
+    static bool saveEntry(const QString &path, const QUrl &url, const Entry &entry);
+
+    QFuture<Response> fetch(QNetworkRequest request, const QString &path, const Entry *stored);
+    static Response finishFetch(QNetworkReply *reply, const QString &path, const Entry *stored);
+    void refreshInBackground(const QNetworkRequest &request, const QString &path);
+
+    QMutex m_mutex;
+    QSet<QString> m_refreshing;  // entries with a background refresh in flight
+};
+} // namespace AMCS::Core::Network
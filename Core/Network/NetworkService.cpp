@@ -0,0 +1,174 @@
+#include "NetworkService.h"
+
+#include "../CoreSettings.h"
+
+#include <QDebug>
+#include <QNetworkReply>
+#include <QThread>
+#include <QUrl>
+
+namespace AMCS::Core::Network
+{
+namespace
+{
+// Tickets are small, but a long session downloading from many mirrors should not grow without bound
+constexpr int kMaxSessionTickets = 256;
+
+QString sessionKey(const QUrl &url)
+{
+    return url.host().toLower() + QLatin1Char(':') + QString::number(url.port(443));
+}
+
+bool parseProxy(const QString &value, QNetworkProxy *out)
+{
+    const QUrl url(value.trimmed());
+    if (!url.isValid() || url.host().isEmpty()) {
+        return false;
+    }
+
+    const QString scheme = url.scheme().toLower();
+    QNetworkProxy proxy;
+    if (scheme == QLatin1String("socks5")) {
+        proxy.setType(QNetworkProxy::Socks5Proxy);
+        proxy.setPort(quint16(url.port(1080)));
+    } else if (scheme == QLatin1String("http")) {
+        proxy.setType(QNetworkProxy::HttpProxy);
+        proxy.setPort(quint16(url.port(8080)));
+    } else {
+        return false;
+    }
+    proxy.setHostName(url.host());
+    proxy.setUser(url.userName());
+    proxy.setPassword(url.password());
+    *out = proxy;
+    return true;
+}
+} // namespace
+
+NetworkService::NetworkService()
+{
+    auto *settings = CoreSettings::getInstance();
+    applySettings();
+    connect(settings, &CoreSettings::pNetworkProxyChanged, this, &NetworkService::applySettings);
+}
+
+QNetworkAccessManager *NetworkService::manager()
+{
+    QThread *thread = QThread::currentThread();
+    {
+        QMutexLocker locker(&m_mutex);
+        if (QNetworkAccessManager *manager = m_threadManagers.value(thread)) {
+            return manager;
+        }
+    }
+
+    QNetworkAccessManager *manager = createManager();
+    connect(thread, &QThread::finished, manager, &QObject::deleteLater);
+
+    QMutexLocker locker(&m_mutex);
+    m_threadManagers.insert(thread, manager);
+    return manager;
+}
+
+QNetworkAccessManager *NetworkService::createManager(QObject *parent)
+{
+    auto *manager = new QNetworkAccessManager(parent);
+    // Runs in the manager's thread, also after it was moved to a worker thread
+    connect(manager, &QNetworkAccessManager::finished, manager, [this](QNetworkReply *reply) { storeSession(reply); });
+    connect(manager, &QObject::destroyed, this, [this, manager]() { untrack(manager); }, Qt::DirectConnection);
+    track(manager);
+    return manager;
+}
+
+void NetworkService::prepareRequest(QNetworkRequest &request) const
+{
+#if QT_CONFIG(ssl)
+    if (request.url().scheme() == QLatin1String("https")) {
+        request.setSslConfiguration(sslConfiguration(request.url(), request.sslConfiguration()));
+    }
+#else
+    Q_UNUSED(request);
+#endif
+}
+
+#if QT_CONFIG(ssl)
+QSslConfiguration NetworkService::sslConfiguration(const QUrl &url, QSslConfiguration base) const
+{
+    // Session persistence has to be on for the ticket of this connection to be readable afterwards
+    base.setSslOption(QSsl::SslOptionDisableSessionPersistence, false);
+
+    QMutexLocker locker(&m_mutex);
+    const QByteArray ticket = m_sessionTickets.value(sessionKey(url));
+    if (!ticket.isEmpty()) {
+        base.setSessionTicket(ticket);
+    }
+    return base;
+}
+#endif
+
+QNetworkProxy NetworkService::proxy() const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_hasProxy ? m_proxy : QNetworkProxy(QNetworkProxy::DefaultProxy);
+}
+
+void NetworkService::track(QNetworkAccessManager *manager)
+{
+    QMutexLocker locker(&m_mutex);
+    if (m_hasProxy) {
+        manager->setProxy(m_proxy);
+    }
+    m_managers.append(manager);
+}
+
+void NetworkService::untrack(QNetworkAccessManager *manager)
+{
+    QMutexLocker locker(&m_mutex);
+    m_managers.removeOne(manager);
+    for (auto it = m_threadManagers.begin(); it != m_threadManagers.end(); ++it) {
+        if (it.value() == manager) {
+            m_threadManagers.erase(it);
+            break;
+        }
+    }
+}
+
+void NetworkService::storeSession(QNetworkReply *reply)
+{
+#if QT_CONFIG(ssl)
+    if (reply->error() != QNetworkReply::NoError || reply->url().scheme() != QLatin1String("https")) {
+        return;
+    }
+    const QByteArray ticket = reply->sslConfiguration().sessionTicket();
+    if (ticket.isEmpty()) {
+        return;
+    }
+
+    const QString key = sessionKey(reply->url());
+    QMutexLocker locker(&m_mutex);
+    if (!m_sessionTickets.contains(key) && m_sessionTickets.size() >= kMaxSessionTickets) {
+        m_sessionTickets.clear();
+    }
+    m_sessionTickets.insert(key, ticket);
+#else
+    Q_UNUSED(reply);
+#endif
+}
+
+void NetworkService::applySettings()
+{
+    const QString value = CoreSettings::getInstance()->getNetworkProxy();
+
+    QMutexLocker locker(&m_mutex);
+    m_hasProxy = !value.trimmed().isEmpty() && parseProxy(value, &m_proxy);
+    if (!value.trimmed().isEmpty() && !m_hasProxy) {
+        qWarning().noquote() << "[network] ignoring invalid proxy:" << value;
+    }
+
+    const QNetworkProxy proxy = m_hasProxy ? m_proxy : QNetworkProxy(QNetworkProxy::DefaultProxy);
+    for (QNetworkAccessManager *manager : std::as_const(m_managers)) {
+        // Managers are bound to their threads; the change is applied there
+        QMetaObject::invokeMethod(manager, [manager, proxy]() { manager->setProxy(proxy); }, Qt::QueuedConnection);
+    }
+}
+} // namespace AMCS::Core::Network
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <QHash>
+#include <QList>
+#include <QMutex>
+#include <QNetworkAccessManager>
+#include <QNetworkProxy>
+#include <QObject>
+
+#if QT_CONFIG(ssl)
+#include <QSslConfiguration>
+#endif
+
+#include "../Common/singleton.h"
+
+class QNetworkReply;
+class QThread;
+
+namespace AMCS::Core::Network
+{
+// Process-wide network stack borrowed by McApi, McAccount and the downloader.
+// Every manager it hands out uses the proxy from CoreSettings and feeds one TLS session cache,
+// so a connection to a host another component already talked to resumes the session instead of
+// doing a full handshake. DNS results are shared through QHostInfo's process-wide cache.
+class NetworkService : public QObject
+{
+    Q_OBJECT
+
+    Q_SINGLETON_CREATE(NetworkService)
+
+public:
+    // Manager of the calling thread, shared by every component running on it so requests to the
+    // same host reuse its connections. Created on first use and deleted when the thread finishes.
+    QNetworkAccessManager *manager();
+
+    // Extra manager with the shared configuration, for callers that need a pool of their own
+    // (Qt limits HTTP/1.1 connections per host and manager)
+    QNetworkAccessManager *createManager(QObject *parent = nullptr);
+
+    // Lets the request resume the TLS session of the last connection to its host
+    void prepareRequest(QNetworkRequest &request) const;
+
+#if QT_CONFIG(ssl)
+    // TLS configuration for a new connection to the host of url (base plus the cached session)
+    QSslConfiguration sslConfiguration(const QUrl &url,
+                                       QSslConfiguration base = QSslConfiguration::defaultConfiguration()) const;
+#endif
+
+    QNetworkProxy proxy() const;
+
+private:
+    NetworkService();
+
+    void track(QNetworkAccessManager *manager);
+    void untrack(QNetworkAccessManager *manager);
+    void storeSession(QNetworkReply *reply);
+    void applySettings();
+
+    mutable QMutex m_mutex;
+    QHash<QThread *, QNetworkAccessManager *> m_threadManagers;
+    QList<QNetworkAccessManager *> m_managers;     // every manager handed out, to push proxy changes
+    QHash<QString, QByteArray> m_sessionTickets;   // "host:port" -> last TLS session ticket
+    QNetworkProxy m_proxy;
+    bool m_hasProxy = false;                       // false keeps Qt's application/system proxy
+};
+} // namespace AMCS::Core::Network
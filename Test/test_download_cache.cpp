@@ -0,0 +1,218 @@
+#include <QCoreApplication>
+#include <QCryptographicHash>
+#include <QDebug>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QTemporaryDir>
+#include <QThread>
+
+#include "../Core/Download/DownloadCache.h"
+
+using AMCS::Core::Download::DownloadCache;
+
+static bool writeFile(const QString &path, const QByteArray &data)
+{
+    QDir().mkpath(QFileInfo(path).absolutePath());
+    QFile file(path);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        return false;
+    }
+    return file.write(data) == data.size();
+}
+
+static QByteArray readFile(const QString &path)
+{
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return QByteArray();
+    }
+    return file.readAll();
+}
+
+static QString sha1Of(const QByteArray &data)
+{
+    return QString::fromLatin1(QCryptographicHash::hash(data, QCryptographicHash::Sha1).toHex());
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+
+    qInfo() << "=== Download Cache Test ===";
+
+    QTemporaryDir tempDir;
+    if (!tempDir.isValid()) {
+        qCritical() << "Failed to create temporary directory";
+        return 1;
+    }
+
+    const QString cacheRoot = tempDir.filePath(QStringLiteral("cache"));
+    const QByteArray payload(4096, 'a');
+    const QString payloadSha1 = sha1Of(payload);
+
+    {
+        qInfo() << "\n--- Test 1: Store a downloaded file and fetch it into another game directory ---";
+
+        DownloadCache cache(cacheRoot);
+        const QString source = tempDir.filePath(QStringLiteral("gameA/libraries/a.jar"));
+        if (!writeFile(source, payload)) {
+            qCritical() << "Failed to write source file";
+            return 1;
+        }
+
+        if (cache.contains(payloadSha1)) {
+            qCritical() << "Empty cache must not contain the object";
+            return 1;
+        }
+        if (cache.store(payloadSha1, source) == DownloadCache::LinkMode::None) {
+            qCritical() << "Store failed";
+            return 1;
+        }
+        if (!cache.contains(payloadSha1, payload.size())) {
+            qCritical() << "Stored object not found at" << cache.objectPath(payloadSha1);
+            return 1;
+        }
+
+        // 残留的不完整文件应被替换
+        const QString target = tempDir.filePath(QStringLiteral("gameB/libraries/a.jar"));
+        if (!writeFile(target, QByteArray("partial"))) {
+            qCritical() << "Failed to write partial target";
+            return 1;
+        }
+        const auto mode = cache.fetch(payloadSha1, target, payload.size());
+        if (mode == DownloadCache::LinkMode::None) {
+            qCritical() << "Fetch failed";
+            return 1;
+        }
+        if (readFile(target) != payload) {
+            qCritical() << "Fetched file content differs";
+            return 1;
+        }
+
+        qInfo() << "Fetched with mode" << static_cast<int>(mode);
+        qInfo() << "Test 1 PASSED";
+    }
+
+    {
+        qInfo() << "\n--- Test 2: Invalid keys and size mismatches are misses ---";
+
+        DownloadCache cache(cacheRoot);
+        const QString target = tempDir.filePath(QStringLiteral("gameC/x.jar"));
+        if (cache.fetch(QStringLiteral("not-a-sha1"), target) != DownloadCache::LinkMode::None) {
+            qCritical() << "Invalid key must not be fetched";
+            return 1;
+        }
+        if (cache.fetch(payloadSha1, target, payload.size() + 1) != DownloadCache::LinkMode::None) {
+            qCritical() << "Size mismatch must be a miss";
+            return 1;
+        }
+        if (cache.contains(payloadSha1)) {
+            qCritical() << "Corrupt object must be dropped";
+            return 1;
+        }
+        if (QFileInfo::exists(target)) {
+            qCritical() << "Miss must not create the target";
+            return 1;
+        }
+
+        qInfo() << "Test 2 PASSED";
+    }
+
+    {
+        qInfo() << "\n--- Test 3: Objects whose content does not match their SHA-1 are rejected ---";
+
+        DownloadCache cache(tempDir.filePath(QStringLiteral("verify")));
+        const QByteArray other(payload.size(), 'b');
+        const QString source = tempDir.filePath(QStringLiteral("gameD/other.jar"));
+        if (!writeFile(source, other)) {
+            qCritical() << "Failed to write source file";
+            return 1;
+        }
+        if (cache.store(payloadSha1, source) != DownloadCache::LinkMode::None || cache.contains(payloadSha1)) {
+            qCritical() << "Store must refuse content that does not match the key";
+            return 1;
+        }
+
+        // 未经校验放入（例如旧版本留下）且大小正确的损坏对象
+        if (!writeFile(cache.objectPath(payloadSha1), other)) {
+            qCritical() << "Failed to plant corrupt object";
+            return 1;
+        }
+        const QString target = tempDir.filePath(QStringLiteral("gameD/a.jar"));
+        if (cache.fetch(payloadSha1, target, payload.size()) != DownloadCache::LinkMode::None) {
+            qCritical() << "Corrupt object of the right size must not be fetched";
+            return 1;
+        }
+        if (cache.contains(payloadSha1) || QFileInfo::exists(target)) {
+            qCritical() << "Corrupt object must be dropped without touching the target";
+            return 1;
+        }
+
+        qInfo() << "Test 3 PASSED";
+    }
+
+    {
+        qInfo() << "\n--- Test 4: Evict least recently used objects down to the size cap ---";
+
+        DownloadCache cache(tempDir.filePath(QStringLiteral("lru")), 1024);
+        QStringList keys;
+        QStringList sources;
+        DownloadCache::LinkMode firstMode = DownloadCache::LinkMode::None;
+        for (int i = 0; i < 3; ++i) {
+            const QByteArray data(1024, static_cast<char>('x' + i));
+            sources.append(tempDir.filePath(QStringLiteral("src/%1").arg(i)));
+            if (!writeFile(sources.last(), data)) {
+                qCritical() << "Failed to write source" << i;
+                return 1;
+            }
+            keys.append(sha1Of(data));
+            const auto mode = cache.store(keys.last(), sources.last());
+            if (mode == DownloadCache::LinkMode::None) {
+                qCritical() << "Store failed for object" << i;
+                return 1;
+            }
+            if (i == 0) {
+                firstMode = mode;
+            }
+            QThread::msleep(20);
+        }
+
+        // 第一个对象仍链接在游戏目录中；其余对象只剩缓存中的一份
+        QFile::remove(sources[1]);
+        QFile::remove(sources[2]);
+
+        // 使用第二个对象，使第三个成为可释放对象中最久未使用的
+        const QString used = tempDir.filePath(QStringLiteral("use/1"));
+        if (cache.fetch(keys[1], used) == DownloadCache::LinkMode::None) {
+            qCritical() << "Fetch of second object failed";
+            return 1;
+        }
+        QFile::remove(used);
+
+        // 不支持硬链接时第一个对象是独立副本，同样可以淘汰
+        const bool firstLinked = firstMode == DownloadCache::LinkMode::Hardlink;
+        const qint64 freed = cache.evict();
+        if (freed != (firstLinked ? 1024 : 2048)) {
+            qCritical() << "Unexpected eviction result:" << freed << cache.totalBytes();
+            return 1;
+        }
+        if (!cache.contains(keys[1]) || cache.contains(keys[2])) {
+            qCritical() << "Wrong object evicted";
+            return 1;
+        }
+        if (firstLinked && !cache.contains(keys[0])) {
+            qCritical() << "Objects still linked into a game directory free nothing and must be kept";
+            return 1;
+        }
+        if (readFile(sources[0]).size() != 1024) {
+            qCritical() << "Eviction must not affect files in game directories";
+            return 1;
+        }
+
+        qInfo() << "Test 4 PASSED";
+    }
+
+    qInfo() << "\n=== All tests PASSED ===";
+    return 0;
+}
@@ -0,0 +1,290 @@
+#include <QCoreApplication>
+#include <QCryptographicHash>
+#include <QDebug>
+#include <QDir>
+#include <QEventLoop>
+#include <QFile>
+#include <QFileInfo>
+#include <QHash>
+#include <QHostAddress>
+#include <QProcess>
+#include <QTcpServer>
+#include <QTcpSocket>
+#include <QTemporaryDir>
+#include <QTimer>
+
+#include "../Core/Download/AsulMultiDownloader.h"
+#include "../Core/Download/DownloadSink.h"
+
+using AMCS::Core::Download::AsulMultiDownloader;
+using AMCS::Core::Download::DownloadBatch;
+using AMCS::Core::Download::DownloadRequest;
+using AMCS::Core::Download::DownloadResult;
+using AMCS::Core::Download::MemoryDownloadSink;
+
+static QByteArray readFile(const QString &path)
+{
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return QByteArray();
+    }
+    return file.readAll();
+}
+
+// 每个请求稍后返回同一份正文，并按路径统计收到的GET请求数
+static void serve(QTcpServer *server, const QByteArray &payload, QHash<QByteArray, int> *requests)
+{
+    QObject::connect(server, &QTcpServer::newConnection, server, [server, payload, requests]() {
+        while (QTcpSocket *socket = server->nextPendingConnection()) {
+            auto buffer = std::make_shared<QByteArray>();
+            QObject::connect(socket, &QTcpSocket::disconnected, socket, &QObject::deleteLater);
+            QObject::connect(socket, &QTcpSocket::readyRead, socket, [socket, buffer, payload, requests]() {
+                buffer->append(socket->readAll());
+                if (!buffer->contains("\r\n\r\n")) {
+                    return;
+                }
+                const QList<QByteArray> requestLine = buffer->left(buffer->indexOf("\r\n")).split(' ');
+                buffer->clear();
+                if (requestLine.size() >= 2 && requestLine[0] == "GET") {
+                    (*requests)[requestLine[1]] += 1;
+                }
+
+                QTimer::singleShot(100, socket, [socket, payload]() {
+                    socket->write("HTTP/1.1 200 OK\r\nContent-Type: application/octet-stream\r\nContent-Length: "
+                                  + QByteArray::number(payload.size()) + "\r\nConnection: close\r\n\r\n");
+                    socket->write(payload);
+                    socket->disconnectFromHost();
+                });
+            });
+        }
+    });
+}
+
+static bool waitAll(const QList<QFuture<DownloadResult>> &futures)
+{
+    QEventLoop loop;
+    QTimer timeout;
+    timeout.setSingleShot(true);
+    QObject::connect(&timeout, &QTimer::timeout, &loop, &QEventLoop::quit);
+    timeout.start(30000);
+
+    QTimer poll;
+    QObject::connect(&poll, &QTimer::timeout, &loop, [&]() {
+        for (const auto &future : futures) {
+            if (!future.isFinished()) {
+                return;
+            }
+        }
+        loop.quit();
+    });
+    poll.start(20);
+    loop.exec();
+    return timeout.isActive();
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+
+    // 子进程模式：立即退出，供测试取得一个已退出进程的进程号
+    if (app.arguments().contains(QStringLiteral("--exit"))) {
+        return 0;
+    }
+
+    qInfo() << "=== Download Coalescing Test ===";
+
+    QTemporaryDir tempDir;
+    if (!tempDir.isValid()) {
+        qCritical() << "Failed to create temporary directory";
+        return 1;
+    }
+
+    QByteArray payload;
+    for (int i = 0; i < 64 * 1024; ++i) {
+        payload.append(static_cast<char>(i * 31));
+    }
+    const QString sha1 = QString::fromLatin1(QCryptographicHash::hash(payload, QCryptographicHash::Sha1).toHex());
+
+    QTcpServer server;
+    QHash<QByteArray, int> requests;
+    serve(&server, payload, &requests);
+    if (!server.listen(QHostAddress::LocalHost)) {
+        qCritical() << "Failed to start local server:" << server.errorString();
+        return 1;
+    }
+    const auto urlFor = [&server](const QString &name) {
+        return QUrl(QStringLiteral("http://127.0.0.1:%1/%2").arg(server.serverPort()).arg(name));
+    };
+
+    AsulMultiDownloader downloader;
+    downloader.setAutoRetry(false);
+
+    // 同一路径先后提交普通请求和带接收器的请求（两种顺序），只应产生一次传输
+    const QStringList orders = {QStringLiteral("plain-first"), QStringLiteral("sink-first")};
+    for (const QString &order : orders) {
+        qInfo().noquote() << "\n--- Same path submitted twice," << order << "---";
+
+        const QString name = order + QStringLiteral(".jar");
+        const QString savePath = tempDir.filePath(QStringLiteral("libraries/") + name);
+
+        const DownloadRequest plain({urlFor(name)}, savePath, payload.size(), sha1);
+        DownloadRequest withSink({urlFor(name)}, savePath, payload.size(), sha1);
+        auto sink = std::make_shared<MemoryDownloadSink>();
+        withSink.sink = sink;
+
+        const QList<DownloadRequest> submitted = order == orders.first()
+                                                     ? QList<DownloadRequest>{plain, withSink}
+                                                     : QList<DownloadRequest>{withSink, plain};
+        const QList<QFuture<DownloadResult>> futures = downloader.addDownloadsAsync(submitted);
+        if (!waitAll(futures)) {
+            qCritical() << "Downloads did not finish in time";
+            return 1;
+        }
+
+        for (const auto &future : futures) {
+            if (future.resultCount() == 0 || !future.result().success) {
+                qCritical() << "Download failed:" << (future.resultCount() > 0 ? future.result().errorString : QString());
+                return 1;
+            }
+        }
+        if (readFile(savePath) != payload) {
+            qCritical() << "Saved file content differs";
+            return 1;
+        }
+        if (sink->data() != payload) {
+            qCritical() << "Sink received" << sink->data().size() << "bytes instead of the full file";
+            return 1;
+        }
+        const int transfers = requests.value(urlFor(name).path().toUtf8());
+        if (transfers != 1) {
+            qCritical() << "Expected one transfer for the path, got" << transfers;
+            return 1;
+        }
+        const QStringList leftovers = QDir(QFileInfo(savePath).absolutePath())
+                                          .entryList({name + QStringLiteral(".*")}, QDir::Files);
+        if (!leftovers.isEmpty()) {
+            qCritical() << "Staging files left behind:" << leftovers;
+            return 1;
+        }
+
+        qInfo() << "PASSED";
+    }
+
+    // 两个批次各提交同一路径的普通请求：后者合并到前者的任务上，报告的任务ID必须与信号和结果一致
+    {
+        qInfo().noquote() << "\n--- Same path in two batches reports one task ID ---";
+
+        const QString name = QStringLiteral("attached.jar");
+        const QString savePath = tempDir.filePath(QStringLiteral("libraries/") + name);
+        const QList<DownloadRequest> submitted{DownloadRequest({urlFor(name)}, savePath, payload.size(), sha1)};
+
+        DownloadBatch *first = downloader.addBatch(submitted);
+        DownloadBatch *second = downloader.addBatch(submitted);
+        if (first->taskIds().size() != 1 || second->taskIds() != first->taskIds()) {
+            qCritical() << "Batches list different task IDs:" << first->taskIds() << second->taskIds();
+            return 1;
+        }
+
+        QStringList finishedIds;
+        QObject::connect(second, &DownloadBatch::taskFinished, second,
+                         [&finishedIds](const QString &taskId, const QString &) { finishedIds.append(taskId); });
+        QStringList downloaderIds;
+        QObject::connect(&downloader, &AsulMultiDownloader::downloadFinished, second,
+                         [&downloaderIds](const QString &taskId) { downloaderIds.append(taskId); });
+
+        if (!waitAll({first->future(), second->future()})) {
+            qCritical() << "Downloads did not finish in time";
+            return 1;
+        }
+        QCoreApplication::processEvents();
+
+        const QString taskId = first->taskIds().constFirst();
+        if (second->future().resultCount() != 1 || second->future().resultAt(0).taskId != taskId) {
+            qCritical() << "Attached batch result carries another task ID";
+            return 1;
+        }
+        if (finishedIds != QStringList{taskId} || !downloaderIds.contains(taskId)) {
+            qCritical() << "Finished signals report" << finishedIds << downloaderIds << "instead of" << taskId;
+            return 1;
+        }
+        if (requests.value(urlFor(name).path().toUtf8()) != 1) {
+            qCritical() << "Expected one transfer for the path";
+            return 1;
+        }
+        delete first;
+        delete second;
+
+        qInfo() << "PASSED";
+    }
+
+    // 已退出的进程留下的临时文件在下载同一文件时被清理，仍在运行的进程的临时文件保留
+    {
+        qInfo().noquote() << "\n--- Orphaned staging files are removed ---";
+
+        QProcess child;
+        child.start(QCoreApplication::applicationFilePath(), {QStringLiteral("--exit")});
+        if (!child.waitForStarted()) {
+            qCritical() << "Failed to start child process";
+            return 1;
+        }
+        const qint64 deadPid = child.processId();
+        child.waitForFinished();
+
+        const QString name = QStringLiteral("orphaned.jar");
+        const QString savePath = tempDir.filePath(QStringLiteral("libraries/") + name);
+        const QString orphan = QStringLiteral("%1.%2-1.download").arg(savePath).arg(deadPid, 0, 36);
+        const QString orphanPart = orphan + QStringLiteral(".part0");
+        const QString live = QStringLiteral("%1.%2-999.download").arg(savePath).arg(QCoreApplication::applicationPid(), 0, 36);
+        for (const QString &path : {orphan, orphanPart, live}) {
+            QFile file(path);
+            if (!file.open(QIODevice::WriteOnly) || file.write("partial") != 7) {
+                qCritical() << "Failed to create" << path;
+                return 1;
+            }
+        }
+
+        const QList<QFuture<DownloadResult>> futures =
+            downloader.addDownloadsAsync({DownloadRequest({urlFor(name)}, savePath, payload.size(), sha1)});
+        if (!waitAll(futures) || futures.first().resultCount() == 0 || !futures.first().result().success) {
+            qCritical() << "Download failed";
+            return 1;
+        }
+        if (QFile::exists(orphan) || QFile::exists(orphanPart)) {
+            qCritical() << "Staging files of an exited process were left behind";
+            return 1;
+        }
+        if (!QFile::exists(live)) {
+            qCritical() << "Staging file of a running process was removed";
+            return 1;
+        }
+        QFile::remove(live);
+
+        qInfo() << "PASSED";
+    }
+
+    // 保存目录在两次下载之间被删除：同一个下载器应重新创建它，而不是沿用已过期的目录缓存
+    {
+        qInfo().noquote() << "\n--- Deleted save directory is recreated ---";
+
+        const QString dirPath = tempDir.filePath(QStringLiteral("versions/reinstalled"));
+        for (const QString &name : {QStringLiteral("before.jar"), QStringLiteral("after.jar")}) {
+            const QString savePath = QDir(dirPath).filePath(name);
+            const QList<QFuture<DownloadResult>> futures =
+                downloader.addDownloadsAsync({DownloadRequest({urlFor(name)}, savePath, payload.size(), sha1)});
+            if (!waitAll(futures) || futures.first().resultCount() == 0 || !futures.first().result().success) {
+                qCritical() << "Download into" << dirPath << "failed";
+                return 1;
+            }
+            if (readFile(savePath) != payload) {
+                qCritical() << "Saved file content differs";
+                return 1;
+            }
+            QDir(dirPath).removeRecursively();
+        }
+
+        qInfo() << "PASSED";
+    }
+
+    qInfo() << "\n=== All tests PASSED ===";
+    return 0;
+}
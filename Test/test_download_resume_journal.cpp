@@ -0,0 +1,128 @@
+#include <QCoreApplication>
+#include <QDebug>
+#include <QTemporaryDir>
+
+#include "../Core/Download/AsulMultiDownloader.h"
+
+using AMCS::Core::Download::DownloadResumeJournal;
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+
+    qInfo() << "=== Download Resume Journal Test ===";
+
+    {
+        qInfo() << "\n--- Test 1: Merge completed ranges and compute missing ranges ---";
+
+        DownloadResumeJournal journal;
+        journal.fileSize = 1000;
+        journal.addCompleted(100, 199);
+        journal.addCompleted(300, 399);
+        journal.addCompleted(200, 249);   // adjacent to [100,199]
+        journal.addCompleted(380, 450);   // overlaps [300,399]
+
+        if (journal.completed.size() != 2
+            || journal.completed[0] != DownloadResumeJournal::Range(100, 249)
+            || journal.completed[1] != DownloadResumeJournal::Range(300, 450)) {
+            qCritical() << "Unexpected completed ranges:" << journal.completed;
+            return 1;
+        }
+        if (journal.completedBytes() != 150 + 151) {
+            qCritical() << "Unexpected completed bytes:" << journal.completedBytes();
+            return 1;
+        }
+
+        const auto missing = journal.missingRanges();
+        if (missing.size() != 3
+            || missing[0] != DownloadResumeJournal::Range(0, 99)
+            || missing[1] != DownloadResumeJournal::Range(250, 299)
+            || missing[2] != DownloadResumeJournal::Range(451, 999)) {
+            qCritical() << "Unexpected missing ranges:" << missing;
+            return 1;
+        }
+
+        qInfo() << "Test 1 PASSED";
+    }
+
+    {
+        qInfo() << "\n--- Test 2: Split missing ranges into segments ---";
+
+        QList<DownloadResumeJournal::Range> ranges{DownloadResumeJournal::Range(0, 8 * 1024 - 1)};
+        const auto split = DownloadResumeJournal::splitRanges(ranges, 8, 512);
+        if (split.size() != 8) {
+            qCritical() << "Expected 8 segments, got" << split.size();
+            return 1;
+        }
+        qint64 cursor = 0;
+        for (const auto &range : split) {
+            if (range.first != cursor) {
+                qCritical() << "Segments are not contiguous:" << split;
+                return 1;
+            }
+            cursor = range.second + 1;
+        }
+        if (cursor != 8 * 1024) {
+            qCritical() << "Segments do not cover the whole range:" << split;
+            return 1;
+        }
+
+        const auto small = DownloadResumeJournal::splitRanges({DownloadResumeJournal::Range(0, 999)}, 8, 512);
+        if (small.size() != 1) {
+            qCritical() << "Range below the minimum size must not be split:" << small;
+            return 1;
+        }
+
+        qInfo() << "Test 2 PASSED";
+    }
+
+    {
+        qInfo() << "\n--- Test 3: Save, load and validator matching ---";
+
+        QTemporaryDir dir;
+        if (!dir.isValid()) {
+            qCritical() << "Failed to create temp dir";
+            return 1;
+        }
+        const QString savePath = dir.filePath(QStringLiteral("client.jar"));
+
+        DownloadResumeJournal journal;
+        journal.url = QStringLiteral("https://example.com/client.jar");
+        journal.fileSize = 5LL * 1024 * 1024 * 1024;
+        journal.etag = QStringLiteral("\"abc\"");
+        journal.addCompleted(0, 3LL * 1024 * 1024 * 1024);
+        if (!journal.save(savePath) || !DownloadResumeJournal::exists(savePath)) {
+            qCritical() << "Failed to save journal";
+            return 1;
+        }
+
+        DownloadResumeJournal loaded;
+        if (!DownloadResumeJournal::load(savePath, &loaded)) {
+            qCritical() << "Failed to load journal";
+            return 1;
+        }
+        if (loaded.fileSize != journal.fileSize || loaded.completed != journal.completed
+            || !loaded.matches(journal)) {
+            qCritical() << "Loaded journal differs:" << loaded.fileSize << loaded.completed;
+            return 1;
+        }
+
+        DownloadResumeJournal changed = journal;
+        changed.etag = QStringLiteral("\"def\"");
+        if (loaded.matches(changed)) {
+            qCritical() << "Journal with a different ETag must not match";
+            return 1;
+        }
+
+        DownloadResumeJournal::remove(savePath);
+        if (DownloadResumeJournal::exists(savePath)) {
+            qCritical() << "Journal was not removed";
+            return 1;
+        }
+
+        qInfo() << "Test 3 PASSED";
+    }
+
+    qInfo() << "\n=== All tests PASSED ===";
+    return 0;
+}
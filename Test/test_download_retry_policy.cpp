@@ -0,0 +1,114 @@
+#include <QCoreApplication>
+#include <QDateTime>
+#include <QDebug>
+#include <QLocale>
+
+#include "../Core/Download/AsulMultiDownloader.h"
+
+using AMCS::Core::Download::DownloadFailure;
+using AMCS::Core::Download::DownloadFailureKind;
+using AMCS::Core::Download::DownloadRetryPolicy;
+
+static DownloadFailure makeFailure(QNetworkReply::NetworkError error, int status, qint64 retryAfterMs = -1)
+{
+    DownloadFailure failure;
+    failure.networkError = error;
+    failure.httpStatus = status;
+    failure.retryAfterMs = retryAfterMs;
+    return failure;
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+
+    qInfo() << "=== Download Retry Policy Test ===";
+
+    const DownloadRetryPolicy policy;
+
+    {
+        qInfo() << "\n--- Test 1: Classify HTTP status and network errors ---";
+
+        struct Case {
+            DownloadFailure failure;
+            DownloadFailureKind expected;
+        };
+        const QList<Case> cases{
+            {makeFailure(QNetworkReply::ContentNotFoundError, 404), DownloadFailureKind::Permanent},
+            {makeFailure(QNetworkReply::ContentAccessDenied, 403), DownloadFailureKind::Permanent},
+            {makeFailure(QNetworkReply::ContentNotFoundError, 0), DownloadFailureKind::Permanent},
+            {makeFailure(QNetworkReply::UnknownContentError, 429), DownloadFailureKind::Throttled},
+            {makeFailure(QNetworkReply::ServiceUnavailableError, 503), DownloadFailureKind::Throttled},
+            {makeFailure(QNetworkReply::InternalServerError, 500, 1000), DownloadFailureKind::Throttled},
+            {makeFailure(QNetworkReply::InternalServerError, 502), DownloadFailureKind::Transient},
+            {makeFailure(QNetworkReply::UnknownContentError, 408), DownloadFailureKind::Transient},
+            {makeFailure(QNetworkReply::TimeoutError, 0), DownloadFailureKind::Transient},
+            {makeFailure(QNetworkReply::RemoteHostClosedError, 0), DownloadFailureKind::Transient},
+            {makeFailure(QNetworkReply::NoError, 0), DownloadFailureKind::Transient},
+        };
+
+        for (int i = 0; i < cases.size(); ++i) {
+            const auto kind = policy.classify(cases[i].failure);
+            if (kind != cases[i].expected) {
+                qCritical() << "Case" << i << "classified as" << static_cast<int>(kind)
+                            << "expected" << static_cast<int>(cases[i].expected);
+                return 1;
+            }
+        }
+
+        qInfo() << "Test 1 PASSED";
+    }
+
+    {
+        qInfo() << "\n--- Test 2: Parse Retry-After ---";
+
+        if (DownloadFailure::parseRetryAfter("120") != 120000) {
+            qCritical() << "delta-seconds not parsed:" << DownloadFailure::parseRetryAfter("120");
+            return 1;
+        }
+        if (DownloadFailure::parseRetryAfter("") != -1 || DownloadFailure::parseRetryAfter("soon") != -1) {
+            qCritical() << "Invalid values must yield -1";
+            return 1;
+        }
+
+        const QDateTime future = QDateTime::currentDateTimeUtc().addSecs(60);
+        const QByteArray httpDate = QLocale::c().toString(future, QStringLiteral("ddd, dd MMM yyyy hh:mm:ss 'GMT'")).toLatin1();
+        const qint64 parsed = DownloadFailure::parseRetryAfter(httpDate);
+        if (parsed < 55000 || parsed > 61000) {
+            qCritical() << "HTTP-date not parsed:" << httpDate << parsed;
+            return 1;
+        }
+
+        qInfo() << "Test 2 PASSED";
+    }
+
+    {
+        qInfo() << "\n--- Test 3: Backoff grows, is capped and honors Retry-After ---";
+
+        const DownloadFailure transient = makeFailure(QNetworkReply::TimeoutError, 0);
+        for (int attempt = 1; attempt <= 10; ++attempt) {
+            const qint64 ceiling = qMin<qint64>(30000, 500LL << (attempt - 1));
+            const qint64 delay = policy.retryDelay(transient, DownloadFailureKind::Transient, attempt);
+            if (delay < ceiling / 2 || delay > ceiling) {
+                qCritical() << "Attempt" << attempt << "delay" << delay << "outside" << ceiling / 2 << ceiling;
+                return 1;
+            }
+        }
+
+        const DownloadFailure throttled = makeFailure(QNetworkReply::UnknownContentError, 429, 45000);
+        if (policy.retryDelay(throttled, DownloadFailureKind::Throttled, 1) < 45000) {
+            qCritical() << "Retry-After not honored";
+            return 1;
+        }
+
+        if (policy.retryDelay(transient, DownloadFailureKind::Permanent, 1) != 0) {
+            qCritical() << "Permanent failures must not wait";
+            return 1;
+        }
+
+        qInfo() << "Test 3 PASSED";
+    }
+
+    qInfo() << "\n=== All tests PASSED ===";
+    return 0;
+}
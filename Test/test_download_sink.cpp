@@ -0,0 +1,180 @@
+#include <QCoreApplication>
+#include <QCryptographicHash>
+#include <QDebug>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QTemporaryDir>
+
+#include <quazip/JlCompress.h>
+
+#include "../Core/Download/DownloadSink.h"
+
+using AMCS::Core::Download::HashDownloadSink;
+using AMCS::Core::Download::MemoryDownloadSink;
+using AMCS::Core::Download::ZipExtractDownloadSink;
+
+static bool writeFile(const QString &path, const QByteArray &data)
+{
+    QDir().mkpath(QFileInfo(path).absolutePath());
+    QFile file(path);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        return false;
+    }
+    return file.write(data) == data.size();
+}
+
+static QByteArray readFile(const QString &path)
+{
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return QByteArray();
+    }
+    return file.readAll();
+}
+
+// 按小块依次写入，模拟网络数据陆续到达
+static bool feed(ZipExtractDownloadSink &sink, const QByteArray &data, int chunkSize)
+{
+    for (qsizetype offset = 0; offset < data.size(); offset += chunkSize) {
+        if (!sink.write(data.mid(offset, chunkSize))) {
+            return false;
+        }
+    }
+    return true;
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+
+    qInfo() << "=== Download Sink Test ===";
+
+    QTemporaryDir tempDir;
+    if (!tempDir.isValid()) {
+        qCritical() << "Failed to create temporary directory";
+        return 1;
+    }
+
+    // 准备一个包含压缩条目、空文件、子目录和 META-INF 的 zip
+    const QString sourceDir = tempDir.filePath(QStringLiteral("source"));
+    QByteArray library;
+    for (int i = 0; i < 20000; ++i) {
+        library.append(QByteArray::number(i * 7919 % 1000)).append(' ');
+    }
+    const QByteArray small("native library");
+    if (!writeFile(sourceDir + QStringLiteral("/liblwjgl.so"), library)
+        || !writeFile(sourceDir + QStringLiteral("/sub/openal.dll"), small)
+        || !writeFile(sourceDir + QStringLiteral("/empty.txt"), QByteArray())
+        || !writeFile(sourceDir + QStringLiteral("/META-INF/MANIFEST.MF"), QByteArray("Manifest-Version: 1.0\n"))) {
+        qCritical() << "Failed to write source files";
+        return 1;
+    }
+    const QString zipPath = tempDir.filePath(QStringLiteral("natives.jar"));
+    if (!JlCompress::compressDir(zipPath, sourceDir, true)) {
+        qCritical() << "Failed to create zip";
+        return 1;
+    }
+    const QByteArray zipData = readFile(zipPath);
+
+    const QString extractDir = tempDir.filePath(QStringLiteral("natives"));
+    auto filter = [extractDir](const QString &entryPath) {
+        if (entryPath.startsWith(QStringLiteral("META-INF/"))) {
+            return QString();
+        }
+        return QDir(extractDir).absoluteFilePath(QFileInfo(entryPath).fileName());
+    };
+
+    {
+        qInfo() << "\n--- Test 1: Extract selected entries while data arrives in small chunks ---";
+
+        ZipExtractDownloadSink sink(filter);
+        sink.reset();
+        if (!feed(sink, zipData, 997) || !sink.finish()) {
+            qCritical() << "Extraction failed:" << sink.errorString();
+            return 1;
+        }
+
+        if (readFile(extractDir + QStringLiteral("/liblwjgl.so")) != library
+            || readFile(extractDir + QStringLiteral("/openal.dll")) != small
+            || !QFileInfo::exists(extractDir + QStringLiteral("/empty.txt"))) {
+            qCritical() << "Extracted content differs";
+            return 1;
+        }
+        if (QFileInfo::exists(extractDir + QStringLiteral("/MANIFEST.MF"))) {
+            qCritical() << "Skipped entry was extracted";
+            return 1;
+        }
+        if (sink.extractedFiles().size() != 3) {
+            qCritical() << "Unexpected extracted files:" << sink.extractedFiles();
+            return 1;
+        }
+
+        qInfo() << "Test 1 PASSED";
+    }
+
+    {
+        qInfo() << "\n--- Test 2: Corrupt and truncated archives fail, reset removes extracted files ---";
+
+        QDir(extractDir).removeRecursively();
+
+        ZipExtractDownloadSink truncated(filter);
+        if (!feed(truncated, zipData.left(zipData.size() / 2), 4096) || truncated.finish()) {
+            qCritical() << "Truncated archive must fail only at finish()";
+            return 1;
+        }
+
+        QByteArray corrupt = zipData;
+        const qsizetype dataOffset = corrupt.indexOf("liblwjgl.so") + 64;
+        corrupt[dataOffset] = char(corrupt[dataOffset] ^ 0x5a);
+        ZipExtractDownloadSink broken(filter);
+        if (feed(broken, corrupt, 4096) && broken.finish()) {
+            qCritical() << "Corrupt archive must fail";
+            return 1;
+        }
+        qInfo() << "Corrupt archive error:" << broken.errorString();
+
+        truncated.reset();
+        broken.reset();
+        if (!QDir(extractDir).entryList(QDir::Files).isEmpty()) {
+            qCritical() << "reset() must remove extracted files:" << QDir(extractDir).entryList(QDir::Files);
+            return 1;
+        }
+
+        qInfo() << "Test 2 PASSED";
+    }
+
+    {
+        qInfo() << "\n--- Test 3: Memory and hash-only sinks ---";
+
+        MemoryDownloadSink memory;
+        HashDownloadSink hash;
+        memory.reset();
+        hash.reset();
+        for (int i = 0; i < 3; ++i) {
+            memory.write(QByteArray("stale"));
+        }
+        memory.reset();
+        for (qsizetype offset = 0; offset < zipData.size(); offset += 1500) {
+            memory.write(zipData.mid(offset, 1500));
+            hash.write(zipData.mid(offset, 1500));
+        }
+        memory.finish();
+        hash.finish();
+
+        if (memory.data() != zipData) {
+            qCritical() << "Memory sink content differs";
+            return 1;
+        }
+        if (hash.result() != QCryptographicHash::hash(zipData, QCryptographicHash::Sha1).toHex()
+            || hash.size() != zipData.size()) {
+            qCritical() << "Hash sink result differs";
+            return 1;
+        }
+
+        qInfo() << "Test 3 PASSED";
+    }
+
+    qInfo() << "\n=== All tests PASSED ===";
+    return 0;
+}
@@ -0,0 +1,114 @@
+#include <QCoreApplication>
+#include <QDebug>
+#include <QFile>
+#include <QTemporaryDir>
+
+#include "../Core/Launcher/InstallCheckpoint.h"
+
+using AMCS::Core::Launcher::InstallCheckpoint;
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+
+    qInfo() << "=== Install Checkpoint Test ===";
+
+    QTemporaryDir tempDir;
+    if (!tempDir.isValid()) {
+        qCritical() << "Failed to create temporary directory";
+        return 1;
+    }
+    const QString path = InstallCheckpoint::checkpointPath(tempDir.path(), QStringLiteral("1.20.1"));
+
+    {
+        qInfo() << "\n--- Test 1: Save and load round trip ---";
+
+        InstallCheckpoint checkpoint;
+        checkpoint.planKey = QStringLiteral("plan");
+        InstallCheckpoint::Item client;
+        client.mirrors = {QUrl(QStringLiteral("https://bmclapi2.bangbang93.com/client.jar")),
+                          QUrl(QStringLiteral("https://piston-data.mojang.com/client.jar"))};
+        client.savePath = tempDir.filePath(QStringLiteral("client.jar"));
+        client.size = 5000000000LL;
+        client.sha1 = QStringLiteral("0123456789abcdef0123456789abcdef01234567");
+        client.priority = 10;
+        client.done = true;
+        InstallCheckpoint::Item natives;
+        natives.mirrors = {QUrl(QStringLiteral("https://libraries.minecraft.net/lwjgl-natives.jar"))};
+        natives.savePath = tempDir.filePath(QStringLiteral("lwjgl-natives.jar"));
+        natives.extractNatives = true;
+        checkpoint.items = {client, natives};
+        checkpoint.nativeJars = {natives.savePath};
+
+        if (!checkpoint.save(path)) {
+            qCritical() << "Failed to save checkpoint";
+            return 1;
+        }
+
+        InstallCheckpoint loaded;
+        if (!InstallCheckpoint::load(path, &loaded)) {
+            qCritical() << "Failed to load checkpoint";
+            return 1;
+        }
+        if (loaded.planKey != checkpoint.planKey || loaded.items.size() != 2
+            || loaded.nativeJars != checkpoint.nativeJars) {
+            qCritical() << "Checkpoint content differs";
+            return 1;
+        }
+        const InstallCheckpoint::Item &first = loaded.items.at(0);
+        const InstallCheckpoint::Item &second = loaded.items.at(1);
+        if (first.mirrors != client.mirrors || first.savePath != client.savePath || first.size != client.size
+            || first.sha1 != client.sha1 || first.priority != 10 || !first.done || first.extractNatives) {
+            qCritical() << "First item differs";
+            return 1;
+        }
+        if (second.size != -1 || !second.extractNatives || second.done) {
+            qCritical() << "Second item differs";
+            return 1;
+        }
+        if (loaded.remainingCount() != 1) {
+            qCritical() << "Unexpected remaining count:" << loaded.remainingCount();
+            return 1;
+        }
+
+        qInfo() << "Test 1 PASSED";
+    }
+
+    {
+        qInfo() << "\n--- Test 2: Unknown formats and corrupt files are ignored ---";
+
+        QFile file(path);
+        if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+            qCritical() << "Failed to overwrite checkpoint";
+            return 1;
+        }
+        file.write("{\"format\":999,\"planKey\":\"plan\",\"items\":[]}");
+        file.close();
+        if (InstallCheckpoint::load(path, nullptr)) {
+            qCritical() << "Checkpoint with unknown format must be ignored";
+            return 1;
+        }
+
+        if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+            qCritical() << "Failed to overwrite checkpoint";
+            return 1;
+        }
+        file.write("{\"format\":1,\"items\":[");
+        file.close();
+        if (InstallCheckpoint::load(path, nullptr)) {
+            qCritical() << "Truncated checkpoint must be ignored";
+            return 1;
+        }
+
+        InstallCheckpoint::remove(path);
+        if (QFile::exists(path) || InstallCheckpoint::load(path, nullptr)) {
+            qCritical() << "remove() must delete the checkpoint";
+            return 1;
+        }
+
+        qInfo() << "Test 2 PASSED";
+    }
+
+    qInfo() << "\n=== All tests PASSED ===";
+    return 0;
+}
@@ -1,6 +1,7 @@
 #include <QCoreApplication>
 #include <QDebug>
 #include <QDir>
+#include <QEventLoop>
 #include <QProcess>
 
 #include "../Core/AMCSCore.h"
@@ -95,6 +96,28 @@ int main(int argc, char *argv[])
         return 1;
     }
 
+    // Profile and entitlements are independent, so the async calls have both requests in flight together
+    const auto profile = accountApi.fetchProfileAsync();
+    const auto license = accountApi.checkHasGameAsync();
+    while (!profile.isFinished() || !license.isFinished()) {
+        QCoreApplication::processEvents(QEventLoop::WaitForMoreEvents);
+    }
+
+    if (profile.resultCount() == 0 || !profile.result().isOk()) {
+        qCritical().noquote() << "Async fetch profile failed:"
+                              << (profile.resultCount() > 0 ? profile.result().error : QStringLiteral("canceled"));
+        return 1;
+    }
+    if (profile.result().value.id != accountApi.profile().id) {
+        qCritical().noquote() << "Async profile differs from the blocking one";
+        return 1;
+    }
+
+    if (license.resultCount() == 0 || !license.result().isOk() || !license.result().value) {
+        qCritical().noquote() << "Async license check failed";
+        return 1;
+    }
+
     LaunchOptions options;
     // TODO(REPLACE_JAVA_PATH): Temporary hardcoded Java path.
     // TODO(REPLACE_JAVA_PATH): Temporary hardcoded Java path.